@@ -0,0 +1,29 @@
+#include "backgroundjob.h"
+#include <QThread>
+
+BackgroundJob::BackgroundJob(QObject *parent)
+    : QObject(parent)
+{
+}
+
+QThread *BackgroundJob::start()
+{
+    QThread *thread = QThread::create([this] {
+        run();
+        emit done();
+    });
+    connect(thread, &QThread::finished, this, &QObject::deleteLater);
+    connect(thread, &QThread::finished, thread, &QObject::deleteLater);
+    thread->start();
+    return thread;
+}
+
+void BackgroundJob::cancel()
+{
+    interrupter.interrupt();
+}
+
+bool BackgroundJob::isCancelled() const
+{
+    return interrupter.isInterrupted();
+}
@@ -0,0 +1,33 @@
+#ifndef BACKGROUNDJOB_H
+#define BACKGROUNDJOB_H
+
+#include "sqliteutil.h"
+#include <QObject>
+
+class QThread;
+
+// Разовая фоновая операция над базой (экспорт, импорт и т.п.).
+// run() можно вызвать напрямую или запустить в отдельном потоке через start();
+// в последнем случае задача и поток удаляются сами по завершении.
+class BackgroundJob : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit BackgroundJob(QObject *parent = nullptr);
+
+    QThread *start();
+    virtual void run() = 0;
+
+    // Можно вызывать из любого потока
+    void cancel();
+    bool isCancelled() const;
+
+signals:
+    void done();
+
+protected:
+    QueryInterrupter interrupter;
+};
+
+#endif // BACKGROUNDJOB_H
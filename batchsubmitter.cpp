@@ -0,0 +1,162 @@
+#include "batchsubmitter.h"
+#include <QElapsedTimer>
+#include <QMap>
+
+#include <sqlite3.h>
+
+#include <algorithm>
+
+static bool execSql(sqlite3 *db, const char *sql, QString *error = nullptr)
+{
+    char *message = nullptr;
+    const int rc = sqlite3_exec(db, sql, nullptr, nullptr, &message);
+    if (rc != SQLITE_OK && error)
+        *error = QString::fromUtf8(message ? message : sqlite3_errmsg(db));
+    sqlite3_free(message);
+    return rc == SQLITE_OK;
+}
+
+BatchSubmitter::BatchSubmitter(const QString &table, const QString &keyExpression, const QStringList &columns,
+                               const QList<RowChange> &changes, const QString &sourceConnection, QObject *parent)
+    : BackgroundJob(parent),
+    table(table),
+    keyExpression(keyExpression),
+    columns(columns),
+    changes(changes),
+    sourceConnection(sourceConnection)
+{
+}
+
+void BatchSubmitter::setOverwriteConflicts(bool overwrite)
+{
+    overwriteConflicts = overwrite;
+}
+
+void BatchSubmitter::run()
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    ScopedConnection connection(sourceConnection, QStringLiteral("submit"));
+    sqlite3 *db = connection.open() ? connection.handle() : nullptr;
+    if (!db) {
+        emit failed(connection.lastError().text());
+        return;
+    }
+    interrupter.attach(db);
+
+    // Группы по набору столбцов: UPDATE - строки с ключом, INSERT - новые
+    QMap<QList<int>, QList<qsizetype>> updates;
+    QMap<QList<int>, QList<qsizetype>> inserts;
+    for (qsizetype i = 0; i < changes.size(); ++i) {
+        QList<int> changed = changes.at(i).values.keys();
+        std::sort(changed.begin(), changed.end());
+        (changes.at(i).key.isValid() ? updates : inserts)[changed] << i;
+    }
+
+    QString errorText;
+    QList<int> conflicts;
+    qint64 done = 0;
+    qint64 updated = 0;
+    qint64 inserted = 0;
+
+    auto runGroup = [&](const QByteArray &sql, const QList<qsizetype> &rows, bool isUpdate) {
+        sqlite3_stmt *stmt = nullptr;
+        if (sqlite3_prepare_v2(db, sql.constData(), int(sql.size()), &stmt, nullptr) != SQLITE_OK) {
+            errorText = QString::fromUtf8(sqlite3_errmsg(db));
+            return;
+        }
+
+        for (qsizetype index : rows) {
+            if (isCancelled())
+                break;
+            const RowChange &change = changes.at(index);
+            QList<int> changed = change.values.keys();
+            std::sort(changed.begin(), changed.end());
+
+            int parameter = 1;
+            for (int column : std::as_const(changed))
+                bindVariant(stmt, parameter++, change.values.value(column));
+            if (isUpdate) {
+                bindVariant(stmt, parameter++, change.key);
+                if (!overwriteConflicts) {
+                    for (int column : std::as_const(changed))
+                        bindVariant(stmt, parameter++, change.original.value(column));
+                }
+            }
+
+            if (sqlite3_step(stmt) != SQLITE_DONE) {
+                errorText = tr("Не удалось сохранить строку %1:\n%2")
+                                .arg(change.row + 1)
+                                .arg(QString::fromUtf8(sqlite3_errmsg(db)));
+                break;
+            }
+            sqlite3_reset(stmt);
+
+            if (!isUpdate)
+                ++inserted;
+            else if (sqlite3_changes(db) > 0)
+                ++updated;
+            else if (!overwriteConflicts)
+                conflicts << change.row;
+
+            if (++done % ProgressInterval == 0)
+                emit progress(done, changes.size());
+        }
+        sqlite3_finalize(stmt);
+    };
+
+    if (execSql(db, "BEGIN IMMEDIATE", &errorText)) {
+        const QByteArray quotedTable = quoteIdentifier(table).toUtf8();
+
+        for (auto group = updates.cbegin(); group != updates.cend() && errorText.isEmpty() && !isCancelled(); ++group) {
+            QStringList assignments;
+            QStringList checks;
+            for (int column : group.key()) {
+                assignments << quoteIdentifier(columns.value(column)) + QLatin1String(" = ?");
+                checks << quoteIdentifier(columns.value(column)) + QLatin1String(" IS ?");
+            }
+            // Проверяются только изменённые столбцы: правки других столбцов той же строки не мешают
+            QByteArray sql = "UPDATE " + quotedTable + " SET " + assignments.join(QLatin1String(", ")).toUtf8()
+                             + " WHERE " + keyExpression.toUtf8() + " = ?";
+            if (!overwriteConflicts)
+                sql += " AND " + checks.join(QLatin1String(" AND ")).toUtf8();
+            runGroup(sql, group.value(), true);
+        }
+
+        for (auto group = inserts.cbegin(); group != inserts.cend() && errorText.isEmpty() && !isCancelled(); ++group) {
+            QByteArray sql = "INSERT INTO " + quotedTable;
+            if (group.key().isEmpty()) {
+                sql += " DEFAULT VALUES";
+            } else {
+                QStringList names;
+                for (int column : group.key())
+                    names << quoteIdentifier(columns.value(column));
+                sql += " (" + names.join(QLatin1String(", ")).toUtf8() + ") VALUES ("
+                       + QByteArray("?, ").repeated(group.key().size()).chopped(2) + ")";
+            }
+            runGroup(sql, group.value(), false);
+        }
+
+        if (errorText.isEmpty() && conflicts.isEmpty() && !isCancelled()) {
+            if (!execSql(db, "COMMIT", &errorText))
+                execSql(db, "ROLLBACK");
+        } else {
+            execSql(db, "ROLLBACK");
+        }
+    }
+
+    interrupter.detach();
+
+    if (isCancelled()) {
+        emit cancelled();
+    } else if (!errorText.isEmpty()) {
+        emit failed(errorText);
+    } else if (!conflicts.isEmpty()) {
+        std::sort(conflicts.begin(), conflicts.end());
+        emit conflicted(conflicts);
+    } else {
+        emit progress(done, changes.size());
+        emit finished(updated, inserted, timer.elapsed());
+    }
+}
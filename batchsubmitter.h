@@ -0,0 +1,59 @@
+#ifndef BATCHSUBMITTER_H
+#define BATCHSUBMITTER_H
+
+#include "backgroundjob.h"
+#include <QHash>
+#include <QList>
+#include <QSqlDatabase>
+#include <QStringList>
+#include <QVariant>
+
+// Несохранённая строка модели
+struct RowChange
+{
+    int row = -1;                   // номер строки в модели, для отчёта о конфликтах
+    QVariant key;                   // невалидный - новая строка
+    QHash<int, QVariant> values;    // номер столбца -> новое значение
+    QHash<int, QVariant> original;  // значения изменённых столбцов на момент чтения
+};
+
+// Сохранение правок одной транзакцией.
+// Строки группируются по виду операции и набору столбцов, каждая группа идёт
+// через один подготовленный запрос. UPDATE сверяет изменённые столбцы с прочитанными
+// значениями: если другое соединение успело изменить или удалить строку,
+// транзакция откатывается и сообщаются конфликтующие строки.
+class BatchSubmitter : public BackgroundJob
+{
+    Q_OBJECT
+
+public:
+    BatchSubmitter(const QString &table, const QString &keyExpression, const QStringList &columns,
+                   const QList<RowChange> &changes,
+                   const QString &sourceConnection = QString::fromLatin1(QSqlDatabase::defaultConnection),
+                   QObject *parent = nullptr);
+
+    // Записать значения поверх чужих изменений без проверки
+    void setOverwriteConflicts(bool overwrite);
+    qint64 rowCount() const { return changes.size(); }
+
+    void run() override;
+
+signals:
+    void progress(qint64 rows, qint64 totalRows);
+    void finished(qint64 updated, qint64 inserted, qint64 elapsedMs);
+    void conflicted(const QList<int> &rows);
+    void cancelled();
+    void failed(const QString &message);
+
+private:
+    static constexpr int ProgressInterval = 1000;
+
+    QString table;
+    QString keyExpression;
+    QStringList columns;
+    QList<RowChange> changes;
+    QString sourceConnection;
+    bool overwriteConflicts = false;
+};
+
+#endif // BATCHSUBMITTER_H
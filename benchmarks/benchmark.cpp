@@ -0,0 +1,440 @@
+// benchmark.cpp
+// Замеры основных путей работы с данными на синтетической базе.
+// Результаты печатаются в JSON, чтобы их можно было сравнивать между коммитами.
+#include "csvexporter.h"
+#include "csvimporter.h"
+#include "pagedtablemodel.h"
+#include "resultset.h"
+#include "sqlitestatement.h"
+#include "sqliteutil.h"
+#include "statementcache.h"
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QRandomGenerator>
+#include <QSqlDatabase>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QSqlRecord>
+#include <QSysInfo>
+#include <QTemporaryDir>
+#include <QThreadPool>
+
+#include <sqlite3.h>
+
+#include <cstdio>
+
+#if defined(Q_OS_WIN)
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+static qint64 peakRssBytes()
+{
+#if defined(Q_OS_WIN)
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return qint64(counters.PeakWorkingSetSize);
+    return -1;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return -1;
+#if defined(Q_OS_DARWIN)
+    return qint64(usage.ru_maxrss);
+#else
+    return qint64(usage.ru_maxrss) * 1024;
+#endif
+#endif
+}
+
+static double perSecond(double amount, qint64 elapsedMs)
+{
+    return amount / (qMax<qint64>(elapsedMs, 1) / 1000.0);
+}
+
+// Форма таблицы задаётся строкой типов столбцов: i — INTEGER, r — REAL, t — TEXT
+static QString tableDefinition(const QString &table, const QString &shape)
+{
+    QStringList columns { QStringLiteral("id INTEGER PRIMARY KEY") };
+    for (int i = 0; i < shape.size(); ++i) {
+        const QChar type = shape.at(i);
+        columns << QStringLiteral("c%1 %2").arg(i + 1).arg(type == QLatin1Char('i') ? QStringLiteral("INTEGER")
+                                                           : type == QLatin1Char('r') ? QStringLiteral("REAL")
+                                                                                      : QStringLiteral("TEXT"));
+    }
+    return QStringLiteral("CREATE TABLE %1 (%2)").arg(quoteIdentifier(table), columns.join(QLatin1String(", ")));
+}
+
+static QJsonObject generate(sqlite3 *db, const QString &shape, qint64 rows, int textLength)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    sqlite3_exec(db, tableDefinition(QStringLiteral("bench"), shape).toUtf8().constData(), nullptr, nullptr, nullptr);
+    sqlite3_exec(db, "BEGIN", nullptr, nullptr, nullptr);
+
+    const QByteArray sql = "INSERT INTO bench VALUES (?" + QByteArray(", ?").repeated(shape.size()) + ")";
+    sqlite3_stmt *stmt = nullptr;
+    sqlite3_prepare_v2(db, sql.constData(), -1, &stmt, nullptr);
+
+    QRandomGenerator random(42);
+    static const char alphabet[] = "abcdefghijklmnopqrstuvwxyz ,\"";
+    QByteArray text(textLength, Qt::Uninitialized);
+    for (qint64 row = 1; row <= rows; ++row) {
+        sqlite3_bind_int64(stmt, 1, row);
+        for (int i = 0; i < shape.size(); ++i) {
+            const QChar type = shape.at(i);
+            if (type == QLatin1Char('i')) {
+                sqlite3_bind_int64(stmt, i + 2, random.bounded(1000000));
+            } else if (type == QLatin1Char('r')) {
+                sqlite3_bind_double(stmt, i + 2, random.generateDouble() * 1000.0);
+            } else {
+                for (char &ch : text)
+                    ch = alphabet[random.bounded(int(sizeof(alphabet) - 1))];
+                sqlite3_bind_text(stmt, i + 2, text.constData(), int(text.size()), SQLITE_TRANSIENT);
+            }
+        }
+        sqlite3_step(stmt);
+        sqlite3_reset(stmt);
+    }
+    sqlite3_finalize(stmt);
+    sqlite3_exec(db, "COMMIT", nullptr, nullptr, nullptr);
+
+    return QJsonObject {
+        { QStringLiteral("rows"), rows },
+        { QStringLiteral("elapsed_ms"), timer.elapsed() },
+        { QStringLiteral("rows_per_sec"), perSecond(rows, timer.elapsed()) },
+    };
+}
+
+static QJsonObject benchExport(const QString &fileName)
+{
+    QJsonObject result;
+    CsvExporter exporter(fileName, QStringLiteral("SELECT * FROM bench"));
+    QObject::connect(&exporter, &CsvExporter::finished, [&result](qint64 rows, qint64 bytes, qint64 elapsedMs) {
+        result.insert(QStringLiteral("rows"), rows);
+        result.insert(QStringLiteral("bytes"), bytes);
+        result.insert(QStringLiteral("elapsed_ms"), elapsedMs);
+        result.insert(QStringLiteral("rows_per_sec"), perSecond(rows, elapsedMs));
+        result.insert(QStringLiteral("mb_per_sec"), perSecond(bytes / (1024.0 * 1024.0), elapsedMs));
+    });
+    QObject::connect(&exporter, &CsvExporter::failed, [&result](const QString &message) {
+        result.insert(QStringLiteral("error"), message);
+    });
+    exporter.run();
+    return result;
+}
+
+static QJsonObject benchImport(sqlite3 *db, const QString &fileName, const QString &shape)
+{
+    sqlite3_exec(db, tableDefinition(QStringLiteral("bench_import"), shape).toUtf8().constData(), nullptr, nullptr, nullptr);
+
+    QJsonObject result;
+    CsvImporter importer(fileName, QStringLiteral("bench_import"));
+    QObject::connect(&importer, &CsvImporter::finished, [&result](qint64 rows, qint64 bytes, qint64 elapsedMs) {
+        result.insert(QStringLiteral("rows"), rows);
+        result.insert(QStringLiteral("bytes"), bytes);
+        result.insert(QStringLiteral("elapsed_ms"), elapsedMs);
+        result.insert(QStringLiteral("rows_per_sec"), perSecond(rows, elapsedMs));
+        result.insert(QStringLiteral("mb_per_sec"), perSecond(bytes / (1024.0 * 1024.0), elapsedMs));
+    });
+    QObject::connect(&importer, &CsvImporter::failed, [&result](const QString &message) {
+        result.insert(QStringLiteral("error"), message);
+    });
+    importer.run();
+    return result;
+}
+
+static QJsonObject benchBrowse()
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    PagedTableModel model;
+    model.setTable(QStringLiteral("bench"));
+    if (!model.select())
+        return QJsonObject { { QStringLiteral("error"), model.lastError().text() } };
+    model.data(model.index(0, 0));
+    const qint64 firstRowUs = timer.nsecsElapsed() / 1000;
+
+    // Переход в середину и в конец таблицы, как при перетаскивании полосы прокрутки
+    timer.restart();
+    model.data(model.index(model.rowCount() / 2, 0));
+    const qint64 middleRowUs = timer.nsecsElapsed() / 1000;
+
+    timer.restart();
+    model.data(model.index(model.rowCount() - 1, 0));
+    const qint64 lastRowUs = timer.nsecsElapsed() / 1000;
+
+    const StatementCache::Stats cache =
+        StatementCache::forConnection(QString::fromLatin1(QSqlDatabase::defaultConnection)).stats();
+    return QJsonObject {
+        { QStringLiteral("time_to_first_row_us"), firstRowUs },
+        { QStringLiteral("jump_to_middle_us"), middleRowUs },
+        { QStringLiteral("jump_to_end_us"), lastRowUs },
+        { QStringLiteral("estimated_rows"), model.rowCount() },
+        { QStringLiteral("statement_cache_hits"), cache.hits },
+        { QStringLiteral("statement_cache_misses"), cache.misses },
+    };
+}
+
+// Чтение всей таблицы в ResultSet, как результат запроса в окне; для сравнения
+// оценивается объём того же результата в виде QVariant на ячейку
+static QJsonObject benchResultSet(sqlite3 *db)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    sqlite3_stmt *stmt = nullptr;
+    if (sqlite3_prepare_v2(db, "SELECT * FROM bench", -1, &stmt, nullptr) != SQLITE_OK)
+        return QJsonObject { { QStringLiteral("error"), QString::fromUtf8(sqlite3_errmsg(db)) } };
+    ResultSet result(sqlite3_column_count(stmt));
+    while (sqlite3_step(stmt) == SQLITE_ROW)
+        result.appendRow(stmt);
+    sqlite3_finalize(stmt);
+    const qint64 fillMs = timer.elapsed();
+
+    // Заголовок QList и QString - 16 байт плюс данные
+    qint64 variantBytes = 0;
+    for (int row = 0; row < result.rowCount(); ++row) {
+        variantBytes += qint64(sizeof(QVariantList)) + 16 + result.columnCount() * qint64(sizeof(QVariant));
+        for (int column = 0; column < result.columnCount(); ++column) {
+            if (result.type(row, column) == SQLITE_TEXT)
+                variantBytes += 16 + result.value(row, column).toString().size() * qint64(sizeof(QChar));
+        }
+    }
+
+    // Чтение ячеек вразброс, как при прокрутке
+    QRandomGenerator random(42);
+    timer.restart();
+    qint64 checksum = 0;
+    constexpr int Reads = 100000;
+    for (int i = 0; i < Reads && result.rowCount() > 0; ++i) {
+        const QVariant value = result.value(int(random.bounded(result.rowCount())),
+                                            int(random.bounded(result.columnCount())));
+        checksum += value.isNull() ? 0 : 1;
+    }
+    const qint64 readUs = timer.nsecsElapsed() / 1000;
+
+    return QJsonObject {
+        { QStringLiteral("rows"), result.rowCount() },
+        { QStringLiteral("fill_ms"), fillMs },
+        { QStringLiteral("rows_per_sec"), perSecond(result.rowCount(), fillMs) },
+        { QStringLiteral("bytes"), result.byteSize() },
+        { QStringLiteral("variant_bytes_estimate"), variantBytes },
+        { QStringLiteral("random_reads_ns_per_value"), Reads > 0 ? readUs * 1000.0 / Reads : 0.0 },
+        { QStringLiteral("non_null_reads"), checksum },
+    };
+}
+
+// Чтение и вставка одних и тех же данных через QSqlQuery с QVariant
+// и через SqliteStatement с типизированной привязкой
+static QJsonObject benchBulkPaths(sqlite3 *db, int insertRows)
+{
+    QElapsedTimer timer;
+    QSqlDatabase database = QSqlDatabase::database();
+
+    qint64 qtBytes = 0;
+    timer.start();
+    {
+        QSqlQuery query(database);
+        query.setForwardOnly(true);
+        if (!query.exec(QStringLiteral("SELECT * FROM bench")))
+            return QJsonObject { { QStringLiteral("error"), query.lastError().text() } };
+        const int columns = query.record().count();
+        while (query.next()) {
+            for (int i = 0; i < columns; ++i)
+                qtBytes += query.value(i).toString().toUtf8().size();
+        }
+    }
+    const qint64 qtReadMs = timer.elapsed();
+
+    qint64 nativeBytes = 0;
+    timer.restart();
+    {
+        SqliteStatement query(db, QByteArrayLiteral("SELECT * FROM bench"));
+        if (!query.isValid())
+            return QJsonObject { { QStringLiteral("error"), query.errorText() } };
+        const int columns = query.columnCount();
+        int size = 0;
+        while (query.step() == SQLITE_ROW) {
+            for (int i = 0; i < columns; ++i) {
+                query.columnText(i, &size);
+                nativeBytes += size;
+            }
+        }
+    }
+    const qint64 nativeReadMs = timer.elapsed();
+
+    // Вставки во временную таблицу откатываются, база остаётся прежней
+    sqlite3_exec(db, "CREATE TEMP TABLE bench_insert (i INTEGER, r REAL, t TEXT)", nullptr, nullptr, nullptr);
+    QList<QByteArray> texts;
+    texts.reserve(insertRows);
+    for (int row = 0; row < insertRows; ++row)
+        texts << QByteArray("value-") + QByteArray::number(row);
+
+    timer.restart();
+    database.transaction();
+    {
+        QSqlQuery insert(database);
+        insert.prepare(QStringLiteral("INSERT INTO temp.bench_insert VALUES (?, ?, ?)"));
+        for (int row = 0; row < insertRows; ++row) {
+            insert.bindValue(0, qint64(row));
+            insert.bindValue(1, row * 0.5);
+            insert.bindValue(2, QString::fromUtf8(texts.at(row)));
+            insert.exec();
+        }
+    }
+    database.rollback();
+    const qint64 qtInsertMs = timer.elapsed();
+
+    timer.restart();
+    sqlite3_exec(db, "BEGIN", nullptr, nullptr, nullptr);
+    {
+        SqliteStatement insert(db, QByteArrayLiteral("INSERT INTO temp.bench_insert VALUES (?, ?, ?)"),
+                               SqliteStatement::Persistent);
+        for (int row = 0; row < insertRows; ++row) {
+            insert.bindAll(qint64(row), row * 0.5, texts.at(row));
+            insert.exec();
+        }
+    }
+    sqlite3_exec(db, "ROLLBACK", nullptr, nullptr, nullptr);
+    const qint64 nativeInsertMs = timer.elapsed();
+    sqlite3_exec(db, "DROP TABLE temp.bench_insert", nullptr, nullptr, nullptr);
+
+    return QJsonObject {
+        { QStringLiteral("read_qt_ms"), qtReadMs },
+        { QStringLiteral("read_native_ms"), nativeReadMs },
+        { QStringLiteral("read_qt_bytes"), qtBytes },
+        { QStringLiteral("read_native_bytes"), nativeBytes },
+        { QStringLiteral("insert_rows"), insertRows },
+        { QStringLiteral("insert_qt_ms"), qtInsertMs },
+        { QStringLiteral("insert_native_ms"), nativeInsertMs },
+        { QStringLiteral("insert_native_rows_per_sec"), perSecond(insertRows, nativeInsertMs) },
+    };
+}
+
+// Тот же путь, что и удаление выбранных строк в окне: набор строк модели
+// удаляется по ключам через временную таблицу, модель убирает их на месте
+static QJsonObject benchDelete(int count)
+{
+    PagedTableModel model;
+    model.setTable(QStringLiteral("bench"));
+    if (!model.select())
+        return QJsonObject { { QStringLiteral("error"), model.lastError().text() } };
+    QThreadPool::globalInstance()->waitForDone();
+
+    QList<int> rows;
+    const int step = qMax(1, model.rowCount() / qMax(count, 1));
+    for (int row = 0; row < model.rowCount() && rows.size() < count; row += step)
+        rows << row;
+
+    QElapsedTimer timer;
+    timer.start();
+    if (!model.deleteRows(rows))
+        return QJsonObject { { QStringLiteral("error"), model.lastError().text() } };
+
+    return QJsonObject {
+        { QStringLiteral("rows"), int(rows.size()) },
+        { QStringLiteral("elapsed_ms"), timer.elapsed() },
+        { QStringLiteral("rows_per_sec"), perSecond(rows.size(), timer.elapsed()) },
+    };
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral("Замеры импорта, экспорта, просмотра и удаления"));
+    parser.addHelpOption();
+    const QCommandLineOption rowsOption(QStringLiteral("rows"), QStringLiteral("Строк в синтетической таблице."),
+                                        QStringLiteral("n"), QStringLiteral("1000000"));
+    const QCommandLineOption shapeOption(QStringLiteral("shape"),
+                                         QStringLiteral("Типы столбцов: i — INTEGER, r — REAL, t — TEXT."),
+                                         QStringLiteral("types"), QStringLiteral("itrtt"));
+    const QCommandLineOption textOption(QStringLiteral("text-length"), QStringLiteral("Длина текстовых значений."),
+                                        QStringLiteral("n"), QStringLiteral("24"));
+    const QCommandLineOption deleteOption(QStringLiteral("delete-rows"), QStringLiteral("Сколько строк удалять."),
+                                          QStringLiteral("n"), QStringLiteral("10000"));
+    const QCommandLineOption dirOption(QStringLiteral("dir"),
+                                       QStringLiteral("Каталог для базы и CSV (по умолчанию временный)."),
+                                       QStringLiteral("path"));
+    const QCommandLineOption outputOption(QStringLiteral("output"),
+                                          QStringLiteral("Файл для JSON (по умолчанию stdout)."),
+                                          QStringLiteral("file"));
+    parser.addOptions({ rowsOption, shapeOption, textOption, deleteOption, dirOption, outputOption });
+    parser.process(app);
+
+    const qint64 rows = parser.value(rowsOption).toLongLong();
+    const QString shape = parser.value(shapeOption);
+    const int textLength = parser.value(textOption).toInt();
+    const int deleteRows = parser.value(deleteOption).toInt();
+
+    QTemporaryDir temporaryDir;
+    const QDir dir(parser.isSet(dirOption) ? parser.value(dirOption) : temporaryDir.path());
+    const QString databaseFile = dir.filePath(QStringLiteral("bench.sqlite"));
+    const QString csvFile = dir.filePath(QStringLiteral("bench.csv"));
+    QFile::remove(databaseFile);
+
+    QJsonObject results;
+    {
+        QSqlDatabase db = QSqlDatabase::addDatabase(QStringLiteral("QSQLITE"));
+        db.setDatabaseName(databaseFile);
+        if (!db.open()) {
+            std::fprintf(stderr, "%s\n", qPrintable(db.lastError().text()));
+            return 1;
+        }
+        sqlite3 *handle = sqliteHandle(db);
+
+        results.insert(QStringLiteral("generate"), generate(handle, shape, rows, textLength));
+        results.insert(QStringLiteral("export"), benchExport(csvFile));
+        results.insert(QStringLiteral("import"), benchImport(handle, csvFile, shape));
+        results.insert(QStringLiteral("browse"), benchBrowse());
+        results.insert(QStringLiteral("result_set"), benchResultSet(handle));
+        results.insert(QStringLiteral("bulk_paths"), benchBulkPaths(handle, int(qMin<qint64>(rows, 200000))));
+
+        // Фоновый подсчёт строк модели держит читающую транзакцию
+        QThreadPool::globalInstance()->waitForDone();
+        results.insert(QStringLiteral("delete"), benchDelete(deleteRows));
+        QThreadPool::globalInstance()->waitForDone();
+        StatementCache::removeForConnection(QString::fromLatin1(QSqlDatabase::defaultConnection));
+        db.close();
+    }
+    QSqlDatabase::removeDatabase(QString::fromLatin1(QSqlDatabase::defaultConnection));
+    QFile::remove(csvFile);
+
+    const QJsonObject report {
+        { QStringLiteral("config"), QJsonObject {
+              { QStringLiteral("rows"), rows },
+              { QStringLiteral("shape"), shape },
+              { QStringLiteral("text_length"), textLength },
+              { QStringLiteral("delete_rows"), deleteRows },
+              { QStringLiteral("sqlite_version"), QString::fromLatin1(sqlite3_libversion()) },
+              { QStringLiteral("cpu"), QSysInfo::currentCpuArchitecture() },
+              { QStringLiteral("threads"), QThreadPool::globalInstance()->maxThreadCount() },
+          } },
+        { QStringLiteral("results"), results },
+        { QStringLiteral("peak_rss_bytes"), peakRssBytes() },
+    };
+
+    const QByteArray json = QJsonDocument(report).toJson(QJsonDocument::Indented);
+    if (parser.isSet(outputOption)) {
+        QFile output(parser.value(outputOption));
+        if (!output.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            std::fprintf(stderr, "%s\n", qPrintable(output.errorString()));
+            return 1;
+        }
+        output.write(json);
+    } else {
+        std::fwrite(json.constData(), 1, size_t(json.size()), stdout);
+    }
+    return 0;
+}
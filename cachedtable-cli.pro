@@ -0,0 +1,8 @@
+QT += sql
+QT -= gui
+CONFIG += console
+CONFIG -= app_bundle
+TARGET = cachedtable-cli
+TEMPLATE = app
+include(engine.pri)
+SOURCES += climain.cpp
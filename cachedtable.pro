@@ -1,5 +1,6 @@
 QT += sql widgets printsupport
 TARGET = DatabaseAdmin
 TEMPLATE = app
-SOURCES += main.cpp databaseadmin.cpp
-HEADERS += databaseadmin.h
+include(engine.pri)
+SOURCES += main.cpp databaseadmin.cpp columnprofilepanel.cpp queryprofilerpanel.cpp scriptresultpanel.cpp searchpanel.cpp tablepickerdialog.cpp
+HEADERS += databaseadmin.h columnprofilepanel.h queryprofilerpanel.h scriptresultpanel.h searchpanel.h tablepickerdialog.h
@@ -0,0 +1,407 @@
+#include "changetracker.h"
+#include "sqliteutil.h"
+#include <QMutexLocker>
+#include <QSqlDatabase>
+
+#include <sqlite3.h>
+
+#include <cstring>
+
+static QMutex trackersMutex;
+static QHash<QString, std::shared_ptr<ChangeTracker>> connectionTrackers;
+
+// Дескриптор -> его Hook, для ReadAuthorizer
+static QMutex handlesMutex;
+static QHash<sqlite3 *, void *> trackedHandles;
+
+ChangeTracker::ChangeTracker(const QString &connectionName)
+{
+    source = sqliteHandle(QSqlDatabase::database(connectionName, false));
+    if (source)
+        attach(source);
+    qint64 dataVersion = -1;
+    qint64 schemaVersion = -1;
+    readVersions(&dataVersion, &schemaVersion);
+}
+
+ChangeTracker::~ChangeTracker()
+{
+    detachSource();
+    qDeleteAll(hooks);
+}
+
+void ChangeTracker::attach(sqlite3 *handle)
+{
+    if (!handle)
+        return;
+
+    auto *hook = new Hook;
+    hook->tracker = this;
+    hook->handle = handle;
+    hook->isSource = handle == source;
+    hook->changesBase = sqlite3_total_changes64(handle);
+    {
+        QMutexLocker locker(&mutex);
+        hooks << hook;
+    }
+    {
+        QMutexLocker locker(&handlesMutex);
+        trackedHandles.insert(handle, hook);
+    }
+    sqlite3_update_hook(handle, &ChangeTracker::updateHook, hook);
+    sqlite3_commit_hook(handle, &ChangeTracker::commitHook, hook);
+    sqlite3_rollback_hook(handle, &ChangeTracker::rollbackHook, hook);
+    sqlite3_set_authorizer(handle, &ChangeTracker::authorizerHook, hook);
+}
+
+void ChangeTracker::detach(sqlite3 *handle)
+{
+    if (!handle)
+        return;
+
+    Hook *hook = nullptr;
+    {
+        QMutexLocker locker(&mutex);
+        for (qsizetype i = 0; i < hooks.size(); ++i) {
+            if (hooks.at(i)->handle == handle) {
+                hook = hooks.takeAt(i);
+                break;
+            }
+        }
+    }
+    if (!hook)
+        return;
+
+    // Последний оператор в автофиксации клона уже учтён в total_changes
+    if (hasUnseenChanges(hook)) {
+        QMutexLocker locker(&mutex);
+        markUnknown();
+    }
+    {
+        QMutexLocker locker(&handlesMutex);
+        trackedHandles.remove(handle);
+    }
+    sqlite3_update_hook(handle, nullptr, nullptr);
+    sqlite3_commit_hook(handle, nullptr, nullptr);
+    sqlite3_rollback_hook(handle, nullptr, nullptr);
+    sqlite3_set_authorizer(handle, nullptr, nullptr);
+    delete hook;
+}
+
+int ChangeTracker::authorize(sqlite3 *handle, int action, const char *first, const char *second,
+                             const char *database, const char *trigger)
+{
+    void *hook = nullptr;
+    {
+        QMutexLocker locker(&handlesMutex);
+        hook = trackedHandles.value(handle);
+    }
+    return hook ? authorizerHook(hook, action, first, second, database, trigger) : SQLITE_OK;
+}
+
+void ChangeTracker::restoreAuthorizer(sqlite3 *handle)
+{
+    QMutexLocker locker(&handlesMutex);
+    void *hook = trackedHandles.value(handle);
+    sqlite3_set_authorizer(handle, hook ? &ChangeTracker::authorizerHook : nullptr, hook);
+}
+
+void ChangeTracker::detachSource()
+{
+    if (!source)
+        return;
+    sqlite3_finalize(versionStatement);
+    versionStatement = nullptr;
+    detach(source);
+    source = nullptr;
+}
+
+void ChangeTracker::addRow(TableRows &target, qint64 rowid, int flags)
+{
+    if (target.overflow)
+        return;
+
+    const auto it = target.rows.find(rowid);
+    if (it != target.rows.end()) {
+        // RowExisted определяется первым изменением строки
+        *it |= flags & ~RowExisted;
+        return;
+    }
+    if (target.rows.size() >= MaxTrackedRows) {
+        target.rows.clear();
+        target.overflow = true;
+        return;
+    }
+    target.rows.insert(rowid, flags);
+}
+
+bool ChangeTracker::hasUnseenChanges(Hook *hook)
+{
+    // Невидимые строки учитываются один раз: дальше сверка идёт от текущего итога
+    const qint64 unseen = sqlite3_total_changes64(hook->handle) - hook->changesBase - hook->changesSeen;
+    if (unseen <= 0)
+        return false;
+    hook->changesBase += unseen;
+    return true;
+}
+
+void ChangeTracker::markUnknown()
+{
+    for (Subscriber &subscriber : subscribers)
+        subscriber.unknown = true;
+}
+
+void ChangeTracker::updateHook(void *context, int operation, const char *database, const char *table, qint64 rowid)
+{
+    auto *hook = static_cast<Hook *>(context);
+    // total_changes считает строки всех баз, поэтому и вызовы считаются до фильтра
+    ++hook->changesSeen;
+    // Временные и присоединённые базы не показываются
+    if (std::strcmp(database, "main") != 0)
+        return;
+
+    if (!hook->lastRows || hook->lastTable != table) {
+        hook->lastTable = table;
+        hook->lastRows = &hook->pending[hook->lastTable.toLower()];
+    }
+
+    int flags = RowUpdated | RowExisted;
+    if (operation == SQLITE_INSERT)
+        flags = RowInserted;
+    else if (operation == SQLITE_DELETE)
+        flags = RowDeleted | RowExisted;
+    addRow(*hook->lastRows, rowid, flags);
+}
+
+int ChangeTracker::authorizerHook(void *context, int action, const char *first, const char *second,
+                                  const char *database, const char *trigger)
+{
+    Q_UNUSED(second)
+    Q_UNUSED(trigger)
+    if (action != SQLITE_INSERT && action != SQLITE_UPDATE && action != SQLITE_DELETE)
+        return SQLITE_OK;
+    // sqlite_master и sqlite_sequence меняет DDL: SQLITE_IGNORE для них отменил бы DROP
+    if (!first || !database || std::strcmp(database, "main") != 0 || qstrnicmp(first, "sqlite_", 7) == 0)
+        return SQLITE_OK;
+
+    auto *hook = static_cast<Hook *>(context);
+    hook->writeTargets.insert(QByteArray(first).toLower());
+    // Для DELETE это значит только "без очистки таблицы целиком": строки
+    // удаляются по одной, и update_hook получает каждую
+    return action == SQLITE_DELETE ? SQLITE_IGNORE : SQLITE_OK;
+}
+
+int ChangeTracker::commitHook(void *context)
+{
+    auto *hook = static_cast<Hook *>(context);
+    hook->tracker->commit(hook);
+    return 0;
+}
+
+void ChangeTracker::rollbackHook(void *context)
+{
+    auto *hook = static_cast<Hook *>(context);
+    // Строки откаченных операторов в total_changes не попадают, а вызовы хука по ним были:
+    // без выравнивания этот избыток скрыл бы следующие невидимые записи
+    if (hasUnseenChanges(hook)) {
+        QMutexLocker locker(&hook->tracker->mutex);
+        hook->tracker->markUnknown();
+    }
+    hook->changesBase = sqlite3_total_changes64(hook->handle) - hook->changesSeen;
+    hook->pending.clear();
+    hook->lastRows = nullptr;
+    hook->writeTargets.clear();
+}
+
+void ChangeTracker::commit(Hook *hook)
+{
+    QMutexLocker locker(&mutex);
+
+    // Фиксации клонов меняют data_version исходного соединения так же, как чужие процессы;
+    // счётчик позволяет отличить одни от других
+    if (!hook->isSource)
+        ++foreignCommits;
+    ++commits;
+
+    bool targetsKnown = false;
+    if (hasUnseenChanges(hook)) {
+        for (const QByteArray &table : std::as_const(hook->writeTargets)) {
+            if (withoutRowid.contains(table)) {
+                hook->pending[table].overflow = true;
+                targetsKnown = true;
+            }
+        }
+        if (!targetsKnown)
+            markUnknown();
+    }
+    hook->writeTargets.clear();
+
+    if (hook->pending.isEmpty()) {
+        markUnknown();
+        return;
+    }
+
+    for (auto table = hook->pending.cbegin(); table != hook->pending.cend(); ++table) {
+        const QString name = QString::fromUtf8(table.key());
+        tableVersions.insert(name, commits);
+        for (Subscriber &subscriber : subscribers) {
+            if (subscriber.table != name)
+                continue;
+            if (table->overflow) {
+                subscriber.changes.rows.clear();
+                subscriber.changes.overflow = true;
+                continue;
+            }
+            for (auto row = table->rows.cbegin(); row != table->rows.cend(); ++row)
+                addRow(subscriber.changes, row.key(), row.value());
+        }
+    }
+    hook->pending.clear();
+    hook->lastRows = nullptr;
+}
+
+bool ChangeTracker::readVersions(qint64 *dataVersion, qint64 *schemaVersion)
+{
+    // Один подготовленный запрос на исходном соединении; data_version не меняется
+    // от его собственных фиксаций, только от чужих
+    if (!source)
+        return false;
+    if (!versionStatement
+        && sqlite3_prepare_v2(source, "SELECT * FROM pragma_data_version, pragma_schema_version",
+                              -1, &versionStatement, nullptr) != SQLITE_OK) {
+        versionStatement = nullptr;
+        return false;
+    }
+
+    const bool ok = sqlite3_step(versionStatement) == SQLITE_ROW;
+    if (ok) {
+        *dataVersion = sqlite3_column_int64(versionStatement, 0);
+        *schemaVersion = sqlite3_column_int64(versionStatement, 1);
+    }
+    sqlite3_reset(versionStatement);
+    if (ok && *schemaVersion != withoutRowidSchema)
+        loadWithoutRowid(*schemaVersion);
+    return ok;
+}
+
+void ChangeTracker::loadWithoutRowid(qint64 schemaVersion)
+{
+    // Так же, как SchemaCatalog: по тексту CREATE TABLE
+    QSet<QByteArray> tables;
+    sqlite3_stmt *stmt = nullptr;
+    if (sqlite3_prepare_v2(source, "SELECT lower(name) FROM main.sqlite_master"
+                                   " WHERE type = 'table' AND sql LIKE '%WITHOUT ROWID%'",
+                           -1, &stmt, nullptr) != SQLITE_OK) {
+        sqlite3_finalize(stmt);
+        return;
+    }
+    while (sqlite3_step(stmt) == SQLITE_ROW)
+        tables.insert(QByteArray(reinterpret_cast<const char *>(sqlite3_column_text(stmt, 0))));
+    sqlite3_finalize(stmt);
+
+    withoutRowidSchema = schemaVersion;
+    QMutexLocker locker(&mutex);
+    withoutRowid.swap(tables);
+}
+
+int ChangeTracker::subscribe(const QString &table)
+{
+    Subscriber subscriber;
+    subscriber.table = table.toLower();
+    readVersions(&subscriber.dataVersion, &subscriber.schemaVersion);
+
+    QMutexLocker locker(&mutex);
+    subscriber.foreignCommits = foreignCommits;
+    const int id = nextSubscription++;
+    subscribers.insert(id, subscriber);
+    return id;
+}
+
+void ChangeTracker::unsubscribe(int subscription)
+{
+    QMutexLocker locker(&mutex);
+    subscribers.remove(subscription);
+}
+
+TrackedChanges ChangeTracker::take(int subscription)
+{
+    qint64 dataVersion = -1;
+    qint64 schemaVersion = -1;
+    const bool versions = readVersions(&dataVersion, &schemaVersion);
+
+    TrackedChanges result;
+    QMutexLocker locker(&mutex);
+    // Хук исходного соединения трогает только этот поток; сверка досчитывает
+    // последний оператор в автофиксации, которого commit_hook ещё не видел
+    for (Hook *hook : std::as_const(hooks)) {
+        if (hook->isSource && hasUnseenChanges(hook))
+            markUnknown();
+    }
+    const auto it = subscribers.find(subscription);
+    if (it == subscribers.end())
+        return result;
+
+    result.rows.swap(it->changes.rows);
+    result.overflow = it->changes.overflow;
+    it->changes.overflow = false;
+
+    result.external = it->unknown;
+    it->unknown = false;
+    if (versions) {
+        // Клон мог зафиксировать транзакцию уже после снимка data_version; тогда
+        // чужой записи не будет видно до следующего раза, и она придёт там
+        result.external = result.external
+                          || (dataVersion != it->dataVersion && foreignCommits == it->foreignCommits);
+        result.schemaChanged = schemaVersion != it->schemaVersion;
+        it->dataVersion = dataVersion;
+        it->schemaVersion = schemaVersion;
+    }
+    it->foreignCommits = foreignCommits;
+    return result;
+}
+
+void ChangeTracker::forget(int subscription, const QList<qint64> &rowids)
+{
+    QMutexLocker locker(&mutex);
+    const auto it = subscribers.find(subscription);
+    if (it == subscribers.end())
+        return;
+    for (qint64 rowid : rowids)
+        it->changes.rows.remove(rowid);
+}
+
+quint64 ChangeTracker::commitCount() const
+{
+    QMutexLocker locker(&mutex);
+    return commits;
+}
+
+quint64 ChangeTracker::tableVersion(const QString &table) const
+{
+    QMutexLocker locker(&mutex);
+    return tableVersions.value(table.toLower());
+}
+
+std::shared_ptr<ChangeTracker> ChangeTracker::forConnection(const QString &connectionName)
+{
+    QMutexLocker locker(&trackersMutex);
+    return connectionTrackers.value(connectionName);
+}
+
+void ChangeTracker::setForConnection(const QString &connectionName, const std::shared_ptr<ChangeTracker> &tracker)
+{
+    QMutexLocker locker(&trackersMutex);
+    connectionTrackers.insert(connectionName, tracker);
+}
+
+void ChangeTracker::removeForConnection(const QString &connectionName)
+{
+    std::shared_ptr<ChangeTracker> tracker;
+    {
+        QMutexLocker locker(&trackersMutex);
+        tracker = connectionTrackers.take(connectionName);
+    }
+    // Клоны держат трекер, пока не закроются, а исходное соединение вот-вот закроется
+    if (tracker)
+        tracker->detachSource();
+}
@@ -0,0 +1,149 @@
+#ifndef CHANGETRACKER_H
+#define CHANGETRACKER_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QSet>
+#include <QString>
+
+#include <memory>
+
+struct sqlite3;
+struct sqlite3_stmt;
+
+// Изменения одной таблицы с прошлого ChangeTracker::take()
+struct TrackedChanges
+{
+    QHash<qint64, int> rows;    // rowid -> маска ChangeTracker::RowFlag
+    bool overflow = false;      // строк больше MaxTrackedRows или их не видно, подробности отброшены
+    bool external = false;      // базу меняли соединения без хуков, например другие процессы
+    bool schemaChanged = false;
+
+    bool isEmpty() const { return rows.isEmpty() && !overflow && !external && !schemaChanged; }
+};
+
+// Сбор изменённых строк через sqlite3_update_hook.
+// Хуки ставятся на исходное соединение и на все его клоны ScopedConnection;
+// изменения транзакции попадают подписчикам только при фиксации (commit_hook),
+// при откате отбрасываются. Записи из других процессов хуки не видят, их выдаёт
+// смена PRAGMA data_version. Хуки срабатывают в потоках клонов, поэтому общие
+// данные под мьютексом; take() и subscribe() вызываются в потоке исходного соединения.
+// Авторизатор на тех же дескрипторах запрещает очистку таблицы целиком в DELETE
+// без WHERE, чтобы хук видел каждую строку. Строки таблиц WITHOUT ROWID хук не видит
+// вовсе: их выдаёт разница sqlite3_total_changes() и числа вызовов хука. Если в
+// транзакции готовилась запись в такую таблицу, она считается изменённой целиком
+// (overflow), иначе невидимая запись - изменение неизвестно чего. В автофиксации
+// строки последнего оператора попадают в total_changes уже после commit_hook, поэтому
+// сверка для них проходит позже: при следующей фиксации того же дескриптора, при
+// take() для исходного соединения или при отключении клона. Фиксация без единой
+// известной строки тоже считается изменением неизвестно чего. Строки, вытесненные
+// INSERT OR REPLACE, выглядят как вставка.
+class ChangeTracker
+{
+public:
+    enum RowFlag {
+        RowInserted = 0x1,
+        RowUpdated = 0x2,
+        RowDeleted = 0x4,
+        RowExisted = 0x8    // строка была в таблице до первого изменения
+    };
+
+    // Ставит хуки на открытое исходное соединение
+    explicit ChangeTracker(const QString &connectionName);
+    ~ChangeTracker();
+
+    void attach(sqlite3 *handle);
+    void detach(sqlite3 *handle);
+
+    // ReadAuthorizer временно подменяет авторизатор трекера: передаёт ему вызовы
+    // и возвращает его на место (на неотслеживаемом дескрипторе - снимает)
+    static int authorize(sqlite3 *handle, int action, const char *first, const char *second,
+                         const char *database, const char *trigger);
+    static void restoreAuthorizer(sqlite3 *handle);
+
+    // Пустое имя таблицы - подписка только на признаки external и schemaChanged
+    int subscribe(const QString &table);
+    void unsubscribe(int subscription);
+    TrackedChanges take(int subscription);
+    // Изменения, которые подписчик уже учёл сам
+    void forget(int subscription, const QList<qint64> &rowids);
+
+    // Число фиксаций через хуки и номер последней из них, менявшей таблицу (0 - не менялась)
+    quint64 commitCount() const;
+    quint64 tableVersion(const QString &table) const;
+
+    // Трекер на соединение; клоны ScopedConnection подключаются к нему при открытии.
+    // Удалять нужно до QSqlDatabase::removeDatabase, пока исходное соединение открыто
+    static std::shared_ptr<ChangeTracker> forConnection(const QString &connectionName);
+    static void setForConnection(const QString &connectionName, const std::shared_ptr<ChangeTracker> &tracker);
+    static void removeForConnection(const QString &connectionName);
+
+    static constexpr int MaxTrackedRows = 10000;
+
+private:
+    Q_DISABLE_COPY(ChangeTracker)
+
+    struct TableRows
+    {
+        QHash<qint64, int> rows;
+        bool overflow = false;
+    };
+
+    // Незафиксированные изменения одного дескриптора; трогает их только его поток
+    struct Hook
+    {
+        ChangeTracker *tracker = nullptr;
+        sqlite3 *handle = nullptr;
+        bool isSource = false;
+        QHash<QByteArray, TableRows> pending;
+        QByteArray lastTable;
+        TableRows *lastRows = nullptr;
+        // Таблицы main, в которые готовилась запись с прошлой фиксации или отката
+        QSet<QByteArray> writeTargets;
+        // Вызовы хука с подключения во всех базах и total_changes на момент подключения:
+        // total_changes не может обогнать вызовы хука, если каждую строку было видно
+        qint64 changesSeen = 0;
+        qint64 changesBase = 0;
+    };
+
+    struct Subscriber
+    {
+        QString table;
+        TableRows changes;
+        bool unknown = false;
+        qint64 dataVersion = -1;
+        qint64 schemaVersion = -1;
+        quint64 foreignCommits = 0;
+    };
+
+    static void updateHook(void *context, int operation, const char *database, const char *table, qint64 rowid);
+    static int commitHook(void *context);
+    static void rollbackHook(void *context);
+    static int authorizerHook(void *context, int action, const char *first, const char *second,
+                              const char *database, const char *trigger);
+
+    static void addRow(TableRows &target, qint64 rowid, int flags);
+    static bool hasUnseenChanges(Hook *hook);
+    void commit(Hook *hook);
+    void markUnknown();
+    bool readVersions(qint64 *dataVersion, qint64 *schemaVersion);
+    void loadWithoutRowid(qint64 schemaVersion);
+    void detachSource();
+
+    sqlite3 *source = nullptr;
+    sqlite3_stmt *versionStatement = nullptr;
+
+    mutable QMutex mutex;
+    QList<Hook *> hooks;
+    QHash<int, Subscriber> subscribers;
+    int nextSubscription = 1;
+    quint64 foreignCommits = 0;
+    quint64 commits = 0;
+    QHash<QString, quint64> tableVersions;
+    QSet<QByteArray> withoutRowid;
+    qint64 withoutRowidSchema = -1;
+};
+
+#endif // CHANGETRACKER_H
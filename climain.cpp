@@ -0,0 +1,11 @@
+// climain.cpp
+#include "commandline.h"
+#include <QCoreApplication>
+
+// Консольная программа пакетного режима: только QtCore и QtSql, поэтому
+// на Windows итог виден в консоли, а на сервере не нужны библиотеки GUI
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    return CommandLine().run(app.arguments());
+}
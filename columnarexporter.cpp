@@ -0,0 +1,145 @@
+#include "columnarexporter.h"
+#include "columnarformat.h"
+#include <QElapsedTimer>
+#include <QFile>
+
+#include <sqlite3.h>
+
+#include <vector>
+
+ColumnarExporter::ColumnarExporter(const QString &fileName, const QString &statement, bool compress,
+                                   const QString &sourceConnection, QObject *parent)
+    : BackgroundJob(parent),
+    fileName(fileName),
+    statement(statement),
+    compress(compress),
+    sourceConnection(sourceConnection)
+{
+}
+
+void ColumnarExporter::run()
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Unbuffered)) {
+        emit failed(tr("Не удалось открыть файл для записи:\n%1").arg(file.errorString()));
+        return;
+    }
+
+    ScopedConnection connection(sourceConnection, QStringLiteral("export"));
+    sqlite3 *db = connection.open() ? connection.handle() : nullptr;
+    if (!db) {
+        emit failed(connection.lastError().text());
+        return;
+    }
+
+    const QByteArray sql = statement.toUtf8();
+    sqlite3_stmt *stmt = nullptr;
+    if (sqlite3_prepare_v2(db, sql.constData(), int(sql.size()), &stmt, nullptr) != SQLITE_OK || !stmt) {
+        emit failed(stmt ? QString::fromUtf8(sqlite3_errmsg(db)) : tr("Пустой запрос"));
+        sqlite3_finalize(stmt);
+        return;
+    }
+    interrupter.attach(db);
+
+    qint64 rows = 0;
+    qint64 bytes = 0;
+    QString errorText;
+
+    const int columnCount = sqlite3_column_count(stmt);
+    if (columnCount == 0)
+        errorText = tr("Запрос не возвращает строк");
+
+    QByteArray out;
+    auto write = [&]() {
+        if (file.write(out) != out.size()) {
+            errorText = file.errorString();
+            return false;
+        }
+        bytes += out.size();
+        out.resize(0);  // ёмкость буфера сохраняется
+        return true;
+    };
+
+    std::vector<ColumnarFormat::ChunkBuilder> builders(size_t(columnCount));
+    int groupRows = 0;
+    qint64 groupBytes = 0;
+    auto writeGroup = [&]() {
+        ColumnarFormat::writeGroupStart(out, groupRows);
+        for (ColumnarFormat::ChunkBuilder &builder : builders)
+            builder.flush(out, compress);
+        groupRows = 0;
+        groupBytes = 0;
+        return write();
+    };
+
+    if (errorText.isEmpty()) {
+        QStringList columns;
+        QStringList declaredTypes;
+        for (int column = 0; column < columnCount; ++column) {
+            columns << QString::fromUtf8(sqlite3_column_name(stmt, column));
+            // Экзотический тип импорт отверг бы вместе со всем дампом - столбец останется без типа
+            const QString type = QString::fromUtf8(sqlite3_column_decltype(stmt, column));
+            declaredTypes << (ColumnarFormat::isTypeName(type) ? type : QString());
+        }
+        ColumnarFormat::writeHeader(out, columns, declaredTypes);
+        write();
+    }
+
+    int rc = SQLITE_DONE;
+    while (errorText.isEmpty() && (rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        for (int column = 0; column < columnCount; ++column) {
+            ColumnarFormat::ChunkBuilder &builder = builders[size_t(column)];
+            switch (sqlite3_column_type(stmt, column)) {
+            case SQLITE_INTEGER:
+                builder.addInteger(sqlite3_column_int64(stmt, column));
+                break;
+            case SQLITE_FLOAT:
+                builder.addReal(sqlite3_column_double(stmt, column));
+                break;
+            case SQLITE_NULL:
+                builder.addNull();
+                break;
+            case SQLITE_BLOB:
+                builder.addBytes(ColumnarFormat::Blob, static_cast<const char *>(sqlite3_column_blob(stmt, column)),
+                                 sqlite3_column_bytes(stmt, column));
+                groupBytes += sqlite3_column_bytes(stmt, column);
+                break;
+            default:
+                builder.addBytes(ColumnarFormat::Text, reinterpret_cast<const char *>(sqlite3_column_text(stmt, column)),
+                                 sqlite3_column_bytes(stmt, column));
+                groupBytes += sqlite3_column_bytes(stmt, column);
+                break;
+            }
+        }
+        ++rows;
+
+        if ((++groupRows == ColumnarFormat::RowsPerGroup || groupBytes >= ColumnarFormat::MaxGroupBytes)
+            && writeGroup())
+            emit progress(rows, bytes);
+    }
+    if (errorText.isEmpty() && rc != SQLITE_DONE && !isCancelled())
+        errorText = QString::fromUtf8(sqlite3_errmsg(db));
+    sqlite3_finalize(stmt);
+    interrupter.detach();
+
+    if (errorText.isEmpty() && !isCancelled()) {
+        if (groupRows == 0 || writeGroup()) {
+            ColumnarFormat::writeEnd(out, rows);
+            write();
+        }
+    }
+    file.close();
+
+    if (isCancelled() || !errorText.isEmpty())
+        file.remove();
+
+    if (isCancelled())
+        emit cancelled();
+    else if (!errorText.isEmpty())
+        emit failed(errorText);
+    else
+        emit finished(rows, bytes, timer.elapsed());
+}
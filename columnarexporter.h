@@ -0,0 +1,34 @@
+#ifndef COLUMNAREXPORTER_H
+#define COLUMNAREXPORTER_H
+
+#include "backgroundjob.h"
+#include <QSqlDatabase>
+
+// Потоковый экспорт результата SELECT в колоночный дамп (см. columnarformat.h).
+// Значения берутся прямо из sqlite3_column_* в типизированные буферы группы строк,
+// без QVariant и QString; в памяти одновременно только одна группа.
+class ColumnarExporter : public BackgroundJob
+{
+    Q_OBJECT
+
+public:
+    ColumnarExporter(const QString &fileName, const QString &statement, bool compress = true,
+                     const QString &sourceConnection = QString::fromLatin1(QSqlDatabase::defaultConnection),
+                     QObject *parent = nullptr);
+
+    void run() override;
+
+signals:
+    void progress(qint64 rows, qint64 bytes);
+    void finished(qint64 rows, qint64 bytes, qint64 elapsedMs);
+    void cancelled();
+    void failed(const QString &message);
+
+private:
+    QString fileName;
+    QString statement;
+    bool compress;
+    QString sourceConnection;
+};
+
+#endif // COLUMNAREXPORTER_H
@@ -0,0 +1,582 @@
+#include "columnarformat.h"
+#include <QCoreApplication>
+#include <QFileInfo>
+#include <QRegularExpression>
+#include <QtEndian>
+
+#ifdef CACHEDTABLE_WITH_ZSTD
+#include <zstd.h>
+#endif
+
+#include <cstring>
+#include <string_view>
+#include <unordered_map>
+
+namespace ColumnarFormat {
+
+namespace {
+
+// Мелкие фрагменты не сжимаем: выигрыш меньше заголовка кадра zstd
+constexpr int MinCompressedSize = 256;
+constexpr int ZstdLevel = 1;
+
+bool isNumber(quint8 type)
+{
+    return type == Integer || type == Real;
+}
+
+bool isBytes(quint8 type)
+{
+    return type == Text || type == Blob;
+}
+
+void appendU8(QByteArray &out, quint8 value)
+{
+    out.append(char(value));
+}
+
+void appendU32(QByteArray &out, quint32 value)
+{
+    char buffer[sizeof value];
+    qToLittleEndian(value, buffer);
+    out.append(buffer, sizeof buffer);
+}
+
+void appendU64(QByteArray &out, quint64 value)
+{
+    char buffer[sizeof value];
+    qToLittleEndian(value, buffer);
+    out.append(buffer, sizeof buffer);
+}
+
+// Чтение с проверкой границ: повреждённый файл не должен уводить за конец буфера
+class Reader
+{
+public:
+    Reader(const char *pos, const char *end) : pos(pos), end(end) {}
+
+    bool isOk() const { return ok; }
+    const char *position() const { return pos; }
+    qint64 remaining() const { return end - pos; }
+
+    quint8 u8() { return take(1) ? quint8(pos[-1]) : 0; }
+    quint16 u16() { return take(2) ? qFromLittleEndian<quint16>(pos - 2) : 0; }
+    quint32 u32() { return take(4) ? qFromLittleEndian<quint32>(pos - 4) : 0; }
+    quint64 u64() { return take(8) ? qFromLittleEndian<quint64>(pos - 8) : 0; }
+    const char *bytes(quint32 size) { return take(size) ? pos - size : nullptr; }
+
+private:
+    bool take(qint64 size)
+    {
+        if (!ok || end - pos < size) {
+            ok = false;
+            return false;
+        }
+        pos += size;
+        return true;
+    }
+
+    const char *pos;
+    const char *end;
+    bool ok = true;
+};
+
+QString tr(const char *text)
+{
+    return QCoreApplication::translate("ColumnarFormat", text);
+}
+
+void setNumber(Value &value, quint64 bits)
+{
+    if (value.type == Integer)
+        value.integer = qint64(bits);
+    else
+        std::memcpy(&value.real, &bits, sizeof bits);
+}
+
+bool readTypeRuns(Reader &data, std::vector<Value> &values)
+{
+    const quint32 runCount = data.u32();
+    size_t row = 0;
+    for (quint32 run = 0; run < runCount && data.isOk(); ++run) {
+        const quint8 type = data.u8();
+        const quint32 length = data.u32();
+        if (type < Integer || type > Null || length > values.size() - row)
+            return false;
+        for (quint32 i = 0; i < length; ++i)
+            values[row++].type = type;
+    }
+    return data.isOk() && row == values.size();
+}
+
+void readNumbers(Reader &data, std::vector<Value> &values)
+{
+    for (Value &value : values) {
+        if (isNumber(value.type))
+            setNumber(value, data.u64());
+    }
+}
+
+bool readPlain(Reader &data, std::vector<Value> &values)
+{
+    if (!readTypeRuns(data, values))
+        return false;
+    readNumbers(data, values);
+    // Сначала все длины, затем все байты подряд
+    for (Value &value : values) {
+        if (isBytes(value.type))
+            value.size = int(data.u32());
+    }
+    for (Value &value : values) {
+        if (isBytes(value.type))
+            value.data = data.bytes(quint32(value.size));
+    }
+    return data.isOk();
+}
+
+bool readDictionary(Reader &data, std::vector<Value> &values)
+{
+    if (!readTypeRuns(data, values))
+        return false;
+    readNumbers(data, values);
+
+    const quint32 entryCount = data.u32();
+    if (!data.isOk() || qint64(entryCount) * 4 > data.remaining())
+        return false;
+    std::vector<std::string_view> entries(entryCount);
+    std::vector<quint32> entrySizes(entryCount);
+    for (quint32 &size : entrySizes)
+        size = data.u32();
+    for (quint32 i = 0; i < entryCount && data.isOk(); ++i) {
+        const char *entry = data.bytes(entrySizes[i]);
+        if (!entry)
+            return false;
+        entries[i] = std::string_view(entry, entrySizes[i]);
+    }
+
+    const quint8 width = data.u8();
+    if (width != 2 && width != 4)
+        return false;
+    for (Value &value : values) {
+        if (!isBytes(value.type))
+            continue;
+        const quint32 code = width == 2 ? data.u16() : data.u32();
+        if (code >= entryCount)
+            return false;
+        value.data = entries[code].data();
+        value.size = int(entries[code].size());
+    }
+    return data.isOk();
+}
+
+bool readRunLength(Reader &data, std::vector<Value> &values)
+{
+    const quint32 runCount = data.u32();
+    size_t row = 0;
+    for (quint32 run = 0; run < runCount && data.isOk(); ++run) {
+        const quint32 length = data.u32();
+        Value value;
+        value.type = data.u8();
+        if (value.type < Integer || value.type > Null || length > values.size() - row)
+            return false;
+        if (isNumber(value.type)) {
+            setNumber(value, data.u64());
+        } else if (isBytes(value.type)) {
+            value.size = int(data.u32());
+            value.data = data.bytes(quint32(value.size));
+        }
+        for (quint32 i = 0; i < length; ++i)
+            values[row++] = value;
+    }
+    return data.isOk() && row == values.size();
+}
+
+}
+
+bool isTypeName(const QString &type)
+{
+    static const QRegularExpression pattern(QRegularExpression::anchoredPattern(QStringLiteral(
+        "(?:[A-Za-z_][A-Za-z0-9_]*(?: +[A-Za-z_][A-Za-z0-9_]*)*"
+        "(?: *\\( *[+-]?[0-9]+(?:\\.[0-9]+)? *(?:, *[+-]?[0-9]+(?:\\.[0-9]+)? *)?\\))?)?")));
+    return pattern.match(type).hasMatch();
+}
+
+bool hasZstd()
+{
+#ifdef CACHEDTABLE_WITH_ZSTD
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool isDumpFile(const QString &fileName)
+{
+    return QFileInfo(fileName).suffix().compare(QLatin1String("ctd"), Qt::CaseInsensitive) == 0;
+}
+
+void writeHeader(QByteArray &out, const QStringList &columns, const QStringList &declaredTypes)
+{
+    out.append(Magic, sizeof Magic);
+    appendU32(out, quint32(columns.size()));
+    for (qsizetype i = 0; i < columns.size(); ++i) {
+        const QByteArray name = columns.at(i).toUtf8();
+        const QByteArray type = declaredTypes.value(i).toUtf8();
+        appendU32(out, quint32(name.size()));
+        out.append(name);
+        appendU32(out, quint32(type.size()));
+        out.append(type);
+    }
+}
+
+bool readHeader(const char *&pos, const char *end, QStringList *columns, QStringList *declaredTypes, QString *error)
+{
+    Reader data(pos, end);
+    const char *magic = data.bytes(sizeof Magic);
+    if (!magic || std::memcmp(magic, Magic, sizeof Magic) != 0) {
+        *error = tr("Файл не является колоночным дампом");
+        return false;
+    }
+
+    const quint32 columnCount = data.u32();
+    for (quint32 i = 0; i < columnCount && data.isOk(); ++i) {
+        const quint32 nameSize = data.u32();
+        const char *name = data.bytes(nameSize);
+        const quint32 typeSize = data.u32();
+        const char *type = data.bytes(typeSize);
+        if (!data.isOk())
+            break;
+        *columns << QString::fromUtf8(name, qsizetype(nameSize));
+        *declaredTypes << QString::fromUtf8(type, qsizetype(typeSize));
+        if (!isTypeName(declaredTypes->constLast())) {
+            *error = tr("Недопустимый тип столбца в заголовке дампа: %1").arg(declaredTypes->constLast());
+            return false;
+        }
+    }
+    if (!data.isOk() || columnCount == 0) {
+        *error = tr("Повреждён заголовок дампа");
+        return false;
+    }
+    pos = data.position();
+    return true;
+}
+
+void writeGroupStart(QByteArray &out, int rowCount)
+{
+    appendU32(out, quint32(rowCount));
+}
+
+void writeEnd(QByteArray &out, qint64 totalRows)
+{
+    appendU32(out, 0);
+    appendU64(out, quint64(totalRows));
+}
+
+bool readGroupStart(const char *&pos, const char *end, int *rowCount, QString *error)
+{
+    Reader data(pos, end);
+    const quint32 rows = data.u32();
+    if (!data.isOk() || rows > quint32(RowsPerGroup)) {
+        *error = data.isOk() ? tr("Повреждённая группа строк дампа") : tr("Файл дампа обрезан");
+        return false;
+    }
+    *rowCount = int(rows);
+    pos = data.position();
+    return true;
+}
+
+bool readEnd(const char *&pos, const char *end, qint64 expectedRows, QString *error)
+{
+    Reader data(pos, end);
+    const quint64 rows = data.u64();
+    if (!data.isOk() || rows != quint64(expectedRows)) {
+        *error = tr("Файл дампа обрезан");
+        return false;
+    }
+    pos = data.position();
+    return true;
+}
+
+void ChunkBuilder::addNull()
+{
+    types.push_back(Null);
+}
+
+void ChunkBuilder::addInteger(qint64 value)
+{
+    types.push_back(Integer);
+    numbers.push_back(value);
+}
+
+void ChunkBuilder::addReal(double value)
+{
+    qint64 bits;
+    std::memcpy(&bits, &value, sizeof bits);
+    types.push_back(Real);
+    numbers.push_back(bits);
+}
+
+void ChunkBuilder::addBytes(ValueType type, const char *data, int size)
+{
+    types.push_back(type);
+    sizes.push_back(quint32(size));
+    bytes.append(data, size);
+}
+
+void ChunkBuilder::appendTypeRuns(QByteArray &out) const
+{
+    std::vector<std::pair<quint8, quint32>> runs;
+    for (quint8 type : types) {
+        if (!runs.empty() && runs.back().first == type)
+            ++runs.back().second;
+        else
+            runs.emplace_back(type, 1);
+    }
+    appendU32(out, quint32(runs.size()));
+    for (const auto &run : runs) {
+        appendU8(out, run.first);
+        appendU32(out, run.second);
+    }
+}
+
+int ChunkBuilder::valueRuns() const
+{
+    int runs = 0;
+    size_t number = 0;
+    size_t sizeIndex = 0;
+    qsizetype offset = 0;
+    quint8 previousType = 0;
+    qint64 previousNumber = 0;
+    qsizetype previousOffset = 0;
+    quint32 previousSize = 0;
+
+    for (quint8 type : types) {
+        bool same = runs > 0 && type == previousType;
+        if (isNumber(type)) {
+            const qint64 value = numbers[number++];
+            same = same && value == previousNumber;
+            previousNumber = value;
+        } else if (isBytes(type)) {
+            const quint32 size = sizes[sizeIndex++];
+            same = same && size == previousSize
+                   && std::memcmp(bytes.constData() + offset, bytes.constData() + previousOffset, size) == 0;
+            previousOffset = offset;
+            previousSize = size;
+            offset += size;
+        }
+        if (!same)
+            ++runs;
+        previousType = type;
+    }
+    return runs;
+}
+
+void ChunkBuilder::encodePlain(QByteArray &out) const
+{
+    appendTypeRuns(out);
+    for (qint64 number : numbers)
+        appendU64(out, quint64(number));
+    for (quint32 size : sizes)
+        appendU32(out, size);
+    out.append(bytes);
+}
+
+bool ChunkBuilder::encodeDictionary(QByteArray &out) const
+{
+    if (sizes.empty())
+        return false;
+
+    // Словарь выгоден, только если значения заметно повторяются
+    const size_t maxEntries = sizes.size() / 2;
+    std::unordered_map<std::string_view, quint32> index;
+    std::vector<std::string_view> entries;
+    std::vector<quint32> codes;
+    codes.reserve(sizes.size());
+    qsizetype offset = 0;
+    for (quint32 size : sizes) {
+        const std::string_view key(bytes.constData() + offset, size);
+        offset += size;
+        const auto inserted = index.try_emplace(key, quint32(entries.size()));
+        if (inserted.second) {
+            entries.push_back(key);
+            if (entries.size() > maxEntries)
+                return false;
+        }
+        codes.push_back(inserted.first->second);
+    }
+
+    appendTypeRuns(out);
+    for (qint64 number : numbers)
+        appendU64(out, quint64(number));
+    appendU32(out, quint32(entries.size()));
+    for (const std::string_view &entry : entries)
+        appendU32(out, quint32(entry.size()));
+    for (const std::string_view &entry : entries)
+        out.append(entry.data(), qsizetype(entry.size()));
+
+    const quint8 width = entries.size() <= 0x10000 ? 2 : 4;
+    appendU8(out, width);
+    for (quint32 code : codes) {
+        if (width == 2) {
+            char buffer[2];
+            qToLittleEndian(quint16(code), buffer);
+            out.append(buffer, 2);
+        } else {
+            appendU32(out, code);
+        }
+    }
+    return true;
+}
+
+void ChunkBuilder::encodeRunLength(QByteArray &out) const
+{
+    appendU32(out, quint32(valueRuns()));
+
+    size_t number = 0;
+    size_t sizeIndex = 0;
+    qsizetype offset = 0;
+    size_t row = 0;
+    while (row < types.size()) {
+        // Начало серии
+        const quint8 type = types[row];
+        const qint64 value = isNumber(type) ? numbers[number] : 0;
+        const quint32 size = isBytes(type) ? sizes[sizeIndex] : 0;
+        const char *data = bytes.constData() + offset;
+
+        quint32 length = 0;
+        while (row < types.size() && types[row] == type) {
+            if (isNumber(type)) {
+                if (numbers[number] != value)
+                    break;
+                ++number;
+            } else if (isBytes(type)) {
+                if (sizes[sizeIndex] != size || std::memcmp(bytes.constData() + offset, data, size) != 0)
+                    break;
+                ++sizeIndex;
+                offset += size;
+            }
+            ++length;
+            ++row;
+        }
+
+        appendU32(out, length);
+        appendU8(out, type);
+        if (isNumber(type)) {
+            appendU64(out, quint64(value));
+        } else if (isBytes(type)) {
+            appendU32(out, size);
+            out.append(data, size);
+        }
+    }
+}
+
+void ChunkBuilder::flush(QByteArray &out, bool compress)
+{
+    QByteArray raw;
+    raw.reserve(bytes.size() + qsizetype(numbers.size()) * 8 + qsizetype(sizes.size()) * 4 + 64);
+
+    // Серии - для почти постоянных и отсортированных столбцов, словарь - для повторяющихся строк
+    quint8 encoding = Plain;
+    if (valueRuns() * 4 <= rowCount()) {
+        encoding = RunLength;
+        encodeRunLength(raw);
+    } else if (encodeDictionary(raw)) {
+        encoding = Dictionary;
+    } else {
+        encodePlain(raw);
+    }
+
+    quint8 codec = NoCompression;
+    QByteArray packed;
+#ifdef CACHEDTABLE_WITH_ZSTD
+    if (compress && raw.size() >= MinCompressedSize) {
+        packed.resize(qsizetype(ZSTD_compressBound(size_t(raw.size()))));
+        const size_t packedSize = ZSTD_compress(packed.data(), size_t(packed.size()),
+                                                raw.constData(), size_t(raw.size()), ZstdLevel);
+        // Почти несжимаемые данные храним как есть: распаковка тоже стоит времени
+        if (!ZSTD_isError(packedSize) && qsizetype(packedSize) < raw.size() * 9 / 10) {
+            packed.resize(qsizetype(packedSize));
+            codec = Zstd;
+        }
+    }
+#else
+    Q_UNUSED(compress);
+#endif
+    const QByteArray &stored = codec == Zstd ? packed : raw;
+
+    appendU8(out, encoding);
+    appendU8(out, codec);
+    appendU8(out, 0);
+    appendU8(out, 0);
+    appendU32(out, quint32(raw.size()));
+    appendU32(out, quint32(stored.size()));
+    out.append(stored);
+
+    types.clear();
+    numbers.clear();
+    sizes.clear();
+    bytes.resize(0);  // ёмкость буфера сохраняется
+}
+
+bool readChunk(const char *&pos, const char *end, int rowCount,
+               std::vector<Value> &values, QByteArray &storage, QString *error)
+{
+    Reader header(pos, end);
+    const quint8 encoding = header.u8();
+    const quint8 codec = header.u8();
+    header.u16();
+    const quint32 rawSize = header.u32();
+    const quint32 storedSize = header.u32();
+    const char *stored = header.bytes(storedSize);
+    if (!header.isOk()) {
+        *error = tr("Файл дампа обрезан");
+        return false;
+    }
+    pos = header.position();
+
+    const char *raw = stored;
+    if (codec == Zstd) {
+#ifdef CACHEDTABLE_WITH_ZSTD
+        // Размер из заголовка фрагмента не проверен, пока с ним не согласен кадр zstd
+        if (rawSize > MaxChunkSize || ZSTD_getFrameContentSize(stored, storedSize) != rawSize) {
+            *error = tr("Повреждённый фрагмент дампа");
+            return false;
+        }
+        storage.resize(qsizetype(rawSize));
+        const size_t size = ZSTD_decompress(storage.data(), rawSize, stored, storedSize);
+        if (ZSTD_isError(size) || size != rawSize) {
+            *error = tr("Не удалось распаковать фрагмент дампа");
+            return false;
+        }
+        raw = storage.constData();
+#else
+        *error = tr("Дамп сжат zstd, а программа собрана без поддержки zstd");
+        return false;
+#endif
+    } else if (codec != NoCompression || rawSize != storedSize) {
+        *error = tr("Неизвестный способ сжатия фрагмента дампа");
+        return false;
+    }
+
+    values.assign(size_t(rowCount), Value());
+    Reader data(raw, raw + rawSize);
+    bool ok = false;
+    switch (encoding) {
+    case Plain:
+        ok = readPlain(data, values);
+        break;
+    case Dictionary:
+        ok = readDictionary(data, values);
+        break;
+    case RunLength:
+        ok = readRunLength(data, values);
+        break;
+    default:
+        break;
+    }
+    if (!ok)
+        *error = tr("Повреждённый фрагмент дампа");
+    return ok;
+}
+
+}
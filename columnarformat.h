@@ -0,0 +1,108 @@
+#ifndef COLUMNARFORMAT_H
+#define COLUMNARFORMAT_H
+
+#include <QByteArray>
+#include <QString>
+#include <QStringList>
+
+#include <vector>
+
+// Колоночный дамп таблицы (*.ctd).
+// Заголовок: сигнатура, число столбцов, имена и объявленные типы.
+// Дальше группы до RowsPerGroup строк: число строк и по фрагменту на каждый
+// столбец. Фрагмент кодируется как есть, словарём или сериями одинаковых
+// значений - что короче - и при сборке с zstd сжимается, если это выгодно.
+// Конец файла - группа из нуля строк и общее число строк для проверки.
+// Все числа - little-endian.
+namespace ColumnarFormat {
+
+constexpr char Magic[8] = { 'C', 'T', 'D', 'U', 'M', 'P', '0', '1' };
+// Читатель держит разобранную группу целиком: 16K строк x 32 байта на значение
+constexpr int RowsPerGroup = 16384;
+// Группа закрывается раньше, если TEXT и BLOB в ней набрали столько байт
+constexpr qint64 MaxGroupBytes = 64 * 1024 * 1024;
+// Больше распакованного фрагмента читатель не выделяет: при MaxGroupBytes
+// до предела доходит только значение длиннее SQLITE_MAX_LENGTH по умолчанию
+constexpr quint32 MaxChunkSize = 1024 * 1024 * 1024;
+
+// Типы значений совпадают с кодами SQLITE_INTEGER ... SQLITE_NULL
+enum ValueType : quint8 {
+    Integer = 1,
+    Real = 2,
+    Text = 3,
+    Blob = 4,
+    Null = 5
+};
+
+enum Encoding : quint8 {
+    Plain = 0,
+    Dictionary = 1,
+    RunLength = 2
+};
+
+enum Codec : quint8 {
+    NoCompression = 0,
+    Zstd = 1
+};
+
+bool hasZstd();
+// Объявленный тип попадает в CREATE TABLE при импорте как есть, поэтому допустимы
+// только имена типов SQLite: слова и необязательные (n) или (n, m); пустой - тоже
+bool isTypeName(const QString &type);
+bool isDumpFile(const QString &fileName);
+
+// Разобранное значение; data указывает в отображённый файл
+// или в распакованный буфер фрагмента
+struct Value
+{
+    quint8 type = Null;
+    qint64 integer = 0;
+    double real = 0;
+    const char *data = nullptr;
+    int size = 0;
+};
+
+// Значения одного столбца текущей группы строк
+class ChunkBuilder
+{
+public:
+    void addNull();
+    void addInteger(qint64 value);
+    void addReal(double value);
+    void addBytes(ValueType type, const char *data, int size);
+
+    int rowCount() const { return int(types.size()); }
+    // Дописывает закодированный фрагмент в out и очищает построитель
+    void flush(QByteArray &out, bool compress);
+
+private:
+    void encodePlain(QByteArray &out) const;
+    bool encodeDictionary(QByteArray &out) const;
+    void encodeRunLength(QByteArray &out) const;
+    void appendTypeRuns(QByteArray &out) const;
+    int valueRuns() const;
+
+    std::vector<quint8> types;
+    std::vector<qint64> numbers;    // INTEGER и биты REAL по порядку
+    std::vector<quint32> sizes;     // длины TEXT и BLOB по порядку
+    QByteArray bytes;
+};
+
+void writeHeader(QByteArray &out, const QStringList &columns, const QStringList &declaredTypes);
+// Отвергает объявленные типы, которые не являются именем типа SQLite
+bool readHeader(const char *&pos, const char *end, QStringList *columns, QStringList *declaredTypes, QString *error);
+
+// Группа строк начинается с их числа; группа из нуля строк завершает файл
+void writeGroupStart(QByteArray &out, int rowCount);
+void writeEnd(QByteArray &out, qint64 totalRows);
+bool readGroupStart(const char *&pos, const char *end, int *rowCount, QString *error);
+bool readEnd(const char *&pos, const char *end, qint64 expectedRows, QString *error);
+
+// Читает фрагмент столбца с позиции pos и сдвигает её за фрагмент.
+// Сжатый фрагмент распаковывается в storage, который должен жить, пока нужны values
+bool readChunk(const char *&pos, const char *end, int rowCount,
+               std::vector<Value> &values, QByteArray &storage, QString *error);
+
+}
+
+#endif // COLUMNARFORMAT_H
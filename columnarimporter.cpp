@@ -0,0 +1,198 @@
+#include "columnarimporter.h"
+#include "columnarformat.h"
+#include <QElapsedTimer>
+#include <QFile>
+
+#include <sqlite3.h>
+
+#include <vector>
+
+static bool execSql(sqlite3 *db, const QByteArray &sql, QString *error = nullptr)
+{
+    char *message = nullptr;
+    const int rc = sqlite3_exec(db, sql.constData(), nullptr, nullptr, &message);
+    if (rc != SQLITE_OK && error)
+        *error = QString::fromUtf8(message ? message : sqlite3_errmsg(db));
+    sqlite3_free(message);
+    return rc == SQLITE_OK;
+}
+
+// Один оператор через prepare/step: в отличие от sqlite3_exec, хвост после него не выполняется
+static bool execStatement(sqlite3 *db, const QByteArray &sql, QString *error)
+{
+    sqlite3_stmt *stmt = nullptr;
+    const char *tail = nullptr;
+    int rc = sqlite3_prepare_v2(db, sql.constData(), int(sql.size()), &stmt, &tail);
+    if (rc == SQLITE_OK && tail && !QByteArray(tail).trimmed().isEmpty()) {
+        sqlite3_finalize(stmt);
+        *error = ColumnarImporter::tr("Лишний текст после оператора: %1")
+                     .arg(QString::fromUtf8(tail));
+        return false;
+    }
+    if (rc == SQLITE_OK)
+        rc = sqlite3_step(stmt);
+    sqlite3_finalize(stmt);
+    if (rc != SQLITE_OK && rc != SQLITE_DONE) {
+        *error = QString::fromUtf8(sqlite3_errmsg(db));
+        return false;
+    }
+    return true;
+}
+
+static bool tableExists(sqlite3 *db, const QString &table)
+{
+    sqlite3_stmt *stmt = nullptr;
+    const QByteArray sql = "PRAGMA table_info(" + quoteIdentifier(table).toUtf8() + ")";
+    const bool exists = sqlite3_prepare_v2(db, sql.constData(), -1, &stmt, nullptr) == SQLITE_OK
+                        && sqlite3_step(stmt) == SQLITE_ROW;
+    sqlite3_finalize(stmt);
+    return exists;
+}
+
+static int bindValue(sqlite3_stmt *stmt, int index, const ColumnarFormat::Value &value)
+{
+    switch (value.type) {
+    case ColumnarFormat::Integer:
+        return sqlite3_bind_int64(stmt, index, value.integer);
+    case ColumnarFormat::Real:
+        return sqlite3_bind_double(stmt, index, value.real);
+    case ColumnarFormat::Text:
+        return sqlite3_bind_text(stmt, index, value.data, value.size, SQLITE_STATIC);
+    case ColumnarFormat::Blob:
+        return sqlite3_bind_blob(stmt, index, value.data, value.size, SQLITE_STATIC);
+    default:
+        return sqlite3_bind_null(stmt, index);
+    }
+}
+
+ColumnarImporter::ColumnarImporter(const QString &fileName, const QString &table,
+                                   const QString &sourceConnection, QObject *parent)
+    : BackgroundJob(parent),
+    fileName(fileName),
+    table(table),
+    sourceConnection(sourceConnection)
+{
+}
+
+void ColumnarImporter::run()
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        emit failed(tr("Не удалось открыть файл для чтения:\n%1").arg(file.errorString()));
+        return;
+    }
+
+    const qint64 totalBytes = file.size();
+    const char *fileStart = totalBytes > 0 ? reinterpret_cast<const char *>(file.map(0, totalBytes)) : nullptr;
+    if (!fileStart) {
+        emit failed(tr("Не удалось отобразить файл в память:\n%1").arg(file.errorString()));
+        return;
+    }
+    const char *pos = fileStart;
+    const char *end = fileStart + totalBytes;
+
+    QString errorText;
+    QStringList columns;
+    QStringList declaredTypes;
+    if (!ColumnarFormat::readHeader(pos, end, &columns, &declaredTypes, &errorText)) {
+        emit failed(errorText);
+        return;
+    }
+
+    ScopedConnection connection(sourceConnection, QStringLiteral("import"));
+    sqlite3 *db = connection.open() ? connection.handle() : nullptr;
+    if (!db) {
+        emit failed(connection.lastError().text());
+        return;
+    }
+    interrupter.attach(db);
+
+    // Профиль соединения может отключить журнал, и тогда ROLLBACK не работает
+    bool canRollBack = true;
+    sqlite3_stmt *journal = nullptr;
+    if (sqlite3_prepare_v2(db, "PRAGMA journal_mode", -1, &journal, nullptr) == SQLITE_OK
+        && sqlite3_step(journal) == SQLITE_ROW) {
+        canRollBack = qstricmp(reinterpret_cast<const char *>(sqlite3_column_text(journal, 0)), "off") != 0;
+    }
+    sqlite3_finalize(journal);
+
+    qint64 rows = 0;
+    if (execSql(db, "BEGIN IMMEDIATE", &errorText)) {
+        QStringList quoted;
+        for (const QString &column : std::as_const(columns))
+            quoted << quoteIdentifier(column);
+
+        // Таблица создаётся в той же транзакции и при ошибке исчезает вместе с данными
+        if (!tableExists(db, table)) {
+            QStringList definitions;
+            for (qsizetype i = 0; i < columns.size(); ++i)
+                definitions << (quoted.at(i) + QLatin1Char(' ') + declaredTypes.at(i)).trimmed();
+            execStatement(db, "CREATE TABLE " + quoteIdentifier(table).toUtf8() + " ("
+                                  + definitions.join(QLatin1String(", ")).toUtf8() + ")", &errorText);
+        }
+
+        sqlite3_stmt *insert = nullptr;
+        if (errorText.isEmpty()) {
+            const QByteArray sql = "INSERT INTO " + quoteIdentifier(table).toUtf8() + " ("
+                                   + quoted.join(QLatin1String(", ")).toUtf8() + ") VALUES ("
+                                   + QByteArray("?, ").repeated(columns.size()).chopped(2) + ")";
+            if (sqlite3_prepare_v2(db, sql.constData(), int(sql.size()), &insert, nullptr) != SQLITE_OK)
+                errorText = QString::fromUtf8(sqlite3_errmsg(db));
+        }
+
+        std::vector<std::vector<ColumnarFormat::Value>> values(size_t(columns.size()));
+        std::vector<QByteArray> storage(size_t(columns.size()));
+        qint64 lastProgressMs = 0;
+        while (errorText.isEmpty() && !isCancelled()) {
+            int groupRows = 0;
+            if (!ColumnarFormat::readGroupStart(pos, end, &groupRows, &errorText))
+                break;
+            if (groupRows == 0) {
+                ColumnarFormat::readEnd(pos, end, rows, &errorText);
+                break;
+            }
+
+            for (size_t column = 0; column < values.size() && errorText.isEmpty(); ++column)
+                ColumnarFormat::readChunk(pos, end, groupRows, values[column], storage[column], &errorText);
+
+            for (int row = 0; row < groupRows && errorText.isEmpty(); ++row) {
+                for (size_t column = 0; column < values.size(); ++column)
+                    bindValue(insert, int(column) + 1, values[column][size_t(row)]);
+                const int rc = sqlite3_step(insert);
+                sqlite3_reset(insert);
+                if (rc != SQLITE_DONE)
+                    errorText = QString::fromUtf8(sqlite3_errmsg(db));
+                else
+                    ++rows;
+            }
+
+            const qint64 elapsed = timer.elapsed();
+            if (elapsed - lastProgressMs >= ProgressIntervalMs) {
+                lastProgressMs = elapsed;
+                emit progress(pos - fileStart, totalBytes, rows);
+            }
+        }
+        sqlite3_finalize(insert);
+
+        if (errorText.isEmpty() && !isCancelled()) {
+            if (!execSql(db, "COMMIT", &errorText))
+                execSql(db, "ROLLBACK");
+        } else {
+            execSql(db, "ROLLBACK");
+        }
+    }
+    interrupter.detach();
+
+    if (!canRollBack && !errorText.isEmpty())
+        errorText += QLatin1Char('\n') + tr("Журнал отключён: строки, вставленные до ошибки, остались в таблице");
+
+    if (isCancelled())
+        emit cancelled(canRollBack);
+    else if (!errorText.isEmpty())
+        emit failed(errorText);
+    else
+        emit finished(rows, totalBytes, timer.elapsed());
+}
@@ -0,0 +1,36 @@
+#ifndef COLUMNARIMPORTER_H
+#define COLUMNARIMPORTER_H
+
+#include "backgroundjob.h"
+#include <QSqlDatabase>
+
+// Импорт колоночного дампа в таблицу; если её нет, она создаётся по столбцам
+// и объявленным типам из дампа. Файл отображается в память, значения
+// привязываются к INSERT напрямую из разобранных фрагментов, всё в одной транзакции.
+class ColumnarImporter : public BackgroundJob
+{
+    Q_OBJECT
+
+public:
+    ColumnarImporter(const QString &fileName, const QString &table,
+                     const QString &sourceConnection = QString::fromLatin1(QSqlDatabase::defaultConnection),
+                     QObject *parent = nullptr);
+
+    void run() override;
+
+signals:
+    void progress(qint64 bytes, qint64 totalBytes, qint64 rows);
+    void finished(qint64 rows, qint64 bytes, qint64 elapsedMs);
+    // rolledBack = false: журнал отключён профилем, часть строк осталась в таблице
+    void cancelled(bool rolledBack);
+    void failed(const QString &message);
+
+private:
+    static constexpr int ProgressIntervalMs = 250;
+
+    QString fileName;
+    QString table;
+    QString sourceConnection;
+};
+
+#endif // COLUMNARIMPORTER_H
@@ -0,0 +1,159 @@
+#include "columnprofilepanel.h"
+#include <QHBoxLayout>
+#include <QHeaderView>
+#include <QLabel>
+#include <QPushButton>
+#include <QTreeWidget>
+#include <QVBoxLayout>
+
+namespace {
+
+enum ProfileColumn {
+    NameColumn,
+    TypeColumn,
+    NullColumn,
+    DistinctColumn,
+    MinColumn,
+    MaxColumn,
+    LengthColumn,
+    ProfileColumnCount
+};
+
+QString formatValue(const QVariant &value)
+{
+    if (value.isNull())
+        return QStringLiteral("NULL");
+    if (value.typeId() == QMetaType::QByteArray)
+        return ColumnProfilePanel::tr("BLOB, %1 байт").arg(value.toByteArray().size());
+
+    const QString text = value.toString().simplified();
+    return text.size() > 80 ? text.left(80) + QChar(0x2026) : text;
+}
+
+QString formatPercent(qint64 part, qint64 total)
+{
+    return total > 0 ? QStringLiteral("%1 (%2%)").arg(part).arg(100.0 * part / total, 0, 'f', 1)
+                     : QString::number(part);
+}
+
+QString bucketRange(int bucket)
+{
+    if (bucket == 0)
+        return QStringLiteral("0");
+    const qint64 low = qint64(1) << (bucket - 1);
+    if (bucket == ColumnProfile::LengthBuckets - 1)
+        return QStringLiteral("%1+").arg(low);
+    const qint64 high = (qint64(1) << bucket) - 1;
+    return low == high ? QString::number(low) : QStringLiteral("%1-%2").arg(low).arg(high);
+}
+
+}
+
+ColumnProfilePanel::ColumnProfilePanel(QWidget *parent)
+    : QWidget(parent),
+    columnTree(new QTreeWidget(this)),
+    statusLabel(new QLabel(this)),
+    refreshButton(new QPushButton(tr("Пересчитать"), this)),
+    stopButton(new QPushButton(tr("Стоп"), this))
+{
+    columnTree->setColumnCount(ProfileColumnCount);
+    columnTree->setHeaderLabels({ tr("Столбец"), tr("Типы"), tr("NULL"), tr("Различных"),
+                                  tr("Минимум"), tr("Максимум"), tr("Длина") });
+    columnTree->setUniformRowHeights(true);
+    columnTree->header()->setStretchLastSection(false);
+
+    statusLabel->setWordWrap(true);
+    connect(refreshButton, &QPushButton::clicked, this, &ColumnProfilePanel::refreshRequested);
+    connect(stopButton, &QPushButton::clicked, this, &ColumnProfilePanel::stopRequested);
+
+    auto *buttonLayout = new QHBoxLayout;
+    buttonLayout->addWidget(statusLabel, 1);
+    buttonLayout->addWidget(refreshButton);
+    buttonLayout->addWidget(stopButton);
+
+    auto *layout = new QVBoxLayout(this);
+    layout->setContentsMargins(0, 0, 0, 0);
+    layout->addLayout(buttonLayout);
+    layout->addWidget(columnTree);
+
+    setRunning(false);
+}
+
+void ColumnProfilePanel::setProfile(const TableProfile &profile, bool cached)
+{
+    columnTree->clear();
+    statusLabel->setText(tr("%1: %2 строк, %3 мс%4")
+                             .arg(profile.table)
+                             .arg(profile.rows)
+                             .arg(profile.elapsedMs)
+                             .arg(cached ? tr(", данные не менялись") : QString()));
+
+    for (const ColumnProfile &column : profile.columns) {
+        auto *item = new QTreeWidgetItem(columnTree);
+        item->setText(NameColumn, column.name);
+        item->setToolTip(NameColumn, column.declaredType);
+
+        QStringList types;
+        if (column.integers > 0)
+            types << QStringLiteral("INTEGER");
+        if (column.reals > 0)
+            types << QStringLiteral("REAL");
+        if (column.texts > 0)
+            types << QStringLiteral("TEXT");
+        if (column.blobs > 0)
+            types << QStringLiteral("BLOB");
+        item->setText(TypeColumn, types.join(QLatin1Char('/')));
+        item->setToolTip(TypeColumn, tr("INTEGER: %1\nREAL: %2\nTEXT: %3\nBLOB: %4")
+                                         .arg(column.integers).arg(column.reals).arg(column.texts).arg(column.blobs));
+        item->setText(NullColumn, formatPercent(column.nulls, profile.rows));
+        item->setText(DistinctColumn, QStringLiteral("~%1").arg(column.distinct));
+        item->setText(MinColumn, formatValue(column.minimum));
+        item->setText(MaxColumn, formatValue(column.maximum));
+        if (column.maxLength >= 0) {
+            item->setText(LengthColumn, tr("%1-%2, в среднем %3")
+                                            .arg(column.minLength)
+                                            .arg(column.maxLength)
+                                            .arg(column.averageLength, 0, 'f', 1));
+        }
+
+        if (!column.topValues.isEmpty()) {
+            auto *topItem = new QTreeWidgetItem(item, { tr("Частые значения") });
+            for (const auto &value : column.topValues)
+                new QTreeWidgetItem(topItem, { formatValue(value.first), QStringLiteral("~%1").arg(value.second) });
+        }
+
+        if (!column.lengthHistogram.isEmpty()) {
+            auto *lengthItem = new QTreeWidgetItem(item, { tr("Длины") });
+            for (int bucket = 0; bucket < column.lengthHistogram.size(); ++bucket) {
+                if (column.lengthHistogram.at(bucket) > 0) {
+                    new QTreeWidgetItem(lengthItem, { bucketRange(bucket),
+                                                      QString::number(column.lengthHistogram.at(bucket)) });
+                }
+            }
+        }
+
+        if (!column.sample.isEmpty()) {
+            auto *sampleItem = new QTreeWidgetItem(item, { tr("Примеры") });
+            for (const QVariant &value : column.sample)
+                new QTreeWidgetItem(sampleItem, { formatValue(value) });
+        }
+    }
+    columnTree->header()->resizeSections(QHeaderView::ResizeToContents);
+}
+
+void ColumnProfilePanel::setRunning(bool running)
+{
+    refreshButton->setEnabled(!running);
+    stopButton->setEnabled(running);
+}
+
+void ColumnProfilePanel::setStatus(const QString &status)
+{
+    statusLabel->setText(status);
+}
+
+void ColumnProfilePanel::clear()
+{
+    columnTree->clear();
+    statusLabel->clear();
+}
@@ -0,0 +1,37 @@
+#ifndef COLUMNPROFILEPANEL_H
+#define COLUMNPROFILEPANEL_H
+
+#include "columnprofiler.h"
+#include <QWidget>
+
+class QLabel;
+class QPushButton;
+class QTreeWidget;
+
+// Боковая панель с профилем столбцов открытой таблицы: NULL, число различных,
+// минимум и максимум, длины, частые значения и случайные примеры
+class ColumnProfilePanel : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit ColumnProfilePanel(QWidget *parent = nullptr);
+
+signals:
+    void refreshRequested();
+    void stopRequested();
+
+public slots:
+    void setProfile(const TableProfile &profile, bool cached);
+    void setRunning(bool running);
+    void setStatus(const QString &status);
+    void clear();
+
+private:
+    QTreeWidget *columnTree;
+    QLabel *statusLabel;
+    QPushButton *refreshButton;
+    QPushButton *stopButton;
+};
+
+#endif // COLUMNPROFILEPANEL_H
@@ -0,0 +1,397 @@
+#include "columnprofiler.h"
+#include <QElapsedTimer>
+#include <QRandomGenerator>
+
+#include <sqlite3.h>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+// Разные затравки, чтобы целое 1 и текст "1" не считались одним значением
+constexpr quint64 IntegerSeed = 0x9e3779b97f4a7c15ULL;
+constexpr quint64 RealSeed = 0xc2b2ae3d27d4eb4fULL;
+constexpr quint64 TextSeed = 0x165667b19e3779f9ULL;
+constexpr quint64 BlobSeed = 0x27d4eb2f165667c5ULL;
+
+quint64 mix64(quint64 x)
+{
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+quint64 hashBytes(const void *data, int size, quint64 seed)
+{
+    // FNV-1a; младшие биты у него слабые, поэтому результат перемешивается
+    quint64 hash = 0xcbf29ce484222325ULL ^ seed;
+    const auto *bytes = static_cast<const unsigned char *>(data);
+    for (int i = 0; i < size; ++i) {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return mix64(hash);
+}
+
+int compareBytes(const char *data, qsizetype size, const QByteArray &other)
+{
+    const int result = std::memcmp(data, other.constData(), size_t(qMin(size, other.size())));
+    if (result != 0)
+        return result;
+    return size < other.size() ? -1 : (size > other.size() ? 1 : 0);
+}
+
+class HyperLogLog
+{
+public:
+    void add(quint64 hash)
+    {
+        const int index = int(hash >> (64 - Precision));
+        // Контрольный бит ограничивает ранг, если оставшиеся биты нулевые
+        const quint64 rest = (hash << Precision) | (quint64(1) << (Precision - 1));
+        const quint8 rank = quint8(qCountLeadingZeroBits(rest) + 1);
+        if (rank > registers[index])
+            registers[index] = rank;
+    }
+
+    qint64 estimate() const
+    {
+        const double m = Registers;
+        double sum = 0;
+        int zeros = 0;
+        for (quint8 rank : registers) {
+            sum += std::ldexp(1.0, -rank);
+            if (rank == 0)
+                ++zeros;
+        }
+        double estimate = 0.7213 / (1 + 1.079 / m) * m * m / sum;
+        // На малых количествах точнее линейный подсчёт
+        if (estimate <= 2.5 * m && zeros > 0)
+            estimate = m * std::log(m / zeros);
+        return qRound64(estimate);
+    }
+
+private:
+    static constexpr int Precision = 12;
+    static constexpr int Registers = 1 << Precision;
+
+    std::array<quint8, Registers> registers {};
+};
+
+class CountMinSketch
+{
+public:
+    CountMinSketch() : counters(Depth * Width, 0) {}
+
+    // Добавляет значение и возвращает оценку его частоты сверху
+    quint32 add(quint64 hash)
+    {
+        const quint32 h1 = quint32(hash);
+        const quint32 h2 = quint32(hash >> 32) | 1;
+        quint32 estimate = UINT32_MAX;
+        for (int row = 0; row < Depth; ++row) {
+            quint32 &counter = counters[size_t(row) * Width + ((h1 + quint32(row) * h2) & (Width - 1))];
+            if (counter < UINT32_MAX)
+                ++counter;
+            estimate = qMin(estimate, counter);
+        }
+        return estimate;
+    }
+
+private:
+    static constexpr int Depth = 4;
+    static constexpr int Width = 2048;
+
+    std::vector<quint32> counters;
+};
+
+struct Candidate
+{
+    quint64 hash = 0;
+    QVariant value;
+    qint64 estimate = 0;
+    qint64 hits = 0;    // точное число встреч с момента, как значение стало кандидатом
+};
+
+struct ColumnState
+{
+    ColumnProfile profile;
+    HyperLogLog distinct;
+    CountMinSketch frequencies;
+    QList<Candidate> candidates;
+    std::array<qint64, ColumnProfile::LengthBuckets> lengths {};
+    qint64 lengthSum = 0;
+    qint64 values = 0;
+
+    bool hasNumber = false;
+    double numberMin = 0;
+    double numberMax = 0;
+    QVariant numberMinValue;
+    QVariant numberMaxValue;
+    bool hasText = false;
+    QByteArray textMin;
+    QByteArray textMax;
+};
+
+QVariant columnValue(sqlite3_stmt *stmt, int column)
+{
+    switch (sqlite3_column_type(stmt, column)) {
+    case SQLITE_INTEGER:
+        return qint64(sqlite3_column_int64(stmt, column));
+    case SQLITE_FLOAT:
+        return sqlite3_column_double(stmt, column);
+    case SQLITE_NULL:
+        return QVariant();
+    case SQLITE_BLOB:
+        return QByteArray(static_cast<const char *>(sqlite3_column_blob(stmt, column)),
+                          sqlite3_column_bytes(stmt, column));
+    default:
+        return QString::fromUtf8(reinterpret_cast<const char *>(sqlite3_column_text(stmt, column)),
+                                 sqlite3_column_bytes(stmt, column));
+    }
+}
+
+void addNumber(ColumnState &state, double number, sqlite3_stmt *stmt, int column)
+{
+    if (!state.hasNumber || number < state.numberMin) {
+        state.numberMin = number;
+        state.numberMinValue = columnValue(stmt, column);
+    }
+    if (!state.hasNumber || number > state.numberMax) {
+        state.numberMax = number;
+        state.numberMaxValue = columnValue(stmt, column);
+    }
+    state.hasNumber = true;
+}
+
+void addBytes(ColumnState &state, const char *data, int size, bool isText)
+{
+    const int bucket = qMin(ColumnProfile::LengthBuckets - 1, 32 - qCountLeadingZeroBits(quint32(size)));
+    ++state.lengths[size_t(bucket)];
+    state.lengthSum += size;
+    if (state.profile.minLength < 0 || size < state.profile.minLength)
+        state.profile.minLength = size;
+    if (size > state.profile.maxLength)
+        state.profile.maxLength = size;
+
+    if (!isText)
+        return;
+    if (!state.hasText || compareBytes(data, size, state.textMin) < 0)
+        state.textMin = QByteArray(data, size);
+    if (!state.hasText || compareBytes(data, size, state.textMax) > 0)
+        state.textMax = QByteArray(data, size);
+    state.hasText = true;
+}
+
+void addCandidate(ColumnState &state, quint64 hash, qint64 estimate, sqlite3_stmt *stmt, int column)
+{
+    // Кандидатов вдвое больше, чем показываем: вытеснение около порога неточно
+    constexpr int MaxCandidates = ColumnProfiler::TopValues * 2;
+
+    int smallest = -1;
+    for (int i = 0; i < state.candidates.size(); ++i) {
+        Candidate &candidate = state.candidates[i];
+        if (candidate.hash == hash) {
+            candidate.estimate = estimate;
+            ++candidate.hits;
+            return;
+        }
+        if (smallest < 0 || candidate.estimate < state.candidates.at(smallest).estimate)
+            smallest = i;
+    }
+
+    if (state.candidates.size() < MaxCandidates)
+        state.candidates.append(Candidate { hash, columnValue(stmt, column), estimate, 1 });
+    else if (estimate > state.candidates.at(smallest).estimate)
+        state.candidates[smallest] = Candidate { hash, columnValue(stmt, column), estimate, 1 };
+}
+
+void finish(ColumnState &state)
+{
+    ColumnProfile &profile = state.profile;
+    profile.distinct = state.values > 0 ? qMin(state.distinct.estimate(), state.values) : 0;
+    profile.averageLength = profile.texts + profile.blobs > 0
+                                ? double(state.lengthSum) / double(profile.texts + profile.blobs) : 0;
+    if (profile.maxLength >= 0)
+        profile.lengthHistogram = QList<qint64>(state.lengths.cbegin(), state.lengths.cend());
+
+    // Порядок SQLite: числа меньше текста, BLOB не сравниваем
+    if (state.hasNumber)
+        profile.minimum = state.numberMinValue;
+    else if (state.hasText)
+        profile.minimum = QString::fromUtf8(state.textMin);
+    if (state.hasText)
+        profile.maximum = QString::fromUtf8(state.textMax);
+    else if (state.hasNumber)
+        profile.maximum = state.numberMaxValue;
+
+    // Значения, встреченные один раз, - шум Count-Min на столбцах без повторов
+    std::sort(state.candidates.begin(), state.candidates.end(), [](const Candidate &a, const Candidate &b) {
+        return a.estimate > b.estimate;
+    });
+    for (const Candidate &candidate : std::as_const(state.candidates)) {
+        if (profile.topValues.size() >= ColumnProfiler::TopValues)
+            break;
+        if (candidate.hits > 1)
+            profile.topValues.append({ candidate.value, candidate.estimate });
+    }
+}
+
+}
+
+ColumnProfiler::ColumnProfiler(const QString &table, const DataVersion &version,
+                               const QString &sourceConnection, QObject *parent)
+    : BackgroundJob(parent),
+    table(table),
+    version(version),
+    sourceConnection(sourceConnection)
+{
+}
+
+DataVersion ColumnProfiler::currentVersion(const QSqlDatabase &db)
+{
+    DataVersion result;
+    sqlite3 *handle = sqliteHandle(db);
+    if (!handle)
+        return result;
+
+    sqlite3_stmt *stmt = nullptr;
+    if (sqlite3_prepare_v2(handle, "SELECT * FROM pragma_data_version, pragma_schema_version",
+                           -1, &stmt, nullptr) == SQLITE_OK
+        && sqlite3_step(stmt) == SQLITE_ROW) {
+        result.data = sqlite3_column_int64(stmt, 0);
+        result.schema = sqlite3_column_int64(stmt, 1);
+        result.localChanges = sqlite3_total_changes(handle);
+    }
+    sqlite3_finalize(stmt);
+    return result;
+}
+
+void ColumnProfiler::run()
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    ScopedConnection connection(sourceConnection, QStringLiteral("profile"));
+    sqlite3 *db = connection.open() ? connection.handle() : nullptr;
+    if (!db) {
+        emit failed(connection.lastError().text());
+        return;
+    }
+
+    const QByteArray sql = QStringLiteral("SELECT * FROM %1").arg(quoteIdentifier(table)).toUtf8();
+    sqlite3_stmt *stmt = nullptr;
+    if (sqlite3_prepare_v2(db, sql.constData(), int(sql.size()), &stmt, nullptr) != SQLITE_OK) {
+        emit failed(QString::fromUtf8(sqlite3_errmsg(db)));
+        return;
+    }
+    interrupter.attach(db);
+
+    const int columnCount = sqlite3_column_count(stmt);
+    std::vector<ColumnState> states(size_t(columnCount));
+    for (int column = 0; column < columnCount; ++column) {
+        states[size_t(column)].profile.name = QString::fromUtf8(sqlite3_column_name(stmt, column));
+        states[size_t(column)].profile.declaredType = QString::fromUtf8(sqlite3_column_decltype(stmt, column));
+    }
+
+    QRandomGenerator random(QRandomGenerator::global()->generate());
+    qint64 rows = 0;
+    qint64 lastProgressMs = 0;
+    int rc;
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        ++rows;
+        for (int column = 0; column < columnCount; ++column) {
+            ColumnState &state = states[size_t(column)];
+            quint64 hash = 0;
+            switch (sqlite3_column_type(stmt, column)) {
+            case SQLITE_NULL:
+                ++state.profile.nulls;
+                continue;
+            case SQLITE_INTEGER: {
+                const qint64 value = sqlite3_column_int64(stmt, column);
+                ++state.profile.integers;
+                hash = mix64(quint64(value) ^ IntegerSeed);
+                addNumber(state, double(value), stmt, column);
+                break;
+            }
+            case SQLITE_FLOAT: {
+                const double value = sqlite3_column_double(stmt, column);
+                quint64 bits;
+                std::memcpy(&bits, &value, sizeof bits);
+                ++state.profile.reals;
+                hash = mix64(bits ^ RealSeed);
+                addNumber(state, value, stmt, column);
+                break;
+            }
+            case SQLITE_BLOB: {
+                const auto *data = static_cast<const char *>(sqlite3_column_blob(stmt, column));
+                const int size = sqlite3_column_bytes(stmt, column);
+                ++state.profile.blobs;
+                hash = hashBytes(data, size, BlobSeed);
+                addBytes(state, data, size, false);
+                break;
+            }
+            default: {
+                const auto *data = reinterpret_cast<const char *>(sqlite3_column_text(stmt, column));
+                const int size = sqlite3_column_bytes(stmt, column);
+                ++state.profile.texts;
+                hash = hashBytes(data, size, TextSeed);
+                addBytes(state, data, size, true);
+                break;
+            }
+            }
+
+            ++state.values;
+            state.distinct.add(hash);
+            addCandidate(state, hash, state.frequencies.add(hash), stmt, column);
+
+            // Выборка алгоритмом R: каждое значение попадает в неё с равной вероятностью
+            if (state.profile.sample.size() < SampleSize) {
+                state.profile.sample.append(columnValue(stmt, column));
+            } else {
+                const quint64 slot = random.bounded(quint64(state.values));
+                if (slot < quint64(SampleSize))
+                    state.profile.sample[qsizetype(slot)] = columnValue(stmt, column);
+            }
+        }
+
+        if ((rows & 0xfff) == 0) {
+            const qint64 elapsed = timer.elapsed();
+            if (elapsed - lastProgressMs >= ProgressIntervalMs) {
+                lastProgressMs = elapsed;
+                emit progress(rows);
+            }
+        }
+    }
+
+    const QString errorText = rc == SQLITE_DONE ? QString() : QString::fromUtf8(sqlite3_errmsg(db));
+    sqlite3_finalize(stmt);
+    interrupter.detach();
+
+    if (isCancelled()) {
+        emit cancelled();
+        return;
+    }
+    if (!errorText.isEmpty()) {
+        emit failed(errorText);
+        return;
+    }
+
+    TableProfile profile;
+    profile.table = table;
+    profile.version = version;
+    profile.rows = rows;
+    for (ColumnState &state : states) {
+        finish(state);
+        profile.columns.append(state.profile);
+    }
+    profile.elapsedMs = timer.elapsed();
+    emit finished(profile);
+}
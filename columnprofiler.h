@@ -0,0 +1,91 @@
+#ifndef COLUMNPROFILER_H
+#define COLUMNPROFILER_H
+
+#include "backgroundjob.h"
+#include <QList>
+#include <QPair>
+#include <QSqlDatabase>
+#include <QVariantList>
+
+// Версия данных на исходном соединении. data_version меняют только фиксации
+// других соединений, поэтому собственные изменения учитываются через total_changes
+struct DataVersion
+{
+    qint64 data = -1;
+    qint64 schema = -1;
+    qint64 localChanges = -1;
+
+    bool isValid() const { return data >= 0; }
+    bool operator==(const DataVersion &other) const
+    {
+        return data == other.data && schema == other.schema && localChanges == other.localChanges;
+    }
+    bool operator!=(const DataVersion &other) const { return !(*this == other); }
+};
+
+struct ColumnProfile
+{
+    // Длины текста и BLOB по степеням двойки: 0, 1, 2-3, 4-7, ..., от 2^14
+    static constexpr int LengthBuckets = 16;
+
+    QString name;
+    QString declaredType;
+    qint64 nulls = 0;
+    qint64 integers = 0;
+    qint64 reals = 0;
+    qint64 texts = 0;
+    qint64 blobs = 0;
+    qint64 distinct = 0;        // оценка HyperLogLog, погрешность около 2%
+    QVariant minimum;           // в порядке сравнения SQLite: числа меньше текста
+    QVariant maximum;
+    qint64 minLength = -1;
+    qint64 maxLength = -1;
+    double averageLength = 0;
+    QList<qint64> lengthHistogram;
+    QList<QPair<QVariant, qint64>> topValues;  // оценка Count-Min, не меньше точной
+    QVariantList sample;
+};
+
+struct TableProfile
+{
+    QString table;
+    DataVersion version;
+    qint64 rows = 0;
+    qint64 elapsedMs = 0;
+    QList<ColumnProfile> columns;
+};
+
+// Профиль столбцов таблицы за один проход курсором на собственном соединении.
+// Память на столбец ограничена: HyperLogLog для числа различных значений,
+// Count-Min с кандидатами в частые значения и случайная выборка фиксированного размера.
+class ColumnProfiler : public BackgroundJob
+{
+    Q_OBJECT
+
+public:
+    ColumnProfiler(const QString &table, const DataVersion &version = DataVersion(),
+                   const QString &sourceConnection = QString::fromLatin1(QSqlDatabase::defaultConnection),
+                   QObject *parent = nullptr);
+
+    void run() override;
+
+    static DataVersion currentVersion(const QSqlDatabase &db);
+
+    static constexpr int TopValues = 10;
+    static constexpr int SampleSize = 20;
+
+signals:
+    void progress(qint64 rows);
+    void finished(const TableProfile &profile);
+    void cancelled();
+    void failed(const QString &message);
+
+private:
+    static constexpr int ProgressIntervalMs = 250;
+
+    QString table;
+    DataVersion version;
+    QString sourceConnection;
+};
+
+#endif // COLUMNPROFILER_H
@@ -0,0 +1,284 @@
+#include "commandline.h"
+#include "columnarexporter.h"
+#include "columnarformat.h"
+#include "columnarimporter.h"
+#include "connectionprofile.h"
+#include "csvexporter.h"
+#include "queryworker.h"
+#include "sqliteutil.h"
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QJsonDocument>
+#include <QSettings>
+#include <QSqlDatabase>
+#include <QSqlError>
+
+#include <cstdio>
+#include <cstring>
+
+bool CommandLine::isRequested(int argc, char *argv[])
+{
+    static const char *const commands[] = { "--import", "--export", "--query", "--help", "-h" };
+    for (int i = 1; i < argc; ++i) {
+        for (const char *command : commands) {
+            const size_t length = std::strlen(command);
+            if (std::strncmp(argv[i], command, length) == 0
+                && (argv[i][length] == '\0' || argv[i][length] == '='))
+                return true;
+        }
+    }
+    return false;
+}
+
+int CommandLine::run(const QStringList &arguments)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral(
+        "Пакетный режим DatabaseAdmin. Итог печатается одной строкой JSON."));
+    parser.addHelpOption();
+    parser.addPositionalArgument(QStringLiteral("database"), QStringLiteral("Файл базы данных SQLite."));
+
+    const QCommandLineOption importOption(QStringLiteral("import"),
+        QStringLiteral("Импортировать CSV-файл или колоночный дамп *.ctd в таблицу --table."), QStringLiteral("file.csv"));
+    const QCommandLineOption exportOption(QStringLiteral("export"),
+        QStringLiteral("Экспортировать таблицу --table или результат --query в CSV-файл или колоночный дамп *.ctd."),
+        QStringLiteral("file.csv"));
+    const QCommandLineOption queryOption(QStringLiteral("query"),
+        QStringLiteral("Выполнить SQL-запрос."), QStringLiteral("sql"));
+    const QCommandLineOption tableOption(QStringLiteral("table"),
+        QStringLiteral("Имя таблицы."), QStringLiteral("name"));
+    const QCommandLineOption delimiterOption(QStringLiteral("delimiter"),
+        QStringLiteral("Разделитель полей при импорте (символ или tab)."), QStringLiteral("char"), QStringLiteral(","));
+    const QCommandLineOption noHeaderOption(QStringLiteral("no-header"),
+        QStringLiteral("В импортируемом файле нет строки заголовков."));
+    const QCommandLineOption journalOption(QStringLiteral("journal-mode"),
+        QStringLiteral("journal_mode на время импорта (WAL или OFF)."), QStringLiteral("mode"));
+    const QCommandLineOption synchronousOption(QStringLiteral("synchronous-off"),
+        QStringLiteral("synchronous = OFF на время импорта."));
+    const QCommandLineOption cacheOption(QStringLiteral("cache-size"),
+        QStringLiteral("Размер кэша страниц на время импорта, МБ."), QStringLiteral("mb"));
+    const QCommandLineOption profileOption(QStringLiteral("profile"),
+        QStringLiteral("Профиль соединения из настроек (safe, read-heavy, bulk-load, ...)."), QStringLiteral("name"));
+    parser.addOptions({ importOption, exportOption, queryOption, tableOption, delimiterOption,
+                        noHeaderOption, journalOption, synchronousOption, cacheOption, profileOption });
+
+    parser.process(arguments);
+
+    const QString table = parser.value(tableOption);
+    if (parser.isSet(importOption))
+        stats.insert(QStringLiteral("operation"), QStringLiteral("import"));
+    else if (parser.isSet(exportOption))
+        stats.insert(QStringLiteral("operation"), QStringLiteral("export"));
+    else
+        stats.insert(QStringLiteral("operation"), QStringLiteral("query"));
+
+    const QStringList positional = parser.positionalArguments();
+    if (positional.size() != 1) {
+        setError(QStringLiteral("Нужно указать ровно один файл базы данных"));
+        print();
+        return 2;
+    }
+    if (parser.isSet(importOption) + parser.isSet(exportOption) > 1
+        || (parser.isSet(importOption) && table.isEmpty())
+        || (parser.isSet(exportOption) && table.isEmpty() && !parser.isSet(queryOption))
+        || (!parser.isSet(importOption) && !parser.isSet(exportOption) && !parser.isSet(queryOption))) {
+        setError(QStringLiteral("Неверное сочетание параметров, см. --help"));
+        print();
+        return 2;
+    }
+
+    const QString delimiter = parser.value(delimiterOption);
+    if (delimiter == QLatin1String("tab"))
+        importOptions.delimiter = '\t';
+    else if (!delimiter.isEmpty())
+        importOptions.delimiter = delimiter.at(0).toLatin1();
+    importOptions.hasHeader = !parser.isSet(noHeaderOption);
+    importOptions.journalMode = parser.value(journalOption).toUpper();
+    importOptions.synchronousOff = parser.isSet(synchronousOption);
+    importOptions.cacheSizeMb = parser.value(cacheOption).toInt();
+
+    stats.insert(QStringLiteral("database"), positional.first());
+
+    // Профили общие с GUI
+    std::optional<ConnectionProfile> profile;
+    if (parser.isSet(profileOption)) {
+        QSettings settings(QStringLiteral("DatabaseAdmin"), QStringLiteral("QtDBAdmin"));
+        const QList<ConnectionProfile> profiles = ConnectionProfile::load(settings);
+        for (const ConnectionProfile &candidate : profiles) {
+            if (candidate.name == parser.value(profileOption))
+                profile = candidate;
+        }
+        if (!profile) {
+            setError(QStringLiteral("Профиль %1 не найден").arg(parser.value(profileOption)));
+            print();
+            return 2;
+        }
+        stats.insert(QStringLiteral("profile"), profile->name);
+    }
+
+    bool ok = false;
+    {
+        // Задачи клонируют соединение по умолчанию, сами запросы идут на клонах
+        QSqlDatabase db = QSqlDatabase::addDatabase(QStringLiteral("QSQLITE"));
+        db.setDatabaseName(positional.first());
+        if (profile) {
+            db.setConnectOptions(profile->connectOptions());
+            ConnectionProfile::setForConnection(db.connectionName(), *profile);
+        }
+        QString profileError;
+        if (!db.open()) {
+            setError(db.lastError().text());
+        } else if (profile && !applyConnectionProfile(db, *profile, true, &profileError)) {
+            setError(profileError);
+        } else if (parser.isSet(importOption)) {
+            ok = runImport(parser.value(importOption), table);
+        } else if (parser.isSet(exportOption)) {
+            const QString statement = parser.isSet(queryOption)
+                                          ? parser.value(queryOption)
+                                          : QStringLiteral("SELECT * FROM ") + quoteIdentifier(table);
+            ok = runExport(parser.value(exportOption), statement);
+        } else {
+            ok = runQuery(parser.value(queryOption));
+        }
+        db.close();
+    }
+    QSqlDatabase::removeDatabase(QString::fromLatin1(QSqlDatabase::defaultConnection));
+    ConnectionProfile::removeForConnection(QString::fromLatin1(QSqlDatabase::defaultConnection));
+
+    stats.insert(QStringLiteral("total_ms"), timer.elapsed());
+    print();
+    return ok ? 0 : 1;
+}
+
+bool CommandLine::runImport(const QString &fileName, const QString &table)
+{
+    stats.insert(QStringLiteral("file"), fileName);
+    stats.insert(QStringLiteral("table"), table);
+
+    if (ColumnarFormat::isDumpFile(fileName))
+        return runDumpImport(fileName, table);
+
+    bool ok = false;
+    CsvImporter importer(fileName, table, importOptions);
+    QObject::connect(&importer, &CsvImporter::finished, [this, &ok](qint64 rows, qint64 bytes, qint64 elapsedMs) {
+        setThroughput(rows, bytes, elapsedMs);
+        ok = true;
+    });
+    QObject::connect(&importer, &CsvImporter::failed, [this](const QString &message) {
+        setError(message);
+    });
+    importer.run();
+    return ok;
+}
+
+bool CommandLine::runExport(const QString &fileName, const QString &statement)
+{
+    stats.insert(QStringLiteral("file"), fileName);
+
+    if (ColumnarFormat::isDumpFile(fileName))
+        return runDumpExport(fileName, statement);
+
+    bool ok = false;
+    CsvExporter exporter(fileName, statement);
+    QObject::connect(&exporter, &CsvExporter::finished, [this, &ok](qint64 rows, qint64 bytes, qint64 elapsedMs) {
+        setThroughput(rows, bytes, elapsedMs);
+        ok = true;
+    });
+    QObject::connect(&exporter, &CsvExporter::failed, [this](const QString &message) {
+        setError(message);
+    });
+    exporter.run();
+    return ok;
+}
+
+bool CommandLine::runDumpImport(const QString &fileName, const QString &table)
+{
+    stats.insert(QStringLiteral("format"), QStringLiteral("ctd"));
+
+    bool ok = false;
+    ColumnarImporter importer(fileName, table);
+    QObject::connect(&importer, &ColumnarImporter::finished, [this, &ok](qint64 rows, qint64 bytes, qint64 elapsedMs) {
+        setThroughput(rows, bytes, elapsedMs);
+        ok = true;
+    });
+    QObject::connect(&importer, &ColumnarImporter::failed, [this](const QString &message) {
+        setError(message);
+    });
+    importer.run();
+    return ok;
+}
+
+bool CommandLine::runDumpExport(const QString &fileName, const QString &statement)
+{
+    stats.insert(QStringLiteral("format"), QStringLiteral("ctd"));
+    stats.insert(QStringLiteral("zstd"), ColumnarFormat::hasZstd());
+
+    bool ok = false;
+    ColumnarExporter exporter(fileName, statement);
+    QObject::connect(&exporter, &ColumnarExporter::finished, [this, &ok](qint64 rows, qint64 bytes, qint64 elapsedMs) {
+        setThroughput(rows, bytes, elapsedMs);
+        ok = true;
+    });
+    QObject::connect(&exporter, &ColumnarExporter::failed, [this](const QString &message) {
+        setError(message);
+    });
+    exporter.run();
+    return ok;
+}
+
+bool CommandLine::runQuery(const QString &sql)
+{
+    bool ok = false;
+    QueryWorker worker;
+    QObject::connect(&worker, &QueryWorker::columnsReady, [this](const QStringList &columns) {
+        stats.insert(QStringLiteral("columns"), int(columns.size()));
+    });
+    QObject::connect(&worker, &QueryWorker::profiled, [this](const QueryProfile &profile) {
+        stats.insert(QStringLiteral("prepare_us"), profile.prepareUs);
+        stats.insert(QStringLiteral("step_us"), profile.stepUs);
+        stats.insert(QStringLiteral("vm_steps"), profile.vmSteps);
+        stats.insert(QStringLiteral("full_scan_steps"), profile.fullScanSteps);
+        stats.insert(QStringLiteral("sorts"), profile.sorts);
+        stats.insert(QStringLiteral("auto_indexes"), profile.autoIndexes);
+    });
+    QObject::connect(&worker, &QueryWorker::finished, [this, &ok](bool isSelect, qint64 rows, qint64 elapsedMs) {
+        stats.insert(QStringLiteral("select"), isSelect);
+        setThroughput(rows, -1, elapsedMs);
+        ok = true;
+    });
+    QObject::connect(&worker, &QueryWorker::failed, [this](const QSqlError &error) {
+        setError(error.text());
+    });
+    worker.execute(sql);
+    return ok;
+}
+
+void CommandLine::setThroughput(qint64 rows, qint64 bytes, qint64 elapsedMs)
+{
+    const double seconds = qMax<qint64>(elapsedMs, 1) / 1000.0;
+    stats.insert(QStringLiteral("status"), QStringLiteral("ok"));
+    stats.insert(QStringLiteral("rows"), rows);
+    stats.insert(QStringLiteral("elapsed_ms"), elapsedMs);
+    stats.insert(QStringLiteral("rows_per_sec"), qRound64(rows / seconds));
+    if (bytes >= 0) {
+        stats.insert(QStringLiteral("bytes"), bytes);
+        stats.insert(QStringLiteral("mb_per_sec"), bytes / (1024.0 * 1024.0) / seconds);
+    }
+}
+
+void CommandLine::setError(const QString &message)
+{
+    stats.insert(QStringLiteral("status"), QStringLiteral("error"));
+    stats.insert(QStringLiteral("message"), message);
+}
+
+void CommandLine::print() const
+{
+    const QByteArray json = QJsonDocument(stats).toJson(QJsonDocument::Compact);
+    std::fwrite(json.constData(), 1, size_t(json.size()), stdout);
+    std::fputc('\n', stdout);
+    std::fflush(stdout);
+}
@@ -0,0 +1,34 @@
+#ifndef COMMANDLINE_H
+#define COMMANDLINE_H
+
+#include "csvimporter.h"
+#include <QJsonObject>
+#include <QStringList>
+
+// Пакетный режим без GUI: импорт и экспорт CSV и колоночных дампов, выполнение запросов.
+// Работает на QCoreApplication, итог и время выполнения печатает
+// одной строкой JSON в stdout.
+class CommandLine
+{
+public:
+    // Есть ли среди аргументов команды пакетного режима
+    static bool isRequested(int argc, char *argv[]);
+
+    int run(const QStringList &arguments);
+
+private:
+    bool runImport(const QString &fileName, const QString &table);
+    bool runExport(const QString &fileName, const QString &statement);
+    bool runDumpImport(const QString &fileName, const QString &table);
+    bool runDumpExport(const QString &fileName, const QString &statement);
+    bool runQuery(const QString &sql);
+
+    void setThroughput(qint64 rows, qint64 bytes, qint64 elapsedMs);
+    void setError(const QString &message);
+    void print() const;
+
+    QJsonObject stats;
+    CsvImportOptions importOptions;
+};
+
+#endif // COMMANDLINE_H
@@ -0,0 +1,165 @@
+#include "connectionprofile.h"
+#include <QHash>
+#include <QMutex>
+#include <QObject>
+#include <QSettings>
+#include <QSqlError>
+#include <QSqlQuery>
+
+const QStringList ConnectionProfile::journalModes = {
+    QStringLiteral("DELETE"), QStringLiteral("TRUNCATE"), QStringLiteral("PERSIST"),
+    QStringLiteral("MEMORY"), QStringLiteral("WAL"), QStringLiteral("OFF")
+};
+const QStringList ConnectionProfile::synchronousModes = {
+    QStringLiteral("OFF"), QStringLiteral("NORMAL"), QStringLiteral("FULL"), QStringLiteral("EXTRA")
+};
+const QStringList ConnectionProfile::tempStores = {
+    QStringLiteral("DEFAULT"), QStringLiteral("FILE"), QStringLiteral("MEMORY")
+};
+
+static QMutex profilesMutex;
+static QHash<QString, ConnectionProfile> connectionProfiles;
+
+// Значения из настроек подставляются в текст PRAGMA, поэтому допускаем только известные
+static QString checkedValue(const QString &value, const QStringList &allowed, const QString &fallback)
+{
+    const QString upper = value.trimmed().toUpper();
+    return allowed.contains(upper) ? upper : fallback;
+}
+
+QString ConnectionProfile::connectOptions() const
+{
+    return QStringLiteral("QSQLITE_BUSY_TIMEOUT=%1").arg(busyTimeoutMs);
+}
+
+QStringList ConnectionProfile::pragmas(bool includeJournalMode) const
+{
+    QStringList result;
+    if (includeJournalMode && !journalMode.isEmpty())
+        result << QStringLiteral("PRAGMA journal_mode = %1").arg(journalMode);
+    result << QStringLiteral("PRAGMA synchronous = %1").arg(synchronous)
+           << QStringLiteral("PRAGMA cache_size = -%1").arg(qint64(cacheSizeMb) * 1024)
+           << QStringLiteral("PRAGMA mmap_size = %1").arg(qint64(mmapSizeMb) * 1024 * 1024)
+           << QStringLiteral("PRAGMA temp_store = %1").arg(tempStore)
+           << QStringLiteral("PRAGMA busy_timeout = %1").arg(busyTimeoutMs);
+    return result;
+}
+
+QString ConnectionProfile::summary() const
+{
+    return QStringLiteral("journal_mode=%1, synchronous=%2, cache=%3 MB, mmap=%4 MB, temp_store=%5, busy_timeout=%6 ms")
+        .arg(journalMode.isEmpty() ? QObject::tr("не менять") : journalMode, synchronous,
+             QString::number(cacheSizeMb), QString::number(mmapSizeMb),
+             tempStore, QString::number(busyTimeoutMs));
+}
+
+QList<ConnectionProfile> ConnectionProfile::builtIn()
+{
+    ConnectionProfile safe;
+    safe.name = QStringLiteral("safe");
+
+    ConnectionProfile readHeavy;
+    readHeavy.name = QStringLiteral("read-heavy");
+    readHeavy.journalMode = QStringLiteral("WAL");
+    readHeavy.synchronous = QStringLiteral("NORMAL");
+    readHeavy.cacheSizeMb = 64;
+    readHeavy.mmapSizeMb = 256;
+    readHeavy.tempStore = QStringLiteral("MEMORY");
+
+    ConnectionProfile bulkLoad;
+    bulkLoad.name = QStringLiteral("bulk-load");
+    bulkLoad.journalMode = QStringLiteral("WAL");
+    bulkLoad.synchronous = QStringLiteral("OFF");
+    bulkLoad.cacheSizeMb = 256;
+    bulkLoad.mmapSizeMb = 256;
+    bulkLoad.tempStore = QStringLiteral("MEMORY");
+
+    return { safe, readHeavy, bulkLoad };
+}
+
+QList<ConnectionProfile> ConnectionProfile::load(QSettings &settings)
+{
+    QList<ConnectionProfile> profiles;
+    const ConnectionProfile defaults;
+
+    settings.beginGroup("ConnectionProfiles");
+    const QStringList names = settings.childGroups();
+    for (const QString &name : names) {
+        settings.beginGroup(name);
+        ConnectionProfile profile;
+        profile.name = name;
+        profile.journalMode = checkedValue(settings.value("journalMode").toString(), journalModes, defaults.journalMode);
+        profile.synchronous = checkedValue(settings.value("synchronous").toString(), synchronousModes, defaults.synchronous);
+        profile.cacheSizeMb = qMax(1, settings.value("cacheSizeMb", defaults.cacheSizeMb).toInt());
+        profile.mmapSizeMb = qMax(0, settings.value("mmapSizeMb", defaults.mmapSizeMb).toInt());
+        profile.tempStore = checkedValue(settings.value("tempStore").toString(), tempStores, defaults.tempStore);
+        profile.busyTimeoutMs = qMax(0, settings.value("busyTimeoutMs", defaults.busyTimeoutMs).toInt());
+        settings.endGroup();
+        profiles << profile;
+    }
+    settings.endGroup();
+
+    return profiles.isEmpty() ? builtIn() : profiles;
+}
+
+void ConnectionProfile::save(QSettings &settings, const ConnectionProfile &profile)
+{
+    // Встроенные профили сохраняются вместе с первым изменённым, иначе они бы пропали из списка
+    if (!settings.childGroups().contains(QLatin1String("ConnectionProfiles"))) {
+        const QList<ConnectionProfile> defaults = builtIn();
+        for (const ConnectionProfile &builtInProfile : defaults) {
+            if (builtInProfile.name != profile.name)
+                save(settings, builtInProfile);
+        }
+    }
+
+    settings.beginGroup("ConnectionProfiles");
+    settings.beginGroup(profile.name);
+    settings.setValue("journalMode", profile.journalMode);
+    settings.setValue("synchronous", profile.synchronous);
+    settings.setValue("cacheSizeMb", profile.cacheSizeMb);
+    settings.setValue("mmapSizeMb", profile.mmapSizeMb);
+    settings.setValue("tempStore", profile.tempStore);
+    settings.setValue("busyTimeoutMs", profile.busyTimeoutMs);
+    settings.endGroup();
+    settings.endGroup();
+}
+
+void ConnectionProfile::setForConnection(const QString &connectionName, const ConnectionProfile &profile)
+{
+    QMutexLocker locker(&profilesMutex);
+    connectionProfiles.insert(connectionName, profile);
+}
+
+void ConnectionProfile::removeForConnection(const QString &connectionName)
+{
+    QMutexLocker locker(&profilesMutex);
+    connectionProfiles.remove(connectionName);
+}
+
+std::optional<ConnectionProfile> ConnectionProfile::forConnection(const QString &connectionName)
+{
+    QMutexLocker locker(&profilesMutex);
+    const auto it = connectionProfiles.constFind(connectionName);
+    if (it == connectionProfiles.cend())
+        return std::nullopt;
+    return *it;
+}
+
+bool applyConnectionProfile(const QSqlDatabase &db, const ConnectionProfile &profile,
+                            bool includeJournalMode, QString *error)
+{
+    QSqlQuery query(db);
+    bool ok = true;
+    const QStringList statements = profile.pragmas(includeJournalMode);
+    for (const QString &statement : statements) {
+        // Остальные настройки применяем, даже если одна не прошла
+        // (например, journal_mode нельзя сменить внутри транзакции)
+        if (!query.exec(statement)) {
+            if (error && ok)
+                *error = query.lastError().text();
+            ok = false;
+        }
+    }
+    return ok;
+}
@@ -0,0 +1,53 @@
+#ifndef CONNECTIONPROFILE_H
+#define CONNECTIONPROFILE_H
+
+#include <QList>
+#include <QSqlDatabase>
+#include <QStringList>
+
+#include <optional>
+
+class QSettings;
+
+// Именованный набор настроек соединения SQLite.
+// Применяется через PRAGMA при каждом открытии соединения (в том числе
+// клонов для рабочих потоков) и через setConnectOptions до открытия.
+struct ConnectionProfile
+{
+    QString name;
+    // Пустой - не менять: journal_mode хранится в файле базы и касается всех, кто её открыл
+    QString journalMode;
+    QString synchronous = QStringLiteral("FULL");
+    int cacheSizeMb = 2;
+    int mmapSizeMb = 0;
+    QString tempStore = QStringLiteral("DEFAULT");
+    int busyTimeoutMs = 5000;
+
+    static const QStringList journalModes;
+    static const QStringList synchronousModes;
+    static const QStringList tempStores;
+
+    QString connectOptions() const;
+    QStringList pragmas(bool includeJournalMode = true) const;
+    QString summary() const;
+
+    // Встроенные профили: safe, read-heavy, bulk-load
+    static QList<ConnectionProfile> builtIn();
+
+    // Профили из группы ConnectionProfiles; если она пуста — встроенные
+    static QList<ConnectionProfile> load(QSettings &settings);
+    static void save(QSettings &settings, const ConnectionProfile &profile);
+
+    // Профиль соединения запоминается по имени, чтобы его клоны
+    // в рабочих потоках открывались с теми же настройками
+    static void setForConnection(const QString &connectionName, const ConnectionProfile &profile);
+    static void removeForConnection(const QString &connectionName);
+    static std::optional<ConnectionProfile> forConnection(const QString &connectionName);
+};
+
+// Выполняет PRAGMA профиля на открытом соединении.
+// journal_mode относится к файлу базы целиком, поэтому для клонов его пропускаем.
+bool applyConnectionProfile(const QSqlDatabase &db, const ConnectionProfile &profile,
+                            bool includeJournalMode = true, QString *error = nullptr);
+
+#endif // CONNECTIONPROFILE_H
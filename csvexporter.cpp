@@ -0,0 +1,160 @@
+#include "csvexporter.h"
+#include "sqlitestatement.h"
+#include <QElapsedTimer>
+#include <QFile>
+#include <QLocale>
+
+#include <sqlite3.h>
+
+// Поле берётся в кавычки, только если содержит разделитель, кавычку или перевод строки.
+// Пустая строка пишется как "", чтобы при импорте отличаться от NULL
+static void appendField(QByteArray &out, const char *data, qsizetype size)
+{
+    bool needsQuotes = size == 0;
+    for (qsizetype i = 0; i < size; ++i) {
+        const char ch = data[i];
+        if (ch == ',' || ch == '"' || ch == '\n' || ch == '\r') {
+            needsQuotes = true;
+            break;
+        }
+    }
+
+    if (!needsQuotes) {
+        out.append(data, size);
+        return;
+    }
+
+    out += '"';
+    for (qsizetype i = 0; i < size; ++i) {
+        if (data[i] == '"')
+            out += '"';
+        out += data[i];
+    }
+    out += '"';
+}
+
+// Значение берётся прямо из SQLite: текст уже в UTF-8, числа пишутся без QString
+static void appendColumn(QByteArray &out, const SqliteStatement &row, int column)
+{
+    int size = 0;
+    switch (row.columnType(column)) {
+    case SQLITE_NULL:
+        break;
+    case SQLITE_INTEGER:
+        out += QByteArray::number(row.columnInt64(column));
+        break;
+    case SQLITE_FLOAT:
+        out += QByteArray::number(row.columnDouble(column), 'g', QLocale::FloatingPointShortest);
+        break;
+    case SQLITE_BLOB: {
+        const char *data = row.columnBlob(column, &size);
+        appendField(out, data ? data : "", size);
+        break;
+    }
+    default: {
+        const char *data = row.columnText(column, &size);
+        appendField(out, data ? data : "", size);
+        break;
+    }
+    }
+}
+
+CsvExporter::CsvExporter(const QString &fileName, const QString &statement,
+                         const QString &sourceConnection, QObject *parent)
+    : BackgroundJob(parent),
+    fileName(fileName),
+    statement(statement),
+    sourceConnection(sourceConnection)
+{
+}
+
+void CsvExporter::run()
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Unbuffered)) {
+        emit failed(tr("Не удалось открыть файл для записи:\n%1").arg(file.errorString()));
+        return;
+    }
+
+    ScopedConnection connection(sourceConnection, QStringLiteral("export"));
+    sqlite3 *db = connection.open() ? connection.handle() : nullptr;
+    if (!db) {
+        emit failed(connection.lastError().text());
+        return;
+    }
+    interrupter.attach(db);
+
+    qint64 rows = 0;
+    qint64 bytes = 0;
+    QString errorText;
+    {
+        SqliteStatement query(db, statement.toUtf8());
+        if (!query.isValid()) {
+            errorText = query.errorText();
+        } else {
+            QByteArray buffer;
+            buffer.reserve(BufferSize + 64 * 1024);
+
+            auto flush = [&]() {
+                if (buffer.isEmpty())
+                    return true;
+                if (file.write(buffer) != buffer.size()) {
+                    errorText = file.errorString();
+                    return false;
+                }
+                bytes += buffer.size();
+                buffer.resize(0);  // ёмкость буфера сохраняется
+                return true;
+            };
+
+            // Запись заголовков
+            const int columnCount = query.columnCount();
+            for (int col = 0; col < columnCount; ++col) {
+                if (col > 0) buffer += ',';
+                const char *name = query.columnName(col);
+                appendField(buffer, name, qsizetype(qstrlen(name)));
+            }
+            buffer += '\n';
+
+            // Запись данных
+            qint64 lastProgressMs = 0;
+            int rc = SQLITE_DONE;
+            while (errorText.isEmpty() && !isCancelled() && (rc = query.step()) == SQLITE_ROW) {
+                for (int col = 0; col < columnCount; ++col) {
+                    if (col > 0) buffer += ',';
+                    appendColumn(buffer, query, col);
+                }
+                buffer += '\n';
+                ++rows;
+
+                if (buffer.size() >= BufferSize && flush()) {
+                    const qint64 elapsed = timer.elapsed();
+                    if (elapsed - lastProgressMs >= ProgressIntervalMs) {
+                        lastProgressMs = elapsed;
+                        emit progress(rows, bytes);
+                    }
+                }
+            }
+
+            if (errorText.isEmpty() && rc != SQLITE_ROW && rc != SQLITE_DONE && !isCancelled())
+                errorText = query.errorText();
+            if (errorText.isEmpty() && !isCancelled())
+                flush();
+        }
+    }
+    interrupter.detach();
+    file.close();
+
+    if (isCancelled() || !errorText.isEmpty())
+        file.remove();
+
+    if (isCancelled())
+        emit cancelled();
+    else if (!errorText.isEmpty())
+        emit failed(errorText);
+    else
+        emit finished(rows, bytes, timer.elapsed());
+}
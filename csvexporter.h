@@ -0,0 +1,37 @@
+#ifndef CSVEXPORTER_H
+#define CSVEXPORTER_H
+
+#include "backgroundjob.h"
+#include <QSqlDatabase>
+
+// Потоковый экспорт результата SELECT в CSV.
+// Читает курсором только вперёд на собственном соединении и пишет через
+// большой переиспользуемый буфер, поэтому память не зависит от размера таблицы.
+// Значения идут из SqliteStatement прямо в буфер, без QVariant и UTF-16.
+class CsvExporter : public BackgroundJob
+{
+    Q_OBJECT
+
+public:
+    CsvExporter(const QString &fileName, const QString &statement,
+                const QString &sourceConnection = QString::fromLatin1(QSqlDatabase::defaultConnection),
+                QObject *parent = nullptr);
+
+    void run() override;
+
+signals:
+    void progress(qint64 rows, qint64 bytes);
+    void finished(qint64 rows, qint64 bytes, qint64 elapsedMs);
+    void cancelled();
+    void failed(const QString &message);
+
+private:
+    static constexpr qsizetype BufferSize = 4 * 1024 * 1024;
+    static constexpr int ProgressIntervalMs = 250;
+
+    QString fileName;
+    QString statement;
+    QString sourceConnection;
+};
+
+#endif // CSVEXPORTER_H
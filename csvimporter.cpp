@@ -0,0 +1,401 @@
+#include "csvimporter.h"
+#include "csvparser.h"
+#include <QElapsedTimer>
+#include <QFile>
+#include <QMutex>
+#include <QThread>
+#include <QThreadPool>
+#include <QWaitCondition>
+
+#include <sqlite3.h>
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+static bool execSql(sqlite3 *db, const QByteArray &sql, QString *error = nullptr)
+{
+    char *message = nullptr;
+    const int rc = sqlite3_exec(db, sql.constData(), nullptr, nullptr, &message);
+    if (rc != SQLITE_OK && error)
+        *error = QString::fromUtf8(message ? message : sqlite3_errmsg(db));
+    sqlite3_free(message);
+    return rc == SQLITE_OK;
+}
+
+static QByteArray pragmaValue(sqlite3 *db, const QByteArray &pragma)
+{
+    QByteArray value;
+    sqlite3_stmt *stmt = nullptr;
+    if (sqlite3_prepare_v2(db, ("PRAGMA " + pragma).constData(), -1, &stmt, nullptr) == SQLITE_OK
+        && sqlite3_step(stmt) == SQLITE_ROW) {
+        value = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 0));
+    }
+    sqlite3_finalize(stmt);
+    return value;
+}
+
+static QStringList tableColumns(sqlite3 *db, const QString &table)
+{
+    QStringList columns;
+    sqlite3_stmt *stmt = nullptr;
+    const QByteArray sql = "PRAGMA table_info(" + quoteIdentifier(table).toUtf8() + ")";
+    if (sqlite3_prepare_v2(db, sql.constData(), -1, &stmt, nullptr) == SQLITE_OK) {
+        while (sqlite3_step(stmt) == SQLITE_ROW)
+            columns << QString::fromUtf8(reinterpret_cast<const char *>(sqlite3_column_text(stmt, 1)));
+    }
+    sqlite3_finalize(stmt);
+    return columns;
+}
+
+// Копит строки и отправляет их многострочными INSERT.
+// Поля привязываются без копирования (SQLITE_STATIC), поэтому данные
+// фрагмента должны жить до flush().
+class BatchInserter
+{
+public:
+    BatchInserter(sqlite3 *db, const QString &table, const QStringList &columns)
+        : db(db),
+        columnCount(int(columns.size()))
+    {
+        QStringList quoted;
+        for (const QString &column : columns)
+            quoted << quoteIdentifier(column);
+        prefix = "INSERT INTO " + quoteIdentifier(table).toUtf8()
+                 + " (" + quoted.join(QLatin1String(", ")).toUtf8() + ") VALUES ";
+        rowPlaceholders = "(" + QByteArray("?, ").repeated(columnCount).chopped(2) + ")";
+
+        const int maxVariables = sqlite3_limit(db, SQLITE_LIMIT_VARIABLE_NUMBER, -1);
+        rowsPerStatement = qBound(1, maxVariables / qMax(1, columnCount), MaxRowsPerStatement);
+        pending.reserve(size_t(rowsPerStatement) * size_t(columnCount));
+    }
+
+    ~BatchInserter()
+    {
+        sqlite3_finalize(fullStatement);
+    }
+
+    bool addRow(const CsvField *fields, qsizetype count)
+    {
+        const qsizetype used = qMin<qsizetype>(count, columnCount);
+        pending.insert(pending.end(), fields, fields + used);
+        pending.resize(pending.size() + size_t(columnCount - used));
+
+        if (++pendingRows < rowsPerStatement)
+            return true;
+
+        if (!fullStatement && !prepare(rowsPerStatement, &fullStatement))
+            return false;
+        return execute(fullStatement);
+    }
+
+    bool flush()
+    {
+        if (pendingRows == 0)
+            return true;
+
+        // Хвост короче полного пакета — отдельный одноразовый запрос
+        sqlite3_stmt *tail = nullptr;
+        const bool ok = prepare(pendingRows, &tail) && execute(tail);
+        sqlite3_finalize(tail);
+        return ok;
+    }
+
+    QString errorText() const { return error; }
+
+private:
+    static constexpr int MaxRowsPerStatement = 500;
+
+    bool prepare(int rows, sqlite3_stmt **stmt)
+    {
+        QByteArray sql = prefix;
+        sql.reserve(prefix.size() + rows * (rowPlaceholders.size() + 2));
+        for (int row = 0; row < rows; ++row) {
+            if (row > 0) sql += ", ";
+            sql += rowPlaceholders;
+        }
+
+        if (sqlite3_prepare_v2(db, sql.constData(), int(sql.size()), stmt, nullptr) != SQLITE_OK) {
+            error = QString::fromUtf8(sqlite3_errmsg(db));
+            return false;
+        }
+        return true;
+    }
+
+    bool execute(sqlite3_stmt *stmt)
+    {
+        for (size_t i = 0; i < pending.size(); ++i) {
+            const CsvField &field = pending[i];
+            if (field.data)
+                sqlite3_bind_text(stmt, int(i) + 1, field.data, int(field.size), SQLITE_STATIC);
+            else
+                sqlite3_bind_null(stmt, int(i) + 1);
+        }
+
+        const int rc = sqlite3_step(stmt);
+        sqlite3_reset(stmt);
+        pending.clear();
+        pendingRows = 0;
+
+        if (rc != SQLITE_DONE) {
+            error = QString::fromUtf8(sqlite3_errmsg(db));
+            return false;
+        }
+        return true;
+    }
+
+    sqlite3 *db;
+    int columnCount;
+    int rowsPerStatement = 1;
+    QByteArray prefix;
+    QByteArray rowPlaceholders;
+    sqlite3_stmt *fullStatement = nullptr;
+    std::vector<CsvField> pending;
+    int pendingRows = 0;
+    QString error;
+};
+
+struct CsvChunk
+{
+    const char *begin;
+    const char *end;
+};
+
+// Делит файл на фрагменты по границам записей.
+// Сначала параллельно считаются кавычки в каждом куске фиксированного размера,
+// по чётности их суммы видно, не попадает ли граница внутрь поля в кавычках.
+static QList<CsvChunk> splitChunks(const char *begin, const char *end, qsizetype chunkSize,
+                                   const CsvParser &parser, QThreadPool *pool)
+{
+    const qsizetype size = end - begin;
+    const qsizetype count = qMax<qsizetype>(1, (size + chunkSize - 1) / chunkSize);
+
+    std::vector<qsizetype> quotes(size_t(count), 0);
+    for (qsizetype i = 0; i < count; ++i) {
+        pool->start([&quotes, begin, end, chunkSize, i] {
+            const char *first = begin + i * chunkSize;
+            const char *last = qMin(end, first + chunkSize);
+            quotes[size_t(i)] = CsvParser::countQuotes(first, last);
+        });
+    }
+    pool->waitForDone();
+
+    QList<CsvChunk> chunks;
+    const char *start = begin;
+    qsizetype quotesBefore = 0;
+    for (qsizetype i = 1; i < count; ++i) {
+        quotesBefore += quotes[size_t(i - 1)];
+        const char *provisional = begin + i * chunkSize;
+        if (provisional <= start)
+            continue;
+
+        const char *boundary = parser.nextRecord(provisional, end, quotesBefore % 2 == 1);
+        if (boundary >= end)
+            break;
+        chunks << CsvChunk { start, boundary };
+        start = boundary;
+    }
+    chunks << CsvChunk { start, end };
+    return chunks;
+}
+
+CsvImporter::CsvImporter(const QString &fileName, const QString &table,
+                         const CsvImportOptions &options, const QString &sourceConnection,
+                         QObject *parent)
+    : BackgroundJob(parent),
+    fileName(fileName),
+    table(table),
+    options(options),
+    sourceConnection(sourceConnection)
+{
+}
+
+void CsvImporter::run()
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        emit failed(tr("Не удалось открыть файл для чтения:\n%1").arg(file.errorString()));
+        return;
+    }
+
+    const qint64 totalBytes = file.size();
+    const char *data = nullptr;
+    if (totalBytes > 0) {
+        data = reinterpret_cast<const char *>(file.map(0, totalBytes));
+        if (!data) {
+            emit failed(tr("Не удалось отобразить файл в память:\n%1").arg(file.errorString()));
+            return;
+        }
+    }
+    const char *fileStart = data;
+    const char *end = data + totalBytes;
+
+    // BOM от Excel и Блокнота
+    if (totalBytes >= 3 && std::memcmp(data, "\xEF\xBB\xBF", 3) == 0)
+        data += 3;
+
+    ScopedConnection connection(sourceConnection, QStringLiteral("import"));
+    sqlite3 *db = connection.open() ? connection.handle() : nullptr;
+    if (!db) {
+        emit failed(connection.lastError().text());
+        return;
+    }
+    interrupter.attach(db);
+
+    const CsvParser parser(options.delimiter);
+
+    // Первая строка - заголовки; если все они совпадают со столбцами таблицы,
+    // вставляем по именам, иначе по порядку столбцов
+    const QStringList columns = options.tableColumns.isEmpty() ? tableColumns(db, table) : options.tableColumns;
+    QStringList targetColumns;
+    const char *body = data;
+    if (options.hasHeader && data < end) {
+        body = parser.nextRecord(data, end, false);
+        CsvRecords header;
+        parser.parse(data, body, header);
+        if (header.rowCount() > 0) {
+            for (qsizetype i = 0; i < header.fieldCount(0); ++i) {
+                const CsvField &field = header.row(0)[i];
+                const QString name = field.data ? QString::fromUtf8(field.data, field.size) : QString();
+                const auto match = std::find_if(columns.cbegin(), columns.cend(), [&name](const QString &column) {
+                    return column.compare(name, Qt::CaseInsensitive) == 0;
+                });
+                if (match == columns.cend()) {
+                    targetColumns.clear();
+                    break;
+                }
+                targetColumns << *match;
+            }
+        }
+    }
+    if (targetColumns.isEmpty())
+        targetColumns = columns;
+
+    if (targetColumns.isEmpty()) {
+        interrupter.detach();
+        emit failed(tr("Таблица %1 не найдена").arg(table));
+        return;
+    }
+
+    // Настройки на время импорта
+    const QByteArray savedJournalMode = pragmaValue(db, "journal_mode");
+    const QByteArray savedSynchronous = pragmaValue(db, "synchronous");
+    const QByteArray savedCacheSize = pragmaValue(db, "cache_size");
+    // PRAGMA journal_mode возвращает режим, который действует после неё: в WAL не
+    // переключается, например, база в памяти, а из WAL - пока открыты другие соединения
+    QByteArray journalMode = savedJournalMode;
+    if (!options.journalMode.isEmpty()) {
+        journalMode = pragmaValue(db, "journal_mode = " + options.journalMode.toLatin1());
+        if (journalMode.compare(options.journalMode.toLatin1(), Qt::CaseInsensitive) != 0) {
+            interrupter.detach();
+            emit failed(tr("Не удалось переключить журнал в режим %1, база осталась в режиме %2")
+                            .arg(options.journalMode, QString::fromLatin1(journalMode)));
+            return;
+        }
+    }
+    // Без журнала ROLLBACK не работает: вставленное до отмены или ошибки остаётся
+    const bool canRollBack = journalMode.compare("off", Qt::CaseInsensitive) != 0;
+    if (options.synchronousOff)
+        execSql(db, "PRAGMA synchronous = OFF");
+    if (options.cacheSizeMb > 0)
+        execSql(db, "PRAGMA cache_size = -" + QByteArray::number(qint64(options.cacheSizeMb) * 1024));
+
+    QThreadPool parsePool;
+    parsePool.setMaxThreadCount(qMax(1, QThread::idealThreadCount() - 1));
+
+    const QList<CsvChunk> chunks = body < end ? splitChunks(body, end, ChunkSize, parser, &parsePool)
+                                              : QList<CsvChunk>();
+
+    QString errorText;
+    qint64 rows = 0;
+
+    if (execSql(db, "BEGIN IMMEDIATE", &errorText)) {
+        BatchInserter inserter(db, table, targetColumns);
+
+        // Разобранные фрагменты отдаются писателю строго по порядку;
+        // впереди него разбирается не больше maxInFlight фрагментов
+        std::vector<std::unique_ptr<CsvRecords>> parsed(size_t(chunks.size()));
+        QMutex parsedMutex;
+        QWaitCondition parsedReady;
+        const qsizetype maxInFlight = qsizetype(parsePool.maxThreadCount()) * 2;
+        qsizetype submitted = 0;
+
+        auto submit = [&]() {
+            const qsizetype index = submitted++;
+            parsePool.start([&, index] {
+                auto records = std::make_unique<CsvRecords>();
+                if (!isCancelled())
+                    parser.parse(chunks.at(index).begin, chunks.at(index).end, *records);
+                QMutexLocker locker(&parsedMutex);
+                parsed[size_t(index)] = std::move(records);
+                parsedReady.wakeAll();
+            });
+        };
+        while (submitted < chunks.size() && submitted < maxInFlight)
+            submit();
+
+        for (qsizetype i = 0; i < chunks.size() && errorText.isEmpty() && !isCancelled(); ++i) {
+            std::unique_ptr<CsvRecords> records;
+            {
+                QMutexLocker locker(&parsedMutex);
+                while (!parsed[size_t(i)])
+                    parsedReady.wait(&parsedMutex);
+                records = std::move(parsed[size_t(i)]);
+            }
+            if (submitted < chunks.size())
+                submit();
+
+            for (qsizetype row = 0; row < records->rowCount(); ++row) {
+                if (!inserter.addRow(records->row(row), records->fieldCount(row))) {
+                    errorText = tr("Не удалось импортировать строку около %1:\n%2")
+                                    .arg(rows + row + 1)
+                                    .arg(inserter.errorText());
+                    break;
+                }
+            }
+            // Поля ссылаются на данные фрагмента, поэтому хвост отправляем до его освобождения
+            if (errorText.isEmpty() && !inserter.flush())
+                errorText = tr("Не удалось импортировать строку около %1:\n%2")
+                                .arg(rows + records->rowCount())
+                                .arg(inserter.errorText());
+            rows += records->rowCount();
+
+            emit progress(chunks.at(i).end - fileStart, totalBytes, rows);
+        }
+
+        // Отменяем ещё не начатый разбор и дожидаемся остальных
+        parsePool.clear();
+        parsePool.waitForDone();
+
+        if (errorText.isEmpty() && !isCancelled()) {
+            if (!execSql(db, "COMMIT", &errorText))
+                execSql(db, "ROLLBACK");
+        } else {
+            execSql(db, "ROLLBACK");
+        }
+    }
+
+    // Восстанавливаем настройки соединения
+    if (!options.journalMode.isEmpty() && !savedJournalMode.isEmpty())
+        execSql(db, "PRAGMA journal_mode = " + savedJournalMode);
+    if (options.synchronousOff && !savedSynchronous.isEmpty())
+        execSql(db, "PRAGMA synchronous = " + savedSynchronous);
+    if (options.cacheSizeMb > 0 && !savedCacheSize.isEmpty())
+        execSql(db, "PRAGMA cache_size = " + savedCacheSize);
+
+    interrupter.detach();
+
+    if (!canRollBack && !errorText.isEmpty())
+        errorText += QLatin1Char('\n') + tr("Журнал был отключён: строки, вставленные до ошибки, остались в таблице");
+
+    if (isCancelled())
+        emit cancelled(canRollBack);
+    else if (!errorText.isEmpty())
+        emit failed(errorText);
+    else
+        emit finished(rows, totalBytes, timer.elapsed());
+}
@@ -0,0 +1,51 @@
+#ifndef CSVIMPORTER_H
+#define CSVIMPORTER_H
+
+#include "backgroundjob.h"
+#include <QSqlDatabase>
+
+struct CsvImportOptions
+{
+    char delimiter = ',';
+    bool hasHeader = true;
+    QStringList tableColumns;   // столбцы таблицы из кэша схемы; пусто — прочитать PRAGMA table_info
+
+    // Настройки соединения на время импорта; по окончании восстанавливаются
+    QString journalMode;        // пусто — не менять, иначе WAL или OFF
+    bool synchronousOff = false;
+    int cacheSizeMb = 0;        // 0 — не менять
+};
+
+// Импорт CSV в существующую таблицу.
+// Файл отображается в память и делится на фрагменты по границам записей,
+// фрагменты разбираются параллельно, а единственный поток-писатель вставляет
+// их по порядку многострочными INSERT ... VALUES (...),(...) в одной транзакции.
+class CsvImporter : public BackgroundJob
+{
+    Q_OBJECT
+
+public:
+    CsvImporter(const QString &fileName, const QString &table,
+                const CsvImportOptions &options = CsvImportOptions(),
+                const QString &sourceConnection = QString::fromLatin1(QSqlDatabase::defaultConnection),
+                QObject *parent = nullptr);
+
+    void run() override;
+
+signals:
+    void progress(qint64 bytes, qint64 totalBytes, qint64 rows);
+    void finished(qint64 rows, qint64 bytes, qint64 elapsedMs);
+    // rolledBack = false: журнал был отключён, часть строк осталась в таблице
+    void cancelled(bool rolledBack);
+    void failed(const QString &message);
+
+private:
+    static constexpr qsizetype ChunkSize = 16 * 1024 * 1024;
+
+    QString fileName;
+    QString table;
+    CsvImportOptions options;
+    QString sourceConnection;
+};
+
+#endif // CSVIMPORTER_H
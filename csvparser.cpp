@@ -0,0 +1,171 @@
+#include "csvparser.h"
+#include <QtAlgorithms>
+
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define CSVPARSER_HAVE_SSE2
+#endif
+
+CsvParser::CsvParser(char delimiter, bool trimSpaces)
+    : delimiter(delimiter),
+    trimSpaces(trimSpaces)
+{
+}
+
+qsizetype CsvParser::countQuotes(const char *begin, const char *end)
+{
+    qsizetype count = 0;
+    const char *p = begin;
+
+#ifdef CSVPARSER_HAVE_SSE2
+    const __m128i quote = _mm_set1_epi8('"');
+    while (end - p >= 16) {
+        const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+        count += qPopulationCount(uint(_mm_movemask_epi8(_mm_cmpeq_epi8(block, quote))));
+        p += 16;
+    }
+#endif
+
+    for (; p < end; ++p) {
+        if (*p == '"')
+            ++count;
+    }
+    return count;
+}
+
+const char *CsvParser::findFieldEnd(const char *p, const char *end) const
+{
+#ifdef CSVPARSER_HAVE_SSE2
+    const __m128i delim = _mm_set1_epi8(delimiter);
+    const __m128i cr = _mm_set1_epi8('\r');
+    const __m128i lf = _mm_set1_epi8('\n');
+    while (end - p >= 16) {
+        const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+        const __m128i hits = _mm_or_si128(_mm_cmpeq_epi8(block, delim),
+                                          _mm_or_si128(_mm_cmpeq_epi8(block, cr), _mm_cmpeq_epi8(block, lf)));
+        const int mask = _mm_movemask_epi8(hits);
+        if (mask)
+            return p + qCountTrailingZeroBits(uint(mask));
+        p += 16;
+    }
+#endif
+
+    while (p < end && *p != delimiter && *p != '\r' && *p != '\n')
+        ++p;
+    return p;
+}
+
+const char *CsvParser::nextRecord(const char *p, const char *end, bool inQuotes) const
+{
+    while (p < end) {
+        if (inQuotes) {
+            // Удвоенная кавычка закроет и тут же снова откроет поле — это корректно
+            const char *quote = static_cast<const char *>(std::memchr(p, '"', size_t(end - p)));
+            if (!quote)
+                return end;
+            inQuotes = false;
+            p = quote + 1;
+            continue;
+        }
+
+        const char ch = *p++;
+        if (ch == '"')
+            inQuotes = true;
+        else if (ch == '\n')
+            return p;
+    }
+    return end;
+}
+
+void CsvParser::parse(const char *begin, const char *end, CsvRecords &records) const
+{
+    const char *p = begin;
+
+    while (p < end) {
+        // Пустые строки пропускаем
+        if (*p == '\n' || *p == '\r') {
+            ++p;
+            continue;
+        }
+
+        records.rowStarts.push_back(qsizetype(records.fields.size()));
+
+        for (;;) {
+            CsvField field;
+
+            if (p < end && *p == '"') {
+                const char *start = ++p;
+                const char *close = end;
+                bool escaped = false;
+                while (p < end) {
+                    const char *quote = static_cast<const char *>(std::memchr(p, '"', size_t(end - p)));
+                    if (!quote) {
+                        p = end;
+                        break;
+                    }
+                    if (quote + 1 < end && quote[1] == '"') {
+                        escaped = true;
+                        p = quote + 2;
+                        continue;
+                    }
+                    close = quote;
+                    p = quote + 1;
+                    break;
+                }
+
+                if (escaped) {
+                    // Адреса в arena стабильны: раскавыченный текст не длиннее исходного фрагмента
+                    if (!records.arena) {
+                        records.arena.reset(new char[size_t(end - begin)]);
+                        records.arenaUsed = 0;
+                    }
+                    char *out = records.arena.get() + records.arenaUsed;
+                    qsizetype size = 0;
+                    for (const char *s = start; s < close; ++s) {
+                        out[size++] = *s;
+                        if (*s == '"' && s + 1 < close && s[1] == '"')
+                            ++s;
+                    }
+                    records.arenaUsed += size;
+                    field.data = out;
+                    field.size = size;
+                } else {
+                    field.data = start;
+                    field.size = close - start;
+                }
+
+                // Всё между закрывающей кавычкой и разделителем отбрасываем
+                p = findFieldEnd(p, end);
+            } else {
+                const char *fieldEnd = findFieldEnd(p, end);
+                const char *first = p;
+                const char *last = fieldEnd;
+                while (trimSpaces && first < last && (*first == ' ' || *first == '\t'))
+                    ++first;
+                while (trimSpaces && last > first && (last[-1] == ' ' || last[-1] == '\t'))
+                    --last;
+                if (first < last) {
+                    field.data = first;
+                    field.size = last - first;
+                }
+                p = fieldEnd;
+            }
+
+            records.fields.push_back(field);
+
+            if (p < end && *p == delimiter) {
+                ++p;
+                continue;
+            }
+            break;
+        }
+
+        // Конец записи: \r\n, \n или \r
+        if (p < end && *p == '\r')
+            ++p;
+        if (p < end && *p == '\n')
+            ++p;
+    }
+}
@@ -0,0 +1,63 @@
+#ifndef CSVPARSER_H
+#define CSVPARSER_H
+
+#include <QtGlobal>
+
+#include <memory>
+#include <vector>
+
+// Поле CSV. Указывает либо в исходный буфер, либо (если внутри были
+// удвоенные кавычки) в собственную копию CsvRecords::arena.
+// data == nullptr означает отсутствующее или пустое поле без кавычек (NULL),
+// а пустая строка записывается как "".
+struct CsvField
+{
+    const char *data = nullptr;
+    qsizetype size = 0;
+};
+
+// Разобранный фрагмент CSV
+struct CsvRecords
+{
+    std::vector<CsvField> fields;
+    std::vector<qsizetype> rowStarts;   // индекс первого поля каждой записи
+    std::unique_ptr<char[]> arena;      // раскавыченные поля
+    qsizetype arenaUsed = 0;
+
+    qsizetype rowCount() const { return qsizetype(rowStarts.size()); }
+    qsizetype fieldCount(qsizetype row) const
+    {
+        const qsizetype next = row + 1 < rowCount() ? rowStarts[row + 1] : qsizetype(fields.size());
+        return next - rowStarts[row];
+    }
+    const CsvField *row(qsizetype row) const { return fields.data() + rowStarts[row]; }
+};
+
+// Разбор CSV по RFC 4180: поля в кавычках могут содержать разделители,
+// переводы строк и удвоенные кавычки. Разделитель, кавычку и конец строки
+// ищет SSE2-сканер по 16 байт за шаг, поля не копируются.
+// С trimSpaces пробелы и табуляции вокруг полей без кавычек отбрасываются
+// (так пишут CSV руками); без него поле берётся как есть, как из буфера обмена.
+class CsvParser
+{
+public:
+    explicit CsvParser(char delimiter = ',', bool trimSpaces = true);
+
+    // Число кавычек в диапазоне; по его чётности определяется,
+    // находится ли произвольная позиция внутри поля в кавычках
+    static qsizetype countQuotes(const char *begin, const char *end);
+
+    // Начало следующей записи после pos; inQuotes — состояние в точке pos
+    const char *nextRecord(const char *pos, const char *end, bool inQuotes) const;
+
+    // begin должен указывать на начало записи
+    void parse(const char *begin, const char *end, CsvRecords &records) const;
+
+private:
+    const char *findFieldEnd(const char *pos, const char *end) const;
+
+    char delimiter;
+    bool trimSpaces;
+};
+
+#endif // CSVPARSER_H
@@ -1,10 +1,38 @@
 #include "databaseadmin.h"
+#include "batchsubmitter.h"
+#include "changetracker.h"
+#include "columnarexporter.h"
+#include "columnarimporter.h"
+#include "columnprofilepanel.h"
+#include "connectionprofile.h"
+#include "csvexporter.h"
+#include "csvimporter.h"
+#include "databasemaintenance.h"
+#include "databasesearch.h"
+#include "indexbuilder.h"
+#include "pagedtablemodel.h"
+#include "queryprofilerpanel.h"
+#include "queryresultmodel.h"
+#include "queryworker.h"
+#include "recentdatabases.h"
+#include "resultcache.h"
+#include "schemacatalog.h"
+#include "scriptresultpanel.h"
+#include "scriptrunner.h"
+#include "searchpanel.h"
+#include "sqliteutil.h"
+#include "statementcache.h"
+#include "tableclipboard.h"
+#include "tablecopier.h"
+#include "tablepickerdialog.h"
 #include <QApplication>
 #include <QTableView>
 #include <QTextEdit>
+#include <QTextBlock>
 #include <QStatusBar>
 #include <QDockWidget>
 #include <QMenuBar>
+#include <QMenu>
 #include <QToolBar>
 #include <QMessageBox>
 #include <QInputDialog>
@@ -20,30 +48,85 @@
 #include <QFormLayout>
 #include <QDialogButtonBox>
 #include <QLineEdit>
-#include <QSqlTableModel>
 #include <QSqlRecord>
+#include <QLabel>
+#include <QActionGroup>
+#include <QCheckBox>
+#include <QComboBox>
+#include <QSpinBox>
+#include <QProgressDialog>
+#include <QSignalBlocker>
+#include <QThread>
+#include <QPushButton>
+#include <QFileInfo>
+#include <QPromise>
+#include <QThreadPool>
+#include <QTimer>
+#include <QTreeWidget>
+#include <QVBoxLayout>
 
 DatabaseAdmin::DatabaseAdmin(QWidget *parent)
     : QMainWindow(parent),
-    sqlModel(new QSqlTableModel(this)),
-    settings(new QSettings("DatabaseAdmin", "QtDBAdmin", this))
+    sqlModel(new PagedTableModel(this)),
+    schemaCatalog(new SchemaCatalog),
+    queryThread(nullptr),
+    queryWorker(nullptr),
+    resultModel(new QueryResultModel(this)),
+    settings(new QSettings("DatabaseAdmin", "QtDBAdmin", this)),
+    schemaWatcher(new QFutureWatcher<QByteArray>(this)),
+    openWatcher(new QFutureWatcher<OpenedDatabase>(this))
 {
-    // Проверка доступности драйвера SQLite
-    if (!QSqlDatabase::isDriverAvailable("QSQLITE")) {
-        QMessageBox::critical(nullptr, "Ошибка", "Драйвер SQLite не доступен");
-        exit(1);
-    }
-
+    // Драйвер QSQLITE проверяет main() до создания окна
     setupUI();
     loadSettings();
+    connect(schemaWatcher, &QFutureWatcher<QByteArray>::finished, this, &DatabaseAdmin::onSchemaRevalidated);
+    connect(openWatcher, &QFutureWatcher<OpenedDatabase>::finished, this, &DatabaseAdmin::onDatabaseOpened);
+
+    // Окно показывается сразу, последняя база открывается уже из цикла событий
+    if (reopenLastAction->isChecked() && !recentDatabases.isEmpty())
+        QTimer::singleShot(0, this, &DatabaseAdmin::restoreSession);
 }
 
 DatabaseAdmin::~DatabaseAdmin()
 {
     saveSettings();
-    if (QSqlDatabase::contains(QSqlDatabase::defaultConnection)) {
-        QSqlDatabase::removeDatabase(QSqlDatabase::defaultConnection);
+
+    // Останавливаем рабочий поток до удаления соединений
+    queryWorker->cancel();
+    queryThread->quit();
+    queryThread->wait();
+
+    for (const QPointer<BackgroundJob> &job : std::as_const(runningJobs)) {
+        if (job)
+            job->cancel();
     }
+    for (const QPointer<QThread> &thread : std::as_const(jobThreads)) {
+        if (thread)
+            thread->wait();
+    }
+
+    delete schemaCatalog;
+
+    closeDefaultConnection();
+}
+
+bool DatabaseAdmin::closeDefaultConnection()
+{
+    // Соединение, которое ещё открывается в фоне, сначала дожидаемся: удалять его из-под потока нельзя
+    if (openWatcher->isRunning())
+        openWatcher->waitForFinished();
+    openingPath.clear();
+    if (!QSqlDatabase::contains(QSqlDatabase::defaultConnection))
+        return false;
+
+    // Кэши и трекер держат дескриптор исходного соединения: убираем их до removeDatabase
+    const QString connectionName = QString::fromLatin1(QSqlDatabase::defaultConnection);
+    StatementCache::removeForConnection(connectionName);
+    ResultCache::removeForConnection(connectionName);
+    ChangeTracker::removeForConnection(connectionName);
+    ConnectionProfile::removeForConnection(connectionName);
+    QSqlDatabase::removeDatabase(connectionName);
+    return true;
 }
 
 void DatabaseAdmin::setupUI()
@@ -52,16 +135,75 @@ void DatabaseAdmin::setupUI()
     tableView = new QTableView(this);
     queryEditor = new QTextEdit(this);
     statusBar = new QStatusBar(this);
-
-    // Настройка модели
-    sqlModel->setEditStrategy(QSqlTableModel::OnManualSubmit);
+    queryStatsLabel = new QLabel(this);
+    statusBar->addPermanentWidget(queryStatsLabel);
+    profileLabel = new QLabel(this);
+    statusBar->addPermanentWidget(profileLabel);
+    resultCacheLabel = new QLabel(this);
+    statusBar->addPermanentWidget(resultCacheLabel);
+
+    // Настройка модели: строки читаются страницами, правки копятся до "Применить"
     tableView->setModel(sqlModel);
+    // Записи этого и других соединений подхватываются без полного select()
+    sqlModel->setChangeTracking(true);
+    connect(sqlModel, &PagedTableModel::rowCountRefined, this, [this](int rows) {
+        statusBar->showMessage(tr("Строк в таблице %1: %2").arg(sqlModel->tableName(), QString::number(rows)), 3000);
+    });
 
     // Док-окно для запросов
     queryDock = new QDockWidget(tr("SQL Запрос"), this);
+    queryDock->setObjectName("queryDock");
     queryDock->setWidget(queryEditor);
     addDockWidget(Qt::BottomDockWidgetArea, queryDock);
 
+    // Профилировщик запросов - вкладкой рядом с редактором
+    profilerPanel = new QueryProfilerPanel(this);
+    profilerDock = new QDockWidget(tr("Профилировщик"), this);
+    profilerDock->setObjectName("profilerDock");
+    profilerDock->setWidget(profilerPanel);
+    addDockWidget(Qt::BottomDockWidgetArea, profilerDock);
+    tabifyDockWidget(queryDock, profilerDock);
+
+    // Итоги скриптов из нескольких операторов
+    scriptPanel = new ScriptResultPanel(this);
+    scriptDock = new QDockWidget(tr("Результаты скрипта"), this);
+    scriptDock->setObjectName("scriptDock");
+    scriptDock->setWidget(scriptPanel);
+    addDockWidget(Qt::BottomDockWidgetArea, scriptDock);
+    tabifyDockWidget(profilerDock, scriptDock);
+    connect(scriptPanel, &ScriptResultPanel::statementActivated, this, &DatabaseAdmin::showScriptStatement);
+
+    // Поиск по всей базе - ещё одна вкладка
+    searchPanel = new SearchPanel(this);
+    searchDock = new QDockWidget(tr("Поиск"), this);
+    searchDock->setObjectName("searchDock");
+    searchDock->setWidget(searchPanel);
+    addDockWidget(Qt::BottomDockWidgetArea, searchDock);
+    tabifyDockWidget(scriptDock, searchDock);
+    connect(searchPanel, &SearchPanel::searchRequested, this, &DatabaseAdmin::startSearch);
+    connect(searchPanel, &SearchPanel::stopRequested, this, &DatabaseAdmin::stopSearch);
+    connect(searchPanel, &SearchPanel::matchActivated, this, &DatabaseAdmin::openSearchMatch);
+    queryDock->raise();
+
+    // Профиль столбцов открытой таблицы - справа, по умолчанию скрыт
+    profilePanel = new ColumnProfilePanel(this);
+    profileDock = new QDockWidget(tr("Профиль таблицы"), this);
+    profileDock->setObjectName("profileDock");
+    profileDock->setWidget(profilePanel);
+    addDockWidget(Qt::RightDockWidgetArea, profileDock);
+    profileDock->hide();
+    connect(profileDock, &QDockWidget::visibilityChanged, this, [this](bool visible) {
+        if (visible)
+            profileTable(sqlModel->tableName());
+    });
+    connect(profilePanel, &ColumnProfilePanel::refreshRequested, this, [this] {
+        profileTable(sqlModel->tableName(), true);
+    });
+    connect(profilePanel, &ColumnProfilePanel::stopRequested, this, [this] {
+        if (activeProfiler)
+            activeProfiler->cancel();
+    });
+
     // Настройка главного окна
     setCentralWidget(tableView);
     setStatusBar(statusBar);
@@ -72,12 +214,84 @@ void DatabaseAdmin::setupUI()
     tableView->setSelectionMode(QAbstractItemView::ExtendedSelection);
     tableView->setSelectionBehavior(QAbstractItemView::SelectRows);
     tableView->setEditTriggers(QAbstractItemView::DoubleClicked);
-    tableView->setSortingEnabled(true);
     tableView->horizontalHeader()->setSectionResizeMode(QHeaderView::Interactive);
 
+    // Сортировка по щелчку на заголовке уходит в SQLite после проверки индексов,
+    // фильтры по столбцам - из контекстного меню заголовка
+    QHeaderView *header = tableView->horizontalHeader();
+    header->setSectionsClickable(true);
+    header->setSortIndicatorShown(true);
+    header->setSortIndicator(-1, Qt::AscendingOrder);
+    header->setContextMenuPolicy(Qt::CustomContextMenu);
+    connect(header, &QHeaderView::sortIndicatorChanged, this, &DatabaseAdmin::sortByColumn);
+    connect(header, &QHeaderView::customContextMenuRequested, this, &DatabaseAdmin::showHeaderMenu);
+
     // Создание меню и панелей инструментов
     createMenus();
     createToolBars();
+
+    setupQueryWorker();
+}
+
+void DatabaseAdmin::setupQueryWorker()
+{
+    // Запросы выполняются в отдельном потоке на собственном соединении,
+    // чтобы долгий SELECT не блокировал интерфейс
+    queryThread = new QThread(this);
+    queryWorker = new QueryWorker;
+    queryWorker->moveToThread(queryThread);
+
+    connect(queryThread, &QThread::finished, queryWorker, &QObject::deleteLater);
+    connect(queryWorker, &QueryWorker::columnsReady, this, &DatabaseAdmin::onQueryColumns);
+    connect(queryWorker, &QueryWorker::rowsReady, this, &DatabaseAdmin::onQueryRows);
+    connect(queryWorker, &QueryWorker::progress, this, &DatabaseAdmin::onQueryProgress);
+    connect(queryWorker, &QueryWorker::finished, this, &DatabaseAdmin::onQueryFinished);
+    connect(queryWorker, &QueryWorker::cancelled, this, &DatabaseAdmin::onQueryCancelled);
+    connect(queryWorker, &QueryWorker::failed, this, &DatabaseAdmin::onQueryFailed);
+    connect(queryWorker, &QueryWorker::profiled, profilerPanel, &QueryProfilerPanel::addProfile);
+    connect(queryWorker, &QueryWorker::profiled, this, &DatabaseAdmin::onQueryProfiled);
+
+    queryThread->start();
+    setQueryRunning(false);
+}
+
+void DatabaseAdmin::resetWorkerConnections()
+{
+    // Соединения рабочих потоков клонируются с основного,
+    // поэтому после переподключения их нужно пересоздать
+    QMetaObject::invokeMethod(queryWorker, &QueryWorker::resetConnection, Qt::QueuedConnection);
+
+    // У другой базы может оказаться тот же schema_version
+    schemaCatalog->invalidate();
+    // и те же data_version, а профили относятся к прежней
+    tableProfiles.clear();
+    profilePanel->clear();
+}
+
+void DatabaseAdmin::startJob(BackgroundJob *job)
+{
+    // Незавершённые задачи прерываются и дожидаются в деструкторе
+    runningJobs.removeAll(nullptr);
+    jobThreads.removeAll(nullptr);
+    runningJobs << job;
+    jobThreads << job->start();
+}
+
+void DatabaseAdmin::setQueryRunning(bool running)
+{
+    executeAction->setEnabled(!running);
+    cancelQueryAction->setEnabled(running);
+}
+
+void DatabaseAdmin::setViewModel(QAbstractItemModel *model)
+{
+    if (tableView->model() == model)
+        return;
+
+    // setModel() не удаляет старую модель выделения
+    QItemSelectionModel *oldSelection = tableView->selectionModel();
+    tableView->setModel(model);
+    delete oldSelection;
 }
 
 void DatabaseAdmin::createMenus()
@@ -86,14 +300,28 @@ void DatabaseAdmin::createMenus()
     QMenu *fileMenu = menuBar()->addMenu(tr("&Файл"));
     connectAction = fileMenu->addAction(tr("&Подключиться..."), this, &DatabaseAdmin::connectToDatabase);
     disconnectAction = fileMenu->addAction(tr("&Отключиться"), this, &DatabaseAdmin::disconnectFromDatabase);
+    recentMenu = fileMenu->addMenu(tr("&Недавние базы"));
+    reopenLastAction = new QAction(tr("Открывать последнюю базу при &запуске"), this);
+    reopenLastAction->setCheckable(true);
+    reopenLastAction->setChecked(true);
     fileMenu->addSeparator();
     exportAction = fileMenu->addAction(tr("&Экспорт в CSV..."), this, &DatabaseAdmin::exportToCSV);
     importAction = fileMenu->addAction(tr("&Импорт из CSV..."), this, &DatabaseAdmin::importFromCSV);
+    fileMenu->addAction(tr("Экспорт в &колоночный дамп..."), this, &DatabaseAdmin::exportToDump);
+    fileMenu->addAction(tr("Импорт из к&олоночного дампа..."), this, &DatabaseAdmin::importFromDump);
     fileMenu->addSeparator();
     fileMenu->addAction(tr("&Выход"), qApp, &QApplication::closeAllWindows);
 
     QMenu *dbMenu = menuBar()->addMenu(tr("&База данных"));
     dbMenu->addAction(tr("&Создать БД..."), this, &DatabaseAdmin::createDatabase);
+    dbMenu->addSeparator();
+    dbMenu->addAction(tr("&Резервная копия..."), this, &DatabaseAdmin::backupDatabase);
+    dbMenu->addAction(tr("&Снимок (VACUUM INTO)..."), this, &DatabaseAdmin::snapshotDatabase);
+    dbMenu->addAction(tr("&Освободить место (incremental_vacuum)"), this, &DatabaseAdmin::incrementalVacuum);
+    dbMenu->addAction(tr("&Копировать таблицы в другую базу..."), this, &DatabaseAdmin::copyTables);
+    dbMenu->addSeparator();
+    profileMenu = dbMenu->addMenu(tr("&Профиль соединения"));
+    profileGroup = new QActionGroup(this);
 
     // Меню "Правка"
     QMenu *editMenu = menuBar()->addMenu(tr("&Правка"));
@@ -102,6 +330,8 @@ void DatabaseAdmin::createMenus()
     editMenu->addSeparator();
     copyAction = editMenu->addAction(tr("&Копировать"), this, &DatabaseAdmin::copyData);
     copyAction->setShortcut(QKeySequence::Copy);
+    pasteAction = editMenu->addAction(tr("В&ставить"), this, &DatabaseAdmin::pasteData);
+    pasteAction->setShortcut(QKeySequence::Paste);
     deleteAction = editMenu->addAction(tr("&Удалить строки"), this, &DatabaseAdmin::deleteSelectedRows);
     insertAction = editMenu->addAction(tr("&Вставить строку"), this, &DatabaseAdmin::insertRow);
     editMenu->addSeparator();
@@ -114,6 +344,21 @@ void DatabaseAdmin::createMenus()
     tableMenu->addSeparator();
     tableMenu->addAction(tr("&Создать таблицу..."), this, &DatabaseAdmin::createTable);
     tableMenu->addAction(tr("&Удалить таблицу..."), this, &DatabaseAdmin::dropTable);
+    tableMenu->addSeparator();
+    QAction *searchAction = tableMenu->addAction(tr("П&оиск по базе"), this, [this] {
+        searchDock->show();
+        searchDock->raise();
+        searchPanel->setFocus();
+    });
+    searchAction->setShortcut(QKeySequence(Qt::CTRL | Qt::SHIFT | Qt::Key_F));
+    tableMenu->addAction(tr("Удалить поисковые &индексы"), this, &DatabaseAdmin::dropSearchIndexes);
+    tableMenu->addSeparator();
+    QAction *profileAction = tableMenu->addAction(tr("Про&филь столбцов"), this, [this] {
+        profileDock->show();
+        profileDock->raise();
+        profileTable(sqlModel->tableName());
+    });
+    profileAction->setShortcut(QKeySequence(Qt::CTRL | Qt::SHIFT | Qt::Key_P));
 
     // Меню "Вид"
     QMenu *viewMenu = menuBar()->addMenu(tr("&Вид"));
@@ -125,6 +370,18 @@ void DatabaseAdmin::createMenus()
     QMenu *queryMenu = menuBar()->addMenu(tr("&Запрос"));
     executeAction = queryMenu->addAction(tr("&Выполнить"), this, &DatabaseAdmin::executeQuery);
     executeAction->setShortcut(Qt::Key_F5);
+    cancelQueryAction = queryMenu->addAction(tr("&Прервать"), this, &DatabaseAdmin::cancelQuery);
+    cancelQueryAction->setShortcut(QKeySequence(Qt::SHIFT | Qt::Key_F5));
+    queryMenu->addSeparator();
+    scriptTransactionAction = queryMenu->addAction(tr("Скрипт в одной &транзакции"));
+    scriptTransactionAction->setCheckable(true);
+    scriptTransactionAction->setChecked(true);
+    scriptTransactionAction->setToolTip(tr("Все операторы скрипта фиксируются разом, ошибка откатывает весь скрипт"));
+    queryMenu->addSeparator();
+    queryMenu->addAction(profilerDock->toggleViewAction());
+    queryMenu->addAction(scriptDock->toggleViewAction());
+    queryMenu->addAction(tr("&Кэш подготовленных запросов..."), this, &DatabaseAdmin::showStatementCache);
+    queryMenu->addAction(tr("Кэш &результатов..."), this, &DatabaseAdmin::showResultCache);
 }
 
 void DatabaseAdmin::createDatabase()
@@ -145,18 +402,22 @@ void DatabaseAdmin::createDatabase()
     QString fullPath = QDir::current().absoluteFilePath(dbName);
 
     // Удаляем старое соединение если есть
-    if (QSqlDatabase::contains(QSqlDatabase::defaultConnection)) {
-        QSqlDatabase::removeDatabase(QSqlDatabase::defaultConnection);
-    }
+    rememberView();
+    databasePath.clear();
+    closeDefaultConnection();
 
     QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE");
     db.setDatabaseName(fullPath);
+    db.setConnectOptions(currentProfile().connectOptions());
 
     if (!db.open()) {
         QMessageBox::critical(this, tr("Ошибка"),
                               tr("Не удалось создать базу данных:\n%1").arg(db.lastError().text()));
         return;
     }
+    applyProfile(db);
+    ChangeTracker::setForConnection(db.connectionName(), std::make_shared<ChangeTracker>(db.connectionName()));
+    ResultCache::forConnection(db.connectionName()).setBudget(qint64(resultCacheMb) * 1024 * 1024);
 
     // Создаем простую таблицу для примера
     QSqlQuery query;
@@ -170,7 +431,7 @@ void DatabaseAdmin::createDatabase()
                              tr("База данных успешно создана:\n%1").arg(fullPath));
 
     // Подключаемся к новой БД
-    connectToDatabase();
+    openDatabase(fullPath, true);
 }
 
 void DatabaseAdmin::refreshDatabaseList()
@@ -244,6 +505,222 @@ void DatabaseAdmin::dropDatabase()
 
 
 
+QString DatabaseAdmin::maintenanceTarget(const QString &title, const QString &suffix)
+{
+    const QSqlDatabase db = QSqlDatabase::database();
+    if (!db.isOpen()) {
+        QMessageBox::warning(this, tr("Ошибка"), tr("База данных не подключена"));
+        return QString();
+    }
+
+    const QFileInfo source(db.databaseName());
+    const QString proposed = QDir(lastDir).filePath(source.completeBaseName() + suffix + QStringLiteral(".db"));
+    const QString fileName = QFileDialog::getSaveFileName(this, title, proposed, tr("Базы SQLite (*.db *.sqlite)"));
+    if (fileName.isEmpty())
+        return QString();
+
+    if (QFileInfo(fileName).absoluteFilePath() == source.absoluteFilePath()) {
+        QMessageBox::warning(this, tr("Ошибка"), tr("Копию нельзя записать поверх самой базы"));
+        return QString();
+    }
+    lastDir = QFileInfo(fileName).path();
+    return fileName;
+}
+
+void DatabaseAdmin::backupDatabase()
+{
+    const QString fileName = maintenanceTarget(tr("Резервная копия"), QStringLiteral("-backup"));
+    if (!fileName.isEmpty())
+        startMaintenance(new DatabaseMaintenance(DatabaseMaintenance::Backup, fileName), tr("Резервная копия"));
+}
+
+void DatabaseAdmin::snapshotDatabase()
+{
+    const QString fileName = maintenanceTarget(tr("Снимок базы"), QStringLiteral("-snapshot"));
+    if (!fileName.isEmpty())
+        startMaintenance(new DatabaseMaintenance(DatabaseMaintenance::VacuumInto, fileName), tr("Снимок базы"));
+}
+
+void DatabaseAdmin::incrementalVacuum()
+{
+    if (!QSqlDatabase::database().isOpen()) {
+        QMessageBox::warning(this, tr("Ошибка"), tr("База данных не подключена"));
+        return;
+    }
+    startMaintenance(new DatabaseMaintenance(DatabaseMaintenance::IncrementalVacuum), tr("Освобождение места"));
+}
+
+void DatabaseAdmin::copyTables()
+{
+    const QSqlDatabase db = QSqlDatabase::database();
+    if (!db.isOpen()) {
+        QMessageBox::warning(this, tr("Ошибка"), tr("База данных не подключена"));
+        return;
+    }
+
+    const SchemaCatalog &schema = catalog();
+    QStringList candidates;
+    for (const QString &name : schema.tableNames()) {
+        if (!schema.table(name)->isVirtual)
+            candidates << name;
+    }
+
+    bool ok;
+    const QStringList tables = TablePickerDialog::getTables(this, tr("Копирование таблиц"),
+                                                           tr("Таблицы для копирования (Ctrl, Shift - несколько):"),
+                                                           candidates, &ok);
+    if (!ok) return;
+
+    // Целевая база может уже существовать: таблицы добавляются в неё
+    const QString fileName = QFileDialog::getSaveFileName(this, tr("Целевая база"), lastDir,
+                                                          tr("Базы SQLite (*.db *.sqlite)"), nullptr,
+                                                          QFileDialog::DontConfirmOverwrite);
+    if (fileName.isEmpty()) return;
+
+    if (QFileInfo(fileName).absoluteFilePath() == QFileInfo(db.databaseName()).absoluteFilePath()) {
+        QMessageBox::warning(this, tr("Ошибка"), tr("Нельзя копировать таблицы в ту же базу"));
+        return;
+    }
+    lastDir = QFileInfo(fileName).path();
+
+    TableCopyOptions options;
+    settings->beginGroup("Copy");
+    options.incremental = settings->value("incremental", false).toBool();
+    options.updatedColumn = settings->value("updatedColumn").toString();
+    options.readers = settings->value("readers", 0).toInt();
+    settings->endGroup();
+
+    QDialog dialog(this);
+    dialog.setWindowTitle(tr("Копирование таблиц"));
+    QFormLayout layout(&dialog);
+
+    QCheckBox *incrementalBox = new QCheckBox(tr("Только новые строки (иначе таблицы пересоздаются)"), &dialog);
+    incrementalBox->setChecked(options.incremental);
+    layout.addRow(incrementalBox);
+
+    QLineEdit *updatedEdit = new QLineEdit(options.updatedColumn, &dialog);
+    updatedEdit->setPlaceholderText(tr("пусто - по rowid"));
+    updatedEdit->setEnabled(options.incremental);
+    layout.addRow(tr("Столбец времени изменения:"), updatedEdit);
+    connect(incrementalBox, &QCheckBox::toggled, updatedEdit, &QWidget::setEnabled);
+
+    QSpinBox *readersBox = new QSpinBox(&dialog);
+    readersBox->setRange(0, 64);
+    readersBox->setSpecialValueText(tr("По числу ядер"));
+    readersBox->setValue(options.readers);
+    layout.addRow(tr("Потоков чтения:"), readersBox);
+
+    // Без общего снимка читатели в режиме WAL начинают чтение независимо друг от друга
+    QSqlQuery journal(QStringLiteral("PRAGMA journal_mode"), db);
+    if (!TableCopier::hasSnapshots() && journal.next()
+        && journal.value(0).toString().compare(QLatin1String("wal"), Qt::CaseInsensitive) == 0) {
+        QLabel *note = new QLabel(tr("База в режиме WAL, а SQLite собран без поддержки снимков: если в базу "
+                                     "пишут во время копирования, потоки чтения могут увидеть разные её версии."),
+                                  &dialog);
+        note->setWordWrap(true);
+        layout.addRow(note);
+    }
+
+    QDialogButtonBox buttons(QDialogButtonBox::Ok | QDialogButtonBox::Cancel, Qt::Horizontal, &dialog);
+    layout.addRow(&buttons);
+    connect(&buttons, &QDialogButtonBox::accepted, &dialog, &QDialog::accept);
+    connect(&buttons, &QDialogButtonBox::rejected, &dialog, &QDialog::reject);
+
+    if (dialog.exec() != QDialog::Accepted)
+        return;
+
+    options.incremental = incrementalBox->isChecked();
+    options.updatedColumn = updatedEdit->text().trimmed();
+    options.readers = readersBox->value();
+
+    settings->beginGroup("Copy");
+    settings->setValue("incremental", options.incremental);
+    settings->setValue("updatedColumn", options.updatedColumn);
+    settings->setValue("readers", options.readers);
+    settings->endGroup();
+
+    auto *copier = new TableCopier(fileName, tables, options);
+
+    auto *progress = new QProgressDialog(tr("Копирование в %1...").arg(fileName), tr("Отмена"), 0, 1000, this);
+    progress->setAttribute(Qt::WA_DeleteOnClose);
+    progress->setWindowModality(Qt::NonModal);
+    progress->setMinimumDuration(500);
+    progress->setAutoClose(false);
+    progress->setAutoReset(false);
+
+    connect(progress, &QProgressDialog::canceled, copier, &BackgroundJob::cancel, Qt::DirectConnection);
+    connect(copier, &TableCopier::progress, progress, [progress](const QString &table, qint64 rows, int permille) {
+        progress->setValue(qBound(0, permille, 1000));
+        progress->setLabelText(tr("Таблица %1, скопировано строк: %2").arg(table).arg(rows));
+    });
+    connect(copier, &TableCopier::done, progress, &QProgressDialog::close);
+    connect(copier, &TableCopier::warning, this, [this](const QString &message) {
+        statusBar->showMessage(message, 5000);
+    });
+    connect(copier, &TableCopier::finished, this, [this, fileName](int tables, qint64 rows, qint64 elapsedMs) {
+        const double seconds = qMax<qint64>(elapsedMs, 1) / 1000.0;
+        statusBar->showMessage(tr("Скопировано таблиц: %1, строк: %2 в %3 (%4 строк/с)")
+                                   .arg(tables)
+                                   .arg(rows)
+                                   .arg(fileName)
+                                   .arg(qRound64(rows / seconds)), 5000);
+    });
+    connect(copier, &TableCopier::cancelled, this, [this] {
+        statusBar->showMessage(tr("Копирование отменено, целевая база не изменена"), 3000);
+    });
+    connect(copier, &TableCopier::failed, this, [this](const QString &message) {
+        QMessageBox::critical(this, tr("Ошибка"), tr("Не удалось скопировать таблицы:\n%1").arg(message));
+    });
+
+    startJob(copier);
+}
+
+void DatabaseAdmin::startMaintenance(DatabaseMaintenance *job, const QString &title)
+{
+    // Операция идёт на своём соединении; таблица и запросы остаются доступны
+    auto *progress = new QProgressDialog(title + QStringLiteral("..."), tr("Отмена"), 0, 1000, this);
+    progress->setAttribute(Qt::WA_DeleteOnClose);
+    progress->setWindowModality(Qt::NonModal);
+    progress->setMinimumDuration(500);
+    progress->setAutoClose(false);
+    progress->setAutoReset(false);
+
+    connect(progress, &QProgressDialog::canceled, job, &BackgroundJob::cancel, Qt::DirectConnection);
+    connect(job, &DatabaseMaintenance::progress, progress,
+            [progress, title](qint64 doneBytes, qint64 totalBytes, qint64 elapsedMs) {
+        const double megabytes = doneBytes / (1024.0 * 1024.0);
+        const double speed = megabytes / (qMax<qint64>(elapsedMs, 1) / 1000.0);
+        QString text = tr("%1: %2 из %3 МБ, %4 МБ/с")
+                           .arg(title)
+                           .arg(megabytes, 0, 'f', 1)
+                           .arg(totalBytes / (1024.0 * 1024.0), 0, 'f', 1)
+                           .arg(speed, 0, 'f', 1);
+        if (totalBytes > 0) {
+            progress->setValue(int(qBound<qint64>(0, doneBytes * 1000 / totalBytes, 1000)));
+            if (doneBytes > 0 && doneBytes < totalBytes)
+                text += tr(", осталось ~%1 с").arg((totalBytes - doneBytes) * elapsedMs / doneBytes / 1000);
+        }
+        progress->setLabelText(text);
+    });
+    connect(job, &DatabaseMaintenance::done, progress, &QProgressDialog::close);
+    connect(job, &DatabaseMaintenance::finished, this, [this, title](qint64 bytes, qint64 elapsedMs) {
+        const double seconds = qMax<qint64>(elapsedMs, 1) / 1000.0;
+        statusBar->showMessage(tr("%1: %2 МБ за %3 с (%4 МБ/с)")
+                                   .arg(title)
+                                   .arg(bytes / (1024.0 * 1024.0), 0, 'f', 1)
+                                   .arg(seconds, 0, 'f', 1)
+                                   .arg(bytes / (1024.0 * 1024.0) / seconds, 0, 'f', 1), 5000);
+    });
+    connect(job, &DatabaseMaintenance::cancelled, this, [this, title] {
+        statusBar->showMessage(tr("%1: отменено").arg(title), 3000);
+    });
+    connect(job, &DatabaseMaintenance::failed, this, [this, title](const QString &message) {
+        QMessageBox::critical(this, title, message);
+    });
+
+    startJob(job);
+}
+
 void DatabaseAdmin::createToolBars()
 {
     // Панель инструментов "База данных"
@@ -263,6 +740,7 @@ void DatabaseAdmin::createToolBars()
     // Панель инструментов "Данные"
     QToolBar *dataToolBar = addToolBar(tr("Данные"));
     dataToolBar->addAction(copyAction);
+    dataToolBar->addAction(pasteAction);
     dataToolBar->addAction(deleteAction);
     dataToolBar->addAction(insertAction);
     dataToolBar->addSeparator();
@@ -272,15 +750,11 @@ void DatabaseAdmin::createToolBars()
     // Панель инструментов "Запрос"
     QToolBar *queryToolBar = addToolBar(tr("Запрос"));
     queryToolBar->addAction(executeAction);
+    queryToolBar->addAction(cancelQueryAction);
 }
 
 void DatabaseAdmin::connectToDatabase()
 {
-    // Закрываем предыдущее соединение, если оно есть
-    if (QSqlDatabase::contains(QSqlDatabase::defaultConnection)) {
-        QSqlDatabase::removeDatabase(QSqlDatabase::defaultConnection);
-    }
-
     QString dbPath = QFileDialog::getOpenFileName(this,
                                                   tr("Выберите файл базы данных"),
                                                   lastDir,
@@ -290,27 +764,230 @@ void DatabaseAdmin::connectToDatabase()
 
     lastDir = QFileInfo(dbPath).path();
 
-    QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE");
-    db.setDatabaseName(dbPath);
+    // Без запомненной таблицы - выбор таблицы, как раньше
+    openDatabase(dbPath, true);
+}
 
-    if (!db.open()) {
+void DatabaseAdmin::restoreSession()
+{
+    if (recentDatabases.isEmpty() || QSqlDatabase::contains(QSqlDatabase::defaultConnection))
+        return;
+    const QString path = recentDatabases.first().path;
+    if (QFileInfo::exists(path))
+        openDatabase(path, false);
+}
+
+void DatabaseAdmin::openDatabase(const QString &path, bool pickTable)
+{
+    if (openWatcher->isRunning()) {
+        statusBar->showMessage(tr("База %1 ещё открывается").arg(openingPath), 3000);
+        return;
+    }
+
+    rememberView();
+
+    // Закрываем предыдущее соединение, если оно есть
+    closeDefaultConnection();
+    databasePath.clear();
+    sqlModel->clear();
+    setViewModel(sqlModel);
+
+    // Открытие и PRAGMA профиля могут ждать блокировку файла или сетевой диск, поэтому
+    // соединение создаётся в пуле потоков и передаётся потоку окна (QSqlDatabase::moveToThread)
+    const ConnectionProfile profile = currentProfile();
+    QThread *windowThread = thread();
+    auto promise = std::make_shared<QPromise<OpenedDatabase>>();
+    openWatcher->setFuture(promise->future());
+    promise->start();
+    openingPath = path;
+    statusBar->showMessage(tr("Открытие %1...").arg(path));
+
+    QThreadPool::globalInstance()->start([promise, path, pickTable, profile, windowThread] {
+        OpenedDatabase opened;
+        opened.path = path;
+        opened.pickTable = pickTable;
+        {
+            QSqlDatabase db = QSqlDatabase::addDatabase(QStringLiteral("QSQLITE"));
+            db.setDatabaseName(path);
+            db.setConnectOptions(profile.connectOptions());
+            if (db.open()) {
+                applyConnectionProfile(db, profile, true, &opened.profileError);
+                // Клоны соединения в рабочих потоках откроются с тем же профилем
+                ConnectionProfile::setForConnection(db.connectionName(), profile);
+            } else {
+                opened.error = db.lastError().text();
+            }
+            db.moveToThread(windowThread);
+        }
+        promise->addResult(opened);
+        promise->finish();
+    });
+}
+
+void DatabaseAdmin::onDatabaseOpened()
+{
+    const QFuture<OpenedDatabase> future = openWatcher->future();
+    // Пустой openingPath - соединение уже закрыли, не дождавшись итога
+    if (future.resultCount() == 0 || openingPath.isEmpty())
+        return;
+    openingPath.clear();
+
+    const OpenedDatabase opened = future.result();
+    if (!opened.error.isEmpty()) {
+        closeDefaultConnection();
         QMessageBox::critical(this, tr("Ошибка"),
-                              tr("Не удалось открыть базу данных:\n%1").arg(db.lastError().text()));
+                              tr("Не удалось открыть базу данных:\n%1").arg(opened.error));
         return;
     }
+    if (!opened.profileError.isEmpty())
+        statusBar->showMessage(tr("Профиль %1 применён не полностью: %2").arg(profileName, opened.profileError), 5000);
+
+    QSqlDatabase db = QSqlDatabase::database();
+    ChangeTracker::setForConnection(db.connectionName(), std::make_shared<ChangeTracker>(db.connectionName()));
+    ResultCache::forConnection(db.connectionName()).setBudget(qint64(resultCacheMb) * 1024 * 1024);
+    resetWorkerConnections();
 
     // Настраиваем модель после подключения
-    sqlModel->setTable("");
-    sqlModel->select();
+    sqlModel->clear();
 
-    statusBar->showMessage(tr("Подключено к %1").arg(dbPath), 3000);
-    showTables();
+    const QString path = opened.path;
+    databasePath = RecentDatabase::normalizePath(path);
+    const RecentDatabase recent = RecentDatabase::touch(recentDatabases, databasePath);
+    rebuildRecentMenu();
+
+    // Схема из снимка сразу даёт список таблиц и ключи; refresh() сверит schema_version,
+    // а полное сравнение со схемой в файле идёт в фоне
+    if (!recent.schema.isEmpty())
+        schemaCatalog->restore(recent.schema);
+    revalidateSchema();
+
+    statusBar->showMessage(tr("Подключено к %1").arg(path), 3000);
+
+    if (!recent.lastTable.isEmpty() && catalog().table(recent.lastTable) && openTable(recent.lastTable)) {
+        const int row = qMin(recent.topRow, sqlModel->rowCount() - 1);
+        if (row > 0)
+            tableView->scrollTo(sqlModel->index(row, 0), QAbstractItemView::PositionAtTop);
+    }
+    if (opened.pickTable && sqlModel->tableName().isEmpty())
+        showTables();
+}
+
+bool DatabaseAdmin::openTable(const QString &tableName)
+{
+    // Устанавливаем выбранную таблицу в модель
+    setViewModel(sqlModel);
+    sqlModel->setTable(tableName);
+    clearSortIndicator();
+
+    if (!sqlModel->select()) {
+        showError(tr("Ошибка загрузки таблицы"), sqlModel->lastError());
+        return false;
+    }
+
+    if (profileDock->isVisible())
+        profileTable(tableName);
+
+    statusBar->showMessage(tr("Загружена таблица: %1").arg(tableName), 2000);
+    return true;
 }
+
+void DatabaseAdmin::rememberView()
+{
+    const int index = RecentDatabase::indexOf(recentDatabases, databasePath);
+    if (databasePath.isEmpty() || index < 0)
+        return;
+
+    RecentDatabase &recent = recentDatabases[index];
+    if (tableView->model() == sqlModel && !sqlModel->tableName().isEmpty()) {
+        recent.lastTable = sqlModel->tableName();
+        recent.topRow = qMax(0, tableView->rowAt(0));
+    }
+    if (schemaCatalog->isLoaded())
+        recent.schema = schemaCatalog->snapshot();
+}
+
+void DatabaseAdmin::rebuildRecentMenu()
+{
+    recentMenu->clear();
+    for (int i = 0; i < recentDatabases.size(); ++i) {
+        const QString path = recentDatabases.at(i).path;
+        QAction *action = recentMenu->addAction(QStringLiteral("&%1 %2").arg(i + 1).arg(QFileInfo(path).fileName()),
+                                                this, [this, path] {
+            // QSQLITE создал бы на месте пропавшего файла пустую базу
+            if (!QFileInfo::exists(path)) {
+                QMessageBox::warning(this, tr("Ошибка"), tr("Файл базы данных не найден:\n%1").arg(path));
+                const int index = RecentDatabase::indexOf(recentDatabases, path);
+                if (index >= 0)
+                    recentDatabases.removeAt(index);
+                rebuildRecentMenu();
+                return;
+            }
+            openDatabase(path, true);
+        });
+        action->setStatusTip(path);
+    }
+
+    if (!recentDatabases.isEmpty())
+        recentMenu->addSeparator();
+    QAction *clearAction = recentMenu->addAction(tr("&Очистить список"), this, [this] {
+        recentDatabases.clear();
+        rebuildRecentMenu();
+    });
+    clearAction->setEnabled(!recentDatabases.isEmpty());
+    recentMenu->addAction(reopenLastAction);
+}
+
+void DatabaseAdmin::revalidateSchema()
+{
+    // Схема читается целиком на своём соединении, окно в это время уже работает
+    const QString connection = QString::fromLatin1(QSqlDatabase::defaultConnection);
+    auto promise = std::make_shared<QPromise<QByteArray>>();
+    schemaWatcher->setFuture(promise->future());
+    promise->start();
+
+    QThreadPool::globalInstance()->start([promise, connection] {
+        QByteArray snapshot;
+        {
+            ScopedConnection reader(connection, QStringLiteral("schema"));
+            if (reader.open()) {
+                SchemaCatalog loaded(reader.connectionName());
+                if (loaded.refresh())
+                    snapshot = loaded.snapshot();
+            }
+        }
+        promise->addResult(snapshot);
+        promise->finish();
+    });
+}
+
+void DatabaseAdmin::onSchemaRevalidated()
+{
+    const QFuture<QByteArray> future = schemaWatcher->future();
+    if (future.resultCount() == 0 || future.result().isEmpty() || databasePath.isEmpty())
+        return;
+
+    // Тот же schema_version ещё не значит ту же схему: файл могли подменить
+    const QByteArray snapshot = future.result();
+    if (snapshot != schemaCatalog->snapshot()) {
+        schemaCatalog->restore(snapshot);
+        if (!sqlModel->tableName().isEmpty() && !schemaCatalog->table(sqlModel->tableName()))
+            statusBar->showMessage(tr("Таблицы %1 больше нет в базе").arg(sqlModel->tableName()), 5000);
+    }
+
+    const int index = RecentDatabase::indexOf(recentDatabases, databasePath);
+    if (index >= 0)
+        recentDatabases[index].schema = snapshot;
+}
+
 void DatabaseAdmin::disconnectFromDatabase()
 {
-    if (QSqlDatabase::contains(QSqlDatabase::defaultConnection)) {
-        QSqlDatabase::removeDatabase(QSqlDatabase::defaultConnection);
+    rememberView();
+    databasePath.clear();
+    if (closeDefaultConnection()) {
         sqlModel->clear();
+        resultModel->clear();
+        setViewModel(sqlModel);
+        resetWorkerConnections();
         statusBar->showMessage(tr("Отключено от базы данных"), 3000);
     }
 }
@@ -322,8 +999,10 @@ void DatabaseAdmin::showTables()
         return;
     }
 
-    // Получаем список всех таблиц
-    QStringList tables = QSqlDatabase::database().tables(QSql::Tables);
+    // Список таблиц из кэша схемы; перечитывается, только если схема изменилась.
+    // Индексы поиска и их теневые таблицы не показываем
+    QStringList tables = catalog().tableNames();
+    tables.removeIf(&DatabaseSearch::isIndexTable);
 
     if (tables.isEmpty()) {
         QMessageBox::information(this, tr("Информация"),
@@ -331,32 +1010,17 @@ void DatabaseAdmin::showTables()
         return;
     }
 
-    // Показываем диалог выбора таблицы
+    // Показываем диалог выбора таблицы с фильтром
     bool ok;
-    QString tableName = QInputDialog::getItem(this,
-                                              tr("Выбор таблицы"),
-                                              tr("Выберите таблицу:"),
-                                              tables,
-                                              0,
-                                              false,
-                                              &ok);
+    QString tableName = TablePickerDialog::getTable(this,
+                                                    tr("Выбор таблицы"),
+                                                    tr("Выберите таблицу:"),
+                                                    tables,
+                                                    &ok);
     if (!ok || tableName.isEmpty()) return;
 
-    // Устанавливаем выбранную таблицу в модель
-    sqlModel->setTable(tableName);
-    sqlModel->setEditStrategy(QSqlTableModel::OnManualSubmit);
-
-    if (!sqlModel->select()) {
-        showError(tr("Ошибка загрузки таблицы"), sqlModel->lastError());
-        return;
-    }
-
-    // Обновляем заголовки столбцов
-    for (int i = 0; i < sqlModel->columnCount(); ++i) {
-        sqlModel->setHeaderData(i, Qt::Horizontal, sqlModel->record().fieldName(i));
-    }
-
-    statusBar->showMessage(tr("Загружена таблица: %1").arg(tableName), 2000);
+    rememberView();
+    openTable(tableName);
 }
 
 void DatabaseAdmin::createTable()
@@ -366,6 +1030,11 @@ void DatabaseAdmin::createTable()
                                               tr("Имя таблицы:"), QLineEdit::Normal, "", &ok);
     if (!ok || tableName.isEmpty()) return;
 
+    if (catalog().table(tableName)) {
+        QMessageBox::warning(this, tr("Предупреждение"), tr("Таблица %1 уже существует").arg(tableName));
+        return;
+    }
+
     QString columns = QInputDialog::getMultiLineText(this, tr("Создание таблицы"),
                                                      tr("Определения столбцов (по одному на строку):"),
                                                      "id INTEGER PRIMARY KEY AUTOINCREMENT", &ok);
@@ -387,15 +1056,17 @@ void DatabaseAdmin::createTable()
 
 void DatabaseAdmin::dropTable()
 {
-    QStringList tables = QSqlDatabase::database().tables(QSql::Tables);
+    // Индексы поиска удаляются вместе с триггерами отдельной командой
+    QStringList tables = catalog().tableNames();
+    tables.removeIf(&DatabaseSearch::isIndexTable);
     if (tables.isEmpty()) {
         QMessageBox::warning(this, tr("Предупреждение"), tr("Нет таблиц для удаления"));
         return;
     }
 
     bool ok;
-    QString tableName = QInputDialog::getItem(this, tr("Удаление таблицы"),
-                                              tr("Выберите таблицу для удаления:"), tables, 0, false, &ok);
+    QString tableName = TablePickerDialog::getTable(this, tr("Удаление таблицы"),
+                                                    tr("Выберите таблицу для удаления:"), tables, &ok);
     if (!ok || tableName.isEmpty()) return;
 
     if (!confirmAction(tr("Вы уверены, что хотите удалить таблицу %1?").arg(tableName))) {
@@ -403,7 +1074,7 @@ void DatabaseAdmin::dropTable()
     }
 
     QSqlQuery query;
-    if (!query.exec(QString("DROP TABLE %1").arg(tableName))) {
+    if (!query.exec(QString("DROP TABLE %1").arg(quoteIdentifier(tableName)))) {
         showError(tr("Ошибка удаления таблицы"), query.lastError());
         return;
     }
@@ -424,119 +1095,329 @@ void DatabaseAdmin::executeQuery()
         return;
     }
 
-    QSqlQuery query;
-    if (!query.exec(queryText)) {
-        showError(tr("Ошибка выполнения запроса"), query.lastError());
+    if (!QSqlDatabase::database().isOpen()) {
+        QMessageBox::warning(this, tr("Ошибка"), tr("База данных не подключена"));
         return;
     }
 
-    // Если это SELECT запрос - обновляем модель
-    if (queryText.startsWith("SELECT", Qt::CaseInsensitive)) {
-        sqlModel->setQuery(query);
-        if (sqlModel->lastError().isValid()) {
-            showError(tr("Ошибка загрузки результатов"), sqlModel->lastError());
-            return;
-        }
-    } else {
-        // Для других запросов обновляем текущую таблицу
-        if (!sqlModel->tableName().isEmpty()) {
-            sqlModel->select();
-        }
+    // Несколько операторов выполняются скриптом, один - как раньше, с профилем и планом
+    const QList<ScriptStatement> statements = ScriptRunner::split(queryText);
+    if (statements.size() > 1) {
+        runScript(statements);
+        return;
     }
 
-    statusBar->showMessage(tr("Запрос выполнен. Строк: %1").arg(sqlModel->rowCount()), 2000);
+    // Повтор читающего запроса по неизменённым таблицам отдаётся из кэша без выполнения
+    ResultCache &cache = ResultCache::forConnection(QString::fromLatin1(QSqlDatabase::defaultConnection));
+    const QString cacheKey = ResultCache::makeKey(queryText);
+    ResultCache::Result cached;
+    if (cache.lookup(cacheKey, &cached)) {
+        resultModel->clear();
+        resultModel->setColumns(cached.columns);
+        resultModel->appendRows(cached.rows);
+        setViewModel(resultModel);
+        queryStatsLabel->setText(tr("Строк: %1, из кэша").arg(cached.rows.rowCount()));
+        statusBar->showMessage(tr("Результат взят из кэша. Строк: %1").arg(cached.rows.rowCount()), 2000);
+        updateResultCacheLabel();
+        return;
+    }
+    pendingCacheKey = cacheKey;
+    pendingCacheTicket = cache.begin();
+    pendingCacheTables.clear();
+    pendingCacheable = false;
+    updateResultCacheLabel();
+
+    setQueryRunning(true);
+    queryStatsLabel->setText(tr("Выполняется..."));
+    queryWorker->submit(queryText);
 }
 
-void DatabaseAdmin::submitChanges()
+void DatabaseAdmin::runScript(const QList<ScriptStatement> &statements)
 {
-    if (sqlModel->tableName().isEmpty()) {
-        QMessageBox::warning(this, tr("Предупреждение"), tr("Нет активной таблицы"));
-        return;
-    }
+    ScriptOptions options;
+    options.transaction = scriptTransactionAction->isChecked();
+    auto *runner = new ScriptRunner(statements, options);
+    activeScript = runner;
+
+    scriptPanel->clear();
+    scriptDock->show();
+    scriptDock->raise();
+    setQueryRunning(true);
+    queryStatsLabel->setText(tr("Выполняется скрипт: %1 операторов").arg(statements.size()));
+
+    connect(runner, &ScriptRunner::resultStarted, scriptPanel, &ScriptResultPanel::addResultSet);
+    connect(runner, &ScriptRunner::resultRows, scriptPanel, &ScriptResultPanel::appendRows);
+    connect(runner, &ScriptRunner::statementsFinished, scriptPanel, &ScriptResultPanel::addStatementResults);
+    connect(runner, &ScriptRunner::progress, this, [this](int executed, int total) {
+        queryStatsLabel->setText(tr("Операторов: %1 из %2").arg(executed).arg(total));
+    });
+    connect(runner, &ScriptRunner::warning, this, [this](const QString &message) {
+        statusBar->showMessage(message, 5000);
+    });
+    connect(runner, &ScriptRunner::done, this, [this] {
+        setQueryRunning(false);
+    });
+    connect(runner, &ScriptRunner::finished, this,
+            [this](int executed, int errors, qint64 changes, qint64 elapsedMs) {
+        queryStatsLabel->setText(tr("Операторов: %1, ошибок: %2, изменено строк: %3, %4 мс")
+                                     .arg(executed).arg(errors).arg(changes).arg(elapsedMs));
+        statusBar->showMessage(tr("Скрипт выполнен"), 2000);
+    });
+    connect(runner, &ScriptRunner::cancelled, this, [this](int executed) {
+        queryStatsLabel->setText(tr("Операторов: %1").arg(executed));
+        statusBar->showMessage(tr("Скрипт прерван"), 3000);
+    });
+    connect(runner, &ScriptRunner::failed, this, [this](const QString &message) {
+        queryStatsLabel->clear();
+        QMessageBox::critical(this, tr("Ошибка выполнения скрипта"), message);
+    });
 
-    if (!sqlModel->submitAll()) {
-        showError(tr("Ошибка сохранения изменений"), sqlModel->lastError());
-    } else {
-        statusBar->showMessage(tr("Изменения сохранены"), 2000);
-    }
+    startJob(runner);
 }
 
-void DatabaseAdmin::revertChanges()
+void DatabaseAdmin::cancelQuery()
 {
-    if (sqlModel->tableName().isEmpty()) {
-        QMessageBox::warning(this, tr("Предупреждение"), tr("Нет активной таблицы"));
+    if (activeScript)
+        activeScript->cancel();
+    else
+        queryWorker->cancel();
+}
+
+void DatabaseAdmin::showScriptStatement(int line)
+{
+    // Курсор редактора - на начало оператора
+    const QTextBlock block = queryEditor->document()->findBlockByNumber(line - 1);
+    if (!block.isValid())
         return;
-    }
 
-    sqlModel->revertAll();
-    statusBar->showMessage(tr("Изменения отменены"), 2000);
+    QTextCursor cursor(block);
+    queryEditor->setTextCursor(cursor);
+    queryDock->raise();
+    queryEditor->setFocus();
 }
 
-void DatabaseAdmin::refreshData()
+void DatabaseAdmin::onQueryColumns(const QStringList &columns)
 {
-    if (sqlModel->tableName().isEmpty()) {
-        showTables();
-        return;
-    }
+    // Результат SELECT показываем в отдельной модели, таблица остаётся открытой
+    resultModel->setColumns(columns);
+    setViewModel(resultModel);
+}
 
-    if (!sqlModel->select()) {
-        showError(tr("Ошибка обновления данных"), sqlModel->lastError());
-        return;
-    }
+void DatabaseAdmin::onQueryRows(const ResultSet &rows)
+{
+    resultModel->appendRows(rows);
+}
 
-    statusBar->showMessage(tr("Данные обновлены"), 2000);
+void DatabaseAdmin::onQueryProgress(qint64 rows, qint64 elapsedMs)
+{
+    const double seconds = elapsedMs / 1000.0;
+    queryStatsLabel->setText(tr("Строк: %1, %2 с, %3 строк/с")
+                                 .arg(rows)
+                                 .arg(seconds, 0, 'f', 1)
+                                 .arg(seconds > 0 ? qRound64(rows / seconds) : rows));
 }
 
-void DatabaseAdmin::exportToCSV()
+void DatabaseAdmin::onQueryFinished(bool isSelect, qint64 rows, qint64 elapsedMs)
 {
-    if (sqlModel->tableName().isEmpty()) {
-        QMessageBox::warning(this, tr("Предупреждение"), tr("Нет активной таблицы"));
+    setQueryRunning(false);
+    onQueryProgress(rows, elapsedMs);
+
+    if (isSelect) {
+        if (pendingCacheable) {
+            ResultCache::forConnection(QString::fromLatin1(QSqlDatabase::defaultConnection))
+                .store(pendingCacheTicket, pendingCacheKey, pendingCacheTables,
+                       { resultModel->columns(), resultModel->rows() });
+            updateResultCacheLabel();
+        }
+        statusBar->showMessage(tr("Запрос выполнен. Строк: %1").arg(rows), 2000);
         return;
     }
 
-    if (sqlModel->rowCount() == 0) {
-        QMessageBox::warning(this, tr("Предупреждение"), tr("Нет данных для экспорта"));
-        return;
-    }
+    // Изменённые строки текущей таблицы модель получит от ChangeTracker
+    statusBar->showMessage(tr("Запрос выполнен. Затронуто строк: %1").arg(rows), 2000);
+}
 
-    QString fileName = QFileDialog::getSaveFileName(this, tr("Экспорт в CSV"),
-                                                    lastDir, tr("CSV файлы (*.csv)"));
-    if (fileName.isEmpty()) return;
+void DatabaseAdmin::onQueryProfiled(const QueryProfile &profile)
+{
+    // Замер приходит раньше finished, строки результата к этому моменту уже в модели
+    pendingCacheTables = profile.readTables;
+    pendingCacheable = profile.cacheable;
+}
 
-    lastDir = QFileInfo(fileName).path();
+void DatabaseAdmin::onQueryCancelled(qint64 rows, qint64 elapsedMs)
+{
+    setQueryRunning(false);
+    onQueryProgress(rows, elapsedMs);
+    statusBar->showMessage(tr("Запрос прерван"), 3000);
+}
 
-    QFile file(fileName);
-    if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
-        QMessageBox::critical(this, tr("Ошибка"),
-                              tr("Не удалось открыть файл для записи:\n%1").arg(file.errorString()));
+void DatabaseAdmin::onQueryFailed(const QSqlError &error)
+{
+    setQueryRunning(false);
+    queryStatsLabel->clear();
+    showError(tr("Ошибка выполнения запроса"), error);
+}
+
+void DatabaseAdmin::submitChanges()
+{
+    if (sqlModel->tableName().isEmpty()) {
+        QMessageBox::warning(this, tr("Предупреждение"), tr("Нет активной таблицы"));
         return;
     }
 
-    QTextStream out(&file);
+    if (!sqlModel->isDirty()) {
+        statusBar->showMessage(tr("Нет несохранённых изменений"), 2000);
+        return;
+    }
+
+    submitEdits(false);
+}
+
+void DatabaseAdmin::submitEdits(bool overwriteConflicts)
+{
+    BatchSubmitter *submitter = sqlModel->createSubmitter();
+    submitter->setOverwriteConflicts(overwriteConflicts);
+    startSubmitter(submitter, tr("Сохранение изменений..."), [this] { submitEdits(true); });
+}
 
-    // Запись заголовков
-    for (int col = 0; col < sqlModel->columnCount(); ++col) {
-        if (col > 0) out << ",";
-        out << "\"" << sqlModel->headerData(col, Qt::Horizontal).toString().replace("\"", "\"\"") << "\"";
+void DatabaseAdmin::startSubmitter(BatchSubmitter *submitter, const QString &title,
+                                   const std::function<void()> &overwrite)
+{
+    // Правки пишутся в фоне на отдельном соединении; окно модальное,
+    // чтобы модель не менялась, пока её снимок сохраняется
+    auto *progress = new QProgressDialog(title, tr("Отмена"),
+                                         0, int(submitter->rowCount()), this);
+    progress->setAttribute(Qt::WA_DeleteOnClose);
+    progress->setWindowModality(Qt::WindowModal);
+    progress->setMinimumDuration(500);
+    progress->setAutoClose(false);
+    progress->setAutoReset(false);
+
+    connect(progress, &QProgressDialog::canceled, submitter, &BackgroundJob::cancel, Qt::DirectConnection);
+    connect(submitter, &BatchSubmitter::progress, progress, [progress](qint64 rows, qint64 totalRows) {
+        progress->setValue(int(rows));
+        progress->setLabelText(tr("Сохранено строк: %1 из %2").arg(rows).arg(totalRows));
+    });
+    connect(submitter, &BatchSubmitter::done, progress, &QProgressDialog::close);
+    connect(submitter, &BatchSubmitter::finished, this, [this](qint64 updated, qint64 inserted, qint64 elapsedMs) {
+        if (!sqlModel->select())
+            showError(tr("Ошибка обновления данных"), sqlModel->lastError());
+        statusBar->showMessage(tr("Изменения сохранены: обновлено %1, добавлено %2 строк за %3 мс")
+                                   .arg(updated).arg(inserted).arg(elapsedMs), 5000);
+    });
+    connect(submitter, &BatchSubmitter::conflicted, this, [this, overwrite](const QList<int> &rows) {
+        tableView->scrollTo(sqlModel->index(rows.first(), 0));
+        QStringList numbers;
+        for (int row : rows.mid(0, 10))
+            numbers << QString::number(row + 1);
+        if (rows.size() > 10)
+            numbers << QStringLiteral("...");
+
+        const QMessageBox::StandardButton answer = QMessageBox::warning(
+            this, tr("Конфликт изменений"),
+            tr("Строк, изменённых или удалённых другим соединением после загрузки: %1 (%2).\n"
+               "Ничего не сохранено.\n\nЗаписать ваши значения поверх чужих изменений?")
+                .arg(rows.size()).arg(numbers.join(QLatin1String(", "))),
+            QMessageBox::Yes | QMessageBox::No, QMessageBox::No);
+        if (answer == QMessageBox::Yes && overwrite)
+            overwrite();
+        else
+            statusBar->showMessage(tr("Изменения не сохранены; обновите данные или отмените правки"), 5000);
+    });
+    connect(submitter, &BatchSubmitter::cancelled, this, [this] {
+        statusBar->showMessage(tr("Сохранение отменено, изменения остались в таблице"), 3000);
+    });
+    connect(submitter, &BatchSubmitter::failed, this, [this](const QString &message) {
+        QMessageBox::critical(this, tr("Ошибка сохранения изменений"), message);
+    });
+
+    startJob(submitter);
+}
+
+void DatabaseAdmin::revertChanges()
+{
+    if (sqlModel->tableName().isEmpty()) {
+        QMessageBox::warning(this, tr("Предупреждение"), tr("Нет активной таблицы"));
+        return;
     }
-    out << "\n";
 
-    // Запись данных
-    for (int row = 0; row < sqlModel->rowCount(); ++row) {
-        for (int col = 0; col < sqlModel->columnCount(); ++col) {
-            if (col > 0) out << ",";
-            out << "\"" << sqlModel->data(sqlModel->index(row, col)).toString().replace("\"", "\"\"") << "\"";
-        }
-        out << "\n";
+    sqlModel->revertAll();
+    statusBar->showMessage(tr("Изменения отменены"), 2000);
+}
+
+void DatabaseAdmin::refreshData()
+{
+    if (sqlModel->tableName().isEmpty()) {
+        showTables();
+        return;
+    }
+
+    setViewModel(sqlModel);
+
+    // Перечитываются только загруженные страницы; позиция прокрутки сохраняется
+    if (!sqlModel->refreshRows()) {
+        showError(tr("Ошибка обновления данных"), sqlModel->lastError());
+        return;
     }
 
-    file.close();
-    statusBar->showMessage(tr("Данные экспортированы в %1").arg(fileName), 3000);
+    statusBar->showMessage(tr("Данные обновлены"), 2000);
 }
 
-void DatabaseAdmin::importFromCSV()
+void DatabaseAdmin::exportToCSV()
 {
     if (sqlModel->tableName().isEmpty()) {
+        QMessageBox::warning(this, tr("Предупреждение"), tr("Нет активной таблицы"));
+        return;
+    }
+
+    if (sqlModel->rowCount() == 0) {
+        QMessageBox::warning(this, tr("Предупреждение"), tr("Нет данных для экспорта"));
+        return;
+    }
+
+    QString fileName = QFileDialog::getSaveFileName(this, tr("Экспорт в CSV"),
+                                                    lastDir, tr("CSV файлы (*.csv)"));
+    if (fileName.isEmpty()) return;
+
+    lastDir = QFileInfo(fileName).path();
+
+    // Экспорт читает таблицу курсором в фоне с текущими фильтром и сортировкой,
+    // а не через модель представления, поэтому выгружаются все строки
+    auto *exporter = new CsvExporter(fileName, sqlModel->selectStatement());
+
+    auto *progress = new QProgressDialog(tr("Экспорт в %1...").arg(fileName), tr("Отмена"),
+                                         0, sqlModel->rowCount(), this);
+    progress->setAttribute(Qt::WA_DeleteOnClose);
+    progress->setMinimumDuration(500);
+    progress->setAutoClose(false);
+    progress->setAutoReset(false);
+
+    connect(progress, &QProgressDialog::canceled, exporter, &BackgroundJob::cancel, Qt::DirectConnection);
+    connect(exporter, &CsvExporter::progress, progress, [progress](qint64 rows, qint64 bytes) {
+        progress->setValue(int(qMin<qint64>(rows, progress->maximum())));
+        progress->setLabelText(tr("Экспортировано строк: %1 (%2 МБ)").arg(rows).arg(bytes / (1024 * 1024)));
+    });
+    connect(exporter, &CsvExporter::done, progress, &QProgressDialog::close);
+    connect(exporter, &CsvExporter::finished, this, [this, fileName](qint64 rows, qint64 bytes, qint64 elapsedMs) {
+        const double seconds = qMax<qint64>(elapsedMs, 1) / 1000.0;
+        statusBar->showMessage(tr("Экспортировано %1 строк в %2 (%3 МБ/с)")
+                                   .arg(rows)
+                                   .arg(fileName)
+                                   .arg(bytes / (1024.0 * 1024.0) / seconds, 0, 'f', 1), 5000);
+    });
+    connect(exporter, &CsvExporter::cancelled, this, [this] {
+        statusBar->showMessage(tr("Экспорт отменён"), 3000);
+    });
+    connect(exporter, &CsvExporter::failed, this, [this](const QString &message) {
+        QMessageBox::critical(this, tr("Ошибка"), tr("Не удалось экспортировать данные:\n%1").arg(message));
+    });
+
+    startJob(exporter);
+}
+
+void DatabaseAdmin::importFromCSV()
+{
+    if (currentTableName().isEmpty()) {
         QMessageBox::warning(this, tr("Предупреждение"), tr("Сначала выберите таблицу"));
         return;
     }
@@ -547,135 +1428,291 @@ void DatabaseAdmin::importFromCSV()
 
     lastDir = QFileInfo(fileName).path();
 
-    QFile file(fileName);
-    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
-        QMessageBox::critical(this, tr("Ошибка"),
-                              tr("Не удалось открыть файл для чтения:\n%1").arg(file.errorString()));
+    // Параметры импорта; настройки соединения запоминаются между запусками
+    CsvImportOptions options;
+    settings->beginGroup("Import");
+    options.hasHeader = settings->value("hasHeader", true).toBool();
+    options.journalMode = settings->value("journalMode").toString();
+    options.synchronousOff = settings->value("synchronousOff", false).toBool();
+    options.cacheSizeMb = settings->value("cacheSizeMb", 0).toInt();
+    settings->endGroup();
+
+    QDialog dialog(this);
+    dialog.setWindowTitle(tr("Импорт из CSV"));
+    QFormLayout layout(&dialog);
+
+    QComboBox *delimiterBox = new QComboBox(&dialog);
+    delimiterBox->addItem(tr("Запятая"), QChar(','));
+    delimiterBox->addItem(tr("Точка с запятой"), QChar(';'));
+    delimiterBox->addItem(tr("Табуляция"), QChar('\t'));
+    layout.addRow(tr("Разделитель:"), delimiterBox);
+
+    QCheckBox *headerBox = new QCheckBox(tr("Первая строка содержит имена столбцов"), &dialog);
+    headerBox->setChecked(options.hasHeader);
+    layout.addRow(headerBox);
+
+    QComboBox *journalBox = new QComboBox(&dialog);
+    journalBox->addItem(tr("Не менять"), QString());
+    journalBox->addItem(QStringLiteral("WAL"), QStringLiteral("WAL"));
+    journalBox->addItem(tr("OFF (без журнала)"), QStringLiteral("OFF"));
+    journalBox->setCurrentIndex(qMax(0, journalBox->findData(options.journalMode)));
+    layout.addRow(tr("Журнал:"), journalBox);
+
+    QCheckBox *synchronousBox = new QCheckBox(tr("synchronous = OFF (быстрее, но без защиты от сбоя питания)"), &dialog);
+    synchronousBox->setChecked(options.synchronousOff);
+    layout.addRow(synchronousBox);
+
+    QSpinBox *cacheBox = new QSpinBox(&dialog);
+    cacheBox->setRange(0, 16384);
+    cacheBox->setSuffix(tr(" МБ"));
+    cacheBox->setSpecialValueText(tr("Не менять"));
+    cacheBox->setValue(options.cacheSizeMb);
+    layout.addRow(tr("Кэш страниц:"), cacheBox);
+
+    QDialogButtonBox buttons(QDialogButtonBox::Ok | QDialogButtonBox::Cancel,
+                             Qt::Horizontal, &dialog);
+    layout.addRow(&buttons);
+
+    connect(&buttons, &QDialogButtonBox::accepted, &dialog, &QDialog::accept);
+    connect(&buttons, &QDialogButtonBox::rejected, &dialog, &QDialog::reject);
+
+    if (dialog.exec() != QDialog::Accepted) {
         return;
     }
 
-    QTextStream in(&file);
-    QStringList headers;
-    int lineNumber = 0;
-    int importedRows = 0;
+    options.delimiter = delimiterBox->currentData().toChar().toLatin1();
+    options.hasHeader = headerBox->isChecked();
+    options.journalMode = journalBox->currentData().toString();
+    options.synchronousOff = synchronousBox->isChecked();
+    options.cacheSizeMb = cacheBox->value();
+
+    settings->beginGroup("Import");
+    settings->setValue("hasHeader", options.hasHeader);
+    settings->setValue("journalMode", options.journalMode);
+    settings->setValue("synchronousOff", options.synchronousOff);
+    settings->setValue("cacheSizeMb", options.cacheSizeMb);
+    settings->endGroup();
 
-    // Получение информации о столбцах таблицы
-    QStringList columnNames;
-    for (int i = 0; i < sqlModel->columnCount(); ++i) {
-        columnNames << sqlModel->headerData(i, Qt::Horizontal).toString();
+    if (options.journalMode == QLatin1String("OFF")
+        && !confirmAction(tr("Без журнала импорт нельзя откатить: при отмене или ошибке уже вставленные "
+                             "строки останутся в таблице. Продолжить?"))) {
+        return;
     }
 
-    QSqlDatabase::database().transaction();
-    QSqlQuery insertQuery;
+    if (const TableInfo *table = catalog().table(currentTableName()))
+        options.tableColumns = table->columnNames();
+
+    // Импорт идёт на отдельном соединении в фоне; прогресс считается в байтах файла
+    auto *importer = new CsvImporter(fileName, currentTableName(), options);
+
+    auto *progress = new QProgressDialog(tr("Импорт из %1...").arg(fileName), tr("Отмена"),
+                                         0, 1000, this);
+    progress->setAttribute(Qt::WA_DeleteOnClose);
+    progress->setMinimumDuration(500);
+    progress->setAutoClose(false);
+    progress->setAutoReset(false);
+
+    connect(progress, &QProgressDialog::canceled, importer, &BackgroundJob::cancel, Qt::DirectConnection);
+    connect(importer, &CsvImporter::progress, progress, [progress](qint64 bytes, qint64 totalBytes, qint64 rows) {
+        progress->setValue(totalBytes > 0 ? int(bytes * 1000 / totalBytes) : 0);
+        progress->setLabelText(tr("Импортировано строк: %1 (%2 из %3 МБ)")
+                                   .arg(rows)
+                                   .arg(bytes / (1024 * 1024))
+                                   .arg(totalBytes / (1024 * 1024)));
+    });
+    connect(importer, &CsvImporter::done, progress, &QProgressDialog::close);
+    connect(importer, &CsvImporter::finished, this, [this, fileName](qint64 rows, qint64 bytes, qint64 elapsedMs) {
+        const double seconds = qMax<qint64>(elapsedMs, 1) / 1000.0;
+        statusBar->showMessage(tr("Импортировано %1 строк из %2 (%3 строк/с, %4 МБ/с)")
+                                   .arg(rows)
+                                   .arg(fileName)
+                                   .arg(qRound64(rows / seconds))
+                                   .arg(bytes / (1024.0 * 1024.0) / seconds, 0, 'f', 1), 5000);
+    });
+    connect(importer, &CsvImporter::cancelled, this, [this](bool rolledBack) {
+        statusBar->showMessage(rolledBack ? tr("Импорт отменён, изменения откатаны")
+                                          : tr("Импорт отменён, уже вставленные строки остались в таблице"), 5000);
+    });
+    connect(importer, &CsvImporter::failed, this, [this](const QString &message) {
+        QMessageBox::critical(this, tr("Ошибка"), tr("Не удалось импортировать данные:\n%1").arg(message));
+    });
 
-    while (!in.atEnd()) {
-        QString line = in.readLine();
-        if (line.trimmed().isEmpty()) continue;
+    startJob(importer);
+}
 
-        QStringList values;
-        QString value;
-        bool inQuotes = false;
+void DatabaseAdmin::exportToDump()
+{
+    if (sqlModel->tableName().isEmpty()) {
+        QMessageBox::warning(this, tr("Предупреждение"), tr("Нет активной таблицы"));
+        return;
+    }
 
-        // Простой парсер CSV
-        for (int i = 0; i < line.length(); ++i) {
-            QChar ch = line.at(i);
-            if (ch == '"') {
-                inQuotes = !inQuotes;
-            } else if (ch == ',' && !inQuotes) {
-                values << value;
-                value.clear();
-            } else {
-                value += ch;
-            }
-        }
-        values << value;
+    const QString proposed = QDir(lastDir).filePath(sqlModel->tableName() + QStringLiteral(".ctd"));
+    const QString fileName = QFileDialog::getSaveFileName(this, tr("Экспорт в колоночный дамп"),
+                                                          proposed, tr("Колоночные дампы (*.ctd)"));
+    if (fileName.isEmpty()) return;
 
-        // Первая строка - заголовки
-        if (lineNumber == 0) {
-            headers = values;
-            lineNumber++;
-            continue;
-        }
+    lastDir = QFileInfo(fileName).path();
 
-        // Подготовка INSERT запроса
-        if (insertQuery.lastQuery().isEmpty()) {
-            QString queryStr = QString("INSERT INTO %1 (%2) VALUES (%3)")
-            .arg(sqlModel->tableName())
-                .arg(columnNames.join(", "))
-                .arg(QString("?, ").repeated(columnNames.size()).chopped(2));
-            insertQuery.prepare(queryStr);
-        }
+    // Типы значений сохраняются как есть, поэтому дамп переносится между базами без потерь
+    auto *exporter = new ColumnarExporter(fileName, sqlModel->selectStatement());
 
-        // Привязка значений
-        for (int i = 0; i < qMin(values.size(), columnNames.size()); ++i) {
-            insertQuery.bindValue(i, values[i].trimmed());
-        }
+    auto *progress = new QProgressDialog(tr("Экспорт в %1...").arg(fileName), tr("Отмена"),
+                                         0, sqlModel->rowCount(), this);
+    progress->setAttribute(Qt::WA_DeleteOnClose);
+    progress->setMinimumDuration(500);
+    progress->setAutoClose(false);
+    progress->setAutoReset(false);
 
-        if (!insertQuery.exec()) {
-            QMessageBox::critical(this, tr("Ошибка"),
-                                  tr("Не удалось импортировать строку %1:\n%2")
-                                      .arg(lineNumber)
-                                      .arg(insertQuery.lastError().text()));
-            QSqlDatabase::database().rollback();
-            file.close();
-            return;
-        }
+    connect(progress, &QProgressDialog::canceled, exporter, &BackgroundJob::cancel, Qt::DirectConnection);
+    connect(exporter, &ColumnarExporter::progress, progress, [progress](qint64 rows, qint64 bytes) {
+        progress->setValue(int(qMin<qint64>(rows, progress->maximum())));
+        progress->setLabelText(tr("Экспортировано строк: %1 (%2 МБ)").arg(rows).arg(bytes / (1024 * 1024)));
+    });
+    connect(exporter, &ColumnarExporter::done, progress, &QProgressDialog::close);
+    connect(exporter, &ColumnarExporter::finished, this, [this, fileName](qint64 rows, qint64 bytes, qint64 elapsedMs) {
+        const double seconds = qMax<qint64>(elapsedMs, 1) / 1000.0;
+        statusBar->showMessage(tr("Экспортировано %1 строк в %2 (%3 МБ, %4 строк/с)")
+                                   .arg(rows)
+                                   .arg(fileName)
+                                   .arg(bytes / (1024.0 * 1024.0), 0, 'f', 1)
+                                   .arg(qRound64(rows / seconds)), 5000);
+    });
+    connect(exporter, &ColumnarExporter::cancelled, this, [this] {
+        statusBar->showMessage(tr("Экспорт отменён"), 3000);
+    });
+    connect(exporter, &ColumnarExporter::failed, this, [this](const QString &message) {
+        QMessageBox::critical(this, tr("Ошибка"), tr("Не удалось экспортировать данные:\n%1").arg(message));
+    });
+
+    startJob(exporter);
+}
+
+void DatabaseAdmin::importFromDump()
+{
+    if (!QSqlDatabase::database().isOpen()) {
+        QMessageBox::warning(this, tr("Ошибка"), tr("База данных не подключена"));
+        return;
+    }
 
-        importedRows++;
-        lineNumber++;
+    const QString fileName = QFileDialog::getOpenFileName(this, tr("Импорт из колоночного дампа"),
+                                                          lastDir, tr("Колоночные дампы (*.ctd)"));
+    if (fileName.isEmpty()) return;
+
+    lastDir = QFileInfo(fileName).path();
+
+    // Несуществующая таблица создаётся по столбцам дампа
+    const QString proposed = currentTableName().isEmpty() ? QFileInfo(fileName).completeBaseName() : currentTableName();
+    bool ok;
+    const QString table = QInputDialog::getText(this, tr("Импорт из колоночного дампа"),
+                                                tr("Таблица (будет создана, если её нет):"),
+                                                QLineEdit::Normal, proposed, &ok);
+    if (!ok || table.isEmpty()) return;
+
+    if (currentProfile().journalMode.compare(QLatin1String("OFF"), Qt::CaseInsensitive) == 0
+        && !confirmAction(tr("В профиле соединения журнал отключён, импорт нельзя откатить: при отмене "
+                             "или ошибке уже вставленные строки останутся в таблице. Продолжить?"))) {
+        return;
     }
 
-    QSqlDatabase::database().commit();
-    file.close();
+    auto *importer = new ColumnarImporter(fileName, table);
+
+    auto *progress = new QProgressDialog(tr("Импорт из %1...").arg(fileName), tr("Отмена"),
+                                         0, 1000, this);
+    progress->setAttribute(Qt::WA_DeleteOnClose);
+    progress->setMinimumDuration(500);
+    progress->setAutoClose(false);
+    progress->setAutoReset(false);
+
+    connect(progress, &QProgressDialog::canceled, importer, &BackgroundJob::cancel, Qt::DirectConnection);
+    connect(importer, &ColumnarImporter::progress, progress, [progress](qint64 bytes, qint64 totalBytes, qint64 rows) {
+        progress->setValue(totalBytes > 0 ? int(bytes * 1000 / totalBytes) : 0);
+        progress->setLabelText(tr("Импортировано строк: %1 (%2 из %3 МБ)")
+                                   .arg(rows)
+                                   .arg(bytes / (1024 * 1024))
+                                   .arg(totalBytes / (1024 * 1024)));
+    });
+    connect(importer, &ColumnarImporter::done, progress, &QProgressDialog::close);
+    connect(importer, &ColumnarImporter::finished, this, [this, table](qint64 rows, qint64 bytes, qint64 elapsedMs) {
+        const double seconds = qMax<qint64>(elapsedMs, 1) / 1000.0;
+        statusBar->showMessage(tr("Импортировано %1 строк в %2 (%3 строк/с, %4 МБ/с)")
+                                   .arg(rows)
+                                   .arg(table)
+                                   .arg(qRound64(rows / seconds))
+                                   .arg(bytes / (1024.0 * 1024.0) / seconds, 0, 'f', 1), 5000);
+    });
+    connect(importer, &ColumnarImporter::cancelled, this, [this](bool rolledBack) {
+        statusBar->showMessage(rolledBack ? tr("Импорт отменён, изменения откатаны")
+                                          : tr("Импорт отменён, уже вставленные строки остались в таблице"), 5000);
+    });
+    connect(importer, &ColumnarImporter::failed, this, [this](const QString &message) {
+        QMessageBox::critical(this, tr("Ошибка"), tr("Не удалось импортировать данные:\n%1").arg(message));
+    });
 
-    // Обновляем данные после импорта
-    sqlModel->select();
-    statusBar->showMessage(tr("Импортировано %1 строк из %2").arg(importedRows).arg(fileName), 3000);
+    startJob(importer);
 }
 
 void DatabaseAdmin::copyData()
 {
-    if (sqlModel->tableName().isEmpty()) {
-        QMessageBox::warning(this, tr("Предупреждение"), tr("Нет активной таблицы"));
+    QItemSelectionModel *selection = tableView->selectionModel();
+    if (!selection || !selection->hasSelection()) return;
+
+    // Диапазоны выделения читаются курсором из базы, а не по ячейке через модель
+    QString error;
+    qint64 cells = 0;
+    const QByteArray tsv = TableClipboard::copy(tableView->model(), selection->selection(), &cells, &error);
+    if (!error.isEmpty()) {
+        QMessageBox::critical(this, tr("Ошибка"), tr("Не удалось скопировать данные:\n%1").arg(error));
         return;
     }
 
-    QItemSelectionModel *selection = tableView->selectionModel();
-    if (!selection->hasSelection()) return;
-
-    QModelIndexList indexes = selection->selectedIndexes();
-    if (indexes.isEmpty()) return;
+    QApplication::clipboard()->setMimeData(new TableMimeData(tsv));
+    statusBar->showMessage(tr("Скопировано %1 ячеек (%2 КБ)").arg(cells).arg(tsv.size() / 1024), 2000);
+}
 
-    // Сортировка индексов по строкам и столбцам
-    std::sort(indexes.begin(), indexes.end(), [](const QModelIndex &a, const QModelIndex &b) {
-        if (a.row() == b.row()) return a.column() < b.column();
-        return a.row() < b.row();
-    });
+void DatabaseAdmin::pasteData()
+{
+    if (sqlModel->tableName().isEmpty() || tableView->model() != sqlModel) {
+        QMessageBox::warning(this, tr("Предупреждение"), tr("Нет активной таблицы"));
+        return;
+    }
+    if (sqlModel->isDirty()) {
+        QMessageBox::warning(this, tr("Предупреждение"), tr("Сначала примените или отмените несохранённые изменения"));
+        return;
+    }
 
-    QString clipboardText;
-    int currentRow = indexes.first().row();
-    int currentCol = indexes.first().column();
+    const QMimeData *mime = QApplication::clipboard()->mimeData();
+    if (!mime || !mime->hasText()) {
+        statusBar->showMessage(tr("В буфере обмена нет текста"), 2000);
+        return;
+    }
 
-    for (const QModelIndex &index : indexes) {
-        if (index.row() != currentRow) {
-            clipboardText += "\n";
-            currentRow = index.row();
-            currentCol = index.column();
-        } else if (index.column() != currentCol) {
-            clipboardText += "\t";
-            currentCol = index.column();
-        }
+    // Вставка начинается с текущей ячейки; без неё - с новой строки в первом столбце
+    const QModelIndex current = tableView->currentIndex();
+    const int row = current.isValid() ? current.row() : sqlModel->rowCount();
+    const int column = current.isValid() ? current.column() : 0;
 
-        clipboardText += index.data().toString();
+    QList<RowChange> changes;
+    QString error;
+    if (!TableClipboard::pasteChanges(sqlModel, row, column, mime->text().toUtf8(), &changes, &error)) {
+        QMessageBox::warning(this, tr("Вставка"), error);
+        return;
     }
 
-    QApplication::clipboard()->setText(clipboardText);
-    statusBar->showMessage(tr("Скопировано %1 ячеек").arg(indexes.size()), 2000);
+    const QString table = sqlModel->tableName();
+    const QString key = sqlModel->keyColumn();
+    const QStringList columns = sqlModel->columnNames();
+    startSubmitter(new BatchSubmitter(table, key, columns, changes), tr("Вставка из буфера обмена..."),
+                   [this, table, key, columns, changes] {
+        auto *submitter = new BatchSubmitter(table, key, columns, changes);
+        submitter->setOverwriteConflicts(true);
+        startSubmitter(submitter, tr("Вставка из буфера обмена..."), nullptr);
+    });
 }
 
 void DatabaseAdmin::deleteSelectedRows()
 {
-    if (sqlModel->tableName().isEmpty()) {
+    if (currentTableName().isEmpty()) {
         QMessageBox::warning(this, tr("Предупреждение"), tr("Нет активной таблицы"));
         return;
     }
@@ -696,48 +1733,32 @@ void DatabaseAdmin::deleteSelectedRows()
         return;
     }
 
-    // Получение первичного ключа (предполагаем, что первый столбец - первичный ключ)
-    QString primaryKey = sqlModel->headerData(0, Qt::Horizontal).toString();
-
-    QSqlDatabase::database().transaction();
-    int deletedRows = 0;
-
-    for (const QModelIndex &index : selectedRows) {
-        QVariant pkValue = sqlModel->data(sqlModel->index(index.row(), 0));
+    // Ключ (rowid или первичный ключ) модель берёт из схемы таблицы
+    QList<int> rows;
+    rows.reserve(selectedRows.size());
+    for (const QModelIndex &index : selectedRows)
+        rows << index.row();
 
-        QSqlQuery deleteQuery;
-        deleteQuery.prepare(QString("DELETE FROM %1 WHERE %2 = ?")
-                                .arg(sqlModel->tableName())
-                                .arg(primaryKey));
-        deleteQuery.bindValue(0, pkValue);
-
-        if (!deleteQuery.exec()) {
-            showError(tr("Ошибка удаления"), deleteQuery.lastError());
-            QSqlDatabase::database().rollback();
-            return;
-        }
-
-        deletedRows++;
+    if (!sqlModel->deleteRows(rows)) {
+        showError(tr("Ошибка удаления"), sqlModel->lastError());
+        return;
     }
 
-    QSqlDatabase::database().commit();
-
-    // Обновляем данные после удаления
-    sqlModel->select();
-    statusBar->showMessage(tr("Удалено %1 строк").arg(deletedRows), 3000);
+    statusBar->showMessage(tr("Удалено %1 строк").arg(rows.size()), 3000);
 }
 
 void DatabaseAdmin::insertRow()
 {
-    if (sqlModel->tableName().isEmpty()) {
+    if (currentTableName().isEmpty()) {
         QMessageBox::warning(this, tr("Предупреждение"), tr("Нет активной таблицы"));
         return;
     }
 
-    // Получение информации о столбцах
-    QStringList columnNames;
-    for (int i = 0; i < sqlModel->columnCount(); ++i) {
-        columnNames << sqlModel->headerData(i, Qt::Horizontal).toString();
+    // Столбцы и их типы из кэша схемы
+    const TableInfo *table = catalog().table(currentTableName());
+    if (!table) {
+        QMessageBox::warning(this, tr("Предупреждение"), tr("Таблица %1 не найдена").arg(currentTableName()));
+        return;
     }
 
     // Создание диалога для ввода значений
@@ -746,9 +1767,11 @@ void DatabaseAdmin::insertRow()
     QFormLayout layout(&dialog);
 
     QList<QLineEdit*> lineEdits;
-    for (const QString &column : columnNames) {
+    for (const ColumnInfo &column : table->columns) {
         QLineEdit *lineEdit = new QLineEdit(&dialog);
-        layout.addRow(column, lineEdit);
+        lineEdit->setPlaceholderText(column.defaultValue.isEmpty() ? column.type
+                                                                   : tr("%1, по умолчанию %2").arg(column.type, column.defaultValue));
+        layout.addRow(column.name, lineEdit);
         lineEdits << lineEdit;
     }
 
@@ -815,13 +1838,12 @@ void DatabaseAdmin::sortData()
                                          QLineEdit::Normal, "", &ok);
     if (!ok || sort.isEmpty()) return;
 
-    sqlModel->setSort(0, Qt::AscendingOrder); // Сброс предыдущей сортировки
-    sqlModel->setFilter(QString()); // Сброс фильтра
-
-    QString query = QString("SELECT * FROM %1 ORDER BY %2").arg(sqlModel->tableName()).arg(sort);
-    sqlModel->setQuery(query);
+    // Сортировка выполняется на стороне SQLite, модель остаётся редактируемой
+    setViewModel(sqlModel);
+    sqlModel->setOrderByClause(sort);
+    clearSortIndicator();
 
-    if (sqlModel->lastError().isValid()) {
+    if (!sqlModel->select()) {
         showError(tr("Ошибка сортировки"), sqlModel->lastError());
         return;
     }
@@ -836,8 +1858,11 @@ void DatabaseAdmin::resetView()
         return;
     }
 
+    setViewModel(sqlModel);
     sqlModel->setFilter(QString());
+    sqlModel->clearColumnFilters();
     sqlModel->setSort(-1, Qt::AscendingOrder); // Сброс сортировки
+    clearSortIndicator();
 
     if (!sqlModel->select()) {
         showError(tr("Ошибка сброса вида"), sqlModel->lastError());
@@ -847,6 +1872,284 @@ void DatabaseAdmin::resetView()
     statusBar->showMessage(tr("Вид сброшен"), 2000);
 }
 
+void DatabaseAdmin::sortByColumn(int column, Qt::SortOrder order)
+{
+    if (tableView->model() != sqlModel || sqlModel->tableName().isEmpty() || column < 0)
+        return;
+
+    const bool indexed = ensureIndex(sqlModel->columnNames().value(column), [this, column, order] {
+        QSignalBlocker blocker(tableView->horizontalHeader());
+        tableView->horizontalHeader()->setSortIndicator(column, order);
+        sortByColumn(column, order);
+    });
+    if (!indexed) {
+        clearSortIndicator();
+        return;
+    }
+
+    sqlModel->setSort(column, order);
+    if (!sqlModel->select()) {
+        showError(tr("Ошибка сортировки"), sqlModel->lastError());
+        return;
+    }
+
+    statusBar->showMessage(tr("Сортировка по столбцу %1").arg(sqlModel->columnNames().value(column)), 2000);
+}
+
+void DatabaseAdmin::filterColumn(int column)
+{
+    const QString name = sqlModel->columnNames().value(column);
+    if (currentTableName().isEmpty() || name.isEmpty())
+        return;
+
+    bool ok;
+    const QString filter = QInputDialog::getText(this, tr("Фильтр по столбцу %1").arg(name),
+                                                 tr("Подстрока или сравнение (=, !=, <, <=, >, >=),\n"
+                                                    "например >=100 или =NULL. Пустая строка снимает фильтр:"),
+                                                 QLineEdit::Normal, sqlModel->columnFilter(column), &ok);
+    if (!ok)
+        return;
+
+    // Поиск подстроки индекс не ускорит, поэтому проверяем только сравнения
+    if (PagedTableModel::isComparisonFilter(filter)
+        && !ensureIndex(name, [this, column, filter] { applyColumnFilter(column, filter); })) {
+        return;
+    }
+    applyColumnFilter(column, filter);
+}
+
+void DatabaseAdmin::applyColumnFilter(int column, const QString &filter)
+{
+    const QString name = sqlModel->columnNames().value(column);
+    sqlModel->setColumnFilter(column, filter);
+    if (!sqlModel->select()) {
+        showError(tr("Ошибка фильтрации"), sqlModel->lastError());
+        return;
+    }
+
+    statusBar->showMessage(filter.trimmed().isEmpty() ? tr("Фильтр по столбцу %1 снят").arg(name)
+                                                      : tr("Фильтр по столбцу %1 применен").arg(name), 2000);
+}
+
+void DatabaseAdmin::showHeaderMenu(const QPoint &pos)
+{
+    if (currentTableName().isEmpty())
+        return;
+
+    const int column = tableView->horizontalHeader()->logicalIndexAt(pos);
+    QMenu menu(this);
+    if (column >= 0)
+        menu.addAction(tr("Фильтр по столбцу %1...").arg(sqlModel->columnNames().value(column)),
+                       this, [this, column] { filterColumn(column); });
+    menu.addAction(tr("Сбросить фильтры столбцов"), this, [this] {
+        sqlModel->clearColumnFilters();
+        if (!sqlModel->select())
+            showError(tr("Ошибка фильтрации"), sqlModel->lastError());
+    });
+    menu.exec(tableView->horizontalHeader()->mapToGlobal(pos));
+}
+
+bool DatabaseAdmin::ensureIndex(const QString &column, const std::function<void()> &retry)
+{
+    const TableInfo *table = catalog().table(sqlModel->tableName());
+    if (!table || table->isView || column.isEmpty() || sqlModel->rowCount() < LargeTableRows)
+        return true;
+
+    // Годится индекс, который начинается с этого столбца: в нём уже лежит пара (столбец, ключ).
+    // Первичный ключ либо сам задаёт порядок таблицы, либо имеет автоиндекс
+    const QStringList primaryKey = table->primaryKey();
+    if (!primaryKey.isEmpty() && primaryKey.first().compare(column, Qt::CaseInsensitive) == 0)
+        return true;
+    for (const IndexInfo &index : table->indexes) {
+        if (!index.columns.isEmpty() && index.columns.first().compare(column, Qt::CaseInsensitive) == 0)
+            return true;
+    }
+
+    const QMessageBox::StandardButton answer = QMessageBox::question(
+        this, tr("Нет подходящего индекса"),
+        tr("В таблице %1 около %2 строк, и ни один индекс не начинается со столбца %3.\n"
+           "Без индекса SQLite будет читать всю таблицу и сортировать её во временном "
+           "B-дереве на каждой странице.\n\nСоздать индекс по столбцу %3?")
+            .arg(table->name, QString::number(sqlModel->rowCount()), column),
+        QMessageBox::Yes | QMessageBox::No | QMessageBox::Cancel, QMessageBox::Yes);
+    if (answer == QMessageBox::Cancel)
+        return false;
+    if (answer == QMessageBox::No)
+        return true;
+
+    // Индекс строится в фоне; сортировка или фильтр применяются заново, когда он готов,
+    // если к тому времени открыта всё та же таблица
+    const QString tableName = table->name;
+    auto *builder = new IndexBuilder(tableName, column);
+
+    auto *progress = new QProgressDialog(tr("Создание индекса по столбцу %1...").arg(column), tr("Отмена"),
+                                         0, 0, this);
+    progress->setAttribute(Qt::WA_DeleteOnClose);
+    progress->setMinimumDuration(500);
+    progress->setAutoClose(false);
+    progress->setAutoReset(false);
+
+    connect(progress, &QProgressDialog::canceled, builder, &BackgroundJob::cancel, Qt::DirectConnection);
+    connect(builder, &IndexBuilder::done, progress, &QProgressDialog::close);
+    connect(builder, &IndexBuilder::finished, this, [this, tableName, retry](const QString &indexName, qint64 elapsedMs) {
+        statusBar->showMessage(tr("Индекс %1 создан за %2 с").arg(indexName).arg(elapsedMs / 1000.0, 0, 'f', 1), 3000);
+        if (sqlModel->tableName() == tableName)
+            retry();
+    });
+    connect(builder, &IndexBuilder::cancelled, this, [this] {
+        statusBar->showMessage(tr("Создание индекса отменено"), 3000);
+    });
+    connect(builder, &IndexBuilder::failed, this, [this](const QString &message) {
+        QMessageBox::critical(this, tr("Ошибка создания индекса"), message);
+    });
+
+    startJob(builder);
+    return false;
+}
+
+const SchemaCatalog &DatabaseAdmin::catalog()
+{
+    schemaCatalog->refresh();
+    return *schemaCatalog;
+}
+
+ConnectionProfile DatabaseAdmin::currentProfile() const
+{
+    const QList<ConnectionProfile> profiles = ConnectionProfile::load(*settings);
+    for (const ConnectionProfile &profile : profiles) {
+        if (profile.name == profileName)
+            return profile;
+    }
+    return profiles.first();
+}
+
+void DatabaseAdmin::applyProfile(const QSqlDatabase &db)
+{
+    const ConnectionProfile profile = currentProfile();
+
+    QString error;
+    if (!applyConnectionProfile(db, profile, true, &error))
+        statusBar->showMessage(tr("Профиль %1 применён не полностью: %2").arg(profile.name, error), 5000);
+
+    // Клоны соединения в рабочих потоках откроются с тем же профилем
+    ConnectionProfile::setForConnection(db.connectionName(), profile);
+}
+
+void DatabaseAdmin::rebuildProfileMenu()
+{
+    profileMenu->clear();
+    for (QAction *action : profileGroup->actions())
+        profileGroup->removeAction(action);
+
+    const ConnectionProfile active = currentProfile();
+    const QList<ConnectionProfile> profiles = ConnectionProfile::load(*settings);
+    for (const ConnectionProfile &profile : profiles) {
+        QAction *action = profileMenu->addAction(profile.name, this, [this, name = profile.name] {
+            setConnectionProfile(name);
+        });
+        action->setCheckable(true);
+        action->setChecked(profile.name == active.name);
+        action->setToolTip(profile.summary());
+        profileGroup->addAction(action);
+    }
+    profileMenu->addSeparator();
+    profileMenu->addAction(tr("&Изменить профиль..."), this, &DatabaseAdmin::editConnectionProfile);
+
+    profileLabel->setText(tr("Профиль: %1").arg(active.name));
+    profileLabel->setToolTip(active.summary());
+}
+
+void DatabaseAdmin::setConnectionProfile(const QString &name)
+{
+    profileName = name;
+    rebuildProfileMenu();
+
+    // Переключение на живом соединении: PRAGMA сразу, параметры подключения — к следующему открытию,
+    // рабочие потоки переоткрывают свои клоны
+    if (QSqlDatabase::contains(QSqlDatabase::defaultConnection)) {
+        QSqlDatabase db = QSqlDatabase::database(QSqlDatabase::defaultConnection, false);
+        if (db.isOpen()) {
+            db.setConnectOptions(currentProfile().connectOptions());
+            applyProfile(db);
+            resetWorkerConnections();
+        }
+    }
+
+    statusBar->showMessage(tr("Профиль соединения: %1").arg(profileName), 3000);
+}
+
+void DatabaseAdmin::editConnectionProfile()
+{
+    const ConnectionProfile current = currentProfile();
+
+    QDialog dialog(this);
+    dialog.setWindowTitle(tr("Профиль соединения"));
+    QFormLayout layout(&dialog);
+
+    QLineEdit *nameEdit = new QLineEdit(current.name, &dialog);
+    layout.addRow(tr("Имя:"), nameEdit);
+
+    QComboBox *journalBox = new QComboBox(&dialog);
+    journalBox->addItem(tr("Не менять"), QString());
+    for (const QString &mode : ConnectionProfile::journalModes)
+        journalBox->addItem(mode, mode);
+    journalBox->setCurrentIndex(qMax(0, journalBox->findData(current.journalMode)));
+    layout.addRow(QStringLiteral("journal_mode:"), journalBox);
+
+    QComboBox *synchronousBox = new QComboBox(&dialog);
+    synchronousBox->addItems(ConnectionProfile::synchronousModes);
+    synchronousBox->setCurrentText(current.synchronous);
+    layout.addRow(QStringLiteral("synchronous:"), synchronousBox);
+
+    QSpinBox *cacheBox = new QSpinBox(&dialog);
+    cacheBox->setRange(1, 16384);
+    cacheBox->setSuffix(tr(" МБ"));
+    cacheBox->setValue(current.cacheSizeMb);
+    layout.addRow(QStringLiteral("cache_size:"), cacheBox);
+
+    QSpinBox *mmapBox = new QSpinBox(&dialog);
+    mmapBox->setRange(0, 65536);
+    mmapBox->setSuffix(tr(" МБ"));
+    mmapBox->setSpecialValueText(tr("Выключено"));
+    mmapBox->setValue(current.mmapSizeMb);
+    layout.addRow(QStringLiteral("mmap_size:"), mmapBox);
+
+    QComboBox *tempStoreBox = new QComboBox(&dialog);
+    tempStoreBox->addItems(ConnectionProfile::tempStores);
+    tempStoreBox->setCurrentText(current.tempStore);
+    layout.addRow(QStringLiteral("temp_store:"), tempStoreBox);
+
+    QSpinBox *busyBox = new QSpinBox(&dialog);
+    busyBox->setRange(0, 600000);
+    busyBox->setSuffix(tr(" мс"));
+    busyBox->setValue(current.busyTimeoutMs);
+    layout.addRow(QStringLiteral("busy_timeout:"), busyBox);
+
+    QDialogButtonBox buttons(QDialogButtonBox::Ok | QDialogButtonBox::Cancel,
+                             Qt::Horizontal, &dialog);
+    layout.addRow(&buttons);
+
+    connect(&buttons, &QDialogButtonBox::accepted, &dialog, &QDialog::accept);
+    connect(&buttons, &QDialogButtonBox::rejected, &dialog, &QDialog::reject);
+
+    if (dialog.exec() != QDialog::Accepted || nameEdit->text().trimmed().isEmpty()) {
+        return;
+    }
+
+    // Под новым именем сохраняется новый профиль, под старым — изменяется текущий
+    ConnectionProfile profile;
+    profile.name = nameEdit->text().trimmed().replace(QLatin1Char('/'), QLatin1Char('-'));
+    profile.journalMode = journalBox->currentData().toString();
+    profile.synchronous = synchronousBox->currentText();
+    profile.cacheSizeMb = cacheBox->value();
+    profile.mmapSizeMb = mmapBox->value();
+    profile.tempStore = tempStoreBox->currentText();
+    profile.busyTimeoutMs = busyBox->value();
+
+    ConnectionProfile::save(*settings, profile);
+    setConnectionProfile(profile.name);
+}
+
 void DatabaseAdmin::loadSettings()
 {
     settings->beginGroup("MainWindow");
@@ -856,7 +2159,15 @@ void DatabaseAdmin::loadSettings()
 
     settings->beginGroup("Preferences");
     lastDir = settings->value("lastDir", QDir::homePath()).toString();
+    profileName = settings->value("connectionProfile", QStringLiteral("safe")).toString();
+    scriptTransactionAction->setChecked(settings->value("scriptTransaction", true).toBool());
+    resultCacheMb = settings->value("resultCacheMb", int(ResultCache::DefaultBudget / (1024 * 1024))).toInt();
+    reopenLastAction->setChecked(settings->value("reopenLast", true).toBool());
     settings->endGroup();
+
+    recentDatabases = RecentDatabase::load(*settings);
+    rebuildProfileMenu();
+    rebuildRecentMenu();
 }
 
 void DatabaseAdmin::saveSettings()
@@ -868,18 +2179,314 @@ void DatabaseAdmin::saveSettings()
 
     settings->beginGroup("Preferences");
     settings->setValue("lastDir", lastDir);
+    settings->setValue("connectionProfile", profileName);
+    settings->setValue("scriptTransaction", scriptTransactionAction->isChecked());
+    settings->setValue("resultCacheMb", resultCacheMb);
+    settings->setValue("reopenLast", reopenLastAction->isChecked());
     settings->endGroup();
+
+    RecentDatabase::save(*settings, recentDatabases);
+}
+
+void DatabaseAdmin::showStatementCache()
+{
+    StatementCache &cache = StatementCache::forConnection(QString::fromLatin1(QSqlDatabase::defaultConnection));
+
+    QDialog dialog(this);
+    dialog.setWindowTitle(tr("Кэш подготовленных запросов"));
+    dialog.resize(700, 400);
+    QVBoxLayout layout(&dialog);
+
+    QLabel *summary = new QLabel(&dialog);
+    layout.addWidget(summary);
+
+    QTreeWidget *entries = new QTreeWidget(&dialog);
+    entries->setRootIsDecorated(false);
+    entries->setHeaderLabels({ tr("Попаданий"), tr("SQL") });
+    layout.addWidget(entries);
+
+    auto update = [&cache, summary, entries] {
+        const StatementCache::Stats stats = cache.stats();
+        const qint64 requests = stats.hits + stats.misses;
+        summary->setText(tr("Запросов в кэше: %1 из %2\n"
+                            "Попаданий: %3, промахов: %4 (%5% попаданий)\n"
+                            "Вытеснено: %6, сбросов из-за смены схемы: %7")
+                             .arg(stats.size).arg(stats.capacity)
+                             .arg(stats.hits).arg(stats.misses)
+                             .arg(requests > 0 ? 100.0 * stats.hits / requests : 0.0, 0, 'f', 1)
+                             .arg(stats.evictions).arg(stats.invalidations));
+
+        entries->clear();
+        for (const StatementCache::Entry &entry : cache.entries()) {
+            auto *item = new QTreeWidgetItem(entries, { QString::number(entry.hits), entry.sql });
+            item->setTextAlignment(0, Qt::AlignRight | Qt::AlignVCenter);
+            item->setToolTip(1, entry.sql);
+        }
+        entries->resizeColumnToContents(0);
+    };
+    update();
+
+    QDialogButtonBox buttons(QDialogButtonBox::Close, &dialog);
+    QPushButton *clearButton = buttons.addButton(tr("Очистить"), QDialogButtonBox::ResetRole);
+    connect(clearButton, &QPushButton::clicked, &dialog, [&cache, &update] {
+        cache.clear();
+        update();
+    });
+    connect(&buttons, &QDialogButtonBox::rejected, &dialog, &QDialog::reject);
+    layout.addWidget(&buttons);
+
+    dialog.exec();
+}
+
+void DatabaseAdmin::showResultCache()
+{
+    ResultCache &cache = ResultCache::forConnection(QString::fromLatin1(QSqlDatabase::defaultConnection));
+
+    QDialog dialog(this);
+    dialog.setWindowTitle(tr("Кэш результатов запросов"));
+    QFormLayout layout(&dialog);
+
+    QLabel *summary = new QLabel(&dialog);
+    layout.addRow(summary);
+
+    QSpinBox *budgetBox = new QSpinBox(&dialog);
+    budgetBox->setRange(0, 4096);
+    budgetBox->setSuffix(tr(" МБ"));
+    budgetBox->setValue(resultCacheMb);
+    budgetBox->setToolTip(tr("0 - не кэшировать результаты"));
+    layout.addRow(tr("Бюджет памяти:"), budgetBox);
+
+    auto update = [&cache, summary] {
+        const ResultCache::Stats stats = cache.stats();
+        summary->setText(tr("Результатов в кэше: %1, %2 из %3 КБ\n"
+                            "Попаданий: %4, промахов: %5 (%6% попаданий)\n"
+                            "Вытеснено: %7, сброшено из-за изменений: %8")
+                             .arg(stats.size).arg(stats.bytes / 1024).arg(stats.budget / 1024)
+                             .arg(stats.hits).arg(stats.misses)
+                             .arg(100.0 * stats.hitRate(), 0, 'f', 1)
+                             .arg(stats.evictions).arg(stats.invalidations));
+    };
+    update();
+
+    QDialogButtonBox buttons(QDialogButtonBox::Ok | QDialogButtonBox::Cancel, &dialog);
+    QPushButton *clearButton = buttons.addButton(tr("Очистить"), QDialogButtonBox::ResetRole);
+    connect(clearButton, &QPushButton::clicked, &dialog, [&cache, &update] {
+        cache.clear();
+        update();
+    });
+    connect(&buttons, &QDialogButtonBox::accepted, &dialog, &QDialog::accept);
+    connect(&buttons, &QDialogButtonBox::rejected, &dialog, &QDialog::reject);
+    layout.addRow(&buttons);
+
+    if (dialog.exec() == QDialog::Accepted) {
+        resultCacheMb = budgetBox->value();
+        cache.setBudget(qint64(resultCacheMb) * 1024 * 1024);
+    }
+    updateResultCacheLabel();
+}
+
+void DatabaseAdmin::updateResultCacheLabel()
+{
+    const ResultCache::Stats stats =
+        ResultCache::forConnection(QString::fromLatin1(QSqlDatabase::defaultConnection)).stats();
+    if (stats.hits + stats.misses == 0) {
+        resultCacheLabel->clear();
+        return;
+    }
+    resultCacheLabel->setText(tr("Кэш: %1% попаданий").arg(qRound(100.0 * stats.hitRate())));
+    resultCacheLabel->setToolTip(tr("Попаданий: %1, промахов: %2, в кэше %3 КБ")
+                                     .arg(stats.hits).arg(stats.misses).arg(stats.bytes / 1024));
+}
+
+void DatabaseAdmin::startSearch(const QString &text, bool useIndexes)
+{
+    if (!QSqlDatabase::database().isOpen()) {
+        QMessageBox::warning(this, tr("Ошибка"), tr("База данных не подключена"));
+        return;
+    }
+    if (activeSearch)
+        return;
+
+    const QList<SearchTarget> targets = DatabaseSearch::targets(catalog());
+    if (targets.isEmpty()) {
+        searchPanel->setStatus(tr("В базе нет таблиц с текстовыми столбцами"));
+        return;
+    }
+
+    // Индексы меняют схему базы, поэтому спрашиваем каждый раз
+    if (useIndexes
+        && !confirmAction(tr("Для поиска будут построены FTS5-индексы и триггеры к %1 таблицам.\n"
+                             "Они останутся в базе и замедлят запись. Продолжить?").arg(targets.size()))) {
+        return;
+    }
+
+    SearchOptions options;
+    options.useIndexes = useIndexes;
+    auto *search = new DatabaseSearch(text, targets, options);
+    activeSearch = search;
+    searchPanel->setRunning(true);
+    searchPanel->setStatus(tr("Поиск в %1 таблицах...").arg(targets.size()));
+
+    connect(search, &DatabaseSearch::indexing, searchPanel, [this](const QString &table) {
+        searchPanel->setStatus(tr("Построение индекса для %1...").arg(table));
+    });
+    connect(search, &DatabaseSearch::matchesFound, searchPanel, &SearchPanel::addMatches);
+    connect(search, &DatabaseSearch::tableSearched, searchPanel,
+            [this, searched = 0, total = targets.size()](const QString &table) mutable {
+        searchPanel->setStatus(tr("Просмотрено таблиц: %1 из %2 (%3)").arg(QString::number(++searched),
+                                                                            QString::number(total), table));
+    });
+    connect(search, &DatabaseSearch::warning, this, [this](const QString &message) {
+        statusBar->showMessage(message.section(QLatin1Char('\n'), 0, 0), 5000);
+    });
+    connect(search, &DatabaseSearch::done, searchPanel, [this] {
+        searchPanel->setRunning(false);
+    });
+    connect(search, &DatabaseSearch::finished, this, [this](qint64 matches, int tables, qint64 elapsedMs) {
+        searchPanel->setStatus(tr("Найдено совпадений: %1 в %2 таблицах за %3 мс").arg(matches).arg(tables).arg(elapsedMs));
+    });
+    connect(search, &DatabaseSearch::cancelled, this, [this] {
+        searchPanel->setStatus(tr("Поиск остановлен"));
+    });
+    connect(search, &DatabaseSearch::failed, this, [this](const QString &message) {
+        searchPanel->setStatus(tr("Ошибка поиска"));
+        QMessageBox::critical(this, tr("Ошибка поиска"), message);
+    });
+
+    startJob(search);
+}
+
+void DatabaseAdmin::stopSearch()
+{
+    if (activeSearch)
+        activeSearch->cancel();
+}
+
+void DatabaseAdmin::openSearchMatch(const QString &table, const QString &keyColumn, const QVariant &key)
+{
+    // Ключ подставляется литералом: фильтр модели - это текст условия WHERE
+    QString literal;
+    switch (key.typeId()) {
+    case QMetaType::Int:
+    case QMetaType::LongLong:
+    case QMetaType::Double:
+        literal = key.toString();
+        break;
+    case QMetaType::QByteArray:
+        literal = QStringLiteral("X'%1'").arg(QString::fromLatin1(key.toByteArray().toHex()));
+        break;
+    default:
+        literal = quoteString(key.toString());
+        break;
+    }
+
+    setViewModel(sqlModel);
+    sqlModel->setTable(table);
+    sqlModel->setFilter(QStringLiteral("%1 = %2").arg(keyColumn, literal));
+    clearSortIndicator();
+    if (!sqlModel->select()) {
+        showError(tr("Ошибка загрузки таблицы"), sqlModel->lastError());
+        return;
+    }
+
+    if (sqlModel->rowCount() > 0)
+        tableView->selectRow(0);
+    statusBar->showMessage(tr("Таблица %1, строка %2 = %3").arg(table, keyColumn, key.toString()), 3000);
+}
+
+void DatabaseAdmin::profileTable(const QString &table, bool force)
+{
+    if (table.isEmpty() || !QSqlDatabase::database().isOpen())
+        return;
+
+    // Пока версия данных та же, профиль из кэша: полный проход по большой таблице дорог
+    const DataVersion version = ColumnProfiler::currentVersion(QSqlDatabase::database());
+    const auto cached = tableProfiles.constFind(table);
+    if (!force && cached != tableProfiles.cend() && cached->version.isValid() && cached->version == version) {
+        if (activeProfiler)
+            activeProfiler->cancel();
+        activeProfiler = nullptr;
+        profilePanel->setRunning(false);
+        profilePanel->setProfile(*cached, true);
+        return;
+    }
+
+    if (activeProfiler)
+        activeProfiler->cancel();
+    auto *profiler = new ColumnProfiler(table, version);
+    activeProfiler = profiler;
+    profilePanel->clear();
+    profilePanel->setRunning(true);
+    profilePanel->setStatus(tr("Профилирование %1...").arg(table));
+
+    // Сигналы прерванного профилировщика могут прийти после запуска нового
+    connect(profiler, &ColumnProfiler::progress, profilePanel, [this, profiler, table](qint64 rows) {
+        if (activeProfiler == profiler)
+            profilePanel->setStatus(tr("Профилирование %1: %2 строк...").arg(table).arg(rows));
+    });
+    connect(profiler, &ColumnProfiler::finished, this, [this, profiler](const TableProfile &profile) {
+        tableProfiles.insert(profile.table, profile);
+        if (activeProfiler == profiler)
+            profilePanel->setProfile(profile, false);
+    });
+    connect(profiler, &ColumnProfiler::cancelled, profilePanel, [this, profiler] {
+        if (activeProfiler == profiler)
+            profilePanel->setStatus(tr("Профилирование остановлено"));
+    });
+    connect(profiler, &ColumnProfiler::failed, profilePanel, [this, profiler](const QString &message) {
+        if (activeProfiler == profiler)
+            profilePanel->setStatus(tr("Ошибка профилирования: %1").arg(message));
+    });
+    connect(profiler, &ColumnProfiler::done, profilePanel, [this, profiler] {
+        if (activeProfiler == profiler)
+            profilePanel->setRunning(false);
+    });
+
+    startJob(profiler);
+}
+
+void DatabaseAdmin::dropSearchIndexes()
+{
+    if (!QSqlDatabase::database().isOpen()) {
+        QMessageBox::warning(this, tr("Ошибка"), tr("База данных не подключена"));
+        return;
+    }
+    if (activeSearch) {
+        QMessageBox::warning(this, tr("Предупреждение"), tr("Дождитесь окончания поиска"));
+        return;
+    }
+    if (!confirmAction(tr("Удалить все FTS5-индексы поиска и их триггеры?")))
+        return;
+
+    QString error;
+    if (!DatabaseSearch::dropIndexes(QSqlDatabase::database(), &error)) {
+        QMessageBox::critical(this, tr("Ошибка"), tr("Не удалось удалить индексы:\n%1").arg(error));
+        return;
+    }
+    statusBar->showMessage(tr("Поисковые индексы удалены"), 3000);
 }
 
 void DatabaseAdmin::closeEvent(QCloseEvent *event)
 {
+    rememberView();
     saveSettings();
-    if (QSqlDatabase::contains(QSqlDatabase::defaultConnection)) {
-        QSqlDatabase::removeDatabase(QSqlDatabase::defaultConnection);
-    }
+    closeDefaultConnection();
     event->accept();
 }
 
+void DatabaseAdmin::clearSortIndicator()
+{
+    // Без блокировки заголовок сам вызовет sort() и перечитает таблицу
+    QSignalBlocker blocker(tableView->horizontalHeader());
+    tableView->horizontalHeader()->setSortIndicator(-1, Qt::AscendingOrder);
+}
+
+QString DatabaseAdmin::currentTableName() const
+{
+    // Пока в представлении результат запроса, операции над строками таблицы недоступны
+    return tableView->model() == sqlModel ? sqlModel->tableName() : QString();
+}
+
 void DatabaseAdmin::showError(const QString &title, const QSqlError &error)
 {
     QMessageBox::critical(this, title,
@@ -1,11 +1,20 @@
 #ifndef DATABASEADMIN_H
 #define DATABASEADMIN_H
 
+#include "columnprofiler.h"
+#include "queryprofile.h"
+#include "recentdatabases.h"
+#include "resultcache.h"
+#include <QFutureWatcher>
+#include <QHash>
 #include <QMainWindow>
-#include <QSqlTableModel>
+#include <QPointer>
+#include <QSqlError>
 #include <QSettings>
 #include <QSqlRecord>  // Добавлено для работы с QSqlRecord
 
+#include <functional>
+
 class QTableView;
 class QTextEdit;
 class QStatusBar;
@@ -13,6 +22,33 @@ class QDockWidget;
 class QMenu;
 class QToolBar;
 class QAction;
+class QLabel;
+class QActionGroup;
+class QThread;
+class QueryWorker;
+class QueryResultModel;
+class QueryProfilerPanel;
+class ScriptResultPanel;
+class ScriptRunner;
+class SearchPanel;
+class DatabaseSearch;
+class ColumnProfilePanel;
+class DatabaseMaintenance;
+class PagedTableModel;
+class BackgroundJob;
+class BatchSubmitter;
+class SchemaCatalog;
+struct ConnectionProfile;
+struct ScriptStatement;
+
+// Итог открытия базы в фоне; соединение по умолчанию к этому времени уже передано потоку окна
+struct OpenedDatabase
+{
+    QString path;
+    QString error;          // база не открылась, соединение надо удалить
+    QString profileError;   // PRAGMA профиля выполнились не все
+    bool pickTable = false; // без запомненной таблицы предложить выбор
+};
 
 class DatabaseAdmin : public QMainWindow
 {
@@ -29,7 +65,12 @@ private slots:
     // Database operations
     void createDatabase();
     void dropDatabase();  // Добавлено
+    void backupDatabase();
+    void snapshotDatabase();
+    void incrementalVacuum();
+    void copyTables();
     void connectToDatabase();
+    void restoreSession();
     void disconnectFromDatabase();
     void refreshData();
 
@@ -40,18 +81,52 @@ private slots:
 
     // Data operations
     void executeQuery();
+    void cancelQuery();
+    void showScriptStatement(int line);
     void exportToCSV();
     void importFromCSV();
+    void exportToDump();
+    void importFromDump();
     void copyData();
+    void pasteData();
     void deleteSelectedRows();
     void insertRow();
     void submitChanges();
     void revertChanges();
 
+    // Connection profiles
+    void setConnectionProfile(const QString &name);
+    void editConnectionProfile();
+
+    // Diagnostics
+    void showStatementCache();
+    void showResultCache();
+
+    // Search
+    void startSearch(const QString &text, bool useIndexes);
+    void stopSearch();
+    void openSearchMatch(const QString &table, const QString &keyColumn, const QVariant &key);
+    void dropSearchIndexes();
+
+    // Column profile
+    void profileTable(const QString &table, bool force = false);
+
     // View operations
     void filterData();
     void sortData();
     void resetView();
+    void sortByColumn(int column, Qt::SortOrder order);
+    void filterColumn(int column);
+    void showHeaderMenu(const QPoint &pos);
+
+    // Query worker
+    void onQueryColumns(const QStringList &columns);
+    void onQueryRows(const ResultSet &rows);
+    void onQueryProgress(qint64 rows, qint64 elapsedMs);
+    void onQueryFinished(bool isSelect, qint64 rows, qint64 elapsedMs);
+    void onQueryProfiled(const QueryProfile &profile);
+    void onQueryCancelled(qint64 rows, qint64 elapsedMs);
+    void onQueryFailed(const QSqlError &error);
 
 private:
     void setupUI();
@@ -60,30 +135,93 @@ private:
     void loadSettings();
     void saveSettings();
     void refreshDatabaseList();  // Добавлено
+    void setupQueryWorker();
+    void resetWorkerConnections();
+    void setQueryRunning(bool running);
+    void runScript(const QList<ScriptStatement> &statements);
+    void setViewModel(QAbstractItemModel *model);
+    void clearSortIndicator();
+    // Открывает базу в фоне; окно достраивается в onDatabaseOpened()
+    void openDatabase(const QString &path, bool pickTable);
+    void onDatabaseOpened();
+    // Закрывает соединение по умолчанию вместе с его кэшами, трекером и профилем
+    bool closeDefaultConnection();
+    bool openTable(const QString &tableName);
+    void rememberView();
+    void rebuildRecentMenu();
+    void revalidateSchema();
+    void onSchemaRevalidated();
+    void updateResultCacheLabel();
+    // false - действие откладывается: отменено или ждёт индекса, после которого вызывается retry
+    bool ensureIndex(const QString &column, const std::function<void()> &retry);
+    void applyColumnFilter(int column, const QString &filter);
+    void startJob(BackgroundJob *job);
+    void startMaintenance(DatabaseMaintenance *job, const QString &title);
+    QString maintenanceTarget(const QString &title, const QString &suffix);
+    void submitEdits(bool overwriteConflicts);
+    void startSubmitter(BatchSubmitter *submitter, const QString &title, const std::function<void()> &overwrite);
+    ConnectionProfile currentProfile() const;
+    void applyProfile(const QSqlDatabase &db);
+    void rebuildProfileMenu();
 
     bool confirmAction(const QString &message);
     bool databaseExists(const QString &dbName);  // Добавлено
     QStringList getTableList();
+    const SchemaCatalog &catalog();
     QStringList getDatabaseList() const;  // Добавлено
     QString currentTableName() const;
     void executeAndShowQuery(const QString &query);
     void showError(const QString &title, const QSqlError &error);
 
-    QSqlTableModel *sqlModel;
+    PagedTableModel *sqlModel;
+    SchemaCatalog *schemaCatalog;
     QTableView *tableView;
     QTextEdit *queryEditor;
     QStatusBar *statusBar;
     QDockWidget *queryDock;
+    QDockWidget *profilerDock;
+    QueryProfilerPanel *profilerPanel;
+    QDockWidget *scriptDock;
+    ScriptResultPanel *scriptPanel;
+    QPointer<ScriptRunner> activeScript;
+    QDockWidget *searchDock;
+    SearchPanel *searchPanel;
+    QPointer<DatabaseSearch> activeSearch;
+    QDockWidget *profileDock;
+    ColumnProfilePanel *profilePanel;
+    QPointer<ColumnProfiler> activeProfiler;
+    QHash<QString, TableProfile> tableProfiles;
+    QLabel *queryStatsLabel;
+    QLabel *profileLabel;
+    QLabel *resultCacheLabel;
+    QMenu *profileMenu;
+    QMenu *recentMenu;
+    QAction *reopenLastAction;
+    QActionGroup *profileGroup;
+
+    QThread *queryThread;
+    QueryWorker *queryWorker;
+    QueryResultModel *resultModel;
+    // Запрос, результат которого сохранится в ResultCache по завершении
+    QString pendingCacheKey;
+    ResultCache::Ticket pendingCacheTicket;
+    QStringList pendingCacheTables;
+    bool pendingCacheable = false;
+    QList<QPointer<BackgroundJob>> runningJobs;
+    QList<QPointer<QThread>> jobThreads;
 
     // Actions
     QAction *connectAction;
     QAction *disconnectAction;
     QAction *refreshAction;
     QAction *executeAction;
+    QAction *cancelQueryAction;
+    QAction *scriptTransactionAction;
     QAction *showTablesAction;
     QAction *exportAction;
     QAction *importAction;
     QAction *copyAction;
+    QAction *pasteAction;
     QAction *deleteAction;
     QAction *insertAction;
     QAction *submitAction;
@@ -93,7 +231,18 @@ private:
     QAction *resetAction;
 
     QSettings *settings;
+    // Недавние базы; место в текущей запоминается при уходе с неё и при закрытии окна
+    QList<RecentDatabase> recentDatabases;
+    QString databasePath;
+    QFutureWatcher<QByteArray> *schemaWatcher;
+    QFutureWatcher<OpenedDatabase> *openWatcher;
+    QString openingPath;
     QString lastDir;
+    QString profileName;
+    int resultCacheMb = int(ResultCache::DefaultBudget / (1024 * 1024));
+
+    // С какого числа строк сортировка и фильтр без индекса заметно тормозят
+    static constexpr int LargeTableRows = 100000;
 };
 
 #endif // DATABASEADMIN_H
@@ -0,0 +1,208 @@
+#include "databasemaintenance.h"
+#include <QFile>
+#include <QFileInfo>
+
+#include <sqlite3.h>
+
+static qint64 pragmaValue(sqlite3 *db, const char *sql)
+{
+    sqlite3_stmt *stmt = nullptr;
+    qint64 value = -1;
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) == SQLITE_OK && sqlite3_step(stmt) == SQLITE_ROW)
+        value = sqlite3_column_int64(stmt, 0);
+    sqlite3_finalize(stmt);
+    return value;
+}
+
+// Вместе с базой - её журналы: оставшийся от прежнего файла -wal или -journal
+// SQLite применил бы к новой копии
+static void removeDatabaseFiles(const QString &fileName)
+{
+    QFile::remove(fileName);
+    QFile::remove(fileName + QStringLiteral("-wal"));
+    QFile::remove(fileName + QStringLiteral("-shm"));
+    QFile::remove(fileName + QStringLiteral("-journal"));
+}
+
+DatabaseMaintenance::DatabaseMaintenance(Operation operation, const QString &fileName,
+                                         const QString &sourceConnection, QObject *parent)
+    : BackgroundJob(parent),
+    op(operation),
+    fileName(fileName),
+    sourceConnection(sourceConnection)
+{
+}
+
+void DatabaseMaintenance::setPagesPerStep(int pages)
+{
+    pagesPerStep = qMax(1, pages);
+}
+
+void DatabaseMaintenance::run()
+{
+    timer.start();
+    lastProgressMs = 0;
+
+    ScopedConnection connection(sourceConnection, QStringLiteral("maintenance"));
+    sqlite3 *db = connection.open() ? connection.handle() : nullptr;
+    if (!db) {
+        emit failed(connection.lastError().text());
+        return;
+    }
+    interrupter.attach(db);
+
+    QString errorText;
+    bool ok = false;
+    switch (op) {
+    case Backup:
+        ok = backup(db, &errorText);
+        break;
+    case VacuumInto:
+        ok = vacuumInto(db, &errorText);
+        break;
+    case IncrementalVacuum:
+        ok = incrementalVacuum(db, &errorText);
+        break;
+    }
+    interrupter.detach();
+
+    // Недописанная копия никому не нужна
+    if (!ok && op != IncrementalVacuum)
+        removeDatabaseFiles(fileName);
+
+    if (isCancelled())
+        emit cancelled();
+    else if (!ok)
+        emit failed(errorText);
+    else
+        emit finished(processedBytes, timer.elapsed());
+}
+
+void DatabaseMaintenance::reportProgress(qint64 doneBytes, bool force)
+{
+    processedBytes = doneBytes;
+    const qint64 elapsed = timer.elapsed();
+    if (!force && elapsed - lastProgressMs < ProgressIntervalMs)
+        return;
+    lastProgressMs = elapsed;
+    emit progress(processedBytes, totalBytes, elapsed);
+}
+
+bool DatabaseMaintenance::backup(sqlite3 *db, QString *error)
+{
+    // Копия пишется поверх, старый файл может оказаться не базой SQLite
+    removeDatabaseFiles(fileName);
+
+    sqlite3 *target = nullptr;
+    if (sqlite3_open_v2(fileName.toUtf8().constData(), &target,
+                        SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, nullptr) != SQLITE_OK) {
+        *error = QString::fromUtf8(target ? sqlite3_errmsg(target) : "out of memory");
+        sqlite3_close(target);
+        return false;
+    }
+
+    sqlite3_backup *backup = sqlite3_backup_init(target, "main", db, "main");
+    if (!backup) {
+        *error = QString::fromUtf8(sqlite3_errmsg(target));
+        sqlite3_close(target);
+        return false;
+    }
+
+    // Запись в базу другим соединением перезапускает копирование со следующей порции,
+    // поэтому под постоянной нагрузкой копия может не успевать за изменениями
+    const qint64 pageSize = pragmaValue(db, "PRAGMA page_size");
+    int rc = SQLITE_OK;
+    while (!isCancelled()) {
+        rc = sqlite3_backup_step(backup, pagesPerStep);
+        const qint64 pages = sqlite3_backup_pagecount(backup);
+        totalBytes = pages * pageSize;
+        reportProgress((pages - sqlite3_backup_remaining(backup)) * pageSize, rc == SQLITE_DONE);
+
+        if (rc == SQLITE_BUSY || rc == SQLITE_LOCKED)
+            sqlite3_sleep(BusyRetryMs);
+        else if (rc != SQLITE_OK)
+            break;
+    }
+
+    const int finishRc = sqlite3_backup_finish(backup);
+    const bool ok = rc == SQLITE_DONE && finishRc == SQLITE_OK;
+    if (!ok && !isCancelled())
+        *error = QString::fromUtf8(sqlite3_errmsg(target));
+    sqlite3_close(target);
+    return ok;
+}
+
+int DatabaseMaintenance::progressHandler(void *context)
+{
+    // VACUUM INTO не сообщает, сколько осталось; смотрим на размер файла снимка
+    auto *job = static_cast<DatabaseMaintenance *>(context);
+    if (job->timer.elapsed() - job->lastProgressMs >= ProgressIntervalMs)
+        job->reportProgress(QFileInfo(job->fileName).size());
+    return job->isCancelled() ? 1 : 0;
+}
+
+bool DatabaseMaintenance::vacuumInto(sqlite3 *db, QString *error)
+{
+    const qint64 pageSize = pragmaValue(db, "PRAGMA page_size");
+    totalBytes = (pragmaValue(db, "PRAGMA page_count") - pragmaValue(db, "PRAGMA freelist_count")) * pageSize;
+
+    // VACUUM INTO отказывается писать в существующий файл
+    removeDatabaseFiles(fileName);
+
+    const QByteArray sql = QStringLiteral("VACUUM INTO %1").arg(quoteString(fileName)).toUtf8();
+    sqlite3_progress_handler(db, 10000, &DatabaseMaintenance::progressHandler, this);
+    char *message = nullptr;
+    const int rc = sqlite3_exec(db, sql.constData(), nullptr, nullptr, &message);
+    sqlite3_progress_handler(db, 0, nullptr, nullptr);
+
+    if (rc != SQLITE_OK)
+        *error = QString::fromUtf8(message ? message : sqlite3_errmsg(db));
+    sqlite3_free(message);
+    if (rc != SQLITE_OK)
+        return false;
+
+    totalBytes = QFileInfo(fileName).size();
+    reportProgress(totalBytes, true);
+    return true;
+}
+
+bool DatabaseMaintenance::incrementalVacuum(sqlite3 *db, QString *error)
+{
+    if (pragmaValue(db, "PRAGMA auto_vacuum") != 2) {
+        *error = tr("Для incremental_vacuum нужен режим auto_vacuum = INCREMENTAL.\n"
+                    "Он включается командами PRAGMA auto_vacuum = INCREMENTAL и VACUUM, "
+                    "которые перестраивают всю базу.");
+        return false;
+    }
+
+    const qint64 pageSize = pragmaValue(db, "PRAGMA page_size");
+    const qint64 freePages = pragmaValue(db, "PRAGMA freelist_count");
+    totalBytes = freePages * pageSize;
+
+    // Каждая порция - отдельная короткая транзакция записи, между ними пишут другие
+    const QByteArray step = "PRAGMA incremental_vacuum(" + QByteArray::number(pagesPerStep) + ")";
+    qint64 left = freePages;
+    while (left > 0 && !isCancelled()) {
+        char *message = nullptr;
+        const int rc = sqlite3_exec(db, step.constData(), nullptr, nullptr, &message);
+        if (rc == SQLITE_BUSY) {
+            sqlite3_free(message);
+            sqlite3_sleep(BusyRetryMs);
+            continue;
+        }
+        if (rc != SQLITE_OK) {
+            *error = QString::fromUtf8(message ? message : sqlite3_errmsg(db));
+            sqlite3_free(message);
+            return false;
+        }
+
+        const qint64 remaining = pragmaValue(db, "PRAGMA freelist_count");
+        // Свободные страницы могли добавить другие соединения; без продвижения не крутимся
+        if (remaining >= left)
+            break;
+        left = remaining;
+        reportProgress(qMax<qint64>(0, freePages - left) * pageSize, left == 0);
+    }
+    reportProgress(processedBytes, true);
+    return !isCancelled();
+}
@@ -0,0 +1,64 @@
+#ifndef DATABASEMAINTENANCE_H
+#define DATABASEMAINTENANCE_H
+
+#include "backgroundjob.h"
+#include <QElapsedTimer>
+#include <QSqlDatabase>
+
+// Резервное копирование и обслуживание открытой базы на собственном соединении.
+// Backup - онлайн-копия через sqlite3_backup_step() порциями страниц: между порциями
+// блокировка чтения снимается, и другие соединения продолжают писать.
+// VacuumInto - сжатый снимок через VACUUM INTO, читает базу одной транзакцией чтения.
+// IncrementalVacuum - возврат свободных страниц порциями PRAGMA incremental_vacuum,
+// работает только при auto_vacuum = INCREMENTAL.
+class DatabaseMaintenance : public BackgroundJob
+{
+    Q_OBJECT
+
+public:
+    enum Operation {
+        Backup,
+        VacuumInto,
+        IncrementalVacuum
+    };
+
+    DatabaseMaintenance(Operation operation, const QString &fileName = QString(),
+                        const QString &sourceConnection = QString::fromLatin1(QSqlDatabase::defaultConnection),
+                        QObject *parent = nullptr);
+
+    Operation operation() const { return op; }
+    void setPagesPerStep(int pages);
+
+    void run() override;
+
+signals:
+    // Объём для VACUUM INTO оценивается по занятым страницам исходной базы
+    void progress(qint64 doneBytes, qint64 totalBytes, qint64 elapsedMs);
+    void finished(qint64 bytes, qint64 elapsedMs);
+    void cancelled();
+    void failed(const QString &message);
+
+private:
+    static constexpr int DefaultPagesPerStep = 1024;
+    static constexpr int BusyRetryMs = 50;
+    static constexpr int ProgressIntervalMs = 250;
+
+    static int progressHandler(void *context);
+
+    bool backup(sqlite3 *db, QString *error);
+    bool vacuumInto(sqlite3 *db, QString *error);
+    bool incrementalVacuum(sqlite3 *db, QString *error);
+    void reportProgress(qint64 doneBytes, bool force = false);
+
+    Operation op;
+    QString fileName;
+    QString sourceConnection;
+    int pagesPerStep = DefaultPagesPerStep;
+
+    QElapsedTimer timer;
+    qint64 lastProgressMs = 0;
+    qint64 totalBytes = 0;
+    qint64 processedBytes = 0;
+};
+
+#endif // DATABASEMAINTENANCE_H
@@ -0,0 +1,434 @@
+#include "databasesearch.h"
+#include "schemacatalog.h"
+#include <QElapsedTimer>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QThread>
+#include <QThreadPool>
+
+#include <sqlite3.h>
+
+#include <algorithm>
+
+static const QLatin1String IndexPrefix("cachedtable_fts_");
+
+static bool execSql(sqlite3 *db, const QString &sql, QString *error = nullptr)
+{
+    char *message = nullptr;
+    const int rc = sqlite3_exec(db, sql.toUtf8().constData(), nullptr, nullptr, &message);
+    if (rc != SQLITE_OK && error)
+        *error = QString::fromUtf8(message ? message : sqlite3_errmsg(db));
+    sqlite3_free(message);
+    return rc == SQLITE_OK;
+}
+
+// Сродство TEXT по правилам SQLite; в столбце без типа может лежать и текст
+static bool isTextColumn(const QString &type)
+{
+    const QString upper = type.toUpper();
+    if (upper.isEmpty())
+        return true;
+    if (upper.contains(QLatin1String("INT")))
+        return false;
+    return upper.contains(QLatin1String("CHAR")) || upper.contains(QLatin1String("CLOB"))
+           || upper.contains(QLatin1String("TEXT"));
+}
+
+static QVariant columnValue(sqlite3_stmt *stmt, int column)
+{
+    switch (sqlite3_column_type(stmt, column)) {
+    case SQLITE_INTEGER:
+        return qint64(sqlite3_column_int64(stmt, column));
+    case SQLITE_FLOAT:
+        return sqlite3_column_double(stmt, column);
+    case SQLITE_NULL:
+        return QVariant();
+    default:
+        return QString::fromUtf8(reinterpret_cast<const char *>(sqlite3_column_text(stmt, column)),
+                                 sqlite3_column_bytes(stmt, column));
+    }
+}
+
+// LIKE в SQLite не учитывает регистр только для латиницы,
+// поэтому кириллица и прочее ищутся через эту функцию
+static void containsFunction(sqlite3_context *context, int, sqlite3_value **argv)
+{
+    const auto *value = reinterpret_cast<const char *>(sqlite3_value_text(argv[0]));
+    const auto *needle = static_cast<const QString *>(sqlite3_user_data(context));
+    sqlite3_result_int(context, value && QString::fromUtf8(value, sqlite3_value_bytes(argv[0]))
+                                             .contains(*needle, Qt::CaseInsensitive));
+}
+
+// Столбцы существующего индекса; пусто, если индекса нет или потерян хоть один триггер
+static QStringList indexColumns(sqlite3 *db, const QString &index)
+{
+    QStringList columns;
+    sqlite3_stmt *stmt = nullptr;
+    const QByteArray sql = "SELECT (SELECT count(*) FROM sqlite_master WHERE type = 'trigger' AND name IN (?1, ?2, ?3)), "
+                           "name FROM pragma_table_info(?4)";
+    if (sqlite3_prepare_v2(db, sql.constData(), -1, &stmt, nullptr) == SQLITE_OK) {
+        bindVariant(stmt, 1, index + QLatin1String("_ai"));
+        bindVariant(stmt, 2, index + QLatin1String("_ad"));
+        bindVariant(stmt, 3, index + QLatin1String("_au"));
+        bindVariant(stmt, 4, index);
+        while (sqlite3_step(stmt) == SQLITE_ROW) {
+            if (sqlite3_column_int(stmt, 0) != 3) {
+                columns.clear();
+                break;
+            }
+            columns << columnValue(stmt, 1).toString();
+        }
+    }
+    sqlite3_finalize(stmt);
+    return columns;
+}
+
+// Внешний контент: FTS5 хранит только триграммы и читает строки из самой таблицы,
+// триггеры держат индекс в актуальном состоянии при любых изменениях таблицы
+static bool createIndex(sqlite3 *db, const SearchTarget &target, QString *error)
+{
+    const QString index = DatabaseSearch::indexName(target.table);
+    const QString fts = quoteIdentifier(index);
+    const QString table = quoteIdentifier(target.table);
+
+    QStringList names;
+    QStringList newValues;
+    QStringList oldValues;
+    for (const QString &column : target.columns) {
+        names << quoteIdentifier(column);
+        newValues << QLatin1String("new.") + quoteIdentifier(column);
+        oldValues << QLatin1String("old.") + quoteIdentifier(column);
+    }
+    const QString columns = names.join(QLatin1String(", "));
+    const QString insertNew = QStringLiteral("INSERT INTO %1 (rowid, %2) VALUES (new.%3, %4);")
+                                  .arg(fts, columns, target.keyColumn, newValues.join(QLatin1String(", ")));
+    const QString deleteOld = QStringLiteral("INSERT INTO %1 (%1, rowid, %2) VALUES ('delete', old.%3, %4);")
+                                  .arg(fts, columns, target.keyColumn, oldValues.join(QLatin1String(", ")));
+
+    const QStringList statements = {
+        QStringLiteral("DROP TRIGGER IF EXISTS %1").arg(quoteIdentifier(index + QLatin1String("_ai"))),
+        QStringLiteral("DROP TRIGGER IF EXISTS %1").arg(quoteIdentifier(index + QLatin1String("_ad"))),
+        QStringLiteral("DROP TRIGGER IF EXISTS %1").arg(quoteIdentifier(index + QLatin1String("_au"))),
+        QStringLiteral("DROP TABLE IF EXISTS %1").arg(fts),
+        QStringLiteral("CREATE VIRTUAL TABLE %1 USING fts5(%2, content=%3, content_rowid=%4, tokenize='trigram')")
+            .arg(fts, columns, quoteString(target.table), quoteString(target.keyColumn)),
+        QStringLiteral("CREATE TRIGGER %1 AFTER INSERT ON %2 BEGIN %3 END")
+            .arg(quoteIdentifier(index + QLatin1String("_ai")), table, insertNew),
+        QStringLiteral("CREATE TRIGGER %1 AFTER DELETE ON %2 BEGIN %3 END")
+            .arg(quoteIdentifier(index + QLatin1String("_ad")), table, deleteOld),
+        QStringLiteral("CREATE TRIGGER %1 AFTER UPDATE ON %2 BEGIN %3 %4 END")
+            .arg(quoteIdentifier(index + QLatin1String("_au")), table, deleteOld, insertNew),
+        QStringLiteral("INSERT INTO %1 (%1) VALUES ('rebuild')").arg(fts),
+    };
+
+    if (!execSql(db, QStringLiteral("BEGIN IMMEDIATE"), error))
+        return false;
+    for (const QString &statement : statements) {
+        if (!execSql(db, statement, error)) {
+            execSql(db, QStringLiteral("ROLLBACK"));
+            return false;
+        }
+    }
+    if (!execSql(db, QStringLiteral("COMMIT"), error)) {
+        execSql(db, QStringLiteral("ROLLBACK"));
+        return false;
+    }
+    return true;
+}
+
+DatabaseSearch::DatabaseSearch(const QString &text, const QList<SearchTarget> &targets,
+                               const SearchOptions &options, const QString &sourceConnection, QObject *parent)
+    : BackgroundJob(parent),
+    text(text),
+    searchTargets(targets),
+    options(options),
+    sourceConnection(sourceConnection)
+{
+}
+
+QList<SearchTarget> DatabaseSearch::targets(const SchemaCatalog &catalog)
+{
+    QList<SearchTarget> result;
+    for (const QString &name : catalog.tableNames()) {
+        const TableInfo *table = catalog.table(name);
+        if (!table || isIndexTable(name))
+            continue;
+
+        SearchTarget target;
+        target.table = table->name;
+        for (const ColumnInfo &column : table->columns) {
+            if (isTextColumn(column.type))
+                target.columns << column.name;
+        }
+        if (target.columns.isEmpty())
+            continue;
+
+        // Ключ выбирается так же, как в PagedTableModel, чтобы по нему можно было открыть строку
+        const QStringList names = table->columnNames();
+        const QStringList primaryKey = table->primaryKey();
+        if (!table->withoutRowid) {
+            for (const QString &alias : { QStringLiteral("rowid"), QStringLiteral("_rowid_"), QStringLiteral("oid") }) {
+                if (!names.contains(alias, Qt::CaseInsensitive)) {
+                    target.keyColumn = alias;
+                    break;
+                }
+            }
+            target.indexable = !table->isVirtual && !target.keyColumn.isEmpty();
+        }
+        if (target.keyColumn.isEmpty() && primaryKey.size() == 1)
+            target.keyColumn = quoteIdentifier(primaryKey.first());
+
+        result << target;
+    }
+    return result;
+}
+
+bool DatabaseSearch::isIndexTable(const QString &name)
+{
+    return name.startsWith(IndexPrefix, Qt::CaseInsensitive);
+}
+
+QString DatabaseSearch::indexName(const QString &table)
+{
+    return IndexPrefix + table;
+}
+
+bool DatabaseSearch::dropIndexes(const QSqlDatabase &db, QString *error)
+{
+    // Теневые таблицы FTS5 удаляются вместе с виртуальной
+    QSqlQuery query(db);
+    QStringList statements;
+    if (query.exec(QStringLiteral("SELECT type, name FROM sqlite_master "
+                                  "WHERE name LIKE 'cachedtable\\_fts\\_%' ESCAPE '\\' "
+                                  "AND (type = 'trigger' OR sql LIKE 'CREATE VIRTUAL TABLE%')"))) {
+        while (query.next()) {
+            statements << QStringLiteral("DROP %1 IF EXISTS %2")
+                              .arg(query.value(0).toString() == QLatin1String("trigger") ? QStringLiteral("TRIGGER")
+                                                                                          : QStringLiteral("TABLE"),
+                                   quoteIdentifier(query.value(1).toString()));
+        }
+    }
+    if (query.lastError().isValid()) {
+        if (error)
+            *error = query.lastError().text();
+        return false;
+    }
+
+    QSqlDatabase database = db;
+    if (!database.transaction()) {
+        if (error)
+            *error = database.lastError().text();
+        return false;
+    }
+    for (const QString &statement : std::as_const(statements)) {
+        if (!query.exec(statement)) {
+            if (error)
+                *error = query.lastError().text();
+            database.rollback();
+            return false;
+        }
+    }
+    return database.commit();
+}
+
+void DatabaseSearch::run()
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    QList<bool> indexed(searchTargets.size(), false);
+    if (options.useIndexes && !searchTargets.isEmpty()) {
+        QString indexError;
+        if (!ensureIndexes(indexed, &indexError)) {
+            emit failed(indexError);
+            return;
+        }
+    }
+
+    // Таблицы разбирают рабочие потоки, у каждого своё соединение на всё время поиска
+    const int threads = qMin(options.threads > 0 ? options.threads : QThread::idealThreadCount(),
+                             int(searchTargets.size()));
+    if (threads > 0 && !isCancelled()) {
+        QThreadPool pool;
+        pool.setMaxThreadCount(threads);
+        for (int i = 0; i < threads; ++i)
+            pool.start([this, &indexed] { searchWorker(indexed); });
+        pool.waitForDone();
+    }
+
+    if (isCancelled())
+        emit cancelled();
+    else if (!errorText.isEmpty())
+        emit failed(errorText);
+    else
+        emit finished(totalMatches, int(searchTargets.size()), timer.elapsed());
+}
+
+int DatabaseSearch::progressHandler(void *context)
+{
+    return static_cast<DatabaseSearch *>(context)->isCancelled() ? 1 : 0;
+}
+
+bool DatabaseSearch::ensureIndexes(QList<bool> &indexed, QString *error)
+{
+    if (text.size() < MinIndexedLength) {
+        emit warning(tr("Строка короче %1 символов ищется без индексов").arg(MinIndexedLength));
+        return true;
+    }
+
+    ScopedConnection connection(sourceConnection, QStringLiteral("search_index"));
+    sqlite3 *db = connection.open() ? connection.handle() : nullptr;
+    if (!db) {
+        *error = connection.lastError().text();
+        return false;
+    }
+    interrupter.attach(db);
+
+    // Без FTS5 или токенизатора trigram (SQLite до 3.34) индексы не построить ни для одной таблицы
+    QString probeError;
+    if (!execSql(db, QStringLiteral("CREATE VIRTUAL TABLE temp.cachedtable_fts_probe USING fts5(x, tokenize='trigram')"),
+                 &probeError)) {
+        interrupter.detach();
+        emit warning(tr("FTS5-индексы недоступны, таблицы будут просмотрены целиком:\n%1").arg(probeError));
+        return true;
+    }
+    execSql(db, QStringLiteral("DROP TABLE temp.cachedtable_fts_probe"));
+
+    for (qsizetype i = 0; i < searchTargets.size() && !isCancelled(); ++i) {
+        const SearchTarget &target = searchTargets.at(i);
+        if (!target.indexable)
+            continue;
+        if (indexColumns(db, indexName(target.table)) == target.columns) {
+            indexed[i] = true;
+            continue;
+        }
+
+        // Нового индекса нет или столбцы таблицы изменились - строим заново
+        emit indexing(target.table);
+        QString indexError;
+        if (createIndex(db, target, &indexError))
+            indexed[i] = true;
+        else if (!isCancelled())
+            emit warning(tr("Не удалось построить индекс для %1, таблица будет просмотрена целиком:\n%2")
+                             .arg(target.table, indexError));
+    }
+
+    interrupter.detach();
+    return true;
+}
+
+void DatabaseSearch::searchWorker(const QList<bool> &indexed)
+{
+    ScopedConnection connection(sourceConnection, QStringLiteral("search"));
+    sqlite3 *db = connection.open() ? connection.handle() : nullptr;
+    if (!db) {
+        setError(connection.lastError().text());
+        return;
+    }
+
+    // Отмена прерывает и долгий проход по таблице без совпадений
+    sqlite3_progress_handler(db, 10000, &DatabaseSearch::progressHandler, this);
+    sqlite3_create_function_v2(db, "cachedtable_contains", 1, SQLITE_UTF8 | SQLITE_DETERMINISTIC,
+                               &text, &containsFunction, nullptr, nullptr, nullptr);
+
+    for (int i = nextTarget++; i < searchTargets.size() && !isCancelled(); i = nextTarget++) {
+        const SearchTarget &target = searchTargets.at(i);
+        const qint64 matches = searchTable(db, target, indexed.at(i));
+        if (matches >= 0)
+            emit tableSearched(target.table, matches, indexed.at(i));
+    }
+
+    sqlite3_progress_handler(db, 0, nullptr, nullptr);
+}
+
+qint64 DatabaseSearch::searchTable(sqlite3 *db, const SearchTarget &target, bool useIndex)
+{
+    QStringList selected;
+    selected << (target.keyColumn.isEmpty() ? QStringLiteral("NULL") : target.keyColumn);
+    for (const QString &column : target.columns)
+        selected << quoteIdentifier(column);
+
+    QString sql;
+    QString parameter;
+    if (useIndex) {
+        // Ключ индексируемой таблицы - её rowid, он же rowid записи FTS5
+        const QString fts = quoteIdentifier(indexName(target.table));
+        selected.first() = QStringLiteral("rowid");
+        sql = QStringLiteral("SELECT %1 FROM %2 WHERE %2 MATCH ?1").arg(selected.join(QLatin1String(", ")), fts);
+        parameter = QLatin1Char('"') + QString(text).replace(QLatin1Char('"'), QLatin1String("\"\"")) + QLatin1Char('"');
+    } else {
+        const bool ascii = std::all_of(text.cbegin(), text.cend(), [](QChar c) { return c.unicode() < 128; });
+        QStringList conditions;
+        for (const QString &column : target.columns) {
+            conditions << (ascii ? quoteIdentifier(column) + QLatin1String(" LIKE ?1 ESCAPE '\\'")
+                                 : QStringLiteral("cachedtable_contains(%1)").arg(quoteIdentifier(column)));
+        }
+        sql = QStringLiteral("SELECT %1 FROM %2 WHERE %3")
+                  .arg(selected.join(QLatin1String(", ")), quoteIdentifier(target.table),
+                       conditions.join(QLatin1String(" OR ")));
+        if (ascii) {
+            QString pattern = text;
+            pattern.replace(QLatin1Char('\\'), QLatin1String("\\\\"))
+                .replace(QLatin1Char('%'), QLatin1String("\\%"))
+                .replace(QLatin1Char('_'), QLatin1String("\\_"));
+            parameter = QLatin1Char('%') + pattern + QLatin1Char('%');
+        }
+    }
+    sql += QStringLiteral(" LIMIT %1").arg(options.maxMatchesPerTable);
+
+    sqlite3_stmt *stmt = nullptr;
+    const QByteArray utf8 = sql.toUtf8();
+    if (sqlite3_prepare_v2(db, utf8.constData(), int(utf8.size()), &stmt, nullptr) != SQLITE_OK) {
+        emit warning(tr("Поиск в %1 пропущен:\n%2").arg(target.table, QString::fromUtf8(sqlite3_errmsg(db))));
+        return 0;
+    }
+    if (sqlite3_bind_parameter_count(stmt) > 0)
+        bindVariant(stmt, 1, parameter);
+
+    QList<SearchMatch> batch;
+    qint64 matches = 0;
+    int rc;
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        const QVariant key = columnValue(stmt, 0);
+        bool matched = false;
+        for (int i = 0; i < target.columns.size(); ++i) {
+            if (sqlite3_column_type(stmt, i + 1) == SQLITE_NULL)
+                continue;
+            const QString value = columnValue(stmt, i + 1).toString();
+            const qsizetype position = value.indexOf(text, 0, Qt::CaseInsensitive);
+            if (position < 0)
+                continue;
+
+            // Фрагмент вокруг совпадения, а не начало длинного текста
+            const qsizetype start = qMax<qsizetype>(0, position - MaxValueLength / 4);
+            const QString snippet = (start > 0 ? QStringLiteral("...") : QString()) + value.mid(start, MaxValueLength);
+            batch.append(SearchMatch { target.table, target.keyColumn, key, target.columns.at(i), snippet });
+            matched = true;
+        }
+        if (matched)
+            ++matches;
+        if (batch.size() >= MatchBatchSize) {
+            emit matchesFound(batch);
+            batch.clear();
+        }
+    }
+    const QString stepError = rc == SQLITE_DONE ? QString() : QString::fromUtf8(sqlite3_errmsg(db));
+    sqlite3_finalize(stmt);
+
+    if (!batch.isEmpty())
+        emit matchesFound(batch);
+    totalMatches += matches;
+
+    if (rc == SQLITE_INTERRUPT || isCancelled())
+        return -1;
+    if (rc != SQLITE_DONE)
+        emit warning(tr("Поиск в %1 прерван:\n%2").arg(target.table, stepError));
+    return matches;
+}
+
+void DatabaseSearch::setError(const QString &message)
+{
+    QMutexLocker locker(&errorMutex);
+    if (errorText.isEmpty())
+        errorText = message;
+}
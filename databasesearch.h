@@ -0,0 +1,98 @@
+#ifndef DATABASESEARCH_H
+#define DATABASESEARCH_H
+
+#include "backgroundjob.h"
+#include <QList>
+#include <QMutex>
+#include <QSqlDatabase>
+#include <QStringList>
+#include <QVariant>
+
+#include <atomic>
+
+class SchemaCatalog;
+
+// Таблица, в которой ищем: текстовые столбцы и ключ для перехода к строке
+struct SearchTarget
+{
+    QString table;
+    QString keyColumn;      // rowid-псевдоним или первичный ключ; пусто - строку не открыть
+    bool indexable = false; // обычная rowid-таблица: только к ней можно привязать FTS5
+    QStringList columns;
+};
+
+struct SearchMatch
+{
+    QString table;
+    QString keyColumn;
+    QVariant key;
+    QString column;
+    QString value;
+};
+
+struct SearchOptions
+{
+    // FTS5-индекс с триграммами на таблицу, поддерживается триггерами
+    bool useIndexes = false;
+    int maxMatchesPerTable = 1000;
+    int threads = 0;        // 0 - по числу ядер
+};
+
+// Поиск подстроки во всех текстовых столбцах всех таблиц.
+// Таблицы раздаются рабочим потокам, у каждого своё соединение для чтения;
+// найденное отдаётся порциями через matchesFound(). С useIndexes перед поиском
+// создаются (или пересоздаются при смене столбцов) FTS5-индексы, и таблицы с
+// индексом ищутся через MATCH вместо полного прохода.
+class DatabaseSearch : public BackgroundJob
+{
+    Q_OBJECT
+
+public:
+    DatabaseSearch(const QString &text, const QList<SearchTarget> &targets,
+                   const SearchOptions &options = SearchOptions(),
+                   const QString &sourceConnection = QString::fromLatin1(QSqlDatabase::defaultConnection),
+                   QObject *parent = nullptr);
+
+    void run() override;
+
+    // Все таблицы, кроме служебных, с текстовыми столбцами
+    static QList<SearchTarget> targets(const SchemaCatalog &catalog);
+    static bool isIndexTable(const QString &name);
+    static QString indexName(const QString &table);
+    // Удаляет все FTS5-индексы поиска вместе с триггерами
+    static bool dropIndexes(const QSqlDatabase &db, QString *error = nullptr);
+
+signals:
+    void indexing(const QString &table);
+    void matchesFound(const QList<SearchMatch> &matches);
+    void tableSearched(const QString &table, qint64 matches, bool usedIndex);
+    void warning(const QString &message);
+    void finished(qint64 matches, int tables, qint64 elapsedMs);
+    void cancelled();
+    void failed(const QString &message);
+
+private:
+    static constexpr int MatchBatchSize = 100;
+    static constexpr int MaxValueLength = 200;
+    // Короче трёх символов триграммный индекс не ищет
+    static constexpr int MinIndexedLength = 3;
+
+    static int progressHandler(void *context);
+
+    bool ensureIndexes(QList<bool> &indexed, QString *error);
+    void searchWorker(const QList<bool> &indexed);
+    qint64 searchTable(sqlite3 *db, const SearchTarget &target, bool useIndex);
+    void setError(const QString &message);
+
+    QString text;
+    QList<SearchTarget> searchTargets;
+    SearchOptions options;
+    QString sourceConnection;
+
+    std::atomic<int> nextTarget { 0 };
+    std::atomic<qint64> totalMatches { 0 };
+    QMutex errorMutex;
+    QString errorText;
+};
+
+#endif // DATABASESEARCH_H
@@ -0,0 +1,12 @@
+# Операции с данными без виджетов: общие для GUI и пакетного режима
+QT += sql
+SOURCES += backgroundjob.cpp batchsubmitter.cpp changetracker.cpp columnarexporter.cpp columnarformat.cpp columnarimporter.cpp columnprofiler.cpp commandline.cpp connectionprofile.cpp csvexporter.cpp csvimporter.cpp csvparser.cpp databasemaintenance.cpp databasesearch.cpp indexbuilder.cpp pagedtablemodel.cpp queryprofile.cpp queryresultmodel.cpp queryworker.cpp recentdatabases.cpp resultcache.cpp resultset.cpp schemacatalog.cpp scriptrunner.cpp sqlitestatement.cpp sqliteutil.cpp statementcache.cpp tableclipboard.cpp tablecopier.cpp
+HEADERS += backgroundjob.h batchsubmitter.h changetracker.h columnarexporter.h columnarformat.h columnarimporter.h columnprofiler.h commandline.h connectionprofile.h csvexporter.h csvimporter.h csvparser.h databasemaintenance.h databasesearch.h indexbuilder.h pagedtablemodel.h queryprofile.h queryresultmodel.h queryworker.h recentdatabases.h resultcache.h resultset.h schemacatalog.h scriptrunner.h sqlitestatement.h sqliteutil.h statementcache.h tableclipboard.h tablecopier.h
+LIBS += -lsqlite3
+# Сжатие колоночных дампов: qmake CONFIG+=zstd
+zstd {
+    DEFINES += CACHEDTABLE_WITH_ZSTD
+    LIBS += -lzstd
+}
+# SQLite собран с SQLITE_ENABLE_SNAPSHOT: qmake CONFIG+=sqlite_snapshot
+sqlite_snapshot: DEFINES += CACHEDTABLE_WITH_SNAPSHOT
@@ -0,0 +1,72 @@
+#include "indexbuilder.h"
+#include <QElapsedTimer>
+
+#include <sqlite3.h>
+
+static bool nameTaken(sqlite3 *db, const QByteArray &name)
+{
+    sqlite3_stmt *stmt = nullptr;
+    bool taken = false;
+    if (sqlite3_prepare_v2(db, "SELECT 1 FROM main.sqlite_master WHERE lower(name) = lower(?)",
+                           -1, &stmt, nullptr) == SQLITE_OK) {
+        sqlite3_bind_text(stmt, 1, name.constData(), int(name.size()), SQLITE_TRANSIENT);
+        taken = sqlite3_step(stmt) == SQLITE_ROW;
+    }
+    sqlite3_finalize(stmt);
+    return taken;
+}
+
+IndexBuilder::IndexBuilder(const QString &table, const QString &column,
+                           const QString &sourceConnection, QObject *parent)
+    : BackgroundJob(parent),
+    table(table),
+    column(column),
+    sourceConnection(sourceConnection)
+{
+}
+
+void IndexBuilder::run()
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    ScopedConnection connection(sourceConnection, QStringLiteral("index"));
+    sqlite3 *db = connection.open() ? connection.handle() : nullptr;
+    if (!db) {
+        emit failed(connection.lastError().text());
+        return;
+    }
+    interrupter.attach(db);
+
+    // Выбор имени и создание в одной транзакции записи: никто не займёт имя между ними
+    QString errorText;
+    QString indexName = QStringLiteral("idx_%1_%2").arg(table, column);
+    int rc = sqlite3_exec(db, "BEGIN IMMEDIATE", nullptr, nullptr, nullptr);
+    if (rc == SQLITE_OK) {
+        const QString baseName = indexName;
+        for (int suffix = 2; nameTaken(db, indexName.toUtf8()); ++suffix)
+            indexName = baseName + QLatin1Char('_') + QString::number(suffix);
+
+        // Индекс по столбцу неявно хранит rowid (или первичный ключ), то есть покрывает ORDER BY столбец, ключ
+        const QByteArray sql = QStringLiteral("CREATE INDEX %1 ON %2 (%3)")
+                                   .arg(quoteIdentifier(indexName), quoteIdentifier(table), quoteIdentifier(column))
+                                   .toUtf8();
+        rc = sqlite3_exec(db, sql.constData(), nullptr, nullptr, nullptr);
+        if (rc == SQLITE_OK)
+            rc = sqlite3_exec(db, "COMMIT", nullptr, nullptr, nullptr);
+        if (rc != SQLITE_OK) {
+            errorText = QString::fromUtf8(sqlite3_errmsg(db));
+            sqlite3_exec(db, "ROLLBACK", nullptr, nullptr, nullptr);
+        }
+    } else {
+        errorText = QString::fromUtf8(sqlite3_errmsg(db));
+    }
+    interrupter.detach();
+
+    if (isCancelled())
+        emit cancelled();
+    else if (!errorText.isEmpty())
+        emit failed(errorText);
+    else
+        emit finished(indexName, timer.elapsed());
+}
@@ -0,0 +1,32 @@
+#ifndef INDEXBUILDER_H
+#define INDEXBUILDER_H
+
+#include "backgroundjob.h"
+#include <QSqlDatabase>
+
+// Создание индекса по одному столбцу на собственном соединении.
+// Имя idx_<таблица>_<столбец> может быть занято индексом по другому столбцу,
+// поэтому к нему добавляется номер до первого свободного.
+class IndexBuilder : public BackgroundJob
+{
+    Q_OBJECT
+
+public:
+    IndexBuilder(const QString &table, const QString &column,
+                 const QString &sourceConnection = QString::fromLatin1(QSqlDatabase::defaultConnection),
+                 QObject *parent = nullptr);
+
+    void run() override;
+
+signals:
+    void finished(const QString &indexName, qint64 elapsedMs);
+    void cancelled();
+    void failed(const QString &message);
+
+private:
+    QString table;
+    QString column;
+    QString sourceConnection;
+};
+
+#endif // INDEXBUILDER_H
@@ -1,4 +1,5 @@
 // main.cpp
+#include "commandline.h"
 #include "databaseadmin.h"
 #include <QApplication>
 #include <QMessageBox>
@@ -6,6 +7,12 @@
 
 int main(int argc, char *argv[])
 {
+    // Пакетный режим: без QApplication, поэтому не нужен дисплей
+    if (CommandLine::isRequested(argc, argv)) {
+        QCoreApplication app(argc, argv);
+        return CommandLine().run(app.arguments());
+    }
+
     QApplication a(argc, argv);
 
 
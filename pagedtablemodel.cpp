@@ -0,0 +1,1318 @@
+#include "pagedtablemodel.h"
+#include "batchsubmitter.h"
+#include "changetracker.h"
+#include "sqliteutil.h"
+#include "sqlitestatement.h"
+#include "statementcache.h"
+#include <QPromise>
+#include <QSet>
+#include <QSqlQuery>
+#include <QThreadPool>
+#include <QTimer>
+
+#include <sqlite3.h>
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+static int clampRowCount(qint64 rows)
+{
+    return int(qBound<qint64>(0, rows, std::numeric_limits<int>::max()));
+}
+
+namespace {
+
+// Значения первичного ключа по классам хранения SQLite, как их привязал бы
+// bindVariant(); NULL ни с одной строкой не совпадёт, его нет
+struct TypedKeys
+{
+    std::vector<qint64> integers;
+    std::vector<double> reals;
+    QList<QByteArray> texts;
+    QList<QByteArray> blobs;
+};
+
+}
+
+static TypedKeys splitKeys(const QVariantList &keys)
+{
+    TypedKeys typed;
+    for (const QVariant &key : keys) {
+        if (key.isNull())
+            continue;
+        switch (key.typeId()) {
+        case QMetaType::Bool:
+        case QMetaType::Int:
+        case QMetaType::UInt:
+        case QMetaType::LongLong:
+        case QMetaType::ULongLong:
+            typed.integers.push_back(key.toLongLong());
+            break;
+        case QMetaType::Double:
+        case QMetaType::Float:
+            typed.reals.push_back(key.toDouble());
+            break;
+        case QMetaType::QByteArray:
+            typed.blobs << key.toByteArray();
+            break;
+        default:
+            typed.texts << key.toString().toUtf8();
+            break;
+        }
+    }
+    return typed;
+}
+
+// Перегрузку bind() выбирает тип элемента, во время компиляции
+template <typename Keys>
+static bool insertKeys(SqliteStatement &insert, const Keys &keys)
+{
+    for (const auto &key : keys) {
+        if (!insert.bindAll(key) || !insert.exec())
+            return false;
+    }
+    return true;
+}
+
+PagedTableModel::PagedTableModel(QObject *parent, const QString &connectionName)
+    : QAbstractTableModel(parent),
+    connectionName(connectionName),
+    countWatcher(new QFutureWatcher<qint64>(this))
+{
+    connect(countWatcher, &QFutureWatcher<qint64>::finished, this, &PagedTableModel::onRowCountReady);
+}
+
+PagedTableModel::~PagedTableModel()
+{
+    if (countInterrupter)
+        countInterrupter->interrupt();
+    unsubscribeChanges();
+}
+
+QSqlDatabase PagedTableModel::database() const
+{
+    return QSqlDatabase::database(connectionName);
+}
+
+void PagedTableModel::setTable(const QString &tableName)
+{
+    table = tableName;
+    filterText.clear();
+    columnFilters.clear();
+    orderByText.clear();
+    sortColumn = -1;
+    sortOrder = Qt::AscendingOrder;
+}
+
+QString PagedTableModel::tableName() const
+{
+    return table;
+}
+
+void PagedTableModel::setFilter(const QString &filter)
+{
+    filterText = filter;
+}
+
+QString PagedTableModel::filter() const
+{
+    return filterText;
+}
+
+// Оператор сравнения в начале текста фильтра; длинные проверяются первыми
+static QString filterOperator(const QString &text)
+{
+    static const char *const operators[] = { "<=", ">=", "!=", "<>", "=", "<", ">" };
+    for (const char *op : operators) {
+        if (text.startsWith(QLatin1String(op)))
+            return QLatin1String(op);
+    }
+    return QString();
+}
+
+void PagedTableModel::setColumnFilter(int column, const QString &text)
+{
+    if (text.trimmed().isEmpty())
+        columnFilters.remove(column);
+    else
+        columnFilters.insert(column, text.trimmed());
+}
+
+QString PagedTableModel::columnFilter(int column) const
+{
+    return columnFilters.value(column);
+}
+
+void PagedTableModel::clearColumnFilters()
+{
+    columnFilters.clear();
+}
+
+bool PagedTableModel::isComparisonFilter(const QString &text)
+{
+    return !filterOperator(text.trimmed()).isEmpty();
+}
+
+void PagedTableModel::setSort(int column, Qt::SortOrder order)
+{
+    sortColumn = column;
+    sortOrder = order;
+    orderByText.clear();
+}
+
+void PagedTableModel::setOrderByClause(const QString &clause)
+{
+    orderByText = clause;
+    sortColumn = -1;
+}
+
+QSqlError PagedTableModel::lastError() const
+{
+    return error;
+}
+
+QStringList PagedTableModel::columnNames() const
+{
+    return columns;
+}
+
+QString PagedTableModel::selectStatement() const
+{
+    // Текущая таблица с фильтром и сортировкой, но без служебного столбца ключа
+    QStringList list;
+    for (const QString &column : columns)
+        list << quoteIdentifier(column);
+    return QStringLiteral("SELECT %1 FROM %2%3%4")
+        .arg(list.join(QLatin1String(", ")), quoteIdentifier(table), whereClause(), orderClause());
+}
+
+QString PagedTableModel::rangeStatement(int first, int count, const QList<int> &columnList, QVariantList *binds) const
+{
+    QStringList list;
+    list << (keyExpression.isEmpty() ? QStringLiteral("NULL") : keyExpression);
+    for (int column : columnList)
+        list << quoteIdentifier(columns.at(column));
+
+    QString condition;
+    int offset = first;
+    if (isKeyset() && first > 0 && first <= committedRows) {
+        const int previous = first - 1;
+        const Page *page = fetchPage(previous / PageSize);
+        const int position = previous % PageSize;
+        if (position < page->keys.size()) {
+            const QVariant value = isSortedByColumn() ? page->rows.at(position).value(sortColumn) : QVariant();
+            condition = seekCondition(value, page->keys.at(position), true, binds);
+            offset = 0;
+        }
+    }
+
+    return QStringLiteral("SELECT %1 FROM %2%3%4 LIMIT %5 OFFSET %6")
+        .arg(list.join(QLatin1String(", ")), quoteIdentifier(table), whereClause(condition), orderClause())
+        .arg(count)
+        .arg(offset);
+}
+
+QString PagedTableModel::keyColumn() const
+{
+    return keyExpression;
+}
+
+bool PagedTableModel::isRowCountExact() const
+{
+    return rowCountExact;
+}
+
+bool PagedTableModel::loadSchema()
+{
+    columns.clear();
+    keyExpression.clear();
+
+    QSqlDatabase db = database();
+    QSqlQuery query(db);
+    if (!query.exec(QStringLiteral("PRAGMA table_info(%1)").arg(quoteIdentifier(table)))) {
+        error = query.lastError();
+        return false;
+    }
+
+    QStringList primaryKey;
+    while (query.next()) {
+        const QString name = query.value(1).toString();
+        columns << name;
+        if (query.value(5).toInt() > 0)
+            primaryKey << name;
+    }
+
+    if (columns.isEmpty()) {
+        error = QSqlError(tr("Таблица %1 не найдена").arg(table), QString(), QSqlError::StatementError);
+        return false;
+    }
+
+    QSqlQuery typeQuery(db);
+    typeQuery.prepare(QStringLiteral("SELECT type FROM sqlite_master WHERE name = ?"));
+    typeQuery.addBindValue(table);
+    const bool isView = typeQuery.exec() && typeQuery.next() && typeQuery.value(0).toString() == QLatin1String("view");
+    if (isView)
+        return true;
+
+    // rowid может быть перекрыт одноимённым столбцом, поэтому берём первый свободный псевдоним;
+    // у таблиц WITHOUT ROWID его нет вовсе
+    for (const QString &alias : {QStringLiteral("rowid"), QStringLiteral("_rowid_"), QStringLiteral("oid")}) {
+        if (columns.contains(alias, Qt::CaseInsensitive))
+            continue;
+        QSqlQuery probe(db);
+        if (probe.exec(QStringLiteral("SELECT %1 FROM %2 LIMIT 0").arg(alias, quoteIdentifier(table))))
+            keyExpression = alias;
+        break;
+    }
+
+    if (keyExpression.isEmpty() && primaryKey.size() == 1)
+        keyExpression = quoteIdentifier(primaryKey.first());
+
+    return true;
+}
+
+bool PagedTableModel::isKeyset() const
+{
+    return !keyExpression.isEmpty() && orderByText.isEmpty();
+}
+
+bool PagedTableModel::isSortedByColumn() const
+{
+    return orderByText.isEmpty() && sortColumn >= 0 && sortColumn < columns.size();
+}
+
+QString PagedTableModel::selectColumns() const
+{
+    QStringList list;
+    if (!keyExpression.isEmpty())
+        list << keyExpression;
+    for (const QString &column : columns)
+        list << quoteIdentifier(column);
+    return list.join(QLatin1String(", "));
+}
+
+QString PagedTableModel::columnFilterCondition(int column, const QString &text) const
+{
+    const QString name = quoteIdentifier(columns.at(column));
+    const QString op = filterOperator(text);
+
+    if (op.isEmpty()) {
+        QString pattern = text;
+        pattern.replace(QLatin1Char('\\'), QLatin1String("\\\\"))
+            .replace(QLatin1Char('%'), QLatin1String("\\%"))
+            .replace(QLatin1Char('_'), QLatin1String("\\_"));
+        return QStringLiteral("%1 LIKE %2 ESCAPE '\\'")
+            .arg(name, quoteString(QLatin1Char('%') + pattern + QLatin1Char('%')));
+    }
+
+    const QString operand = text.mid(op.size()).trimmed();
+    if (operand.compare(QLatin1String("NULL"), Qt::CaseInsensitive) == 0) {
+        if (op == QLatin1String("="))
+            return name + QLatin1String(" IS NULL");
+        if (op == QLatin1String("!=") || op == QLatin1String("<>"))
+            return name + QLatin1String(" IS NOT NULL");
+    }
+
+    // Числа подставляются как числа, чтобы сравнение шло по значению и могло использовать индекс
+    bool isNumber = false;
+    const double number = operand.toDouble(&isNumber);
+    isNumber = isNumber && qIsFinite(number);
+    return QStringLiteral("%1 %2 %3").arg(name, op, isNumber ? operand : quoteString(operand));
+}
+
+QString PagedTableModel::whereClause(const QString &extra) const
+{
+    QStringList conditions;
+    if (!filterText.isEmpty())
+        conditions << QLatin1Char('(') + filterText + QLatin1Char(')');
+    for (auto it = columnFilters.cbegin(); it != columnFilters.cend(); ++it) {
+        if (it.key() < columns.size())
+            conditions << columnFilterCondition(it.key(), it.value());
+    }
+    if (!extra.isEmpty())
+        conditions << extra;
+    return conditions.isEmpty() ? QString() : QLatin1String(" WHERE ") + conditions.join(QLatin1String(" AND "));
+}
+
+QString PagedTableModel::orderClause(bool reversed) const
+{
+    // reversed нужен только keyset-чтению с конца, произвольный ORDER BY не переворачивается
+    const bool descending = (isSortedByColumn() && sortOrder == Qt::DescendingOrder) != reversed;
+    const QLatin1String direction = descending ? QLatin1String(" DESC") : QLatin1String(" ASC");
+
+    QString order;
+    if (!orderByText.isEmpty())
+        order = orderByText;
+    else if (isSortedByColumn())
+        order = quoteIdentifier(columns.at(sortColumn)) + direction;
+
+    // Ключ в конце делает порядок строк однозначным; направление у него то же,
+    // что у столбца, чтобы keyset мог сравнивать пару (столбец, ключ) целиком
+    if (!keyExpression.isEmpty()) {
+        const QString key = orderByText.isEmpty() ? keyExpression + direction : keyExpression;
+        order = order.isEmpty() ? key : order + QLatin1String(", ") + key;
+    }
+
+    return order.isEmpty() ? QString() : QLatin1String(" ORDER BY ") + order;
+}
+
+QString PagedTableModel::pageStatement(const QString &condition, bool reversed) const
+{
+    // LIMIT и OFFSET - параметры, чтобы все страницы шли через один подготовленный запрос
+    return QStringLiteral("SELECT %1 FROM %2%3%4 LIMIT ? OFFSET ?")
+        .arg(selectColumns(), quoteIdentifier(table), whereClause(condition), orderClause(reversed));
+}
+
+QString PagedTableModel::seekCondition(const QVariant &value, const QVariant &key, bool after, QVariantList *binds) const
+{
+    // "После" в порядке показа при DESC означает "меньше" в порядке индекса
+    const bool greater = after != (isSortedByColumn() && sortOrder == Qt::DescendingOrder);
+    const QString op = greater ? QStringLiteral(">") : QStringLiteral("<");
+
+    if (!isSortedByColumn()) {
+        *binds << key;
+        return QStringLiteral("%1 %2 ?").arg(keyExpression, op);
+    }
+
+    // NULL в SQLite меньше любого значения, а сравнение пары с NULL не истинно,
+    // поэтому строки с NULL в столбце сортировки добираются отдельным условием
+    const QString column = quoteIdentifier(columns.at(sortColumn));
+    if (value.isNull()) {
+        *binds << key;
+        return greater ? QStringLiteral("(%1 IS NULL AND %2 > ? OR %1 IS NOT NULL)").arg(column, keyExpression)
+                       : QStringLiteral("(%1 IS NULL AND %2 < ?)").arg(column, keyExpression);
+    }
+    *binds << value << key;
+    return greater ? QStringLiteral("(%1, %2) > (?, ?)").arg(column, keyExpression)
+                   : QStringLiteral("((%1, %2) < (?, ?) OR %1 IS NULL)").arg(column, keyExpression);
+}
+
+bool PagedTableModel::select()
+{
+    if (table.isEmpty())
+        return false;
+
+    beginResetModel();
+    resetCache();
+    pendingEdits.clear();
+    pendingInserts.clear();
+    committedRows = 0;
+    rowCountExact = false;
+    error = QSqlError();
+
+    // Подписка до чтения: всё, что изменится после, придёт из трекера
+    subscribeChanges();
+
+    bool ok = loadSchema();
+    if (ok) {
+        // Ошибки в фильтре или сортировке должны всплыть сразу, а не при прокрутке;
+        // заодно в кэше оказывается запрос первой страницы
+        ok = StatementCache::forConnection(connectionName).prepare(pageStatement(), &error) != nullptr;
+        if (ok)
+            committedRows = estimateRowCount();
+    }
+    if (!ok)
+        columns.clear();
+
+    endResetModel();
+
+    if (ok && !rowCountExact)
+        startRowCount();
+    return ok;
+}
+
+int PagedTableModel::estimateRowCount()
+{
+    QSqlDatabase db = database();
+
+    if (filterText.isEmpty() && columnFilters.isEmpty() && !keyExpression.isEmpty()) {
+        // Сначала статистика ANALYZE, если она есть
+        QSqlQuery statQuery(db);
+        statQuery.prepare(QStringLiteral("SELECT stat FROM sqlite_stat1 WHERE tbl = ? LIMIT 1"));
+        statQuery.addBindValue(table);
+        if (statQuery.exec() && statQuery.next()) {
+            const qint64 rows = statQuery.value(0).toString().section(QLatin1Char(' '), 0, 0).toLongLong();
+            if (rows > 0)
+                return clampRowCount(rows);
+        }
+
+        // Для rowid min/max читаются с краёв B-дерева без прохода по таблице
+        if (!keyExpression.startsWith(QLatin1Char('"'))) {
+            QSqlQuery spanQuery(db);
+            if (spanQuery.exec(QStringLiteral("SELECT min(%1), max(%1) FROM %2")
+                                   .arg(keyExpression, quoteIdentifier(table)))
+                && spanQuery.next()) {
+                if (spanQuery.value(0).isNull()) {
+                    rowCountExact = true;
+                    return 0;
+                }
+                return clampRowCount(spanQuery.value(1).toLongLong() - spanQuery.value(0).toLongLong() + 1);
+            }
+        }
+    }
+
+    // Иначе считаем не больше одной страницы: для маленьких выборок этого достаточно
+    QSqlQuery query(db);
+    if (query.exec(QStringLiteral("SELECT count(*) FROM (SELECT 1 FROM %1%2 LIMIT %3)")
+                       .arg(quoteIdentifier(table), whereClause(), QString::number(PageSize + 1)))
+        && query.next()) {
+        const int rows = query.value(0).toInt();
+        rowCountExact = rows <= PageSize;
+        return rows;
+    }
+
+    error = query.lastError();
+    return 0;
+}
+
+void PagedTableModel::startRowCount()
+{
+    if (countInterrupter)
+        countInterrupter->interrupt();
+
+    const QString sql = QStringLiteral("SELECT count(*) FROM %1%2").arg(quoteIdentifier(table), whereClause());
+    const QString connection = connectionName;
+    auto interrupter = std::make_shared<QueryInterrupter>();
+    auto promise = std::make_shared<QPromise<qint64>>();
+
+    countInterrupter = interrupter;
+    countWatcher->setFuture(promise->future());
+    promise->start();
+
+    // Повторный фильтр по неизменённым таблицам не пересчитывается
+    ResultCache &cache = ResultCache::forConnection(connectionName);
+    countKey = ResultCache::makeKey(sql);
+    ResultCache::Result cached;
+    if (cache.lookup(countKey, &cached) && !cached.rows.isEmpty()) {
+        countTables.reset();
+        promise->addResult(cached.rows.value(0, 0).toLongLong());
+        promise->finish();
+        return;
+    }
+    countTicket = cache.begin();
+    auto tables = std::make_shared<QStringList>();
+    countTables = tables;
+
+    QThreadPool::globalInstance()->start([promise, interrupter, connection, sql, tables] {
+        qint64 rows = -1;
+        {
+            ScopedConnection counter(connection, QStringLiteral("count"));
+            if (!interrupter->isInterrupted() && counter.open()) {
+                interrupter->attach(counter.handle());
+                QSqlQuery query(counter.database());
+                query.setForwardOnly(true);
+                ReadAuthorizer authorizer(counter.handle());
+                const bool prepared = query.prepare(sql);
+                authorizer.finish(prepared ? sqliteStatement(query) : nullptr);
+                if (prepared && query.exec() && query.next()) {
+                    rows = query.value(0).toLongLong();
+                    if (authorizer.isCacheable())
+                        *tables = authorizer.tables();
+                }
+                interrupter->detach();
+            }
+        }
+        promise->addResult(rows);
+        promise->finish();
+    });
+}
+
+void PagedTableModel::onRowCountReady()
+{
+    const QFuture<qint64> future = countWatcher->future();
+    if (future.resultCount() == 0 || future.result() < 0)
+        return;
+
+    if (countTables && !countTables->isEmpty()) {
+        ResultSet count(1);
+        count.appendRow(QVariantList { future.result() });
+        ResultCache::forConnection(connectionName)
+            .store(countTicket, countKey, *countTables, { { QStringLiteral("count(*)") }, count });
+    }
+    countTables.reset();
+
+    const int rows = clampRowCount(future.result());
+    rowCountExact = true;
+
+    // Страницы, прочитанные с конца таблицы, были привязаны к оценке
+    int boundary = committedRows;
+    bool dropped = false;
+    for (auto it = anchors.begin(); it != anchors.end();) {
+        if (it->fromEnd) {
+            boundary = qMin(boundary, it.key() * PageSize);
+            it = anchors.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    for (auto it = pages.begin(); it != pages.end();) {
+        if (it->fromEnd) {
+            boundary = qMin(boundary, it.key() * PageSize);
+            it = pages.erase(it);
+            dropped = true;
+        } else {
+            ++it;
+        }
+    }
+
+    if (rows != committedRows) {
+        const int delta = rows - committedRows;
+        QMap<int, RowEdit> shifted;
+        for (auto it = pendingEdits.cbegin(); it != pendingEdits.cend(); ++it) {
+            const int row = it.key() >= boundary ? it.key() + delta : it.key();
+            if (row >= 0 && row < rows)
+                shifted.insert(row, it.value());
+        }
+
+        if (delta > 0) {
+            beginInsertRows(QModelIndex(), committedRows, rows - 1);
+            committedRows = rows;
+            pendingEdits = shifted;
+            endInsertRows();
+        } else {
+            beginRemoveRows(QModelIndex(), rows, committedRows - 1);
+            committedRows = rows;
+            pendingEdits = shifted;
+            endRemoveRows();
+        }
+    }
+
+    if (dropped && rowCount() > 0)
+        emit dataChanged(index(0, 0), index(rowCount() - 1, columnCount() - 1));
+
+    emit rowCountRefined(rows);
+}
+
+void PagedTableModel::clear()
+{
+    if (countInterrupter)
+        countInterrupter->interrupt();
+    countInterrupter.reset();
+    unsubscribeChanges();
+
+    beginResetModel();
+    table.clear();
+    keyExpression.clear();
+    columns.clear();
+    filterText.clear();
+    columnFilters.clear();
+    orderByText.clear();
+    sortColumn = -1;
+    committedRows = 0;
+    rowCountExact = false;
+    resetCache();
+    pendingEdits.clear();
+    pendingInserts.clear();
+    error = QSqlError();
+    endResetModel();
+}
+
+bool PagedTableModel::refreshRows()
+{
+    if (table.isEmpty())
+        return false;
+
+    // Страницы можно перечитать только при прежнем наборе столбцов
+    QSqlQuery query(database());
+    if (!query.exec(QStringLiteral("PRAGMA table_info(%1)").arg(quoteIdentifier(table)))) {
+        error = query.lastError();
+        return false;
+    }
+    QStringList names;
+    while (query.next())
+        names << query.value(1).toString();
+    if (names != columns)
+        return select();
+
+    // Представление само запросит видимые строки; правки остаются на своих местах
+    resetCache();
+    if (rowCount() > 0)
+        emit dataChanged(index(0, 0), index(rowCount() - 1, columnCount() - 1));
+    startRowCount();
+    return true;
+}
+
+void PagedTableModel::resetCache()
+{
+    pages.clear();
+    anchors.clear();
+    useCounter = 0;
+}
+
+const PagedTableModel::Page *PagedTableModel::fetchPage(int pageIndex) const
+{
+    auto it = pages.find(pageIndex);
+    if (it == pages.end()) {
+        storePage(pageIndex, loadPage(pageIndex));
+        it = pages.find(pageIndex);
+    }
+    it->lastUse = ++useCounter;
+    return &it.value();
+}
+
+void PagedTableModel::storePage(int pageIndex, const Page &page) const
+{
+    if (pages.size() >= MaxCachedPages) {
+        auto oldest = pages.begin();
+        for (auto it = pages.begin(); it != pages.end(); ++it) {
+            if (it->lastUse < oldest->lastUse)
+                oldest = it;
+        }
+        pages.erase(oldest);
+    }
+    pages.insert(pageIndex, page);
+
+    // Границы страниц переживают вытеснение из LRU и служат точками входа для keyset
+    if (isKeyset() && !page.keys.isEmpty()) {
+        if (anchors.size() >= MaxAnchors)
+            anchors.clear();
+        Anchor anchor { page.keys.first(), page.keys.last(), QVariant(), QVariant(), page.fromEnd };
+        if (isSortedByColumn()) {
+            anchor.firstValue = page.rows.first().value(sortColumn);
+            anchor.lastValue = page.rows.last().value(sortColumn);
+        }
+        anchors.insert(pageIndex, anchor);
+    }
+}
+
+PagedTableModel::Page PagedTableModel::loadPage(int pageIndex) const
+{
+    Page page;
+    const int first = pageIndex * PageSize;
+    const int count = qMin(PageSize, committedRows - first);
+    if (count <= 0)
+        return page;
+
+    QString condition;
+    QVariantList binds;
+    int offset = 0;
+    bool reversed = false;
+
+    if (isKeyset()) {
+        const auto previous = anchors.constFind(pageIndex - 1);
+        const auto next = anchors.constFind(pageIndex + 1);
+        const int lastPage = (committedRows - 1) / PageSize;
+
+        if (pageIndex == 0) {
+            // С начала таблицы, без условия и смещения
+        } else if (previous != anchors.constEnd()) {
+            condition = seekCondition(previous->lastValue, previous->lastKey, true, &binds);
+            page.fromEnd = previous->fromEnd;
+        } else if (next != anchors.constEnd()) {
+            condition = seekCondition(next->firstValue, next->firstKey, false, &binds);
+            page.fromEnd = next->fromEnd;
+            reversed = true;
+        } else if (pageIndex == lastPage) {
+            // Конец таблицы читается с обратной стороны B-дерева без OFFSET
+            page.fromEnd = !rowCountExact;
+            reversed = true;
+        } else {
+            offset = first;
+        }
+    } else {
+        offset = first;
+    }
+
+    const std::shared_ptr<QSqlQuery> query =
+        StatementCache::forConnection(connectionName).prepare(pageStatement(condition, reversed), &error);
+    if (!query)
+        return page;
+
+    binds << count << offset;
+    for (int i = 0; i < binds.size(); ++i)
+        query->bindValue(i, binds.at(i));
+    if (!query->exec()) {
+        error = query->lastError();
+        return page;
+    }
+
+    const int keyOffset = keyExpression.isEmpty() ? 0 : 1;
+    while (query->next()) {
+        QVariantList row;
+        row.reserve(columns.size());
+        for (int i = 0; i < columns.size(); ++i)
+            row << query->value(i + keyOffset);
+        page.rows << row;
+        if (keyOffset)
+            page.keys << query->value(0);
+    }
+
+    if (reversed) {
+        std::reverse(page.rows.begin(), page.rows.end());
+        std::reverse(page.keys.begin(), page.keys.end());
+    }
+    return page;
+}
+
+QVariant PagedTableModel::rowKey(int row) const
+{
+    if (row < 0 || row >= committedRows || keyExpression.isEmpty())
+        return QVariant();
+
+    const auto edit = pendingEdits.constFind(row);
+    if (edit != pendingEdits.constEnd() && edit->key.isValid())
+        return edit->key;
+
+    return fetchPage(row / PageSize)->keys.value(row % PageSize);
+}
+
+int PagedTableModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : committedRows + pendingInserts.size();
+}
+
+int PagedTableModel::columnCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : columns.size();
+}
+
+QVariant PagedTableModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || (role != Qt::DisplayRole && role != Qt::EditRole))
+        return QVariant();
+
+    const int row = index.row();
+    const int column = index.column();
+
+    if (row >= committedRows)
+        return pendingInserts.value(row - committedRows).value(column);
+
+    const auto edit = pendingEdits.constFind(row);
+    if (edit != pendingEdits.constEnd() && edit->values.contains(column))
+        return edit->values.value(column);
+
+    const Page *page = fetchPage(row / PageSize);
+    const int rowInPage = row % PageSize;
+    if (rowInPage >= page->rows.size())
+        return QVariant();
+    return page->rows.at(rowInPage).value(column);
+}
+
+QVariant PagedTableModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (role != Qt::DisplayRole)
+        return QVariant();
+
+    if (orientation == Qt::Horizontal) {
+        const QString filter = columnFilters.value(section);
+        return filter.isEmpty() ? columns.value(section) : QStringLiteral("%1 [%2]").arg(columns.value(section), filter);
+    }
+
+    // Как в QSqlTableModel: вставленные, но не сохранённые строки помечаются звёздочкой
+    if (section >= committedRows)
+        return QStringLiteral("*");
+    return section + 1;
+}
+
+Qt::ItemFlags PagedTableModel::flags(const QModelIndex &index) const
+{
+    Qt::ItemFlags result = QAbstractTableModel::flags(index);
+    if (!index.isValid())
+        return result;
+
+    // Без ключа строку нельзя однозначно обновить
+    if (index.row() >= committedRows || !keyExpression.isEmpty())
+        result |= Qt::ItemIsEditable;
+    return result;
+}
+
+bool PagedTableModel::setData(const QModelIndex &index, const QVariant &value, int role)
+{
+    if (!index.isValid() || role != Qt::EditRole || index.column() >= columns.size())
+        return false;
+
+    const int row = index.row();
+    if (row >= committedRows) {
+        pendingInserts[row - committedRows].insert(index.column(), value);
+    } else {
+        if (keyExpression.isEmpty())
+            return false;
+        const QVariant key = rowKey(row);
+        if (!key.isValid())
+            return false;
+        RowEdit &edit = pendingEdits[row];
+        edit.key = key;
+        if (!edit.original.contains(index.column())) {
+            const Page *page = fetchPage(row / PageSize);
+            edit.original.insert(index.column(), page->rows.value(row % PageSize).value(index.column()));
+        }
+        edit.values.insert(index.column(), value);
+    }
+
+    emit dataChanged(index, index, {Qt::DisplayRole, Qt::EditRole});
+    return true;
+}
+
+bool PagedTableModel::insertRows(int row, int count, const QModelIndex &parent)
+{
+    // Новые строки, как и в QSqlTableModel, живут в модели до submitAll();
+    // здесь они всегда добавляются в конец
+    if (parent.isValid() || count <= 0 || row != rowCount() || columns.isEmpty())
+        return false;
+
+    beginInsertRows(QModelIndex(), row, row + count - 1);
+    for (int i = 0; i < count; ++i)
+        pendingInserts.append(QHash<int, QVariant>());
+    endInsertRows();
+    return true;
+}
+
+void PagedTableModel::sort(int column, Qt::SortOrder order)
+{
+    if (table.isEmpty())
+        return;
+
+    setSort(column, order);
+    select();
+}
+
+bool PagedTableModel::isDirty() const
+{
+    return !pendingEdits.isEmpty() || !pendingInserts.isEmpty();
+}
+
+bool PagedTableModel::submitAll()
+{
+    if (!isDirty())
+        return true;
+
+    std::unique_ptr<BatchSubmitter> submitter(createSubmitter());
+    bool ok = false;
+    connect(submitter.get(), &BatchSubmitter::finished, this, [&ok] { ok = true; });
+    connect(submitter.get(), &BatchSubmitter::conflicted, this, [this](const QList<int> &rows) {
+        QStringList numbers;
+        for (int row : rows.mid(0, 10))
+            numbers << QString::number(row + 1);
+        error = QSqlError(tr("Строки изменены или удалены другим соединением после загрузки: %1%2")
+                              .arg(numbers.join(QLatin1String(", ")), rows.size() > 10 ? QStringLiteral("...") : QString()),
+                          QString(), QSqlError::TransactionError);
+    });
+    connect(submitter.get(), &BatchSubmitter::failed, this, [this](const QString &message) {
+        error = QSqlError(message, QString(), QSqlError::TransactionError);
+    });
+    submitter->run();
+
+    return ok && select();
+}
+
+BatchSubmitter *PagedTableModel::createSubmitter(QObject *parent) const
+{
+    QList<RowChange> changes;
+    changes.reserve(pendingEdits.size() + pendingInserts.size());
+    for (auto it = pendingEdits.cbegin(); it != pendingEdits.cend(); ++it)
+        changes.append(RowChange { it.key(), it->key, it->values, it->original });
+    for (qsizetype i = 0; i < pendingInserts.size(); ++i)
+        changes.append(RowChange { committedRows + int(i), QVariant(), pendingInserts.at(i), {} });
+
+    return new BatchSubmitter(table, keyExpression, columns, changes, connectionName, parent);
+}
+
+bool PagedTableModel::deleteKeys(const QVariantList &keys)
+{
+    QSqlDatabase db = database();
+    sqlite3 *handle = sqliteHandle(db);
+    if (!handle) {
+        error = QSqlError(tr("Нет соединения с базой"), QString(), QSqlError::ConnectionError);
+        return false;
+    }
+    if (!db.transaction()) {
+        error = db.lastError();
+        return false;
+    }
+
+    // Ключи складываются во временную таблицу одним подготовленным запросом,
+    // а удаляются одним DELETE ... IN (SELECT ...)
+    QSqlQuery query(db);
+    bool ok = query.exec(QStringLiteral("CREATE TEMP TABLE IF NOT EXISTS cachedtable_deleted_keys (key PRIMARY KEY) WITHOUT ROWID"))
+              && query.exec(QStringLiteral("DELETE FROM temp.cachedtable_deleted_keys"));
+    if (!ok)
+        error = query.lastError();
+
+    if (ok) {
+        SqliteStatement insert(handle, QByteArrayLiteral("INSERT OR IGNORE INTO temp.cachedtable_deleted_keys VALUES (?)"),
+                               SqliteStatement::Persistent);
+        ok = insert.isValid();
+        // Вид ключа выбирается один раз; в циклах привязки нет разбора типа QVariant
+        if (ok && isRowidKey()) {
+            for (qsizetype i = 0; ok && i < keys.size(); ++i)
+                ok = insert.bindAll(keys.at(i).toLongLong()) && insert.exec();
+        } else if (ok) {
+            const TypedKeys typed = splitKeys(keys);
+            ok = insertKeys(insert, typed.integers) && insertKeys(insert, typed.reals)
+                 && insertKeys(insert, typed.texts);
+            for (qsizetype i = 0; ok && i < typed.blobs.size(); ++i) {
+                const QByteArray &blob = typed.blobs.at(i);
+                ok = insert.bindBlob(1, blob.constData(), int(blob.size())) && insert.exec();
+            }
+        }
+        if (!ok)
+            error = QSqlError(insert.errorText(), QString(), QSqlError::StatementError);
+    }
+
+    if (ok) {
+        ok = query.exec(QStringLiteral("DELETE FROM %1 WHERE %2 IN (SELECT key FROM temp.cachedtable_deleted_keys)")
+                            .arg(quoteIdentifier(table), keyExpression))
+             && query.exec(QStringLiteral("DELETE FROM temp.cachedtable_deleted_keys"));
+        if (!ok)
+            error = query.lastError();
+    }
+
+    if (!ok || !db.commit()) {
+        if (ok)
+            error = db.lastError();
+        db.rollback();
+        return false;
+    }
+    return true;
+}
+
+bool PagedTableModel::deleteRows(const QList<int> &rowList)
+{
+    QList<int> rows;
+    for (int row : rowList) {
+        if (row >= 0 && row < rowCount())
+            rows << row;
+    }
+    std::sort(rows.begin(), rows.end());
+    rows.erase(std::unique(rows.begin(), rows.end()), rows.end());
+    if (rows.isEmpty())
+        return true;
+
+    const auto firstInsert = std::lower_bound(rows.cbegin(), rows.cend(), committedRows);
+    if (firstInsert != rows.cbegin()) {
+        if (keyExpression.isEmpty()) {
+            error = QSqlError(tr("У %1 нет первичного ключа или rowid, строки нельзя удалить").arg(table),
+                              QString(), QSqlError::StatementError);
+            return false;
+        }
+
+        QVariantList keys;
+        keys.reserve(firstInsert - rows.cbegin());
+        for (auto it = rows.cbegin(); it != firstInsert; ++it) {
+            const QVariant key = rowKey(*it);
+            if (!key.isValid()) {
+                error = QSqlError(tr("Не удалось определить ключ строки %1").arg(*it + 1),
+                                  QString(), QSqlError::StatementError);
+                return false;
+            }
+            keys << key;
+        }
+
+        if (!deleteKeys(keys))
+            return false;
+
+        // Эти строки модель убирает сама, трекер не должен вычесть их второй раз
+        if (const std::shared_ptr<ChangeTracker> tracker = changeTracker.lock(); tracker && isRowidKey()) {
+            QList<qint64> rowids;
+            rowids.reserve(keys.size());
+            for (const QVariant &key : std::as_const(keys))
+                rowids << key.toLongLong();
+            tracker->forget(changeSubscription, rowids);
+        }
+    }
+
+    // Новый номер строки = старый минус число удалённых строк перед ней
+    auto shiftedRow = [&rows](int row) {
+        return row - int(std::lower_bound(rows.cbegin(), rows.cend(), row) - rows.cbegin());
+    };
+
+    // Уцелевшие строки из кэша переносятся на новые позиции, чтобы видимая
+    // часть таблицы не перечитывалась
+    QMap<int, QPair<QVariant, QVariantList>> survivors;
+    for (auto page = pages.cbegin(); page != pages.cend(); ++page) {
+        if (page->fromEnd)
+            continue;
+        for (qsizetype i = 0; i < page->rows.size(); ++i) {
+            const int row = page.key() * PageSize + int(i);
+            if (!std::binary_search(rows.cbegin(), rows.cend(), row))
+                survivors.insert(shiftedRow(row), qMakePair(page->keys.value(i), page->rows.at(i)));
+        }
+    }
+
+    QMap<int, RowEdit> shiftedEdits;
+    for (auto it = pendingEdits.cbegin(); it != pendingEdits.cend(); ++it) {
+        if (!std::binary_search(rows.cbegin(), rows.cend(), it.key()))
+            shiftedEdits.insert(shiftedRow(it.key()), it.value());
+    }
+
+    // Непрерывные диапазоны снимаем снизу вверх, чтобы номера выше не сдвигались;
+    // при сильно разбросанном выделении дешевле один сброс модели
+    QList<QPair<int, int>> ranges;
+    for (int row : rows) {
+        if (!ranges.isEmpty() && ranges.last().second + 1 == row)
+            ranges.last().second = row;
+        else
+            ranges << qMakePair(row, row);
+    }
+
+    const bool reset = ranges.size() > MaxRemoveSignals;
+    if (reset)
+        beginResetModel();
+
+    resetCache();
+    for (auto range = ranges.crbegin(); range != ranges.crend(); ++range) {
+        if (!reset)
+            beginRemoveRows(QModelIndex(), range->first, range->second);
+        for (int row = range->second; row >= range->first; --row) {
+            if (row >= committedRows)
+                pendingInserts.removeAt(row - committedRows);
+        }
+        committedRows -= qBound(0, qMin(range->second + 1, committedRows) - range->first, committedRows);
+        if (!reset)
+            endRemoveRows();
+    }
+    pendingEdits = shiftedEdits;
+
+    // Собираем из уцелевших строк полные страницы новой нумерации
+    int pageIndex = survivors.isEmpty() ? 0 : survivors.firstKey() / PageSize;
+    const int lastPage = survivors.isEmpty() ? -1 : survivors.lastKey() / PageSize;
+    for (; pageIndex <= lastPage; ++pageIndex) {
+        const int first = pageIndex * PageSize;
+        const int last = qMin(first + PageSize, committedRows);
+        if (last - first < PageSize && !rowCountExact)
+            continue;
+
+        Page page;
+        for (int row = first; row < last; ++row) {
+            const auto it = survivors.constFind(row);
+            if (it == survivors.cend())
+                break;
+            page.keys << it->first;
+            page.rows << it->second;
+        }
+        if (page.rows.size() == last - first && !page.rows.isEmpty())
+            storePage(pageIndex, page);
+    }
+
+    if (reset)
+        endResetModel();
+
+    // Подсчёт, начатый до удаления, вернул бы старое число строк
+    if (!rowCountExact)
+        startRowCount();
+    return true;
+}
+
+void PagedTableModel::revertAll()
+{
+    if (!pendingInserts.isEmpty()) {
+        beginRemoveRows(QModelIndex(), committedRows, committedRows + pendingInserts.size() - 1);
+        pendingInserts.clear();
+        endRemoveRows();
+    }
+
+    const QList<int> rows = pendingEdits.keys();
+    pendingEdits.clear();
+    for (int row : rows)
+        emit dataChanged(index(row, 0), index(row, columnCount() - 1));
+}
+
+bool PagedTableModel::isRowidKey() const
+{
+    return !keyExpression.isEmpty() && !keyExpression.startsWith(QLatin1Char('"'));
+}
+
+void PagedTableModel::setChangeTracking(bool enabled)
+{
+    if (enabled == (changeTimer != nullptr))
+        return;
+
+    if (enabled) {
+        changeTimer = new QTimer(this);
+        changeTimer->setInterval(ChangePollInterval);
+        connect(changeTimer, &QTimer::timeout, this, &PagedTableModel::pollChanges);
+        changeTimer->start();
+        subscribeChanges();
+    } else {
+        delete changeTimer;
+        changeTimer = nullptr;
+        unsubscribeChanges();
+    }
+}
+
+void PagedTableModel::subscribeChanges()
+{
+    unsubscribeChanges();
+    if (!changeTimer || table.isEmpty())
+        return;
+
+    const std::shared_ptr<ChangeTracker> tracker = ChangeTracker::forConnection(connectionName);
+    if (!tracker)
+        return;
+    changeTracker = tracker;
+    changeSubscription = tracker->subscribe(table);
+}
+
+void PagedTableModel::unsubscribeChanges()
+{
+    if (const std::shared_ptr<ChangeTracker> tracker = changeTracker.lock())
+        tracker->unsubscribe(changeSubscription);
+    changeTracker.reset();
+    changeSubscription = 0;
+}
+
+void PagedTableModel::pollChanges()
+{
+    // Несохранённые правки привязаны к номерам строк, поэтому, пока они есть,
+    // изменения копятся в трекере
+    if (table.isEmpty() || columns.isEmpty() || isDirty())
+        return;
+
+    const std::shared_ptr<ChangeTracker> tracker = ChangeTracker::forConnection(connectionName);
+    if (!tracker)
+        return;
+    if (tracker != changeTracker.lock()) {
+        // Соединение открыли заново
+        subscribeChanges();
+        return;
+    }
+
+    const TrackedChanges changes = tracker->take(changeSubscription);
+    if (changes.isEmpty())
+        return;
+
+    // Без списка строк остаётся перечитать то, что загружено
+    if (changes.overflow || changes.external || changes.schemaChanged || !isRowidKey())
+        refreshRows();
+    else
+        applyChanges(changes.rows);
+}
+
+int PagedTableModel::keyPosition(qint64 rowid) const
+{
+    // Место строки известно только в порядке rowid: первая страница,
+    // чья граница не меньше ключа, или последняя известная
+    if (!isKeyset() || isSortedByColumn())
+        return 0;
+
+    int page = -1;
+    int lastPage = -1;
+    for (auto it = anchors.cbegin(); it != anchors.cend(); ++it) {
+        lastPage = qMax(lastPage, it.key());
+        if (it->lastKey.toLongLong() >= rowid && (page < 0 || it.key() < page))
+            page = it.key();
+    }
+    return qMax(0, page >= 0 ? page : lastPage) * PageSize;
+}
+
+void PagedTableModel::applyChanges(const QHash<qint64, int> &changes)
+{
+    // Текущие значения изменённых строк, которые проходят фильтр
+    QHash<qint64, QVariantList> current;
+    const QList<qint64> rowids = changes.keys();
+    for (qsizetype start = 0; start < rowids.size(); start += ChangeBatchSize) {
+        QStringList list;
+        for (qint64 rowid : rowids.mid(start, ChangeBatchSize))
+            list << QString::number(rowid);
+
+        QSqlQuery query(database());
+        query.setForwardOnly(true);
+        if (!query.exec(QStringLiteral("SELECT %1 FROM %2%3")
+                            .arg(selectColumns(), quoteIdentifier(table),
+                                 whereClause(QStringLiteral("%1 IN (%2)").arg(keyExpression, list.join(QLatin1Char(',')))))) {
+            error = query.lastError();
+            return;
+        }
+        while (query.next()) {
+            QVariantList row;
+            row.reserve(columns.size());
+            for (int i = 0; i < columns.size(); ++i)
+                row << query.value(i + 1);
+            current.insert(query.value(0).toLongLong(), row);
+        }
+    }
+
+    int firstAffected = -1;
+    auto affect = [&firstAffected](int row) {
+        firstAffected = firstAffected < 0 ? row : qMin(firstAffected, row);
+    };
+    int delta = 0;
+    bool deltaKnown = true;
+    QList<int> patched;
+    QSet<qint64> cached;
+
+    // Загруженные строки: изменённые на месте обновляются, остальные сдвигают хвост
+    for (auto page = pages.begin(); page != pages.end(); ++page) {
+        for (qsizetype i = 0; i < page->keys.size(); ++i) {
+            const qint64 rowid = page->keys.at(i).toLongLong();
+            if (!changes.contains(rowid))
+                continue;
+            cached.insert(rowid);
+
+            const int row = page.key() * PageSize + int(i);
+            const auto it = current.constFind(rowid);
+            if (it == current.cend()) {
+                // Удалена или больше не проходит фильтр
+                --delta;
+                affect(row);
+            } else if (isSortedByColumn() && it->value(sortColumn) != page->rows.at(i).value(sortColumn)) {
+                // Переехала, а куда - неизвестно
+                affect(0);
+            } else {
+                page->rows[i] = *it;
+                patched << row;
+            }
+        }
+    }
+
+    // Строки вне кэша видны, только если меняют число строк или порядок
+    const bool filtered = !filterText.isEmpty() || !columnFilters.isEmpty();
+    for (auto it = changes.cbegin(); it != changes.cend(); ++it) {
+        if (cached.contains(it.key()))
+            continue;
+        const bool existed = it.value() & ChangeTracker::RowExisted;
+        const bool present = current.contains(it.key());
+        if (!existed && !present)
+            continue;
+
+        if (existed && filtered) {
+            // Неизвестно, проходила ли строка фильтр до изменения
+            deltaKnown = false;
+        } else {
+            delta += int(present) - int(existed);
+            if (existed && present && isKeyset() && !isSortedByColumn())
+                continue;
+        }
+        affect(keyPosition(it.key()));
+    }
+
+    if (firstAffected >= 0) {
+        // Страницы начиная с первой затронутой перечитаются при обращении
+        const int firstPage = firstAffected / PageSize;
+        for (auto it = pages.begin(); it != pages.end();) {
+            if (it.key() >= firstPage || it->fromEnd)
+                it = pages.erase(it);
+            else
+                ++it;
+        }
+        for (auto it = anchors.begin(); it != anchors.end();) {
+            if (it.key() >= firstPage || it->fromEnd)
+                it = anchors.erase(it);
+            else
+                ++it;
+        }
+
+        const int rows = qMax(0, committedRows + delta);
+        if (rows > committedRows) {
+            beginInsertRows(QModelIndex(), committedRows, rows - 1);
+            committedRows = rows;
+            endInsertRows();
+        } else if (rows < committedRows) {
+            beginRemoveRows(QModelIndex(), rows, committedRows - 1);
+            committedRows = rows;
+            endRemoveRows();
+        }
+        if (firstAffected < committedRows)
+            emit dataChanged(index(firstAffected, 0), index(committedRows - 1, columns.size() - 1));
+
+        // Подсчёт, начатый раньше, вернул бы старое число
+        if (!deltaKnown || (delta != 0 && countWatcher->isRunning()))
+            startRowCount();
+    }
+
+    for (int row : std::as_const(patched)) {
+        if (firstAffected < 0 || row < firstAffected)
+            emit dataChanged(index(row, 0), index(row, columns.size() - 1));
+    }
+}
@@ -0,0 +1,190 @@
+#ifndef PAGEDTABLEMODEL_H
+#define PAGEDTABLEMODEL_H
+
+#include "resultcache.h"
+#include <QAbstractTableModel>
+#include <QFutureWatcher>
+#include <QHash>
+#include <QMap>
+#include <QSqlDatabase>
+#include <QSqlError>
+#include <QStringList>
+#include <QVariantList>
+
+#include <memory>
+
+class BatchSubmitter;
+class ChangeTracker;
+class QueryInterrupter;
+class QTimer;
+
+// Модель для просмотра таблиц любого размера.
+// Строки подгружаются окнами по PageSize с keyset-пагинацией по rowid
+// (или единственному первичному ключу), при сортировке по столбцу — по паре
+// (столбец, ключ). В памяти хранится LRU из
+// MaxCachedPages страниц. Число строк сначала оценивается по концам
+// B-дерева, затем уточняется через count(*) в фоновом потоке.
+// Правки копятся до submitAll(), как в QSqlTableModel::OnManualSubmit.
+// С setChangeTracking() строки, изменённые в базе, берутся из ChangeTracker
+// и перечитываются точечно, без select().
+class PagedTableModel : public QAbstractTableModel
+{
+    Q_OBJECT
+
+public:
+    explicit PagedTableModel(QObject *parent = nullptr,
+                             const QString &connectionName = QString::fromLatin1(QSqlDatabase::defaultConnection));
+    ~PagedTableModel();
+
+    void setTable(const QString &tableName);
+    QString tableName() const;
+
+    void setFilter(const QString &filter);
+    QString filter() const;
+    // Быстрый фильтр по столбцу: "=v", "!=v", "<v", "<=v", ">v", ">=v"
+    // или подстрока; пустой текст снимает фильтр
+    void setColumnFilter(int column, const QString &text);
+    QString columnFilter(int column) const;
+    void clearColumnFilters();
+    // Сравнение может использовать индекс, поиск подстроки — нет
+    static bool isComparisonFilter(const QString &text);
+
+    void setSort(int column, Qt::SortOrder order);
+    void setOrderByClause(const QString &clause);
+
+    bool select();
+    void clear();
+    // Перечитывает загруженные строки и число строк, не сбрасывая модель
+    bool refreshRows();
+    void setChangeTracking(bool enabled);
+
+    // Сохраняет правки одной транзакцией; false и lastError(), в том числе
+    // если строки успели изменить другие соединения
+    bool submitAll();
+    void revertAll();
+    // Задача сохранения текущих правок для запуска в фоне; после её finished() нужен select()
+    BatchSubmitter *createSubmitter(QObject *parent = nullptr) const;
+
+    // Сразу удаляет строки из таблицы (несохранённые вставки — только из модели)
+    // и убирает их из представления без повторного select()
+    bool deleteRows(const QList<int> &rows);
+    bool isDirty() const;
+    QSqlError lastError() const;
+
+    QStringList columnNames() const;
+    QString selectStatement() const;
+    // Строки [first, first + count) в порядке показа: первым столбцом ключ (или NULL),
+    // затем столбцы columnList. Начало ищется по ключу предыдущей строки, а не через OFFSET.
+    // Несохранённые правки не учитываются
+    QString rangeStatement(int first, int count, const QList<int> &columnList, QVariantList *binds) const;
+    QSqlDatabase database() const;
+    QString keyColumn() const;
+    QVariant rowKey(int row) const;
+    bool isRowCountExact() const;
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation,
+                        int role = Qt::DisplayRole) const override;
+    Qt::ItemFlags flags(const QModelIndex &index) const override;
+    bool setData(const QModelIndex &index, const QVariant &value, int role = Qt::EditRole) override;
+    bool insertRows(int row, int count, const QModelIndex &parent = QModelIndex()) override;
+    void sort(int column, Qt::SortOrder order = Qt::AscendingOrder) override;
+
+signals:
+    void rowCountRefined(int rows);
+
+private slots:
+    void onRowCountReady();
+    void pollChanges();
+
+private:
+    struct Page
+    {
+        QVariantList keys;
+        QList<QVariantList> rows;
+        quint64 lastUse = 0;
+        bool fromEnd = false;
+    };
+
+    struct Anchor
+    {
+        QVariant firstKey;
+        QVariant lastKey;
+        QVariant firstValue;    // значения столбца сортировки на границах
+        QVariant lastValue;
+        bool fromEnd = false;
+    };
+
+    struct RowEdit
+    {
+        QVariant key;
+        QHash<int, QVariant> values;
+        QHash<int, QVariant> original;  // прочитанные значения для проверки конфликтов
+    };
+
+    bool loadSchema();
+    bool isKeyset() const;
+    bool isSortedByColumn() const;
+    QString selectColumns() const;
+    QString columnFilterCondition(int column, const QString &text) const;
+    QString whereClause(const QString &extra = QString()) const;
+    QString orderClause(bool reversed = false) const;
+    QString pageStatement(const QString &condition = QString(), bool reversed = false) const;
+    QString seekCondition(const QVariant &value, const QVariant &key, bool after, QVariantList *binds) const;
+    int estimateRowCount();
+    void startRowCount();
+    void resetCache();
+    bool deleteKeys(const QVariantList &keys);
+    bool isRowidKey() const;
+    void subscribeChanges();
+    void unsubscribeChanges();
+    void applyChanges(const QHash<qint64, int> &changes);
+    int keyPosition(qint64 rowid) const;
+
+    const Page *fetchPage(int pageIndex) const;
+    Page loadPage(int pageIndex) const;
+    void storePage(int pageIndex, const Page &page) const;
+
+    static constexpr int PageSize = 256;
+    static constexpr int MaxCachedPages = 64;
+    static constexpr int MaxAnchors = 65536;
+    static constexpr int MaxRemoveSignals = 256;
+    static constexpr int ChangePollInterval = 500;
+    static constexpr int ChangeBatchSize = 500;
+
+    QString connectionName;
+    QString table;
+    QString keyExpression;
+    QStringList columns;
+    QString filterText;
+    QMap<int, QString> columnFilters;
+    QString orderByText;
+    int sortColumn = -1;
+    Qt::SortOrder sortOrder = Qt::AscendingOrder;
+
+    int committedRows = 0;
+    bool rowCountExact = false;
+
+    mutable QHash<int, Page> pages;
+    mutable QHash<int, Anchor> anchors;
+    mutable quint64 useCounter = 0;
+    mutable QSqlError error;
+
+    QMap<int, RowEdit> pendingEdits;
+    QList<QHash<int, QVariant>> pendingInserts;
+
+    QFutureWatcher<qint64> *countWatcher;
+    std::shared_ptr<QueryInterrupter> countInterrupter;
+    // Подсчёт, результат которого сохранится в ResultCache; таблиц нет - не сохранять
+    QString countKey;
+    ResultCache::Ticket countTicket;
+    std::shared_ptr<QStringList> countTables;
+
+    QTimer *changeTimer = nullptr;
+    std::weak_ptr<ChangeTracker> changeTracker;
+    int changeSubscription = 0;
+};
+
+#endif // PAGEDTABLEMODEL_H
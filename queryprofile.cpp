@@ -0,0 +1,47 @@
+#include "queryprofile.h"
+
+bool QueryPlanStep::isFullScan() const
+{
+    // Формат до 3.36: "SCAN TABLE t", после: "SCAN t"; проход по индексу упоминает INDEX
+    return detail.startsWith(QLatin1String("SCAN "))
+           && !detail.contains(QLatin1String("INDEX"))
+           && !detail.contains(QLatin1String("CONSTANT ROW"));
+}
+
+bool QueryPlanStep::usesTempBTree() const
+{
+    return detail.contains(QLatin1String("USE TEMP B-TREE"));
+}
+
+QueryProfileHistory::QueryProfileHistory(int capacity)
+    : entries(size_t(qMax(1, capacity)))
+{
+}
+
+quint64 QueryProfileHistory::append(const QueryProfile &profile)
+{
+    entries[size_t(count % entries.size())] = profile;
+    return ++count;
+}
+
+const QueryProfile *QueryProfileHistory::find(quint64 number) const
+{
+    if (number <= firstNumber() || number > lastNumber())
+        return nullptr;
+    return &entries[size_t((number - 1) % entries.size())];
+}
+
+const QueryProfile *QueryProfileHistory::previousRun(quint64 number) const
+{
+    const QueryProfile *current = find(number);
+    if (!current)
+        return nullptr;
+
+    const QString sql = current->sql.simplified();
+    for (quint64 previous = number - 1; previous > firstNumber(); --previous) {
+        const QueryProfile *profile = find(previous);
+        if (profile->error.isEmpty() && !profile->cancelled && profile->sql.simplified() == sql)
+            return profile;
+    }
+    return nullptr;
+}
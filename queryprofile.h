@@ -0,0 +1,72 @@
+#ifndef QUERYPROFILE_H
+#define QUERYPROFILE_H
+
+#include <QDateTime>
+#include <QList>
+#include <QString>
+#include <QStringList>
+
+#include <vector>
+
+// Строка EXPLAIN QUERY PLAN
+struct QueryPlanStep
+{
+    int id = 0;
+    int parent = 0;
+    QString detail;
+
+    // SCAN без индекса — полный проход по таблице
+    bool isFullScan() const;
+    // USE TEMP B-TREE — сортировка или DISTINCT во временном дереве
+    bool usesTempBTree() const;
+};
+
+// Замеры одного выполненного запроса
+struct QueryProfile
+{
+    QString sql;
+    QDateTime startedAt;
+    qint64 prepareUs = 0;
+    qint64 stepUs = 0;
+    qint64 rows = 0;
+
+    // Счётчики sqlite3_stmt_status
+    int vmSteps = 0;
+    int fullScanSteps = 0;
+    int sorts = 0;
+    int autoIndexes = 0;
+
+    QList<QueryPlanStep> plan;
+    QString error;
+    bool cancelled = false;
+
+    // Таблицы main, которые читает запрос, и можно ли кэшировать его результат (ReadAuthorizer)
+    QStringList readTables;
+    bool cacheable = false;
+
+    qint64 totalUs() const { return prepareUs + stepUs; }
+};
+
+// Кольцевой буфер последних замеров; старые вытесняются по мере добавления.
+// Номер записи растёт монотонно и остаётся действительным, пока она в буфере.
+class QueryProfileHistory
+{
+public:
+    explicit QueryProfileHistory(int capacity = 200);
+
+    quint64 append(const QueryProfile &profile);
+    const QueryProfile *find(quint64 number) const;
+
+    // Предыдущий запуск того же текста запроса — для сравнения между прогонами
+    const QueryProfile *previousRun(quint64 number) const;
+
+    int size() const { return int(qMin<quint64>(count, entries.size())); }
+    quint64 firstNumber() const { return count - quint64(size()); }
+    quint64 lastNumber() const { return count; }
+
+private:
+    std::vector<QueryProfile> entries;
+    quint64 count = 0;
+};
+
+#endif // QUERYPROFILE_H
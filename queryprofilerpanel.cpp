@@ -0,0 +1,150 @@
+#include "queryprofilerpanel.h"
+#include <QHash>
+#include <QHeaderView>
+#include <QPushButton>
+#include <QSplitter>
+#include <QTreeWidget>
+#include <QVBoxLayout>
+
+namespace {
+
+enum HistoryColumn {
+    TimeColumn,
+    SqlColumn,
+    PrepareColumn,
+    StepColumn,
+    RowsColumn,
+    VmStepsColumn,
+    FullScanColumn,
+    SortColumn,
+    AutoIndexColumn,
+    ChangeColumn,
+    HistoryColumnCount
+};
+
+QString formatUs(qint64 us)
+{
+    return us < 10000 ? QueryProfilerPanel::tr("%1 мкс").arg(us)
+                      : QueryProfilerPanel::tr("%1 мс").arg(us / 1000.0, 0, 'f', 1);
+}
+
+}
+
+QueryProfilerPanel::QueryProfilerPanel(QWidget *parent)
+    : QWidget(parent),
+    history(HistorySize),
+    historyTree(new QTreeWidget(this)),
+    planTree(new QTreeWidget(this))
+{
+    historyTree->setColumnCount(HistoryColumnCount);
+    historyTree->setHeaderLabels({ tr("Время"), tr("Запрос"), tr("Подготовка"), tr("Выполнение"), tr("Строк"),
+                                   tr("Шагов VM"), tr("Полный скан"), tr("Сортировок"), tr("Автоиндексов"),
+                                   tr("К прошлому запуску") });
+    historyTree->setRootIsDecorated(false);
+    historyTree->setUniformRowHeights(true);
+    historyTree->header()->setSectionResizeMode(SqlColumn, QHeaderView::Stretch);
+    historyTree->header()->setStretchLastSection(false);
+
+    planTree->setHeaderLabels({ tr("План запроса") });
+
+    auto *clearButton = new QPushButton(tr("Очистить"), this);
+    connect(clearButton, &QPushButton::clicked, this, &QueryProfilerPanel::clear);
+    connect(historyTree, &QTreeWidget::currentItemChanged, this, &QueryProfilerPanel::showPlan);
+
+    auto *splitter = new QSplitter(Qt::Horizontal, this);
+    splitter->addWidget(historyTree);
+    splitter->addWidget(planTree);
+    splitter->setStretchFactor(0, 3);
+    splitter->setStretchFactor(1, 2);
+
+    auto *layout = new QVBoxLayout(this);
+    layout->setContentsMargins(0, 0, 0, 0);
+    layout->addWidget(splitter);
+    layout->addWidget(clearButton, 0, Qt::AlignRight);
+}
+
+void QueryProfilerPanel::addProfile(const QueryProfile &profile)
+{
+    const quint64 number = history.append(profile);
+
+    auto *item = new QTreeWidgetItem;
+    item->setData(TimeColumn, Qt::UserRole, number);
+    item->setText(TimeColumn, profile.startedAt.toString(QStringLiteral("HH:mm:ss")));
+    item->setText(SqlColumn, profile.sql.simplified());
+    item->setToolTip(SqlColumn, profile.sql);
+    item->setText(PrepareColumn, formatUs(profile.prepareUs));
+    item->setText(StepColumn, formatUs(profile.stepUs));
+    item->setText(RowsColumn, QString::number(profile.rows));
+    item->setText(VmStepsColumn, QString::number(profile.vmSteps));
+    item->setText(FullScanColumn, QString::number(profile.fullScanSteps));
+    item->setText(SortColumn, QString::number(profile.sorts));
+    item->setText(AutoIndexColumn, QString::number(profile.autoIndexes));
+    for (int column = PrepareColumn; column < HistoryColumnCount; ++column)
+        item->setTextAlignment(column, Qt::AlignRight | Qt::AlignVCenter);
+
+    if (!profile.error.isEmpty()) {
+        item->setText(ChangeColumn, tr("ошибка"));
+        item->setToolTip(ChangeColumn, profile.error);
+        item->setForeground(ChangeColumn, Qt::red);
+    } else if (profile.cancelled) {
+        item->setText(ChangeColumn, tr("прервано"));
+    } else if (const QueryProfile *previous = history.previousRun(number)) {
+        const qint64 before = qMax<qint64>(previous->totalUs(), 1);
+        const qint64 percent = (profile.totalUs() - before) * 100 / before;
+        item->setText(ChangeColumn, QStringLiteral("%1%2%").arg(percent > 0 ? QStringLiteral("+") : QString()).arg(percent));
+        item->setToolTip(ChangeColumn, tr("Было %1, стало %2").arg(formatUs(previous->totalUs()), formatUs(profile.totalUs())));
+        if (percent >= RegressionPercent)
+            item->setForeground(ChangeColumn, Qt::red);
+        else if (percent <= -RegressionPercent)
+            item->setForeground(ChangeColumn, Qt::darkGreen);
+    }
+
+    if (profile.fullScanSteps > 0)
+        item->setForeground(FullScanColumn, Qt::red);
+    if (profile.sorts > 0)
+        item->setForeground(SortColumn, Qt::darkYellow);
+    if (profile.autoIndexes > 0)
+        item->setForeground(AutoIndexColumn, Qt::darkYellow);
+
+    historyTree->insertTopLevelItem(0, item);
+    while (historyTree->topLevelItemCount() > history.size())
+        delete historyTree->takeTopLevelItem(historyTree->topLevelItemCount() - 1);
+
+    historyTree->setCurrentItem(item);
+}
+
+void QueryProfilerPanel::clear()
+{
+    history = QueryProfileHistory(HistorySize);
+    historyTree->clear();
+    planTree->clear();
+}
+
+void QueryProfilerPanel::showPlan()
+{
+    planTree->clear();
+
+    const QTreeWidgetItem *current = historyTree->currentItem();
+    const QueryProfile *profile = current ? history.find(current->data(TimeColumn, Qt::UserRole).toULongLong())
+                                          : nullptr;
+    if (!profile)
+        return;
+
+    // Строки плана приходят в порядке обхода, родитель всегда раньше потомков
+    QHash<int, QTreeWidgetItem *> items;
+    for (const QueryPlanStep &step : profile->plan) {
+        QTreeWidgetItem *parent = items.value(step.parent);
+        auto *item = parent ? new QTreeWidgetItem(parent) : new QTreeWidgetItem(planTree);
+        item->setText(0, step.detail);
+
+        if (step.isFullScan()) {
+            item->setForeground(0, Qt::red);
+            item->setToolTip(0, tr("Полный проход по таблице: индекс не используется"));
+        } else if (step.usesTempBTree()) {
+            item->setForeground(0, Qt::darkYellow);
+            item->setToolTip(0, tr("Сортировка или группировка во временном B-дереве"));
+        }
+        items.insert(step.id, item);
+    }
+    planTree->expandAll();
+}
@@ -0,0 +1,37 @@
+#ifndef QUERYPROFILERPANEL_H
+#define QUERYPROFILERPANEL_H
+
+#include "queryprofile.h"
+#include <QWidget>
+
+class QTreeWidget;
+class QTreeWidgetItem;
+
+// Панель профилировщика: история выполненных запросов с замерами
+// и план выбранного запроса. Полные проходы по таблице и сортировки
+// во временном B-дереве подсвечиваются, для повторных запусков того же
+// текста показывается изменение времени относительно прошлого прогона.
+class QueryProfilerPanel : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit QueryProfilerPanel(QWidget *parent = nullptr);
+
+public slots:
+    void addProfile(const QueryProfile &profile);
+    void clear();
+
+private slots:
+    void showPlan();
+
+private:
+    static constexpr int HistorySize = 200;
+    static constexpr int RegressionPercent = 20;
+
+    QueryProfileHistory history;
+    QTreeWidget *historyTree;
+    QTreeWidget *planTree;
+};
+
+#endif // QUERYPROFILERPANEL_H
@@ -0,0 +1,61 @@
+#include "queryresultmodel.h"
+
+QueryResultModel::QueryResultModel(QObject *parent)
+    : QAbstractTableModel(parent)
+{
+}
+
+int QueryResultModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : resultRows.rowCount();
+}
+
+int QueryResultModel::columnCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : columnNames.size();
+}
+
+QVariant QueryResultModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || (role != Qt::DisplayRole && role != Qt::EditRole))
+        return QVariant();
+
+    return resultRows.value(index.row(), index.column());
+}
+
+QVariant QueryResultModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (role != Qt::DisplayRole)
+        return QVariant();
+
+    if (orientation == Qt::Horizontal)
+        return section < columnNames.size() ? columnNames.at(section) : QVariant();
+    return section + 1;
+}
+
+void QueryResultModel::clear()
+{
+    beginResetModel();
+    columnNames.clear();
+    resultRows = ResultSet();
+    endResetModel();
+}
+
+void QueryResultModel::setColumns(const QStringList &columns)
+{
+    beginResetModel();
+    columnNames = columns;
+    resultRows = ResultSet(int(columns.size()));
+    endResetModel();
+}
+
+void QueryResultModel::appendRows(const ResultSet &rows)
+{
+    if (rows.isEmpty() || rows.columnCount() != resultRows.columnCount())
+        return;
+
+    const int first = resultRows.rowCount();
+    beginInsertRows(QModelIndex(), first, first + rows.rowCount() - 1);
+    resultRows.append(rows);
+    endInsertRows();
+}
@@ -0,0 +1,37 @@
+#ifndef QUERYRESULTMODEL_H
+#define QUERYRESULTMODEL_H
+
+#include "resultset.h"
+#include <QAbstractTableModel>
+#include <QStringList>
+
+// Модель только для чтения, в которую QueryWorker порциями дописывает
+// строки результата запроса. Строки хранятся по столбцам в ResultSet,
+// QVariant создаётся только в data()
+class QueryResultModel : public QAbstractTableModel
+{
+    Q_OBJECT
+
+public:
+    explicit QueryResultModel(QObject *parent = nullptr);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation,
+                        int role = Qt::DisplayRole) const override;
+
+    QStringList columns() const { return columnNames; }
+    ResultSet rows() const { return resultRows; }
+
+public slots:
+    void clear();
+    void setColumns(const QStringList &columns);
+    void appendRows(const ResultSet &rows);
+
+private:
+    QStringList columnNames;
+    ResultSet resultRows;
+};
+
+#endif // QUERYRESULTMODEL_H
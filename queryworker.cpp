@@ -0,0 +1,214 @@
+#include "queryworker.h"
+#include "resultcache.h"
+#include "sqliteutil.h"
+#include <QSqlQuery>
+
+#include <sqlite3.h>
+
+static QSqlError statementError(sqlite3 *handle)
+{
+    if (!handle)
+        return QSqlError(QString(), QStringLiteral("No database handle"), QSqlError::ConnectionError);
+    return QSqlError(QString(), QString::fromUtf8(sqlite3_errmsg(handle)), QSqlError::StatementError,
+                     QString::number(sqlite3_extended_errcode(handle)));
+}
+
+QueryWorker::QueryWorker(const QString &sourceConnection, QObject *parent)
+    : QObject(parent),
+    sourceConnection(sourceConnection)
+{
+}
+
+QueryWorker::~QueryWorker()
+{
+    resetConnection();
+}
+
+void QueryWorker::cancel()
+{
+    cancelledUpTo = submittedRequests.load();
+
+    // sqlite3_interrupt безопасно вызывать из другого потока,
+    // пока соединение открыто; закрытие защищено тем же мьютексом
+    QMutexLocker locker(&handleMutex);
+    if (activeHandle)
+        sqlite3_interrupt(activeHandle);
+}
+
+void QueryWorker::resetConnection()
+{
+    setActiveHandle(nullptr);
+    connection.reset();
+}
+
+void QueryWorker::setActiveHandle(sqlite3 *handle)
+{
+    QMutexLocker locker(&handleMutex);
+    activeHandle = handle;
+}
+
+bool QueryWorker::ensureConnection()
+{
+    if (connection && connection->isOpen())
+        return true;
+
+    connection = std::make_unique<ScopedConnection>(sourceConnection, QStringLiteral("query"));
+    if (!connection->open())
+        return false;
+
+    setActiveHandle(connection->handle());
+    return true;
+}
+
+int QueryWorker::progressHandler(void *context)
+{
+    auto *worker = static_cast<QueryWorker *>(context);
+    if (worker->isCancelled())
+        return 1;
+
+    // Долгие агрегаты не возвращают строк, поэтому прогресс шлём отсюда
+    const qint64 elapsed = worker->timer.elapsed();
+    if (elapsed - worker->lastProgressMs >= ProgressIntervalMs) {
+        worker->lastProgressMs = elapsed;
+        emit worker->progress(worker->fetchedRows, elapsed);
+    }
+    return 0;
+}
+
+QList<QueryPlanStep> QueryWorker::queryPlan(const QString &sql)
+{
+    QList<QueryPlanStep> plan;
+    QSqlQuery query(connection->database());
+    query.setForwardOnly(true);
+    if (query.exec(QLatin1String("EXPLAIN QUERY PLAN ") + sql)) {
+        while (query.next())
+            plan << QueryPlanStep { query.value(0).toInt(), query.value(1).toInt(), query.value(3).toString() };
+    }
+    return plan;
+}
+
+void QueryWorker::submit(const QString &sql)
+{
+    // Номер выдаётся при постановке в очередь, чтобы не потерять отмену, пока запрос ждёт
+    const quint64 request = ++submittedRequests;
+    QMetaObject::invokeMethod(this, [this, sql, request] {
+        run(sql, request);
+    }, Qt::QueuedConnection);
+}
+
+void QueryWorker::execute(const QString &sql)
+{
+    run(sql, ++submittedRequests);
+}
+
+void QueryWorker::run(const QString &sql, quint64 request)
+{
+    currentRequest = request;
+    fetchedRows = 0;
+    lastProgressMs = 0;
+    timer.start();
+
+    if (isCancelled()) {
+        emit cancelled(0, 0);
+        return;
+    }
+
+    if (!ensureConnection()) {
+        emit failed(connection->lastError());
+        resetConnection();
+        return;
+    }
+
+    sqlite3 *handle = connection->handle();
+    if (handle)
+        sqlite3_progress_handler(handle, 1000, &QueryWorker::progressHandler, this);
+
+    QueryProfile profile;
+    profile.sql = sql;
+    profile.startedAt = QDateTime::currentDateTime();
+
+    bool isSelect = false;
+    QSqlError error;
+    {
+        QElapsedTimer stepTimer;
+        stepTimer.start();
+        const QByteArray text = sql.toUtf8();
+        sqlite3_stmt *stmt = nullptr;
+        ReadAuthorizer authorizer(handle);
+        const bool prepared = handle
+                              && sqlite3_prepare_v2(handle, text.constData(), int(text.size()), &stmt, nullptr) == SQLITE_OK;
+        authorizer.finish(prepared ? stmt : nullptr);
+        profile.readTables = authorizer.tables();
+        profile.cacheable = authorizer.isCacheable();
+        profile.prepareUs = stepTimer.nsecsElapsed() / 1000;
+        stepTimer.restart();
+
+        if (!prepared) {
+            error = statementError(handle);
+        } else if (stmt) {
+            const int columnCount = sqlite3_column_count(stmt);
+            isSelect = columnCount > 0;
+            if (isSelect) {
+                QStringList columns;
+                for (int i = 0; i < columnCount; ++i)
+                    columns << QString::fromUtf8(sqlite3_column_name(stmt, i));
+                emit columnsReady(columns);
+            }
+
+            const int changesBefore = sqlite3_total_changes(handle);
+            ResultSet batch(columnCount);
+            qint64 lastBatchMs = 0;
+            int rc;
+            while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+                batch.appendRow(stmt);
+                ++fetchedRows;
+
+                const qint64 elapsed = timer.elapsed();
+                if (batch.rowCount() >= BatchSize || elapsed - lastBatchMs >= BatchIntervalMs) {
+                    emit rowsReady(batch);
+                    batch.clear();
+                    lastBatchMs = elapsed;
+                    if (elapsed - lastProgressMs >= ProgressIntervalMs) {
+                        lastProgressMs = elapsed;
+                        emit progress(fetchedRows, elapsed);
+                    }
+                }
+            }
+            if (!batch.isEmpty())
+                emit rowsReady(batch);
+            if (rc != SQLITE_DONE)
+                error = statementError(handle);
+            // sqlite3_changes() - строки самого оператора, без триггеров и каскадов FK.
+            // После DDL там остаётся число от прошлого оператора, поэтому сначала
+            // проверяем, менялось ли что-нибудь вообще
+            if (!isSelect)
+                fetchedRows = sqlite3_total_changes(handle) != changesBefore ? sqlite3_changes(handle) : 0;
+
+            profile.vmSteps = sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_VM_STEP, 0);
+            profile.fullScanSteps = sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_FULLSCAN_STEP, 0);
+            profile.sorts = sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_SORT, 0);
+            profile.autoIndexes = sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_AUTOINDEX, 0);
+        }
+        sqlite3_finalize(stmt);
+        profile.stepUs = stepTimer.nsecsElapsed() / 1000;
+    }
+
+    if (handle)
+        sqlite3_progress_handler(handle, 0, nullptr, nullptr);
+
+    profile.rows = fetchedRows;
+    profile.cancelled = isCancelled();
+    profile.error = error.isValid() ? error.text() : QString();
+    profile.cacheable = profile.cacheable && !profile.cancelled && profile.error.isEmpty();
+    if (!profile.cancelled && profile.error.isEmpty())
+        profile.plan = queryPlan(sql);
+    emit profiled(profile);
+
+    const qint64 elapsed = timer.elapsed();
+    if (isCancelled())
+        emit cancelled(fetchedRows, elapsed);
+    else if (error.isValid())
+        emit failed(error);
+    else
+        emit finished(isSelect, fetchedRows, elapsed);
+}
@@ -0,0 +1,80 @@
+#ifndef QUERYWORKER_H
+#define QUERYWORKER_H
+
+#include "queryprofile.h"
+#include "resultset.h"
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QObject>
+#include <QSqlDatabase>
+#include <QSqlError>
+#include <QStringList>
+
+#include <atomic>
+#include <memory>
+
+struct sqlite3;
+class ScopedConnection;
+
+// Выполняет SQL в рабочем потоке на собственном соединении.
+// Объект переносится в отдельный QThread, слоты вызываются через очередь,
+// строки результата читаются прямо из sqlite3_column_* в ResultSet
+// и отдаются порциями через rowsReady().
+class QueryWorker : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit QueryWorker(const QString &sourceConnection = QString::fromLatin1(QSqlDatabase::defaultConnection),
+                         QObject *parent = nullptr);
+    ~QueryWorker();
+
+    // Можно вызывать из любого потока. Отменяет выполняемый запрос и поставленные
+    // через submit(), но ещё не начатые
+    void cancel();
+    void submit(const QString &sql);
+
+public slots:
+    void execute(const QString &sql);
+    void resetConnection();
+
+signals:
+    void columnsReady(const QStringList &columns);
+    void rowsReady(const ResultSet &rows);
+    void progress(qint64 rows, qint64 elapsedMs);
+    void finished(bool isSelect, qint64 rows, qint64 elapsedMs);
+    void cancelled(qint64 rows, qint64 elapsedMs);
+    void failed(const QSqlError &error);
+
+    // Перед finished/cancelled/failed: время, счётчики VM и план запроса
+    void profiled(const QueryProfile &profile);
+
+private:
+    static int progressHandler(void *context);
+
+    bool ensureConnection();
+    QList<QueryPlanStep> queryPlan(const QString &sql);
+    void setActiveHandle(sqlite3 *handle);
+    void run(const QString &sql, quint64 request);
+    bool isCancelled() const { return currentRequest <= cancelledUpTo; }
+
+    static constexpr int BatchSize = 500;
+    static constexpr int BatchIntervalMs = 100;
+    static constexpr int ProgressIntervalMs = 250;
+
+    QString sourceConnection;
+    std::unique_ptr<ScopedConnection> connection;
+
+    QMutex handleMutex;
+    sqlite3 *activeHandle = nullptr;
+    // Номера запросов: отмена относится ко всем, выданным до неё
+    std::atomic<quint64> submittedRequests { 0 };
+    std::atomic<quint64> cancelledUpTo { 0 };
+    quint64 currentRequest = 0;
+
+    QElapsedTimer timer;
+    qint64 fetchedRows = 0;
+    qint64 lastProgressMs = 0;
+};
+
+#endif // QUERYWORKER_H
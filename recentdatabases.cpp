@@ -0,0 +1,110 @@
+#include "recentdatabases.h"
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QSet>
+#include <QSettings>
+#include <QStandardPaths>
+
+static QString snapshotDir()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + QStringLiteral("/schemas");
+}
+
+QList<RecentDatabase> RecentDatabase::load(QSettings &settings)
+{
+    QList<RecentDatabase> databases;
+    const int count = settings.beginReadArray("RecentDatabases");
+    for (int i = 0; i < count && databases.size() < MaxEntries; ++i) {
+        settings.setArrayIndex(i);
+        RecentDatabase database;
+        database.path = settings.value("path").toString();
+        database.lastTable = settings.value("lastTable").toString();
+        database.topRow = qMax(0, settings.value("topRow").toInt());
+        const QString schemaFile = settings.value("schemaFile").toString();
+        if (!schemaFile.isEmpty()) {
+            QFile file(schemaFile);
+            if (file.open(QIODevice::ReadOnly))
+                database.schema = file.readAll();
+        } else {
+            // Прежние версии хранили снимок прямо в настройках; при сохранении он переедет в файл
+            database.schema = settings.value("schema").toByteArray();
+        }
+        if (!database.path.isEmpty() && indexOf(databases, database.path) < 0)
+            databases << database;
+    }
+    settings.endArray();
+    return databases;
+}
+
+void RecentDatabase::save(QSettings &settings, const QList<RecentDatabase> &databases)
+{
+    QDir().mkpath(snapshotDir());
+    QSet<QString> snapshots;
+
+    // Массив перезаписывается целиком, иначе от длинного старого списка останутся хвосты
+    settings.remove("RecentDatabases");
+    settings.beginWriteArray("RecentDatabases", int(databases.size()));
+    for (int i = 0; i < databases.size(); ++i) {
+        const RecentDatabase &database = databases.at(i);
+        settings.setArrayIndex(i);
+        settings.setValue("path", database.path);
+        settings.setValue("lastTable", database.lastTable);
+        settings.setValue("topRow", database.topRow);
+        if (database.schema.isEmpty())
+            continue;
+
+        const QString schemaFile = snapshotFile(database.path);
+        QSaveFile file(schemaFile);
+        if (file.open(QIODevice::WriteOnly) && file.write(database.schema) == database.schema.size() && file.commit()) {
+            settings.setValue("schemaFile", schemaFile);
+            snapshots.insert(QFileInfo(schemaFile).fileName());
+        }
+    }
+    settings.endArray();
+
+    // Снимки баз, выпавших из списка, больше не нужны
+    const QStringList files = QDir(snapshotDir()).entryList({ QStringLiteral("*.snapshot") }, QDir::Files);
+    for (const QString &name : files) {
+        if (!snapshots.contains(name))
+            QFile::remove(snapshotDir() + QLatin1Char('/') + name);
+    }
+}
+
+QString RecentDatabase::snapshotFile(const QString &path)
+{
+    const QByteArray hash = QCryptographicHash::hash(normalizePath(path).toUtf8(), QCryptographicHash::Sha1);
+    return snapshotDir() + QLatin1Char('/') + QString::fromLatin1(hash.toHex()) + QStringLiteral(".snapshot");
+}
+
+QString RecentDatabase::normalizePath(const QString &path)
+{
+    return QFileInfo(path).absoluteFilePath();
+}
+
+int RecentDatabase::indexOf(const QList<RecentDatabase> &databases, const QString &path)
+{
+    const QString normalized = normalizePath(path);
+    for (int i = 0; i < databases.size(); ++i) {
+        if (databases.at(i).path == normalized)
+            return i;
+    }
+    return -1;
+}
+
+RecentDatabase &RecentDatabase::touch(QList<RecentDatabase> &databases, const QString &path)
+{
+    const int index = indexOf(databases, path);
+    if (index > 0) {
+        databases.move(index, 0);
+    } else if (index < 0) {
+        RecentDatabase database;
+        database.path = normalizePath(path);
+        databases.prepend(database);
+        while (databases.size() > MaxEntries)
+            databases.removeLast();
+    }
+    return databases.first();
+}
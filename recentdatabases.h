@@ -0,0 +1,35 @@
+#ifndef RECENTDATABASES_H
+#define RECENTDATABASES_H
+
+#include <QByteArray>
+#include <QList>
+#include <QString>
+
+class QSettings;
+
+// Недавно открытая база: где остановился пользователь и снимок схемы
+// (SchemaCatalog::snapshot()), чтобы при следующем открытии не читать схему заново.
+// Снимки лежат файлами в кэше приложения (QStandardPaths::CacheLocation/schemas),
+// в QSettings - только путь к файлу: схема большой базы весит мегабайты
+struct RecentDatabase
+{
+    QString path;
+    QString lastTable;
+    int topRow = 0;
+    QByteArray schema;
+
+    // Список от последней открытой к давним; пути хранятся абсолютными
+    static QList<RecentDatabase> load(QSettings &settings);
+    static void save(QSettings &settings, const QList<RecentDatabase> &databases);
+
+    static QString normalizePath(const QString &path);
+    // Файл снимка схемы для базы по её абсолютному пути
+    static QString snapshotFile(const QString &path);
+    static int indexOf(const QList<RecentDatabase> &databases, const QString &path);
+    // Поднимает базу в начало списка, при необходимости добавляя её, и возвращает запись
+    static RecentDatabase &touch(QList<RecentDatabase> &databases, const QString &path);
+
+    static constexpr int MaxEntries = 10;
+};
+
+#endif // RECENTDATABASES_H
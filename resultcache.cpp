@@ -0,0 +1,285 @@
+#include "resultcache.h"
+#include "changetracker.h"
+#include "statementcache.h"
+#include <QMutex>
+
+#include <sqlite3.h>
+
+static QMutex cachesMutex;
+static QHash<QString, ResultCache *> connectionCaches;
+
+ReadAuthorizer::ReadAuthorizer(sqlite3 *handle)
+    : handle(handle),
+    cacheable(handle != nullptr)
+{
+    if (handle)
+        sqlite3_set_authorizer(handle, &ReadAuthorizer::authorize, this);
+}
+
+ReadAuthorizer::~ReadAuthorizer()
+{
+    if (handle && !finished)
+        ChangeTracker::restoreAuthorizer(handle);
+}
+
+int ReadAuthorizer::authorize(void *context, int action, const char *first, const char *second,
+                              const char *database, const char *trigger)
+{
+    auto *authorizer = static_cast<ReadAuthorizer *>(context);
+
+    // Результат этих функций меняется без записи в базу
+    static const char *const volatileFunctions[] = {
+        "random", "randomblob", "changes", "total_changes", "last_insert_rowid",
+        "date", "time", "datetime", "julianday", "strftime", "unixepoch", "timediff",
+        "current_date", "current_time", "current_timestamp"
+    };
+
+    switch (action) {
+    case SQLITE_READ:
+        // Хуки ChangeTracker видят только main
+        if (!database || qstrcmp(database, "main") != 0)
+            authorizer->cacheable = false;
+        else if (first)
+            authorizer->read.insert(QString::fromUtf8(first).toLower());
+        break;
+    case SQLITE_FUNCTION:
+        for (const char *name : volatileFunctions) {
+            if (second && qstricmp(second, name) == 0)
+                authorizer->cacheable = false;
+        }
+        break;
+    case SQLITE_PRAGMA:
+        authorizer->cacheable = false;
+        break;
+    default:
+        break;
+    }
+    // Авторизатор трекера на время подготовки снят, его работа - здесь
+    return ChangeTracker::authorize(authorizer->handle, action, first, second, database, trigger);
+}
+
+void ReadAuthorizer::finish(sqlite3_stmt *stmt)
+{
+    if (!handle || finished)
+        return;
+    finished = true;
+    ChangeTracker::restoreAuthorizer(handle);
+
+    // BEGIN и прочие операторы без результата тоже считаются читающими
+    if (!stmt || !sqlite3_stmt_readonly(stmt) || sqlite3_column_count(stmt) == 0)
+        cacheable = false;
+    if (!cacheable)
+        return;
+
+    // Виртуальные таблицы, табличные функции и строки таблиц WITHOUT ROWID меняются мимо хуков
+    sqlite3_stmt *lookup = nullptr;
+    if (sqlite3_prepare_v2(handle, "SELECT sql FROM main.sqlite_master WHERE type = 'table' AND name = ?1 COLLATE NOCASE",
+                           -1, &lookup, nullptr) != SQLITE_OK) {
+        cacheable = false;
+        sqlite3_finalize(lookup);
+        return;
+    }
+    for (const QString &table : std::as_const(read)) {
+        if (table == QLatin1String("sqlite_master") || table == QLatin1String("sqlite_schema"))
+            continue;
+        const QByteArray name = table.toUtf8();
+        sqlite3_bind_text(lookup, 1, name.constData(), int(name.size()), SQLITE_TRANSIENT);
+        const bool found = sqlite3_step(lookup) == SQLITE_ROW;
+        const char *sql = found ? reinterpret_cast<const char *>(sqlite3_column_text(lookup, 0)) : nullptr;
+        if (!sql || qstrnicmp(sql, "CREATE VIRTUAL", 14) == 0
+            || QString::fromUtf8(sql).contains(QLatin1String("WITHOUT ROWID"), Qt::CaseInsensitive))
+            cacheable = false;
+        sqlite3_reset(lookup);
+        if (!cacheable)
+            break;
+    }
+    sqlite3_finalize(lookup);
+}
+
+ResultCache::ResultCache(const QString &connectionName, qint64 budget)
+    : connectionName(connectionName),
+    maxBytes(qMax<qint64>(0, budget))
+{
+}
+
+ResultCache::~ResultCache()
+{
+    if (tracker)
+        tracker->unsubscribe(subscription);
+}
+
+bool ResultCache::sync()
+{
+    // Без трекера изменения не видны, и кэш не работает
+    const std::shared_ptr<ChangeTracker> current = ChangeTracker::forConnection(connectionName);
+    if (current != tracker) {
+        if (tracker)
+            tracker->unsubscribe(subscription);
+        invalidate();
+        tracker = current;
+        subscription = tracker ? tracker->subscribe(QString()) : 0;
+        return tracker != nullptr;
+    }
+    if (!tracker)
+        return false;
+
+    const TrackedChanges changes = tracker->take(subscription);
+    if (changes.external || changes.schemaChanged)
+        invalidate();
+    return true;
+}
+
+void ResultCache::invalidate()
+{
+    counters.invalidations += entries.size();
+    entries.clear();
+    counters.bytes = 0;
+    ++epoch;
+}
+
+void ResultCache::remove(QHash<QString, Entry>::iterator it)
+{
+    counters.bytes -= it->bytes;
+    entries.erase(it);
+}
+
+void ResultCache::evict()
+{
+    auto oldest = entries.begin();
+    for (auto it = entries.begin(); it != entries.end(); ++it) {
+        if (it->lastUse < oldest->lastUse)
+            oldest = it;
+    }
+    if (oldest != entries.end()) {
+        remove(oldest);
+        ++counters.evictions;
+    }
+}
+
+bool ResultCache::lookup(const QString &key, Result *result)
+{
+    if (!sync()) {
+        ++counters.misses;
+        return false;
+    }
+
+    const auto it = entries.find(key);
+    if (it == entries.end()) {
+        ++counters.misses;
+        return false;
+    }
+
+    for (auto version = it->versions.cbegin(); version != it->versions.cend(); ++version) {
+        if (tracker->tableVersion(version.key()) != version.value()) {
+            remove(it);
+            ++counters.invalidations;
+            ++counters.misses;
+            return false;
+        }
+    }
+
+    it->lastUse = ++useCounter;
+    ++counters.hits;
+    *result = it->result;
+    return true;
+}
+
+ResultCache::Ticket ResultCache::begin()
+{
+    Ticket ticket;
+    if (sync())
+        ticket.commits = tracker->commitCount();
+    ticket.epoch = epoch;
+    return ticket;
+}
+
+void ResultCache::store(const Ticket &ticket, const QString &key, const QStringList &tables, const Result &result)
+{
+    if (!sync() || ticket.epoch != epoch)
+        return;
+
+    Entry entry;
+    for (const QString &table : tables) {
+        const quint64 version = tracker->tableVersion(table);
+        // Таблицу меняли, пока шёл запрос: неизвестно, что он успел увидеть
+        if (version > ticket.commits)
+            return;
+        entry.versions.insert(table.toLower(), version);
+    }
+
+    entry.bytes = resultBytes(result) + key.size() * qint64(sizeof(QChar));
+    if (entry.bytes > maxBytes)
+        return;
+
+    const auto existing = entries.find(key);
+    if (existing != entries.end())
+        remove(existing);
+    while (!entries.isEmpty() && counters.bytes + entry.bytes > maxBytes)
+        evict();
+
+    entry.result = result;
+    entry.lastUse = ++useCounter;
+    counters.bytes += entry.bytes;
+    entries.insert(key, entry);
+}
+
+void ResultCache::clear()
+{
+    entries.clear();
+    counters.bytes = 0;
+    ++epoch;
+}
+
+void ResultCache::setBudget(qint64 bytes)
+{
+    maxBytes = qMax<qint64>(0, bytes);
+    while (!entries.isEmpty() && counters.bytes > maxBytes)
+        evict();
+}
+
+ResultCache::Stats ResultCache::stats() const
+{
+    Stats result = counters;
+    result.size = int(entries.size());
+    result.budget = maxBytes;
+    return result;
+}
+
+QString ResultCache::makeKey(const QString &sql, const QVariantList &binds)
+{
+    QString key = StatementCache::normalize(sql);
+    for (const QVariant &value : binds) {
+        key += QChar(0x1f);
+        if (value.isNull()) {
+            key += QLatin1String("null");
+            continue;
+        }
+        key += QString::number(value.typeId()) + QLatin1Char(':');
+        key += value.typeId() == QMetaType::QByteArray ? QString::fromLatin1(value.toByteArray().toHex())
+                                                       : value.toString();
+    }
+    return key;
+}
+
+qint64 ResultCache::resultBytes(const Result &result)
+{
+    qint64 bytes = result.rows.byteSize();
+    for (const QString &column : result.columns)
+        bytes += qint64(sizeof(QString)) + column.size() * qint64(sizeof(QChar));
+    return bytes;
+}
+
+ResultCache &ResultCache::forConnection(const QString &connectionName)
+{
+    QMutexLocker locker(&cachesMutex);
+    ResultCache *&cache = connectionCaches[connectionName];
+    if (!cache)
+        cache = new ResultCache(connectionName);
+    return *cache;
+}
+
+void ResultCache::removeForConnection(const QString &connectionName)
+{
+    QMutexLocker locker(&cachesMutex);
+    delete connectionCaches.take(connectionName);
+}
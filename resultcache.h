@@ -0,0 +1,130 @@
+#ifndef RESULTCACHE_H
+#define RESULTCACHE_H
+
+#include "resultset.h"
+#include <QHash>
+#include <QSet>
+#include <QSqlDatabase>
+#include <QString>
+#include <QStringList>
+
+#include <memory>
+
+class ChangeTracker;
+struct sqlite3;
+struct sqlite3_stmt;
+
+// Таблицы, которые читает оператор, подготовленный на дескрипторе, пока объект жив
+// (sqlite3_set_authorizer). Результат можно кэшировать, если оператор только читает,
+// все его таблицы - обычные таблицы main с rowid и в нём нет функций, зависящих от времени,
+// случайности или состояния соединения.
+class ReadAuthorizer
+{
+public:
+    explicit ReadAuthorizer(sqlite3 *handle);
+    ~ReadAuthorizer();
+
+    // Снимает авторизатор и проверяет подготовленный оператор; до вызова ответ - нет
+    void finish(sqlite3_stmt *stmt);
+
+    bool isCacheable() const { return cacheable; }
+    QStringList tables() const { return read.values(); }
+
+private:
+    Q_DISABLE_COPY(ReadAuthorizer)
+
+    static int authorize(void *context, int action, const char *first, const char *second,
+                         const char *database, const char *trigger);
+
+    sqlite3 *handle;
+    QSet<QString> read;
+    bool cacheable = true;
+    bool finished = false;
+};
+
+// Кэш результатов читающих запросов соединения, в потоке исходного соединения.
+// Ключ - текст, нормализованный StatementCache::normalize(), и значения параметров.
+// Запись помнит номера последних фиксаций прочитанных таблиц по ChangeTracker и
+// выдаётся, только пока ни одна из них не менялась. Записи других процессов
+// (смена data_version), фиксации неизвестно чего и смена схемы очищают кэш целиком.
+// Сверх бюджета памяти вытесняются давно не использованные записи.
+class ResultCache
+{
+public:
+    struct Result
+    {
+        QStringList columns;
+        ResultSet rows;
+    };
+
+    struct Stats
+    {
+        qint64 hits = 0;
+        qint64 misses = 0;
+        qint64 evictions = 0;
+        qint64 invalidations = 0;
+        qint64 bytes = 0;
+        qint64 budget = 0;
+        int size = 0;
+
+        double hitRate() const { return hits + misses > 0 ? double(hits) / double(hits + misses) : 0.0; }
+    };
+
+    // Отметка начала запроса: результат сохраняется, только если его таблицы
+    // и база в целом не менялись после неё
+    struct Ticket
+    {
+        quint64 epoch = 0;
+        quint64 commits = 0;
+    };
+
+    explicit ResultCache(const QString &connectionName, qint64 budget = DefaultBudget);
+    ~ResultCache();
+
+    bool lookup(const QString &key, Result *result);
+    Ticket begin();
+    void store(const Ticket &ticket, const QString &key, const QStringList &tables, const Result &result);
+    void clear();
+
+    qint64 budget() const { return maxBytes; }
+    void setBudget(qint64 bytes);
+    Stats stats() const;
+
+    static QString makeKey(const QString &sql, const QVariantList &binds = QVariantList());
+    // Приблизительный объём результата в памяти
+    static qint64 resultBytes(const Result &result);
+
+    // Кэш на соединение, создаётся при первом обращении.
+    // Удалять нужно до ChangeTracker::removeForConnection
+    static ResultCache &forConnection(const QString &connectionName);
+    static void removeForConnection(const QString &connectionName);
+
+    static constexpr qint64 DefaultBudget = 64 * 1024 * 1024;
+
+private:
+    Q_DISABLE_COPY(ResultCache)
+
+    struct Entry
+    {
+        Result result;
+        QHash<QString, quint64> versions;
+        qint64 bytes = 0;
+        quint64 lastUse = 0;
+    };
+
+    bool sync();
+    void invalidate();
+    void remove(QHash<QString, Entry>::iterator it);
+    void evict();
+
+    QString connectionName;
+    qint64 maxBytes;
+    QHash<QString, Entry> entries;
+    std::shared_ptr<ChangeTracker> tracker;
+    int subscription = 0;
+    quint64 epoch = 0;
+    quint64 useCounter = 0;
+    Stats counters;
+};
+
+#endif // RESULTCACHE_H
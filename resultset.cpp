@@ -0,0 +1,264 @@
+#include "resultset.h"
+
+#include <sqlite3.h>
+
+#include <cstring>
+#include <vector>
+
+namespace {
+
+// Тип столбца, в котором встретились значения разных типов
+constexpr quint8 MixedTypes = 0xff;
+
+struct Column
+{
+    quint8 type = 0;              // общий тип непустых значений; 0 - пока только NULL
+    std::vector<quint8> types;    // тип каждой строки, только при MixedTypes
+    std::vector<quint64> nulls;   // битовая карта NULL
+    std::vector<qint64> values;
+    QByteArray bytes;             // TEXT и BLOB подряд: длина (quint32) и содержимое
+};
+
+}
+
+class ResultSetData : public QSharedData
+{
+public:
+    void appendValue(Column &column, int type, qint64 number, const char *data = nullptr, int size = 0);
+    void appendFrom(Column &column, const Column &source, int row);
+
+    std::vector<Column> columns;
+    int rows = 0;
+};
+
+static bool isNull(const Column &column, int row)
+{
+    return column.nulls[size_t(row) >> 6] & (quint64(1) << (row & 63));
+}
+
+static int rowType(const Column &column, int row)
+{
+    if (isNull(column, row))
+        return SQLITE_NULL;
+    return column.type == MixedTypes ? column.types[size_t(row)] : column.type;
+}
+
+void ResultSetData::appendValue(Column &column, int type, qint64 number, const char *data, int size)
+{
+    // Строка rows ещё не засчитана
+    if ((rows & 63) == 0)
+        column.nulls.push_back(0);
+
+    if (type == SQLITE_NULL) {
+        column.nulls.back() |= quint64(1) << (rows & 63);
+        column.values.push_back(0);
+        if (column.type == MixedTypes)
+            column.types.push_back(SQLITE_NULL);
+        return;
+    }
+
+    if (column.type == 0) {
+        column.type = quint8(type);
+    } else if (column.type != type && column.type != MixedTypes) {
+        column.types.assign(size_t(rows), column.type);
+        column.type = MixedTypes;
+    }
+    if (column.type == MixedTypes)
+        column.types.push_back(quint8(type));
+
+    if (type == SQLITE_TEXT || type == SQLITE_BLOB) {
+        column.values.push_back(column.bytes.size());
+        const quint32 length = quint32(size);
+        column.bytes.append(reinterpret_cast<const char *>(&length), sizeof(length));
+        column.bytes.append(data, size);
+    } else {
+        column.values.push_back(number);
+    }
+}
+
+void ResultSetData::appendFrom(Column &column, const Column &source, int row)
+{
+    const int type = rowType(source, row);
+    const qint64 stored = source.values[size_t(row)];
+    if (type == SQLITE_TEXT || type == SQLITE_BLOB) {
+        quint32 length = 0;
+        std::memcpy(&length, source.bytes.constData() + stored, sizeof(length));
+        appendValue(column, type, 0, source.bytes.constData() + stored + sizeof(length), int(length));
+    } else {
+        appendValue(column, type, stored);
+    }
+}
+
+ResultSet::ResultSet()
+    : d(new ResultSetData)
+{
+}
+
+ResultSet::ResultSet(int columnCount)
+    : d(new ResultSetData)
+{
+    d->columns.resize(size_t(qMax(0, columnCount)));
+}
+
+ResultSet::ResultSet(const ResultSet &other) = default;
+ResultSet &ResultSet::operator=(const ResultSet &other) = default;
+ResultSet::~ResultSet() = default;
+
+int ResultSet::rowCount() const
+{
+    return d->rows;
+}
+
+int ResultSet::columnCount() const
+{
+    return int(d->columns.size());
+}
+
+void ResultSet::appendRow(sqlite3_stmt *stmt)
+{
+    ResultSetData *data = d.data();
+    const int count = qMin(int(data->columns.size()), sqlite3_column_count(stmt));
+    for (int i = 0; i < int(data->columns.size()); ++i) {
+        Column &column = data->columns[size_t(i)];
+        const int type = i < count ? sqlite3_column_type(stmt, i) : SQLITE_NULL;
+        switch (type) {
+        case SQLITE_INTEGER:
+            data->appendValue(column, type, sqlite3_column_int64(stmt, i));
+            break;
+        case SQLITE_FLOAT: {
+            const double real = sqlite3_column_double(stmt, i);
+            qint64 bits;
+            std::memcpy(&bits, &real, sizeof(bits));
+            data->appendValue(column, type, bits);
+            break;
+        }
+        case SQLITE_TEXT:
+        case SQLITE_BLOB: {
+            // Указатель берётся до длины, как требует SQLite
+            const void *bytes = type == SQLITE_BLOB ? sqlite3_column_blob(stmt, i)
+                                                    : static_cast<const void *>(sqlite3_column_text(stmt, i));
+            data->appendValue(column, type, 0, static_cast<const char *>(bytes), sqlite3_column_bytes(stmt, i));
+            break;
+        }
+        default:
+            data->appendValue(column, SQLITE_NULL, 0);
+            break;
+        }
+    }
+    ++data->rows;
+}
+
+void ResultSet::appendRow(const QVariantList &values)
+{
+    ResultSetData *data = d.data();
+    for (int i = 0; i < int(data->columns.size()); ++i) {
+        Column &column = data->columns[size_t(i)];
+        const QVariant value = i < values.size() ? values.at(i) : QVariant();
+        if (value.isNull()) {
+            data->appendValue(column, SQLITE_NULL, 0);
+            continue;
+        }
+        switch (value.typeId()) {
+        case QMetaType::Bool:
+        case QMetaType::Int:
+        case QMetaType::UInt:
+        case QMetaType::LongLong:
+        case QMetaType::ULongLong:
+            data->appendValue(column, SQLITE_INTEGER, value.toLongLong());
+            break;
+        case QMetaType::Float:
+        case QMetaType::Double: {
+            const double real = value.toDouble();
+            qint64 bits;
+            std::memcpy(&bits, &real, sizeof(bits));
+            data->appendValue(column, SQLITE_FLOAT, bits);
+            break;
+        }
+        case QMetaType::QByteArray: {
+            const QByteArray bytes = value.toByteArray();
+            data->appendValue(column, SQLITE_BLOB, 0, bytes.constData(), int(bytes.size()));
+            break;
+        }
+        default: {
+            const QByteArray text = value.toString().toUtf8();
+            data->appendValue(column, SQLITE_TEXT, 0, text.constData(), int(text.size()));
+            break;
+        }
+        }
+    }
+    ++data->rows;
+}
+
+void ResultSet::append(const ResultSet &other)
+{
+    if (other.isEmpty() || other.columnCount() != columnCount())
+        return;
+    // Первая порция становится общей, а не копируется
+    if (isEmpty()) {
+        d = other.d;
+        return;
+    }
+
+    ResultSetData *data = d.data();
+    for (int row = 0; row < other.rowCount(); ++row) {
+        for (size_t i = 0; i < data->columns.size(); ++i)
+            data->appendFrom(data->columns[i], other.d->columns[i], row);
+        ++data->rows;
+    }
+}
+
+void ResultSet::clear()
+{
+    const int count = columnCount();
+    d = new ResultSetData;
+    d->columns.resize(size_t(count));
+}
+
+int ResultSet::type(int row, int column) const
+{
+    if (row < 0 || row >= d->rows || column < 0 || column >= columnCount())
+        return SQLITE_NULL;
+    return rowType(d->columns[size_t(column)], row);
+}
+
+QVariant ResultSet::value(int row, int column) const
+{
+    if (row < 0 || row >= d->rows || column < 0 || column >= columnCount())
+        return QVariant();
+
+    const Column &source = d->columns[size_t(column)];
+    const qint64 stored = source.values[size_t(row)];
+    switch (rowType(source, row)) {
+    case SQLITE_INTEGER:
+        return stored;
+    case SQLITE_FLOAT: {
+        double real;
+        std::memcpy(&real, &stored, sizeof(real));
+        return real;
+    }
+    case SQLITE_TEXT:
+    case SQLITE_BLOB: {
+        quint32 length = 0;
+        const char *bytes = source.bytes.constData() + stored;
+        std::memcpy(&length, bytes, sizeof(length));
+        if (rowType(source, row) == SQLITE_BLOB)
+            return QByteArray(bytes + sizeof(length), qsizetype(length));
+        return QString::fromUtf8(bytes + sizeof(length), qsizetype(length));
+    }
+    default:
+        return QVariant();
+    }
+}
+
+qint64 ResultSet::byteSize() const
+{
+    qint64 bytes = qint64(sizeof(ResultSetData));
+    for (const Column &column : d->columns) {
+        bytes += qint64(sizeof(Column))
+                 + qint64(column.types.capacity())
+                 + qint64(column.nulls.capacity() * sizeof(quint64))
+                 + qint64(column.values.capacity() * sizeof(qint64))
+                 + column.bytes.capacity();
+    }
+    return bytes;
+}
@@ -0,0 +1,48 @@
+#ifndef RESULTSET_H
+#define RESULTSET_H
+
+#include <QByteArray>
+#include <QSharedDataPointer>
+#include <QVariant>
+#include <QVariantList>
+
+struct sqlite3_stmt;
+class ResultSetData;
+
+// Строки результата запроса, разложенные по столбцам.
+// Каждый столбец - массив по 8 байт на строку (INTEGER, биты REAL или смещение
+// TEXT/BLOB в общем буфере столбца), битовая карта NULL и тип значений; тип
+// по строкам хранится, только если в столбце встретились разные типы.
+// QVariant создаётся только при чтении значения. Данные общие у копий
+// до первого изменения, поэтому набор дёшево передавать сигналами и держать в кэше.
+class ResultSet
+{
+public:
+    ResultSet();
+    explicit ResultSet(int columnCount);
+    ResultSet(const ResultSet &other);
+    ResultSet &operator=(const ResultSet &other);
+    ~ResultSet();
+
+    int rowCount() const;
+    int columnCount() const;
+    bool isEmpty() const { return rowCount() == 0; }
+
+    // Текущая строка оператора после sqlite3_step() == SQLITE_ROW
+    void appendRow(sqlite3_stmt *stmt);
+    void appendRow(const QVariantList &values);
+    void append(const ResultSet &other);
+    void clear();
+
+    // Коды SQLITE_INTEGER ... SQLITE_NULL
+    int type(int row, int column) const;
+    QVariant value(int row, int column) const;
+
+    // Занятая память, включая запас ёмкости
+    qint64 byteSize() const;
+
+private:
+    QSharedDataPointer<ResultSetData> d;
+};
+
+#endif // RESULTSET_H
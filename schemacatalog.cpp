@@ -0,0 +1,251 @@
+#include "schemacatalog.h"
+#include "sqliteutil.h"
+#include <QDataStream>
+#include <QIODevice>
+#include <QSqlQuery>
+
+#include <algorithm>
+
+static constexpr quint32 SnapshotMagic = 0x53434831;  // "SCH1"
+
+QStringList TableInfo::columnNames() const
+{
+    QStringList names;
+    for (const ColumnInfo &column : columns)
+        names << column.name;
+    return names;
+}
+
+QStringList TableInfo::primaryKey() const
+{
+    QList<const ColumnInfo *> key;
+    for (const ColumnInfo &column : columns) {
+        if (column.primaryKeyIndex > 0)
+            key << &column;
+    }
+    std::sort(key.begin(), key.end(), [](const ColumnInfo *a, const ColumnInfo *b) {
+        return a->primaryKeyIndex < b->primaryKeyIndex;
+    });
+
+    QStringList names;
+    for (const ColumnInfo *column : key)
+        names << column->name;
+    return names;
+}
+
+SchemaCatalog::SchemaCatalog(const QString &connectionName)
+    : connectionName(connectionName)
+{
+}
+
+void SchemaCatalog::invalidate()
+{
+    schemaVersion = -1;
+    tables.clear();
+    tableIndex.clear();
+}
+
+bool SchemaCatalog::refresh()
+{
+    QSqlDatabase db = QSqlDatabase::database(connectionName, false);
+    if (!db.isOpen()) {
+        invalidate();
+        return false;
+    }
+
+    // schema_version меняется при любом DDL, в том числе из других соединений
+    QSqlQuery versionQuery(db);
+    if (!versionQuery.exec(QStringLiteral("PRAGMA schema_version")) || !versionQuery.next()) {
+        error = versionQuery.lastError();
+        return false;
+    }
+    const qint64 version = versionQuery.value(0).toLongLong();
+    if (version == schemaVersion)
+        return true;
+
+    invalidate();
+    if (!load(db))
+        return false;
+    schemaVersion = version;
+    return true;
+}
+
+bool SchemaCatalog::load(QSqlDatabase &db)
+{
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+    if (!query.exec(QStringLiteral("SELECT name, type, sql FROM sqlite_master "
+                                   "WHERE type IN ('table', 'view') AND name NOT LIKE 'sqlite\\_%' ESCAPE '\\' "
+                                   "ORDER BY name"))) {
+        error = query.lastError();
+        return false;
+    }
+
+    while (query.next()) {
+        TableInfo table;
+        table.name = query.value(0).toString();
+        table.isView = query.value(1).toString() == QLatin1String("view");
+        table.isVirtual = query.value(2).toString().startsWith(QLatin1String("CREATE VIRTUAL"), Qt::CaseInsensitive);
+        table.withoutRowid = query.value(2).toString().contains(QLatin1String("WITHOUT ROWID"), Qt::CaseInsensitive);
+        tableIndex.insert(table.name.toLower(), int(tables.size()));
+        tables << table;
+    }
+
+    loadColumns(db);
+    loadIndexes(db);
+    error = QSqlError();
+    return true;
+}
+
+void SchemaCatalog::loadColumns(QSqlDatabase &db)
+{
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+    const QString bulk = QStringLiteral(
+        "SELECT m.name, p.name, p.type, p.\"notnull\", p.dflt_value, p.pk "
+        "FROM sqlite_master AS m JOIN pragma_table_info(m.name) AS p "
+        "WHERE m.type IN ('table', 'view') AND m.name NOT LIKE 'sqlite\\_%' ESCAPE '\\' "
+        "ORDER BY m.name, p.cid");
+
+    auto readColumn = [&query](TableInfo *table, int offset) {
+        ColumnInfo column;
+        column.name = query.value(offset).toString();
+        column.type = query.value(offset + 1).toString();
+        column.notNull = query.value(offset + 2).toBool();
+        column.defaultValue = query.value(offset + 3).toString();
+        column.primaryKeyIndex = query.value(offset + 4).toInt();
+        table->columns << column;
+    };
+
+    if (query.exec(bulk)) {
+        while (query.next()) {
+            if (TableInfo *table = findTable(query.value(0).toString()))
+                readColumn(table, 1);
+        }
+        if (!query.lastError().isValid())
+            return;
+    }
+
+    // Одно сломанное представление роняет общий запрос — тогда читаем по таблицам
+    for (TableInfo &table : tables) {
+        table.columns.clear();
+        if (query.exec(QStringLiteral("PRAGMA table_info(%1)").arg(quoteIdentifier(table.name)))) {
+            while (query.next())
+                readColumn(&table, 1);
+        }
+    }
+}
+
+void SchemaCatalog::loadIndexes(QSqlDatabase &db)
+{
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+    if (!query.exec(QStringLiteral(
+            "SELECT m.name, l.name, l.\"unique\", i.name "
+            "FROM sqlite_master AS m JOIN pragma_index_list(m.name) AS l JOIN pragma_index_info(l.name) AS i "
+            "WHERE m.type = 'table' AND m.name NOT LIKE 'sqlite\\_%' ESCAPE '\\' "
+            "ORDER BY m.name, l.name, i.seqno"))) {
+        return;
+    }
+
+    while (query.next()) {
+        TableInfo *table = findTable(query.value(0).toString());
+        if (!table)
+            continue;
+
+        const QString indexName = query.value(1).toString();
+        if (table->indexes.isEmpty() || table->indexes.last().name != indexName) {
+            IndexInfo index;
+            index.name = indexName;
+            index.unique = query.value(2).toBool();
+            table->indexes << index;
+        }
+        table->indexes.last().columns << query.value(3).toString();
+    }
+}
+
+TableInfo *SchemaCatalog::findTable(const QString &name)
+{
+    const auto it = tableIndex.constFind(name.toLower());
+    return it == tableIndex.cend() ? nullptr : &tables[*it];
+}
+
+QStringList SchemaCatalog::tableNames(bool includeViews) const
+{
+    QStringList names;
+    names.reserve(tables.size());
+    for (const TableInfo &table : tables) {
+        if (includeViews || !table.isView)
+            names << table.name;
+    }
+    return names;
+}
+
+const TableInfo *SchemaCatalog::table(const QString &name) const
+{
+    const auto it = tableIndex.constFind(name.toLower());
+    return it == tableIndex.cend() ? nullptr : &tables.at(*it);
+}
+
+QByteArray SchemaCatalog::snapshot() const
+{
+    QByteArray data;
+    QDataStream out(&data, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_6_0);
+    out << SnapshotMagic << schemaVersion << qint32(tables.size());
+    for (const TableInfo &table : tables) {
+        out << table.name << table.isView << table.isVirtual << table.withoutRowid;
+        out << qint32(table.columns.size());
+        for (const ColumnInfo &column : table.columns) {
+            out << column.name << column.type << column.defaultValue << column.notNull
+                << qint32(column.primaryKeyIndex);
+        }
+        out << qint32(table.indexes.size());
+        for (const IndexInfo &index : table.indexes)
+            out << index.name << index.columns << index.unique;
+    }
+    return data;
+}
+
+bool SchemaCatalog::restore(const QByteArray &snapshot)
+{
+    QDataStream in(snapshot);
+    in.setVersion(QDataStream::Qt_6_0);
+    quint32 magic = 0;
+    qint64 version = -1;
+    qint32 tableCount = 0;
+    in >> magic >> version >> tableCount;
+    if (in.status() != QDataStream::Ok || magic != SnapshotMagic || version < 0 || tableCount < 0)
+        return false;
+
+    QList<TableInfo> restored;
+    for (qint32 i = 0; i < tableCount && in.status() == QDataStream::Ok; ++i) {
+        TableInfo table;
+        qint32 count = 0;
+        in >> table.name >> table.isView >> table.isVirtual >> table.withoutRowid >> count;
+        for (qint32 j = 0; j < count && in.status() == QDataStream::Ok; ++j) {
+            ColumnInfo column;
+            qint32 primaryKeyIndex = 0;
+            in >> column.name >> column.type >> column.defaultValue >> column.notNull >> primaryKeyIndex;
+            column.primaryKeyIndex = primaryKeyIndex;
+            table.columns << column;
+        }
+        in >> count;
+        for (qint32 j = 0; j < count && in.status() == QDataStream::Ok; ++j) {
+            IndexInfo index;
+            in >> index.name >> index.columns >> index.unique;
+            table.indexes << index;
+        }
+        restored << table;
+    }
+    if (in.status() != QDataStream::Ok)
+        return false;
+
+    invalidate();
+    tables = restored;
+    for (int i = 0; i < tables.size(); ++i)
+        tableIndex.insert(tables.at(i).name.toLower(), i);
+    schemaVersion = version;
+    error = QSqlError();
+    return true;
+}
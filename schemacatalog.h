@@ -0,0 +1,76 @@
+#ifndef SCHEMACATALOG_H
+#define SCHEMACATALOG_H
+
+#include <QHash>
+#include <QList>
+#include <QSqlDatabase>
+#include <QSqlError>
+#include <QStringList>
+
+struct ColumnInfo
+{
+    QString name;
+    QString type;
+    QString defaultValue;
+    bool notNull = false;
+    int primaryKeyIndex = 0;    // позиция в первичном ключе, 0 — не входит
+};
+
+struct IndexInfo
+{
+    QString name;
+    QStringList columns;
+    bool unique = false;
+};
+
+struct TableInfo
+{
+    QString name;
+    bool isView = false;
+    bool isVirtual = false;
+    bool withoutRowid = false;
+    QList<ColumnInfo> columns;
+    QList<IndexInfo> indexes;
+
+    QStringList columnNames() const;
+    QStringList primaryKey() const;
+};
+
+// Кэш схемы базы: таблицы, представления, столбцы, первичные ключи и индексы.
+// Загружается несколькими запросами к sqlite_master и табличным функциям pragma_*
+// и перечитывается, только когда меняется PRAGMA schema_version.
+class SchemaCatalog
+{
+public:
+    explicit SchemaCatalog(const QString &connectionName = QString::fromLatin1(QSqlDatabase::defaultConnection));
+
+    // Проверяет schema_version и при необходимости перечитывает схему
+    bool refresh();
+    void invalidate();
+
+    QStringList tableNames(bool includeViews = false) const;
+    // Поиск без учёта регистра, как в самом SQLite; nullptr, если нет
+    const TableInfo *table(const QString &name) const;
+
+    QSqlError lastError() const { return error; }
+    bool isLoaded() const { return schemaVersion >= 0; }
+
+    // Снимок схемы вместе с schema_version, например для настроек: восстановленный
+    // каталог не читает схему заново, пока refresh() видит ту же версию
+    QByteArray snapshot() const;
+    bool restore(const QByteArray &snapshot);
+
+private:
+    bool load(QSqlDatabase &db);
+    void loadColumns(QSqlDatabase &db);
+    void loadIndexes(QSqlDatabase &db);
+    TableInfo *findTable(const QString &name);
+
+    QString connectionName;
+    qint64 schemaVersion = -1;
+    QList<TableInfo> tables;
+    QHash<QString, int> tableIndex;
+    QSqlError error;
+};
+
+#endif // SCHEMACATALOG_H
@@ -0,0 +1,122 @@
+#include "scriptresultpanel.h"
+#include "queryresultmodel.h"
+#include <QHeaderView>
+#include <QTabWidget>
+#include <QTableView>
+#include <QTreeWidget>
+#include <QVBoxLayout>
+
+namespace {
+
+enum MessageColumn {
+    NumberColumn,
+    LineColumn,
+    TimeColumn,
+    RowsColumn,
+    ChangesColumn,
+    TextColumn
+};
+
+}
+
+ScriptResultPanel::ScriptResultPanel(QWidget *parent)
+    : QWidget(parent),
+    tabs(new QTabWidget(this)),
+    messageTree(new QTreeWidget(this))
+{
+    messageTree->setColumnCount(6);
+    messageTree->setHeaderLabels({ tr("№"), tr("Строка"), tr("Время, мс"), tr("Строк"), tr("Изменено"),
+                                   tr("Запрос / ошибка") });
+    messageTree->setRootIsDecorated(false);
+    messageTree->setUniformRowHeights(true);
+    messageTree->header()->setSectionResizeMode(TextColumn, QHeaderView::Stretch);
+    messageTree->header()->setStretchLastSection(false);
+    connect(messageTree, &QTreeWidget::itemActivated, this, &ScriptResultPanel::activateItem);
+
+    tabs->addTab(messageTree, tr("Сообщения"));
+
+    auto *layout = new QVBoxLayout(this);
+    layout->setContentsMargins(0, 0, 0, 0);
+    layout->addWidget(tabs);
+}
+
+void ScriptResultPanel::clear()
+{
+    // Вкладка сообщений первая и остаётся
+    while (tabs->count() > 1) {
+        QWidget *page = tabs->widget(1);
+        tabs->removeTab(1);
+        delete page;
+    }
+    resultModels.clear();
+    skippedResults = 0;
+    messageTree->clear();
+    tabs->setTabText(0, tr("Сообщения"));
+    tabs->setCurrentIndex(0);
+}
+
+void ScriptResultPanel::addResultSet(int statement, const QStringList &columns)
+{
+    if (resultModels.size() >= MaxResultTabs) {
+        ++skippedResults;
+        return;
+    }
+
+    auto *view = new QTableView(tabs);
+    auto *model = new QueryResultModel(view);
+    model->setColumns(columns);
+    view->setModel(model);
+    view->setSelectionBehavior(QAbstractItemView::SelectRows);
+    view->horizontalHeader()->setSectionResizeMode(QHeaderView::Interactive);
+    resultModels.insert(statement, model);
+
+    tabs->addTab(view, tr("Результат %1").arg(resultModels.size()));
+    // Первый результат показываем сразу, остальные ждут во вкладках
+    if (resultModels.size() == 1)
+        tabs->setCurrentWidget(view);
+}
+
+void ScriptResultPanel::appendRows(int statement, const ResultSet &rows)
+{
+    if (QueryResultModel *model = resultModels.value(statement))
+        model->appendRows(rows);
+}
+
+void ScriptResultPanel::addStatementResults(const QList<StatementResult> &results)
+{
+    QList<QTreeWidgetItem *> items;
+    items.reserve(results.size());
+    for (const StatementResult &result : results) {
+        auto *item = new QTreeWidgetItem;
+        item->setText(NumberColumn, QString::number(result.index + 1));
+        item->setText(LineColumn, QString::number(result.line));
+        item->setText(TimeColumn, QString::number(result.elapsedUs / 1000.0, 'f', 3));
+        if (result.hasResult) {
+            item->setText(RowsColumn, result.truncated ? tr("%1 (не все показаны)").arg(result.rows)
+                                                       : QString::number(result.rows));
+        }
+        item->setText(ChangesColumn, QString::number(result.changes));
+        for (int column = NumberColumn; column <= ChangesColumn; ++column)
+            item->setTextAlignment(column, Qt::AlignRight | Qt::AlignVCenter);
+
+        // В списке запрос одной строкой, целиком - в подсказке
+        const QString text = result.error.isEmpty() ? result.sql.simplified() : result.error;
+        item->setText(TextColumn, text.left(200));
+        item->setToolTip(TextColumn, result.sql);
+        if (!result.error.isEmpty()) {
+            for (int column = NumberColumn; column <= TextColumn; ++column)
+                item->setForeground(column, Qt::red);
+        }
+        item->setData(NumberColumn, Qt::UserRole, result.line);
+        items << item;
+    }
+    messageTree->addTopLevelItems(items);
+
+    if (skippedResults > 0)
+        tabs->setTabText(0, tr("Сообщения (ещё %1 результатов не показано)").arg(skippedResults));
+}
+
+void ScriptResultPanel::activateItem(QTreeWidgetItem *item)
+{
+    emit statementActivated(item->data(NumberColumn, Qt::UserRole).toInt());
+}
@@ -0,0 +1,45 @@
+#ifndef SCRIPTRESULTPANEL_H
+#define SCRIPTRESULTPANEL_H
+
+#include "scriptrunner.h"
+#include <QHash>
+#include <QWidget>
+
+class QTabWidget;
+class QTreeWidget;
+class QTreeWidgetItem;
+class QueryResultModel;
+
+// Итоги выполнения скрипта: вкладка "Сообщения" со временем и числом строк
+// каждого оператора и по вкладке на каждый результат SELECT
+class ScriptResultPanel : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit ScriptResultPanel(QWidget *parent = nullptr);
+
+signals:
+    // Двойной щелчок по оператору: строка его начала в тексте скрипта
+    void statementActivated(int line);
+
+public slots:
+    void clear();
+    void addResultSet(int statement, const QStringList &columns);
+    void appendRows(int statement, const ResultSet &rows);
+    void addStatementResults(const QList<StatementResult> &results);
+
+private slots:
+    void activateItem(QTreeWidgetItem *item);
+
+private:
+    // Каждая вкладка - отдельная модель с данными в памяти
+    static constexpr int MaxResultTabs = 50;
+
+    QTabWidget *tabs;
+    QTreeWidget *messageTree;
+    QHash<int, QueryResultModel *> resultModels;
+    int skippedResults = 0;
+};
+
+#endif // SCRIPTRESULTPANEL_H
@@ -0,0 +1,244 @@
+#include "scriptrunner.h"
+#include <QSqlError>
+
+#include <sqlite3.h>
+
+static bool execSql(sqlite3 *db, const char *sql, QString *error = nullptr)
+{
+    char *message = nullptr;
+    const int rc = sqlite3_exec(db, sql, nullptr, nullptr, &message);
+    if (rc != SQLITE_OK && error)
+        *error = QString::fromUtf8(message ? message : sqlite3_errmsg(db));
+    sqlite3_free(message);
+    return rc == SQLITE_OK;
+}
+
+ScriptRunner::ScriptRunner(const QList<ScriptStatement> &statements, const ScriptOptions &options,
+                           const QString &sourceConnection, QObject *parent)
+    : BackgroundJob(parent),
+    statements(statements),
+    options(options),
+    sourceConnection(sourceConnection)
+{
+}
+
+QList<ScriptStatement> ScriptRunner::split(const QString &script)
+{
+    QList<ScriptStatement> result;
+    qsizetype start = 0;
+    int line = 1;
+    int startLine = 0;
+
+    auto append = [&](qsizetype end) {
+        const QString sql = script.mid(start, end - start).trimmed();
+        if (!firstKeyword(sql).isEmpty())
+            result.append(ScriptStatement { sql, startLine });
+    };
+
+    // Конец оператора - точка с запятой, после которой текст для SQLite полон
+    for (qsizetype i = 0; i < script.size(); ++i) {
+        const QChar ch = script.at(i);
+        if (ch == QLatin1Char('\n'))
+            ++line;
+        else if (startLine == 0 && !ch.isSpace())
+            startLine = line;
+
+        if (ch == QLatin1Char(';') && sqlite3_complete(script.mid(start, i - start + 1).toUtf8().constData())) {
+            append(i + 1);
+            start = i + 1;
+            startLine = 0;
+        }
+    }
+    append(script.size());
+    return result;
+}
+
+QString ScriptRunner::firstKeyword(const QString &sql)
+{
+    qsizetype i = 0;
+    while (i < sql.size()) {
+        if (sql.at(i).isSpace()) {
+            ++i;
+        } else if (sql.mid(i, 2) == QLatin1String("--")) {
+            i = sql.indexOf(QLatin1Char('\n'), i);
+            if (i < 0)
+                return QString();
+        } else if (sql.mid(i, 2) == QLatin1String("/*")) {
+            i = sql.indexOf(QLatin1String("*/"), i + 2);
+            if (i < 0)
+                return QString();
+            i += 2;
+        } else {
+            break;
+        }
+    }
+
+    qsizetype end = i;
+    while (end < sql.size() && (sql.at(end).isLetter() || sql.at(end) == QLatin1Char('_')))
+        ++end;
+    return sql.mid(i, end - i).toUpper();
+}
+
+bool ScriptRunner::needsAutocommit(const QString &sql)
+{
+    static const char *const keywords[] = { "BEGIN", "COMMIT", "END", "ROLLBACK", "VACUUM", "ATTACH", "DETACH" };
+    const QString keyword = firstKeyword(sql);
+    for (const char *candidate : keywords) {
+        if (keyword == QLatin1String(candidate))
+            return true;
+    }
+    return false;
+}
+
+void ScriptRunner::run()
+{
+    timer.start();
+    lastFlushMs = 0;
+
+    ScopedConnection connection(sourceConnection, QStringLiteral("script"));
+    sqlite3 *db = connection.open() ? connection.handle() : nullptr;
+    if (!db) {
+        emit failed(connection.lastError().text());
+        return;
+    }
+    interrupter.attach(db);
+
+    bool transaction = options.transaction;
+    if (transaction) {
+        for (const ScriptStatement &statement : std::as_const(statements)) {
+            if (needsAutocommit(statement.sql)) {
+                transaction = false;
+                emit warning(tr("Скрипт сам управляет транзакциями (строка %1), он выполняется без общей транзакции")
+                                 .arg(statement.line));
+                break;
+            }
+        }
+    }
+
+    QString errorText;
+    if (transaction && !execSql(db, "BEGIN IMMEDIATE", &errorText)) {
+        interrupter.detach();
+        emit failed(errorText);
+        return;
+    }
+
+    int executed = 0;
+    int errors = 0;
+    qint64 changes = 0;
+    for (int i = 0; i < statements.size() && !isCancelled(); ++i) {
+        StatementResult result;
+        const bool ok = execute(db, i, result);
+        ++executed;
+        changes += result.changes;
+        pendingResults << result;
+
+        if (!ok) {
+            ++errors;
+            // При некоторых ошибках SQLite сам откатывает транзакцию, продолжать её нельзя
+            const bool lost = transaction && sqlite3_get_autocommit(db);
+            if (options.stopOnError || lost) {
+                errorText = tr("Строка %1: %2").arg(QString::number(result.line), result.error);
+                break;
+            }
+        }
+        flushResults();
+        if (executed % BatchSize == 0)
+            emit progress(executed, int(statements.size()));
+    }
+    flushResults(true);
+
+    if (transaction) {
+        if (errorText.isEmpty() && !isCancelled()) {
+            if (!execSql(db, "COMMIT", &errorText))
+                execSql(db, "ROLLBACK");
+        } else if (!sqlite3_get_autocommit(db)) {
+            execSql(db, "ROLLBACK");
+        }
+    }
+
+    interrupter.detach();
+
+    if (isCancelled()) {
+        emit cancelled(executed);
+    } else if (!errorText.isEmpty()) {
+        emit failed(transaction ? tr("%1\nИзменения скрипта откатаны").arg(errorText) : errorText);
+    } else {
+        emit progress(executed, int(statements.size()));
+        emit finished(executed, errors, changes, timer.elapsed());
+    }
+}
+
+bool ScriptRunner::execute(sqlite3 *db, int index, StatementResult &result)
+{
+    const ScriptStatement &statement = statements.at(index);
+    result.index = index;
+    result.line = statement.line;
+    result.sql = statement.sql;
+
+    QElapsedTimer statementTimer;
+    statementTimer.start();
+    const int changesBefore = sqlite3_total_changes(db);
+
+    const QByteArray sql = statement.sql.toUtf8();
+    sqlite3_stmt *stmt = nullptr;
+    if (sqlite3_prepare_v2(db, sql.constData(), int(sql.size()), &stmt, nullptr) != SQLITE_OK) {
+        result.error = QString::fromUtf8(sqlite3_errmsg(db));
+        result.elapsedUs = statementTimer.nsecsElapsed() / 1000;
+        return false;
+    }
+    // Только комментарии
+    if (!stmt)
+        return true;
+
+    const int columnCount = sqlite3_column_count(stmt);
+    result.hasResult = columnCount > 0;
+    if (result.hasResult) {
+        QStringList columns;
+        for (int i = 0; i < columnCount; ++i)
+            columns << QString::fromUtf8(sqlite3_column_name(stmt, i));
+        // Итоги предыдущих операторов должны прийти раньше строк этого
+        flushResults(true);
+        emit resultStarted(index, columns);
+    }
+
+    ResultSet batch(columnCount);
+    int rc;
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        // Лишние строки досчитываются, но не передаются: оператор может что-то менять (RETURNING)
+        if (result.rows++ >= options.maxResultRows) {
+            result.truncated = true;
+            continue;
+        }
+        batch.appendRow(stmt);
+        if (batch.rowCount() >= BatchSize) {
+            emit resultRows(index, batch);
+            batch.clear();
+        }
+    }
+    if (!batch.isEmpty())
+        emit resultRows(index, batch);
+
+    if (rc != SQLITE_DONE)
+        result.error = QString::fromUtf8(sqlite3_errmsg(db));
+    sqlite3_finalize(stmt);
+
+    // Как в QueryWorker: строки самого оператора, без триггеров и каскадов FK;
+    // после DDL в sqlite3_changes() остаётся число от прошлого оператора
+    result.changes = sqlite3_total_changes(db) != changesBefore ? sqlite3_changes(db) : 0;
+    result.elapsedUs = statementTimer.nsecsElapsed() / 1000;
+    return result.error.isEmpty();
+}
+
+void ScriptRunner::flushResults(bool force)
+{
+    if (pendingResults.isEmpty())
+        return;
+
+    const qint64 elapsed = timer.elapsed();
+    if (!force && pendingResults.size() < BatchSize && elapsed - lastFlushMs < BatchIntervalMs)
+        return;
+
+    emit statementsFinished(pendingResults);
+    pendingResults.clear();
+    lastFlushMs = elapsed;
+}
@@ -0,0 +1,85 @@
+#ifndef SCRIPTRUNNER_H
+#define SCRIPTRUNNER_H
+
+#include "backgroundjob.h"
+#include "resultset.h"
+#include <QElapsedTimer>
+#include <QList>
+#include <QSqlDatabase>
+#include <QStringList>
+
+struct ScriptStatement
+{
+    QString sql;
+    int line = 1;           // строка начала в тексте скрипта, с единицы
+};
+
+struct StatementResult
+{
+    int index = 0;
+    int line = 1;
+    QString sql;
+    qint64 elapsedUs = 0;
+    qint64 rows = 0;        // строк в результате
+    qint64 changes = 0;     // изменено строк самим оператором, без триггеров
+    bool hasResult = false;
+    bool truncated = false; // показаны не все строки результата
+    QString error;
+};
+
+struct ScriptOptions
+{
+    // Весь скрипт одной транзакцией: одна синхронизация с диском вместо одной на оператор
+    bool transaction = true;
+    bool stopOnError = true;
+    int maxResultRows = 10000;
+};
+
+// Выполнение SQL-скрипта из нескольких операторов на отдельном соединении.
+// Текст делится на операторы по sqlite3_complete(), поэтому точки с запятой
+// в строках, комментариях и телах триггеров не разрывают оператор.
+// Итоги операторов отдаются порциями, строки каждого результата - отдельно.
+class ScriptRunner : public BackgroundJob
+{
+    Q_OBJECT
+
+public:
+    ScriptRunner(const QList<ScriptStatement> &statements, const ScriptOptions &options = ScriptOptions(),
+                 const QString &sourceConnection = QString::fromLatin1(QSqlDatabase::defaultConnection),
+                 QObject *parent = nullptr);
+
+    void run() override;
+
+    static QList<ScriptStatement> split(const QString &script);
+    // Первое ключевое слово оператора после пробелов и комментариев, в верхнем регистре
+    static QString firstKeyword(const QString &sql);
+    // BEGIN, COMMIT, VACUUM и т.п. нельзя выполнить внутри чужой транзакции
+    static bool needsAutocommit(const QString &sql);
+
+signals:
+    void resultStarted(int statement, const QStringList &columns);
+    void resultRows(int statement, const ResultSet &rows);
+    void statementsFinished(const QList<StatementResult> &results);
+    void progress(int statements, int total);
+    void warning(const QString &message);
+    void finished(int statements, int errors, qint64 changes, qint64 elapsedMs);
+    void cancelled(int statements);
+    void failed(const QString &message);
+
+private:
+    static constexpr int BatchSize = 500;
+    static constexpr int BatchIntervalMs = 100;
+
+    bool execute(sqlite3 *db, int index, StatementResult &result);
+    void flushResults(bool force = false);
+
+    QList<ScriptStatement> statements;
+    ScriptOptions options;
+    QString sourceConnection;
+
+    QList<StatementResult> pendingResults;
+    qint64 lastFlushMs = 0;
+    QElapsedTimer timer;
+};
+
+#endif // SCRIPTRUNNER_H
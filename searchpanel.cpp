@@ -0,0 +1,143 @@
+#include "searchpanel.h"
+#include <QCheckBox>
+#include <QHBoxLayout>
+#include <QHeaderView>
+#include <QLabel>
+#include <QLineEdit>
+#include <QPushButton>
+#include <QTreeWidget>
+#include <QVBoxLayout>
+
+namespace {
+
+enum ResultColumn {
+    TableColumn,
+    ColumnColumn,
+    KeyColumn,
+    ValueColumn
+};
+
+enum ResultRole {
+    KeyColumnRole = Qt::UserRole,
+    KeyRole
+};
+
+}
+
+SearchPanel::SearchPanel(QWidget *parent)
+    : QWidget(parent),
+    searchEdit(new QLineEdit(this)),
+    indexCheck(new QCheckBox(tr("FTS5-индексы"), this)),
+    searchButton(new QPushButton(tr("Найти"), this)),
+    stopButton(new QPushButton(tr("Стоп"), this)),
+    resultTree(new QTreeWidget(this)),
+    statusLabel(new QLabel(this))
+{
+    searchEdit->setPlaceholderText(tr("Текст для поиска во всех таблицах"));
+    searchEdit->setClearButtonEnabled(true);
+    setFocusProxy(searchEdit);
+    indexCheck->setToolTip(tr("Построить триграммные FTS5-индексы для текстовых столбцов.\n"
+                              "Первый поиск дольше, повторные - быстрее. Индексы хранятся в базе\n"
+                              "и поддерживаются триггерами, поэтому вставка и изменение строк замедлятся."));
+
+    resultTree->setColumnCount(4);
+    resultTree->setHeaderLabels({ tr("Таблица"), tr("Столбец"), tr("Ключ"), tr("Значение") });
+    resultTree->setUniformRowHeights(true);
+    resultTree->header()->setSectionResizeMode(ValueColumn, QHeaderView::Stretch);
+    resultTree->header()->setStretchLastSection(false);
+
+    connect(searchEdit, &QLineEdit::returnPressed, this, &SearchPanel::requestSearch);
+    connect(searchButton, &QPushButton::clicked, this, &SearchPanel::requestSearch);
+    connect(stopButton, &QPushButton::clicked, this, &SearchPanel::stopRequested);
+    connect(resultTree, &QTreeWidget::itemActivated, this, &SearchPanel::activateItem);
+
+    auto *searchLayout = new QHBoxLayout;
+    searchLayout->addWidget(searchEdit, 1);
+    searchLayout->addWidget(indexCheck);
+    searchLayout->addWidget(searchButton);
+    searchLayout->addWidget(stopButton);
+
+    auto *layout = new QVBoxLayout(this);
+    layout->setContentsMargins(0, 0, 0, 0);
+    layout->addLayout(searchLayout);
+    layout->addWidget(resultTree);
+    layout->addWidget(statusLabel);
+
+    setRunning(false);
+}
+
+QString SearchPanel::text() const
+{
+    return searchEdit->text();
+}
+
+void SearchPanel::addMatches(const QList<SearchMatch> &matches)
+{
+    for (const SearchMatch &match : matches) {
+        if (shownMatches >= MaxShownMatches)
+            return;
+
+        // Совпадения приходят из разных потоков вперемешку, группируем по таблице
+        QTreeWidgetItem *tableItem = nullptr;
+        const QList<QTreeWidgetItem *> found = resultTree->findItems(match.table, Qt::MatchExactly, TableColumn);
+        if (found.isEmpty()) {
+            tableItem = new QTreeWidgetItem(resultTree);
+            tableItem->setText(TableColumn, match.table);
+            tableItem->setExpanded(true);
+        } else {
+            tableItem = found.first();
+        }
+
+        auto *item = new QTreeWidgetItem(tableItem);
+        item->setText(ColumnColumn, match.column);
+        item->setText(KeyColumn, match.key.toString());
+        item->setText(ValueColumn, match.value);
+        item->setToolTip(ValueColumn, match.value);
+        item->setData(TableColumn, KeyColumnRole, match.keyColumn);
+        item->setData(TableColumn, KeyRole, match.key);
+        tableItem->setText(KeyColumn, tr("%1 совп.").arg(tableItem->childCount()));
+
+        if (++shownMatches == MaxShownMatches)
+            statusLabel->setText(tr("Показаны первые %1 совпадений, уточните запрос").arg(MaxShownMatches));
+    }
+}
+
+void SearchPanel::setRunning(bool running)
+{
+    searchButton->setEnabled(!running);
+    indexCheck->setEnabled(!running);
+    stopButton->setEnabled(running);
+}
+
+void SearchPanel::setStatus(const QString &status)
+{
+    if (shownMatches < MaxShownMatches)
+        statusLabel->setText(status);
+}
+
+void SearchPanel::clear()
+{
+    resultTree->clear();
+    statusLabel->clear();
+    shownMatches = 0;
+}
+
+void SearchPanel::requestSearch()
+{
+    const QString needle = searchEdit->text();
+    if (needle.isEmpty() || !searchButton->isEnabled())
+        return;
+
+    clear();
+    emit searchRequested(needle, indexCheck->isChecked());
+}
+
+void SearchPanel::activateItem(QTreeWidgetItem *item)
+{
+    // Строка таблицы-группы никуда не ведёт, как и совпадение без ключа
+    const QString keyColumn = item->data(TableColumn, KeyColumnRole).toString();
+    if (!item->parent() || keyColumn.isEmpty())
+        return;
+
+    emit matchActivated(item->parent()->text(TableColumn), keyColumn, item->data(TableColumn, KeyRole));
+}
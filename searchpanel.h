@@ -0,0 +1,53 @@
+#ifndef SEARCHPANEL_H
+#define SEARCHPANEL_H
+
+#include "databasesearch.h"
+#include <QWidget>
+
+class QCheckBox;
+class QLabel;
+class QLineEdit;
+class QPushButton;
+class QTreeWidget;
+class QTreeWidgetItem;
+
+// Панель поиска по всей базе: строка поиска и найденные значения,
+// сгруппированные по таблицам. Двойной щелчок открывает строку в таблице.
+class SearchPanel : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit SearchPanel(QWidget *parent = nullptr);
+
+    QString text() const;
+
+signals:
+    void searchRequested(const QString &text, bool useIndexes);
+    void stopRequested();
+    void matchActivated(const QString &table, const QString &keyColumn, const QVariant &key);
+
+public slots:
+    void addMatches(const QList<SearchMatch> &matches);
+    void setRunning(bool running);
+    void setStatus(const QString &status);
+    void clear();
+
+private slots:
+    void requestSearch();
+    void activateItem(QTreeWidgetItem *item);
+
+private:
+    // Больше строк дерево показывает медленно, а смотреть их никто не будет
+    static constexpr int MaxShownMatches = 5000;
+
+    QLineEdit *searchEdit;
+    QCheckBox *indexCheck;
+    QPushButton *searchButton;
+    QPushButton *stopButton;
+    QTreeWidget *resultTree;
+    QLabel *statusLabel;
+    int shownMatches = 0;
+};
+
+#endif // SEARCHPANEL_H
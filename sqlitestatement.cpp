@@ -0,0 +1,157 @@
+#include "sqlitestatement.h"
+#include "sqliteutil.h"
+
+#include <sqlite3.h>
+
+#include <utility>
+
+static_assert(SqliteStatement::Persistent == SQLITE_PREPARE_PERSISTENT, "SQLITE_PREPARE_PERSISTENT changed");
+
+SqliteStatement::SqliteStatement(sqlite3 *db, const QByteArray &sql, unsigned flags)
+{
+    prepare(db, sql, flags);
+}
+
+SqliteStatement::SqliteStatement(SqliteStatement &&other) noexcept
+    : db(std::exchange(other.db, nullptr)),
+    stmt(std::exchange(other.stmt, nullptr))
+{
+}
+
+SqliteStatement &SqliteStatement::operator=(SqliteStatement &&other) noexcept
+{
+    if (this != &other) {
+        finalize();
+        db = std::exchange(other.db, nullptr);
+        stmt = std::exchange(other.stmt, nullptr);
+    }
+    return *this;
+}
+
+SqliteStatement::~SqliteStatement()
+{
+    finalize();
+}
+
+bool SqliteStatement::prepare(sqlite3 *handle, const QByteArray &sql, unsigned flags)
+{
+    finalize();
+    db = handle;
+    if (!db)
+        return false;
+    if (sqlite3_prepare_v3(db, sql.constData(), int(sql.size()), flags, &stmt, nullptr) != SQLITE_OK) {
+        sqlite3_finalize(stmt);
+        stmt = nullptr;
+        return false;
+    }
+    return stmt != nullptr;
+}
+
+void SqliteStatement::finalize()
+{
+    sqlite3_finalize(stmt);
+    stmt = nullptr;
+}
+
+QString SqliteStatement::errorText() const
+{
+    return db ? QString::fromUtf8(sqlite3_errmsg(db)) : QStringLiteral("No database handle");
+}
+
+bool SqliteStatement::bind(int index, std::nullptr_t)
+{
+    return sqlite3_bind_null(stmt, index) == SQLITE_OK;
+}
+
+bool SqliteStatement::bind(int index, int value)
+{
+    return sqlite3_bind_int(stmt, index, value) == SQLITE_OK;
+}
+
+bool SqliteStatement::bind(int index, qint64 value)
+{
+    return sqlite3_bind_int64(stmt, index, value) == SQLITE_OK;
+}
+
+bool SqliteStatement::bind(int index, double value)
+{
+    return sqlite3_bind_double(stmt, index, value) == SQLITE_OK;
+}
+
+bool SqliteStatement::bind(int index, const QByteArray &utf8)
+{
+    return bind(index, utf8.constData(), int(utf8.size()));
+}
+
+bool SqliteStatement::bind(int index, const char *utf8, int size)
+{
+    // Ненулевой указатель, иначе SQLite привяжет NULL
+    return sqlite3_bind_text(stmt, index, utf8 ? utf8 : "", size, SQLITE_STATIC) == SQLITE_OK;
+}
+
+bool SqliteStatement::bindBlob(int index, const void *data, int size)
+{
+    return sqlite3_bind_blob(stmt, index, data ? data : "", size, SQLITE_STATIC) == SQLITE_OK;
+}
+
+bool SqliteStatement::bind(int index, const QVariant &value)
+{
+    return bindVariant(stmt, index, value) == SQLITE_OK;
+}
+
+int SqliteStatement::step()
+{
+    return stmt ? sqlite3_step(stmt) : SQLITE_MISUSE;
+}
+
+bool SqliteStatement::exec()
+{
+    const bool ok = step() == SQLITE_DONE;
+    reset();
+    return ok;
+}
+
+void SqliteStatement::reset()
+{
+    sqlite3_reset(stmt);
+}
+
+int SqliteStatement::columnCount() const
+{
+    return sqlite3_column_count(stmt);
+}
+
+const char *SqliteStatement::columnName(int column) const
+{
+    return sqlite3_column_name(stmt, column);
+}
+
+int SqliteStatement::columnType(int column) const
+{
+    return sqlite3_column_type(stmt, column);
+}
+
+qint64 SqliteStatement::columnInt64(int column) const
+{
+    return sqlite3_column_int64(stmt, column);
+}
+
+double SqliteStatement::columnDouble(int column) const
+{
+    return sqlite3_column_double(stmt, column);
+}
+
+const char *SqliteStatement::columnText(int column, int *size) const
+{
+    // Указатель берётся до длины, как требует SQLite
+    const char *data = reinterpret_cast<const char *>(sqlite3_column_text(stmt, column));
+    *size = sqlite3_column_bytes(stmt, column);
+    return data;
+}
+
+const char *SqliteStatement::columnBlob(int column, int *size) const
+{
+    const char *data = static_cast<const char *>(sqlite3_column_blob(stmt, column));
+    *size = sqlite3_column_bytes(stmt, column);
+    return data;
+}
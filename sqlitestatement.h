@@ -0,0 +1,77 @@
+#ifndef SQLITESTATEMENT_H
+#define SQLITESTATEMENT_H
+
+#include <QByteArray>
+#include <QString>
+#include <QVariant>
+
+#include <cstddef>
+
+struct sqlite3;
+struct sqlite3_stmt;
+
+// Подготовленный оператор на нативном дескрипторе, для массовых операций
+// без QSqlQuery, QVariant и перекодирования в UTF-16. Владеет sqlite3_stmt.
+// bind() перегружен по типу C++, и bindAll() раскладывает значения по параметрам
+// во время компиляции, без switch по типу QVariant. Текст и BLOB привязываются
+// с SQLITE_STATIC: буфер должен жить до step() или reset().
+// Указатели columnText()/columnBlob() действительны до следующего step() или reset().
+class SqliteStatement
+{
+public:
+    // SQLITE_PREPARE_PERSISTENT: оператор будет выполняться много раз
+    static constexpr unsigned Persistent = 0x01;
+
+    SqliteStatement() = default;
+    SqliteStatement(sqlite3 *db, const QByteArray &sql, unsigned flags = 0);
+    SqliteStatement(SqliteStatement &&other) noexcept;
+    SqliteStatement &operator=(SqliteStatement &&other) noexcept;
+    ~SqliteStatement();
+
+    bool prepare(sqlite3 *db, const QByteArray &sql, unsigned flags = 0);
+    void finalize();
+    bool isValid() const { return stmt != nullptr; }
+    sqlite3_stmt *handle() const { return stmt; }
+    QString errorText() const;
+
+    bool bind(int index, std::nullptr_t);
+    bool bind(int index, int value);
+    bool bind(int index, qint64 value);
+    bool bind(int index, double value);
+    // UTF-8 текст; пустой QByteArray - пустая строка, а не NULL
+    bool bind(int index, const QByteArray &utf8);
+    bool bind(int index, const char *utf8, int size);
+    bool bindBlob(int index, const void *data, int size);
+    // Когда тип известен только во время выполнения
+    bool bind(int index, const QVariant &value);
+
+    // Параметры с первого по порядку
+    template <typename... Values>
+    bool bindAll(const Values &...values)
+    {
+        int index = 0;
+        return (bind(++index, values) && ...);
+    }
+
+    // Код sqlite3_step: SQLITE_ROW, SQLITE_DONE или ошибка
+    int step();
+    // Шаг оператора без результата и сброс для следующего выполнения
+    bool exec();
+    void reset();
+
+    int columnCount() const;
+    const char *columnName(int column) const;
+    int columnType(int column) const;
+    qint64 columnInt64(int column) const;
+    double columnDouble(int column) const;
+    const char *columnText(int column, int *size) const;
+    const char *columnBlob(int column, int *size) const;
+
+private:
+    Q_DISABLE_COPY(SqliteStatement)
+
+    sqlite3 *db = nullptr;
+    sqlite3_stmt *stmt = nullptr;
+};
+
+#endif // SQLITESTATEMENT_H
@@ -0,0 +1,163 @@
+#include "sqliteutil.h"
+#include "changetracker.h"
+#include "connectionprofile.h"
+#include <QAtomicInt>
+#include <QObject>
+#include <QSqlDriver>
+#include <QSqlQuery>
+#include <QSqlResult>
+#include <QVariant>
+
+#include <sqlite3.h>
+
+sqlite3 *sqliteHandle(const QSqlDatabase &db)
+{
+    if (!db.isValid() || !db.driver())
+        return nullptr;
+
+    const QVariant handle = db.driver()->handle();
+    if (!handle.isValid() || qstrcmp(handle.typeName(), "sqlite3*") != 0)
+        return nullptr;
+
+    return *static_cast<sqlite3 *const *>(handle.constData());
+}
+
+sqlite3_stmt *sqliteStatement(const QSqlQuery &query)
+{
+    const QSqlResult *result = query.result();
+    if (!result)
+        return nullptr;
+
+    const QVariant handle = result->handle();
+    if (!handle.isValid() || qstrcmp(handle.typeName(), "sqlite3_stmt*") != 0)
+        return nullptr;
+
+    return *static_cast<sqlite3_stmt *const *>(handle.constData());
+}
+
+QString quoteIdentifier(const QString &name)
+{
+    QString escaped = name;
+    escaped.replace(QLatin1Char('"'), QLatin1String("\"\""));
+    return QLatin1Char('"') + escaped + QLatin1Char('"');
+}
+
+QString quoteString(const QString &text)
+{
+    QString escaped = text;
+    escaped.replace(QLatin1Char('\''), QLatin1String("''"));
+    return QLatin1Char('\'') + escaped + QLatin1Char('\'');
+}
+
+int bindVariant(sqlite3_stmt *stmt, int index, const QVariant &value)
+{
+    if (value.isNull())
+        return sqlite3_bind_null(stmt, index);
+
+    switch (value.typeId()) {
+    case QMetaType::Bool:
+    case QMetaType::Int:
+    case QMetaType::UInt:
+    case QMetaType::LongLong:
+    case QMetaType::ULongLong:
+        return sqlite3_bind_int64(stmt, index, value.toLongLong());
+    case QMetaType::Double:
+    case QMetaType::Float:
+        return sqlite3_bind_double(stmt, index, value.toDouble());
+    case QMetaType::QByteArray: {
+        const QByteArray bytes = value.toByteArray();
+        return sqlite3_bind_blob64(stmt, index, bytes.constData(), sqlite3_uint64(bytes.size()), SQLITE_TRANSIENT);
+    }
+    default: {
+        const QByteArray text = value.toString().toUtf8();
+        return sqlite3_bind_text64(stmt, index, text.constData(), sqlite3_uint64(text.size()),
+                                   SQLITE_TRANSIENT, SQLITE_UTF8);
+    }
+    }
+}
+
+ScopedConnection::ScopedConnection(const QString &sourceConnection, const QString &purpose)
+    : source(sourceConnection)
+{
+    static QAtomicInt counter;
+    name = QStringLiteral("cachedtable_%1_%2").arg(purpose).arg(counter.fetchAndAddRelaxed(1));
+
+    // Перегрузка по имени соединения потокобезопасна
+    QSqlDatabase::cloneDatabase(sourceConnection, name);
+}
+
+ScopedConnection::~ScopedConnection()
+{
+    {
+        QSqlDatabase db = QSqlDatabase::database(name, false);
+        if (tracker)
+            tracker->detach(sqliteHandle(db));
+        if (db.isOpen())
+            db.close();
+    }
+    QSqlDatabase::removeDatabase(name);
+}
+
+bool ScopedConnection::open()
+{
+    QSqlDatabase db = QSqlDatabase::database(name, false);
+    if (!db.isValid())
+        return false;
+    if (db.isOpen())
+        return true;
+    if (!db.open())
+        return false;
+
+    if (const auto profile = ConnectionProfile::forConnection(source))
+        applyConnectionProfile(db, *profile, false);
+    tracker = ChangeTracker::forConnection(source);
+    if (tracker)
+        tracker->attach(sqliteHandle(db));
+    return true;
+}
+
+bool ScopedConnection::isOpen() const
+{
+    return QSqlDatabase::database(name, false).isOpen();
+}
+
+QSqlDatabase ScopedConnection::database() const
+{
+    return QSqlDatabase::database(name, false);
+}
+
+QSqlError ScopedConnection::lastError() const
+{
+    QSqlDatabase db = QSqlDatabase::database(name, false);
+    if (!db.isValid())
+        return QSqlError(QObject::tr("Нет исходного соединения"), QString(), QSqlError::ConnectionError);
+    return db.lastError();
+}
+
+sqlite3 *ScopedConnection::handle() const
+{
+    return sqliteHandle(QSqlDatabase::database(name, false));
+}
+
+void QueryInterrupter::attach(sqlite3 *db)
+{
+    QMutexLocker locker(&mutex);
+    handle = db;
+    if (interrupted && handle)
+        sqlite3_interrupt(handle);
+}
+
+void QueryInterrupter::detach()
+{
+    QMutexLocker locker(&mutex);
+    handle = nullptr;
+}
+
+void QueryInterrupter::interrupt()
+{
+    interrupted = true;
+
+    QMutexLocker locker(&mutex);
+    if (handle)
+        sqlite3_interrupt(handle);
+}
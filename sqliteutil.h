@@ -0,0 +1,74 @@
+#ifndef SQLITEUTIL_H
+#define SQLITEUTIL_H
+
+#include <QMutex>
+#include <QSqlDatabase>
+#include <QSqlError>
+#include <QString>
+
+#include <atomic>
+#include <memory>
+
+class ChangeTracker;
+struct sqlite3;
+struct sqlite3_stmt;
+class QSqlQuery;
+
+// Нативные дескрипторы SQLite, которые драйвер QSQLITE отдаёт через handle()
+sqlite3 *sqliteHandle(const QSqlDatabase &db);
+sqlite3_stmt *sqliteStatement(const QSqlQuery &query);
+
+// Экранирование имени таблицы/столбца для подстановки в текст запроса
+QString quoteIdentifier(const QString &name);
+// Строковый литерал в одинарных кавычках
+QString quoteString(const QString &text);
+
+// Привязка QVariant к параметру подготовленного запроса напрямую через C API;
+// возвращает код sqlite3_bind_*
+int bindVariant(sqlite3_stmt *stmt, int index, const QVariant &value);
+
+// Собственное соединение для рабочего потока.
+// Клонирует исходное соединение и удаляет клон в деструкторе,
+// поэтому создавать, использовать и уничтожать его нужно в одном потоке.
+// При открытии применяет профиль настроек исходного соединения
+// и подключается к его ChangeTracker, если он есть.
+class ScopedConnection
+{
+public:
+    explicit ScopedConnection(const QString &sourceConnection = QString::fromLatin1(QSqlDatabase::defaultConnection),
+                              const QString &purpose = QStringLiteral("worker"));
+    ~ScopedConnection();
+
+    bool open();
+    bool isOpen() const;
+
+    QSqlDatabase database() const;
+    QSqlError lastError() const;
+    QString connectionName() const { return name; }
+    sqlite3 *handle() const;
+
+private:
+    Q_DISABLE_COPY(ScopedConnection)
+
+    QString source;
+    QString name;
+    std::shared_ptr<ChangeTracker> tracker;
+};
+
+// Позволяет прервать запрос, который выполняется в другом потоке.
+// Рабочий поток привязывает свой дескриптор на время работы соединения.
+class QueryInterrupter
+{
+public:
+    void attach(sqlite3 *handle);
+    void detach();
+    void interrupt();
+    bool isInterrupted() const { return interrupted; }
+
+private:
+    QMutex mutex;
+    sqlite3 *handle = nullptr;
+    std::atomic<bool> interrupted { false };
+};
+
+#endif // SQLITEUTIL_H
@@ -0,0 +1,186 @@
+#include "statementcache.h"
+#include <QMutex>
+
+#include <algorithm>
+
+static QMutex cachesMutex;
+static QHash<QString, StatementCache *> connectionCaches;
+
+StatementCache::StatementCache(const QString &connectionName, int capacity)
+    : connectionName(connectionName),
+    maxSize(qMax(1, capacity))
+{
+}
+
+StatementCache::~StatementCache()
+{
+    clear();
+}
+
+std::shared_ptr<QSqlQuery> StatementCache::prepare(const QString &sql, QSqlError *error)
+{
+    QSqlDatabase db = QSqlDatabase::database(connectionName, false);
+    checkSchema(db);
+
+    const QString key = normalize(sql);
+    auto it = statements.find(key);
+    if (it != statements.end()) {
+        ++counters.hits;
+        ++it->hits;
+        it->lastUse = ++useCounter;
+        // Незавершённое чтение держало бы транзакцию чтения открытой
+        it->query->finish();
+        return it->query;
+    }
+
+    ++counters.misses;
+    auto query = std::make_shared<QSqlQuery>(db);
+    query->setForwardOnly(true);
+    if (!query->prepare(sql)) {
+        if (error)
+            *error = query->lastError();
+        return nullptr;
+    }
+
+    if (statements.size() >= maxSize)
+        evict();
+    statements.insert(key, Statement { query, ++useCounter, 0 });
+    return query;
+}
+
+void StatementCache::clear()
+{
+    for (const Statement &statement : std::as_const(statements))
+        statement.query->finish();
+    statements.clear();
+    versionQuery.reset();
+    schemaVersion = -1;
+}
+
+void StatementCache::setCapacity(int capacity)
+{
+    maxSize = qMax(1, capacity);
+    while (statements.size() > maxSize)
+        evict();
+}
+
+StatementCache::Stats StatementCache::stats() const
+{
+    Stats result = counters;
+    result.size = int(statements.size());
+    result.capacity = maxSize;
+    return result;
+}
+
+QList<StatementCache::Entry> StatementCache::entries() const
+{
+    QList<QPair<quint64, Entry>> ordered;
+    for (auto it = statements.cbegin(); it != statements.cend(); ++it)
+        ordered.append(qMakePair(it->lastUse, Entry { it.key(), it->hits }));
+    std::sort(ordered.begin(), ordered.end(), [](const auto &a, const auto &b) { return a.first > b.first; });
+
+    QList<Entry> result;
+    for (const auto &item : std::as_const(ordered))
+        result << item.second;
+    return result;
+}
+
+QString StatementCache::normalize(const QString &sql)
+{
+    // Пробелы внутри строк и идентификаторов в кавычках значимы, остальные схлопываются.
+    // Комментарии -- и /* */ заменяются пробелом: иначе "-- x\nFROM t" и "-- x FROM t"
+    // дали бы один ключ, хотя во втором FROM закомментирован
+    QString result;
+    result.reserve(sql.size());
+    QChar quote;
+    bool pendingSpace = false;
+    const qsizetype size = sql.size();
+    for (qsizetype i = 0; i < size; ++i) {
+        const QChar c = sql.at(i);
+        if (quote.isNull()) {
+            const QChar next = i + 1 < size ? sql.at(i + 1) : QChar();
+            if (c == QLatin1Char('-') && next == QLatin1Char('-')) {
+                while (i + 1 < size && sql.at(i + 1) != QLatin1Char('\n'))
+                    ++i;
+                pendingSpace = !result.isEmpty();
+                continue;
+            }
+            if (c == QLatin1Char('/') && next == QLatin1Char('*')) {
+                const qsizetype close = sql.indexOf(QLatin1String("*/"), i + 2);
+                i = close < 0 ? size : close + 1;
+                pendingSpace = !result.isEmpty();
+                continue;
+            }
+            if (c.isSpace()) {
+                pendingSpace = !result.isEmpty();
+                continue;
+            }
+            if (pendingSpace)
+                result += QLatin1Char(' ');
+            pendingSpace = false;
+            if (c == QLatin1Char('\'') || c == QLatin1Char('"') || c == QLatin1Char('`'))
+                quote = c;
+            else if (c == QLatin1Char('['))
+                quote = QLatin1Char(']');
+        } else if (c == quote) {
+            quote = QChar();
+        }
+        result += c;
+    }
+    return result;
+}
+
+StatementCache &StatementCache::forConnection(const QString &connectionName)
+{
+    QMutexLocker locker(&cachesMutex);
+    StatementCache *&cache = connectionCaches[connectionName];
+    if (!cache)
+        cache = new StatementCache(connectionName);
+    return *cache;
+}
+
+void StatementCache::removeForConnection(const QString &connectionName)
+{
+    QMutexLocker locker(&cachesMutex);
+    delete connectionCaches.take(connectionName);
+}
+
+void StatementCache::checkSchema(const QSqlDatabase &db)
+{
+    // Одно чтение заголовка базы дешевле подготовки запроса; при смене схемы
+    // старые запросы могли бы вернуть другой набор столбцов
+    if (!versionQuery) {
+        versionQuery = std::make_unique<QSqlQuery>(db);
+        versionQuery->setForwardOnly(true);
+        if (!versionQuery->prepare(QStringLiteral("PRAGMA schema_version"))) {
+            versionQuery.reset();
+            return;
+        }
+    }
+    if (!versionQuery->exec() || !versionQuery->next())
+        return;
+    const qint64 version = versionQuery->value(0).toLongLong();
+    versionQuery->finish();
+
+    if (version == schemaVersion)
+        return;
+    if (schemaVersion >= 0 && !statements.isEmpty())
+        ++counters.invalidations;
+    for (const Statement &statement : std::as_const(statements))
+        statement.query->finish();
+    statements.clear();
+    schemaVersion = version;
+}
+
+void StatementCache::evict()
+{
+    auto oldest = statements.begin();
+    for (auto it = statements.begin(); it != statements.end(); ++it) {
+        if (it->lastUse < oldest->lastUse)
+            oldest = it;
+    }
+    if (oldest != statements.end()) {
+        statements.erase(oldest);
+        ++counters.evictions;
+    }
+}
@@ -0,0 +1,82 @@
+#ifndef STATEMENTCACHE_H
+#define STATEMENTCACHE_H
+
+#include <QHash>
+#include <QList>
+#include <QSqlDatabase>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QString>
+
+#include <memory>
+
+// LRU-кэш подготовленных запросов одного соединения.
+// Ключ - текст SQL со схлопнутыми пробелами вне литералов. Перед выдачей запроса
+// сверяется PRAGMA schema_version, при её смене кэш очищается целиком.
+// Кэш принадлежит потоку соединения; параметры привязываются по номеру
+// (bindValue(i, ...)), потому что запрос переиспользуется между вызовами.
+class StatementCache
+{
+public:
+    struct Entry
+    {
+        QString sql;
+        qint64 hits = 0;
+    };
+
+    struct Stats
+    {
+        qint64 hits = 0;
+        qint64 misses = 0;
+        qint64 evictions = 0;
+        qint64 invalidations = 0;
+        int size = 0;
+        int capacity = 0;
+    };
+
+    explicit StatementCache(const QString &connectionName, int capacity = DefaultCapacity);
+    ~StatementCache();
+
+    // Подготовленный запрос, готовый к exec(); nullptr и error при ошибке подготовки
+    std::shared_ptr<QSqlQuery> prepare(const QString &sql, QSqlError *error = nullptr);
+    void clear();
+
+    int capacity() const { return maxSize; }
+    void setCapacity(int capacity);
+    Stats stats() const;
+    // От недавно использованных к давним
+    QList<Entry> entries() const;
+
+    // Ключ кэша: комментарии убраны, пробелы вне кавычек и [идентификаторов] схлопнуты
+    static QString normalize(const QString &sql);
+
+    // Кэш на соединение, создаётся при первом обращении.
+    // Удалять нужно до QSqlDatabase::removeDatabase, иначе соединение останется занятым
+    static StatementCache &forConnection(const QString &connectionName);
+    static void removeForConnection(const QString &connectionName);
+
+    static constexpr int DefaultCapacity = 64;
+
+private:
+    Q_DISABLE_COPY(StatementCache)
+
+    struct Statement
+    {
+        std::shared_ptr<QSqlQuery> query;
+        quint64 lastUse = 0;
+        qint64 hits = 0;
+    };
+
+    void checkSchema(const QSqlDatabase &db);
+    void evict();
+
+    QString connectionName;
+    int maxSize;
+    QHash<QString, Statement> statements;
+    std::unique_ptr<QSqlQuery> versionQuery;
+    qint64 schemaVersion = -1;
+    quint64 useCounter = 0;
+    Stats counters;
+};
+
+#endif // STATEMENTCACHE_H
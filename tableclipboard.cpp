@@ -0,0 +1,358 @@
+#include "tableclipboard.h"
+#include "csvparser.h"
+#include "pagedtablemodel.h"
+#include "sqliteutil.h"
+
+#include <sqlite3.h>
+
+#include <algorithm>
+#include <vector>
+
+static QVariant columnValue(sqlite3_stmt *stmt, int column)
+{
+    switch (sqlite3_column_type(stmt, column)) {
+    case SQLITE_INTEGER:
+        return qint64(sqlite3_column_int64(stmt, column));
+    case SQLITE_FLOAT:
+        return sqlite3_column_double(stmt, column);
+    case SQLITE_NULL:
+        return QVariant();
+    case SQLITE_BLOB:
+        return QByteArray(static_cast<const char *>(sqlite3_column_blob(stmt, column)),
+                          sqlite3_column_bytes(stmt, column));
+    default:
+        return QString::fromUtf8(reinterpret_cast<const char *>(sqlite3_column_text(stmt, column)),
+                                 sqlite3_column_bytes(stmt, column));
+    }
+}
+
+static sqlite3_stmt *prepareRange(sqlite3 *db, const PagedTableModel *model, int first, int count,
+                                  const QList<int> &columnList, QString *error)
+{
+    QVariantList binds;
+    const QByteArray sql = model->rangeStatement(first, count, columnList, &binds).toUtf8();
+    sqlite3_stmt *stmt = nullptr;
+    if (sqlite3_prepare_v2(db, sql.constData(), int(sql.size()), &stmt, nullptr) != SQLITE_OK) {
+        if (error)
+            *error = QString::fromUtf8(sqlite3_errmsg(db));
+        sqlite3_finalize(stmt);
+        return nullptr;
+    }
+    for (qsizetype i = 0; i < binds.size(); ++i)
+        bindVariant(stmt, int(i) + 1, binds.at(i));
+    return stmt;
+}
+
+TableMimeData::TableMimeData(const QByteArray &tsv)
+    : tsv(tsv)
+{
+}
+
+QStringList TableMimeData::formats() const
+{
+    return { QStringLiteral("text/plain"), QStringLiteral("text/tab-separated-values"),
+             QStringLiteral("text/csv"), QStringLiteral("text/html") };
+}
+
+bool TableMimeData::hasFormat(const QString &mimeType) const
+{
+    return formats().contains(mimeType);
+}
+
+QVariant TableMimeData::retrieveData(const QString &mimeType, QMetaType type) const
+{
+    if (mimeType == QLatin1String("text/plain") || mimeType == QLatin1String("text/tab-separated-values")) {
+        if (type.id() == QMetaType::QString)
+            return QString::fromUtf8(tsv);
+        return tsv;
+    }
+
+    if (mimeType != QLatin1String("text/csv") && mimeType != QLatin1String("text/html"))
+        return QMimeData::retrieveData(mimeType, type);
+
+    // Производные форматы нужны редко, поэтому строятся, только когда их попросят
+    const bool wantCsv = mimeType == QLatin1String("text/csv");
+    QByteArray &cached = wantCsv ? csv : html;
+    if (cached.isEmpty() && !tsv.isEmpty()) {
+        CsvRecords records;
+        CsvParser('\t', false).parse(tsv.constData(), tsv.constData() + tsv.size(), records);
+
+        cached.reserve(wantCsv ? tsv.size() + tsv.size() / 8 : tsv.size() * 2 + 64);
+        if (!wantCsv)
+            cached += "<table>\n";
+        for (qsizetype row = 0; row < records.rowCount(); ++row) {
+            const CsvField *fields = records.row(row);
+            if (!wantCsv)
+                cached += "<tr>";
+            for (qsizetype i = 0; i < records.fieldCount(row); ++i) {
+                if (wantCsv) {
+                    if (i > 0)
+                        cached += ',';
+                    TableClipboard::appendField(cached, fields[i].data, fields[i].size, ',');
+                } else {
+                    cached += "<td>";
+                    if (fields[i].data)
+                        cached += QString::fromUtf8(fields[i].data, fields[i].size).toHtmlEscaped().toUtf8();
+                    cached += "</td>";
+                }
+            }
+            cached += wantCsv ? "\n" : "</tr>\n";
+        }
+        if (!wantCsv)
+            cached += "</table>\n";
+    }
+
+    if (type.id() == QMetaType::QString)
+        return QString::fromUtf8(cached);
+    return cached;
+}
+
+void TableClipboard::appendField(QByteArray &out, const char *data, qsizetype size, char delimiter)
+{
+    if (!data)
+        return;
+
+    bool needsQuotes = size == 0;
+    for (qsizetype i = 0; i < size && !needsQuotes; ++i) {
+        const char ch = data[i];
+        needsQuotes = ch == delimiter || ch == '"' || ch == '\n' || ch == '\r';
+    }
+
+    if (!needsQuotes) {
+        out.append(data, size);
+        return;
+    }
+
+    out += '"';
+    for (qsizetype i = 0; i < size; ++i) {
+        if (data[i] == '"')
+            out += '"';
+        out += data[i];
+    }
+    out += '"';
+}
+
+QByteArray TableClipboard::copy(const QAbstractItemModel *model, const QItemSelection &selection,
+                                qint64 *cells, QString *error)
+{
+    // Общая сетка: слитые интервалы строк и отсортированные столбцы всех диапазонов
+    QList<QPair<int, int>> rowRanges;
+    QList<int> columnList;
+    qint64 selectedCells = 0;
+    for (const QItemSelectionRange &range : selection) {
+        if (!range.isValid())
+            continue;
+        rowRanges << qMakePair(range.top(), range.bottom());
+        for (int column = range.left(); column <= range.right(); ++column)
+            columnList << column;
+        selectedCells += qint64(range.width()) * range.height();
+    }
+    if (cells)
+        *cells = selectedCells;
+    if (rowRanges.isEmpty())
+        return QByteArray();
+
+    std::sort(columnList.begin(), columnList.end());
+    columnList.erase(std::unique(columnList.begin(), columnList.end()), columnList.end());
+
+    std::sort(rowRanges.begin(), rowRanges.end());
+    QList<QPair<int, int>> merged;
+    for (const auto &range : std::as_const(rowRanges)) {
+        if (!merged.isEmpty() && range.first <= merged.last().second + 1)
+            merged.last().second = qMax(merged.last().second, range.second);
+        else
+            merged << range;
+    }
+
+    qint64 totalRows = 0;
+    for (const auto &range : std::as_const(merged))
+        totalRows += range.second - range.first + 1;
+
+    const bool rectangle = selection.size() == 1;
+
+    // Набор выделенных столбцов меняется только на границах диапазонов, поэтому
+    // маска столбцов считается один раз на полосу строк между соседними границами
+    QList<int> bandStarts;
+    std::vector<std::vector<bool>> bandMasks;
+    if (!rectangle) {
+        for (const QItemSelectionRange &range : selection) {
+            if (range.isValid())
+                bandStarts << range.top() << range.bottom() + 1;
+        }
+        std::sort(bandStarts.begin(), bandStarts.end());
+        bandStarts.erase(std::unique(bandStarts.begin(), bandStarts.end()), bandStarts.end());
+
+        bandMasks.resize(size_t(bandStarts.size()));
+        for (qsizetype band = 0; band < bandStarts.size(); ++band) {
+            std::vector<bool> &mask = bandMasks[size_t(band)];
+            mask.assign(size_t(columnList.size()), false);
+            const int row = bandStarts.at(band);
+            for (const QItemSelectionRange &range : selection) {
+                if (!range.isValid() || row < range.top() || row > range.bottom())
+                    continue;
+                auto column = std::lower_bound(columnList.cbegin(), columnList.cend(), range.left());
+                for (; column != columnList.cend() && *column <= range.right(); ++column)
+                    mask[size_t(column - columnList.cbegin())] = true;
+            }
+        }
+    }
+    // Строки обходятся по возрастанию, поэтому полоса только сдвигается вперёд
+    qsizetype band = 0;
+    auto columnMask = [&](int row) -> const std::vector<bool> * {
+        if (rectangle)
+            return nullptr;
+        while (band + 1 < bandStarts.size() && bandStarts.at(band + 1) <= row)
+            ++band;
+        return &bandMasks[size_t(band)];
+    };
+    const auto *paged = qobject_cast<const PagedTableModel *>(model);
+    sqlite3 *db = paged && !paged->isDirty() ? sqliteHandle(paged->database()) : nullptr;
+
+    QByteArray out;
+    out.reserve(qsizetype(qMin<qint64>(totalRows * columnList.size() * 8, MaxReserve)));
+    qint64 rowsDone = 0;
+
+    // После первых строк ёмкость выставляется по их среднему размеру, чтобы буфер не перевыделялся
+    auto finishRow = [&]() {
+        out += '\n';
+        if (++rowsDone == SampleRows && totalRows > SampleRows)
+            out.reserve(qsizetype(qMin<qint64>(out.size() / SampleRows * totalRows * 11 / 10, MaxReserve)));
+    };
+
+    for (const auto &range : std::as_const(merged)) {
+        if (db) {
+            sqlite3_stmt *stmt = prepareRange(db, paged, range.first, range.second - range.first + 1,
+                                              columnList, error);
+            if (!stmt)
+                return QByteArray();
+
+            int row = range.first;
+            int rc;
+            while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+                const std::vector<bool> *mask = columnMask(row);
+                for (qsizetype i = 0; i < columnList.size(); ++i) {
+                    if (i > 0)
+                        out += '\t';
+                    if (mask && !(*mask)[size_t(i)])
+                        continue;
+
+                    // Столбец 0 - ключ строки
+                    const int column = int(i) + 1;
+                    const int type = sqlite3_column_type(stmt, column);
+                    if (type == SQLITE_NULL)
+                        continue;
+                    const void *data = type == SQLITE_BLOB ? sqlite3_column_blob(stmt, column)
+                                                           : static_cast<const void *>(sqlite3_column_text(stmt, column));
+                    appendField(out, data ? static_cast<const char *>(data) : "", sqlite3_column_bytes(stmt, column));
+                }
+                finishRow();
+                ++row;
+            }
+            if (rc != SQLITE_DONE && error)
+                *error = QString::fromUtf8(sqlite3_errmsg(db));
+            sqlite3_finalize(stmt);
+            if (rc != SQLITE_DONE)
+                return QByteArray();
+        } else {
+            // Результаты запросов и таблица с несохранёнными правками - через модель
+            for (int row = range.first; row <= range.second; ++row) {
+                const std::vector<bool> *mask = columnMask(row);
+                for (qsizetype i = 0; i < columnList.size(); ++i) {
+                    if (i > 0)
+                        out += '\t';
+                    if (mask && !(*mask)[size_t(i)])
+                        continue;
+                    const QVariant value = model->index(row, columnList.at(i)).data(Qt::EditRole);
+                    if (value.isNull())
+                        continue;
+                    const QByteArray bytes = value.typeId() == QMetaType::QByteArray ? value.toByteArray()
+                                                                                     : value.toString().toUtf8();
+                    appendField(out, bytes.constData(), bytes.size());
+                }
+                finishRow();
+            }
+        }
+    }
+    return out;
+}
+
+bool TableClipboard::pasteChanges(const PagedTableModel *model, int row, int column, const QByteArray &tsv,
+                                  QList<RowChange> *changes, QString *error)
+{
+    CsvRecords records;
+    // Пробелы по краям ячеек таблицы - часть значения
+    CsvParser('\t', false).parse(tsv.constData(), tsv.constData() + tsv.size(), records);
+    if (records.rowCount() == 0) {
+        *error = tr("В буфере обмена нет данных");
+        return false;
+    }
+
+    qsizetype width = 0;
+    for (qsizetype i = 0; i < records.rowCount(); ++i)
+        width = qMax(width, records.fieldCount(i));
+    // Столбцы правее последнего отбрасываются
+    const int columnCount = int(qMin<qsizetype>(width, model->columnCount() - column));
+    if (columnCount <= 0) {
+        *error = tr("Некуда вставлять: столбец вне таблицы");
+        return false;
+    }
+
+    QList<int> columnList;
+    for (int i = 0; i < columnCount; ++i)
+        columnList << column + i;
+
+    auto fieldValue = [](const CsvField &field) {
+        return field.data ? QVariant(QString::fromUtf8(field.data, field.size)) : QVariant();
+    };
+
+    const int existing = int(qMin<qsizetype>(records.rowCount(), qMax(0, model->rowCount() - row)));
+    changes->reserve(records.rowCount());
+
+    // Ключи и текущие значения перезаписываемых строк: по ним BatchSubmitter заметит чужие изменения
+    if (existing > 0) {
+        if (model->keyColumn().isEmpty()) {
+            *error = tr("У таблицы нет ключа строк, существующие строки обновить нельзя");
+            return false;
+        }
+        sqlite3 *db = sqliteHandle(model->database());
+        sqlite3_stmt *stmt = db ? prepareRange(db, model, row, existing, columnList, error) : nullptr;
+        if (!stmt) {
+            if (error->isEmpty())
+                *error = tr("Нет соединения с базой");
+            return false;
+        }
+
+        int read = 0;
+        while (read < existing && sqlite3_step(stmt) == SQLITE_ROW) {
+            RowChange change;
+            change.row = row + read;
+            change.key = columnValue(stmt, 0);
+            const CsvField *fields = records.row(read);
+            const qsizetype count = qMin<qsizetype>(records.fieldCount(read), columnCount);
+            for (qsizetype i = 0; i < count; ++i) {
+                change.values.insert(column + int(i), fieldValue(fields[i]));
+                change.original.insert(column + int(i), columnValue(stmt, int(i) + 1));
+            }
+            changes->append(change);
+            ++read;
+        }
+        sqlite3_finalize(stmt);
+
+        if (read < existing) {
+            changes->clear();
+            *error = tr("Строки таблицы изменились, обновите её и повторите вставку");
+            return false;
+        }
+    }
+
+    for (qsizetype i = existing; i < records.rowCount(); ++i) {
+        RowChange change;
+        change.row = row + int(i);
+        const CsvField *fields = records.row(i);
+        const qsizetype count = qMin<qsizetype>(records.fieldCount(i), columnCount);
+        for (qsizetype field = 0; field < count; ++field)
+            change.values.insert(column + int(field), fieldValue(fields[field]));
+        changes->append(change);
+    }
+    return true;
+}
@@ -0,0 +1,60 @@
+#ifndef TABLECLIPBOARD_H
+#define TABLECLIPBOARD_H
+
+#include "batchsubmitter.h"
+#include <QCoreApplication>
+#include <QItemSelection>
+#include <QMimeData>
+
+class QAbstractItemModel;
+class PagedTableModel;
+
+// Содержимое буфера обмена для выделения таблицы. Сразу хранится только TSV,
+// CSV и HTML строятся из него при первом запросе получателя.
+class TableMimeData : public QMimeData
+{
+    Q_OBJECT
+
+public:
+    explicit TableMimeData(const QByteArray &tsv);
+
+    QStringList formats() const override;
+    bool hasFormat(const QString &mimeType) const override;
+
+protected:
+    QVariant retrieveData(const QString &mimeType, QMetaType type) const override;
+
+private:
+    QByteArray tsv;
+    mutable QByteArray csv;
+    mutable QByteArray html;
+};
+
+// Копирование и вставка прямоугольных выделений.
+// Копирование идёт по диапазонам выделения: строки PagedTableModel без несохранённых
+// правок читаются одним курсором на диапазон прямо из базы, без data() на каждую ячейку,
+// и пишутся в TSV в буфер, размер которого оценивается по первым строкам.
+// Вставка разбирает TSV через CsvParser и превращает его в правки для BatchSubmitter:
+// строки поверх существующих обновляются, за последней строкой добавляются.
+class TableClipboard
+{
+    Q_DECLARE_TR_FUNCTIONS(TableClipboard)
+
+public:
+    // Несмежные диапазоны сводятся в общую сетку строк и столбцов, невыделенные ячейки пустые
+    static QByteArray copy(const QAbstractItemModel *model, const QItemSelection &selection,
+                           qint64 *cells = nullptr, QString *error = nullptr);
+
+    // Правки для вставки TSV с ячейки (row, column); у модели не должно быть несохранённых правок
+    static bool pasteChanges(const PagedTableModel *model, int row, int column, const QByteArray &tsv,
+                             QList<RowChange> *changes, QString *error);
+
+    // NULL - пустое поле, пустая строка - "", поля с табуляцией, переводом строки или кавычкой - в кавычках
+    static void appendField(QByteArray &out, const char *data, qsizetype size, char delimiter = '\t');
+
+private:
+    static constexpr int SampleRows = 256;
+    static constexpr qsizetype MaxReserve = 256 * 1024 * 1024;
+};
+
+#endif // TABLECLIPBOARD_H
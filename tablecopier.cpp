@@ -0,0 +1,587 @@
+#include "tablecopier.h"
+#include <QFile>
+#include <QFileInfo>
+#include <QMutex>
+#include <QThread>
+#include <QThreadPool>
+#include <QWaitCondition>
+
+#include <sqlite3.h>
+
+#include <atomic>
+#include <deque>
+#include <vector>
+
+static bool execSql(sqlite3 *db, const QByteArray &sql, QString *error = nullptr)
+{
+    char *message = nullptr;
+    const int rc = sqlite3_exec(db, sql.constData(), nullptr, nullptr, &message);
+    if (rc != SQLITE_OK && error)
+        *error = QString::fromUtf8(message ? message : sqlite3_errmsg(db));
+    sqlite3_free(message);
+    return rc == SQLITE_OK;
+}
+
+static bool hasTable(sqlite3 *db, const QString &table)
+{
+    sqlite3_stmt *stmt = nullptr;
+    const QByteArray name = table.toUtf8();
+    bool exists = false;
+    if (sqlite3_prepare_v2(db, "SELECT 1 FROM sqlite_master WHERE type = 'table' AND name = ?1 COLLATE NOCASE",
+                           -1, &stmt, nullptr) == SQLITE_OK) {
+        sqlite3_bind_text(stmt, 1, name.constData(), int(name.size()), SQLITE_STATIC);
+        exists = sqlite3_step(stmt) == SQLITE_ROW;
+    }
+    sqlite3_finalize(stmt);
+    return exists;
+}
+
+static bool isWal(sqlite3 *db)
+{
+    sqlite3_stmt *stmt = nullptr;
+    bool wal = false;
+    if (sqlite3_prepare_v2(db, "PRAGMA journal_mode", -1, &stmt, nullptr) == SQLITE_OK
+        && sqlite3_step(stmt) == SQLITE_ROW)
+        wal = qstricmp(reinterpret_cast<const char *>(sqlite3_column_text(stmt, 0)), "wal") == 0;
+    sqlite3_finalize(stmt);
+    return wal;
+}
+
+// Читатель держит одну транзакцию на все свои диапазоны, в режиме WAL - на снимке из run()
+static bool beginReader(sqlite3 *reader, sqlite3_snapshot *snapshot, QString *error)
+{
+    if (!execSql(reader, "BEGIN", error))
+        return false;
+#ifdef CACHEDTABLE_WITH_SNAPSHOT
+    if (snapshot && sqlite3_snapshot_open(reader, "main", snapshot) != SQLITE_OK) {
+        *error = QString::fromUtf8(sqlite3_errmsg(reader));
+        execSql(reader, "ROLLBACK");
+        return false;
+    }
+#else
+    Q_UNUSED(snapshot);
+#endif
+    return true;
+}
+
+namespace {
+
+struct CopyValue
+{
+    int type = SQLITE_NULL;
+    qint64 integer = 0;
+    double real = 0;
+    qsizetype offset = 0;   // текст и BLOB лежат подряд в RowBatch::storage
+    int size = 0;
+};
+
+// Пакет строк от читателя к писателю
+struct RowBatch
+{
+    std::vector<CopyValue> values;
+    QByteArray storage;
+    int rows = 0;
+};
+
+// Очередь пакетов ограничена, чтобы читатели не обгоняли писателя на всю таблицу
+class BatchQueue
+{
+public:
+    BatchQueue(int capacity, int producers)
+        : capacity(size_t(capacity)),
+        producers(producers)
+    {
+    }
+
+    bool push(RowBatch &&batch)
+    {
+        QMutexLocker locker(&mutex);
+        while (!aborted && batches.size() >= capacity)
+            notFull.wait(&mutex);
+        if (aborted)
+            return false;
+        batches.push_back(std::move(batch));
+        notEmpty.wakeOne();
+        return true;
+    }
+
+    // false - читатели закончили и очередь пуста, либо работа прервана
+    bool pop(RowBatch *batch)
+    {
+        QMutexLocker locker(&mutex);
+        while (!aborted && batches.empty() && producers > 0)
+            notEmpty.wait(&mutex);
+        if (aborted || batches.empty())
+            return false;
+        *batch = std::move(batches.front());
+        batches.pop_front();
+        notFull.wakeOne();
+        return true;
+    }
+
+    void producerFinished()
+    {
+        QMutexLocker locker(&mutex);
+        --producers;
+        notEmpty.wakeAll();
+    }
+
+    void abort()
+    {
+        QMutexLocker locker(&mutex);
+        aborted = true;
+        notEmpty.wakeAll();
+        notFull.wakeAll();
+    }
+
+private:
+    QMutex mutex;
+    QWaitCondition notEmpty;
+    QWaitCondition notFull;
+    std::deque<RowBatch> batches;
+    size_t capacity;
+    int producers;
+    bool aborted = false;
+};
+
+struct RowidRange
+{
+    qint64 from;
+    qint64 to;
+};
+
+} // namespace
+
+static void appendRow(sqlite3_stmt *stmt, int columnCount, RowBatch *batch)
+{
+    for (int i = 0; i < columnCount; ++i) {
+        CopyValue value;
+        value.type = sqlite3_column_type(stmt, i);
+        switch (value.type) {
+        case SQLITE_INTEGER:
+            value.integer = sqlite3_column_int64(stmt, i);
+            break;
+        case SQLITE_FLOAT:
+            value.real = sqlite3_column_double(stmt, i);
+            break;
+        case SQLITE_TEXT:
+        case SQLITE_BLOB: {
+            const void *data = value.type == SQLITE_TEXT ? static_cast<const void *>(sqlite3_column_text(stmt, i))
+                                                         : sqlite3_column_blob(stmt, i);
+            value.size = sqlite3_column_bytes(stmt, i);
+            value.offset = batch->storage.size();
+            batch->storage.append(static_cast<const char *>(data), value.size);
+            break;
+        }
+        default:
+            break;
+        }
+        batch->values.push_back(value);
+    }
+    ++batch->rows;
+}
+
+static int bindValue(sqlite3_stmt *stmt, int index, const RowBatch &batch, size_t position)
+{
+    const CopyValue &value = batch.values[position];
+    switch (value.type) {
+    case SQLITE_INTEGER:
+        return sqlite3_bind_int64(stmt, index, value.integer);
+    case SQLITE_FLOAT:
+        return sqlite3_bind_double(stmt, index, value.real);
+    case SQLITE_TEXT:
+        return sqlite3_bind_text(stmt, index, batch.storage.constData() + value.offset, value.size, SQLITE_STATIC);
+    case SQLITE_BLOB:
+        // constData() пустого массива не нулевой, поэтому пустой BLOB не станет NULL
+        return sqlite3_bind_blob(stmt, index, batch.storage.constData() + value.offset, value.size, SQLITE_STATIC);
+    default:
+        return sqlite3_bind_null(stmt, index);
+    }
+}
+
+TableCopier::TableCopier(const QString &targetFile, const QStringList &tables, const TableCopyOptions &options,
+                         const QString &sourceConnection, QObject *parent)
+    : BackgroundJob(parent),
+    targetFile(targetFile),
+    tables(tables),
+    options(options),
+    sourceConnection(sourceConnection)
+{
+}
+
+void TableCopier::run()
+{
+    timer.start();
+    lastProgressMs = 0;
+    copiedRows = 0;
+    tableCount = 0;
+
+    ScopedConnection connection(sourceConnection, QStringLiteral("copy"));
+    sqlite3 *db = connection.open() ? connection.handle() : nullptr;
+    if (!db) {
+        emit failed(connection.lastError().text());
+        return;
+    }
+
+    const QString sourceFile = QString::fromUtf8(sqlite3_db_filename(db, "main"));
+    if (!sourceFile.isEmpty()
+        && QFileInfo(sourceFile).canonicalFilePath() == QFileInfo(targetFile).canonicalFilePath()) {
+        emit failed(tr("Нельзя копировать таблицы в ту же базу"));
+        return;
+    }
+
+    QString errorText;
+    if (!beginRead(db, &errorText)) {
+        emit failed(errorText);
+        return;
+    }
+
+    QList<TableSchema> schemas;
+    for (const QString &table : std::as_const(tables)) {
+        TableSchema schema;
+        if (!readSchema(db, table, &schema, &errorText)) {
+            endRead(db);
+            emit failed(errorText);
+            return;
+        }
+        // Содержимое виртуальной таблицы живёт в её теневых таблицах или вовсе вне базы
+        if (schema.isVirtual)
+            emit warning(tr("Виртуальная таблица %1 пропущена").arg(table));
+        else
+            schemas << schema;
+    }
+
+    tableCount = int(schemas.size());
+
+    const bool targetExisted = QFileInfo::exists(targetFile);
+    sqlite3 *target = nullptr;
+    if (sqlite3_open_v2(targetFile.toUtf8().constData(), &target,
+                        SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, nullptr) != SQLITE_OK) {
+        emit failed(target ? QString::fromUtf8(sqlite3_errmsg(target))
+                           : tr("Не удалось открыть базу %1").arg(targetFile));
+        sqlite3_close_v2(target);
+        endRead(db);
+        return;
+    }
+    sqlite3_busy_timeout(target, 5000);
+    // Таблицы копируются в произвольном порядке, ссылки между ними проверять рано
+    execSql(target, "PRAGMA foreign_keys = OFF");
+    interrupter.attach(target);
+
+    int copied = 0;
+    if (execSql(target, "BEGIN IMMEDIATE", &errorText)) {
+        for (int i = 0; i < schemas.size() && !isCancelled(); ++i) {
+            if (!copyTable(db, target, schemas.at(i), i, &errorText))
+                break;
+            ++copied;
+        }
+
+        if (errorText.isEmpty() && !isCancelled()) {
+            if (!execSql(target, "COMMIT", &errorText))
+                execSql(target, "ROLLBACK");
+        } else {
+            execSql(target, "ROLLBACK");
+        }
+    }
+
+    interrupter.detach();
+    sqlite3_close_v2(target);
+    endRead(db);
+
+    if (!targetExisted && (isCancelled() || !errorText.isEmpty()))
+        QFile::remove(targetFile);
+
+    if (isCancelled())
+        emit cancelled();
+    else if (!errorText.isEmpty())
+        emit failed(errorText);
+    else
+        emit finished(copied, copiedRows, timer.elapsed());
+}
+
+bool TableCopier::hasSnapshots()
+{
+#ifdef CACHEDTABLE_WITH_SNAPSHOT
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool TableCopier::beginRead(sqlite3 *db, QString *error)
+{
+    // Транзакция чтения начинается с первого запроса после BEGIN и держится до конца копирования
+    if (!execSql(db, "BEGIN", error) || !execSql(db, "SELECT 1 FROM sqlite_master LIMIT 1", error)) {
+        execSql(db, "ROLLBACK");
+        return false;
+    }
+#ifdef CACHEDTABLE_WITH_SNAPSHOT
+    // Вне WAL снимка нет; пока транзакция открыта, контрольная точка его не затрёт
+    if (sqlite3_snapshot_get(db, "main", &snapshot) != SQLITE_OK)
+        snapshot = nullptr;
+#endif
+    if (!snapshot && isWal(db))
+        emit warning(tr("Потоки чтения могут увидеть разные версии базы, если в неё пишут во время копирования"));
+    return true;
+}
+
+void TableCopier::endRead(sqlite3 *db)
+{
+#ifdef CACHEDTABLE_WITH_SNAPSHOT
+    sqlite3_snapshot_free(snapshot);
+#endif
+    snapshot = nullptr;
+    execSql(db, "COMMIT");
+}
+
+bool TableCopier::readSchema(sqlite3 *db, const QString &table, TableSchema *schema, QString *error)
+{
+    schema->name = table;
+    const QByteArray name = table.toUtf8();
+
+    sqlite3_stmt *stmt = nullptr;
+    if (sqlite3_prepare_v2(db, "SELECT type, sql FROM sqlite_master WHERE tbl_name = ?1 COLLATE NOCASE"
+                               " AND sql IS NOT NULL AND type IN ('table', 'index', 'trigger')",
+                           -1, &stmt, nullptr) != SQLITE_OK) {
+        *error = QString::fromUtf8(sqlite3_errmsg(db));
+        return false;
+    }
+    sqlite3_bind_text(stmt, 1, name.constData(), int(name.size()), SQLITE_STATIC);
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        const QByteArray type = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 0));
+        const QByteArray sql = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 1));
+        if (type == "table")
+            schema->createSql = sql;
+        else
+            schema->deferredSql << sql;
+    }
+    sqlite3_finalize(stmt);
+
+    if (schema->createSql.isEmpty()) {
+        *error = tr("Таблица %1 не найдена").arg(table);
+        return false;
+    }
+    schema->isVirtual = schema->createSql.left(32).simplified().toUpper().startsWith("CREATE VIRTUAL");
+    if (schema->isVirtual)
+        return true;
+
+    int primaryKeys = 0;
+    bool integerKey = false;
+    if (sqlite3_prepare_v2(db, "SELECT name, type, pk FROM pragma_table_info(?1)", -1, &stmt, nullptr) == SQLITE_OK) {
+        sqlite3_bind_text(stmt, 1, name.constData(), int(name.size()), SQLITE_STATIC);
+        while (sqlite3_step(stmt) == SQLITE_ROW) {
+            schema->columns << QString::fromUtf8(reinterpret_cast<const char *>(sqlite3_column_text(stmt, 0)));
+            if (sqlite3_column_int(stmt, 2) > 0) {
+                ++primaryKeys;
+                integerKey = qstricmp(reinterpret_cast<const char *>(sqlite3_column_text(stmt, 1)), "INTEGER") == 0;
+            }
+        }
+    }
+    sqlite3_finalize(stmt);
+
+    // Для WITHOUT ROWID запрос rowid не компилируется
+    const QByteArray probe = "SELECT rowid FROM " + quoteIdentifier(table).toUtf8() + " LIMIT 0";
+    schema->hasRowid = sqlite3_prepare_v2(db, probe.constData(), -1, &stmt, nullptr) == SQLITE_OK;
+    sqlite3_finalize(stmt);
+    schema->rowidAliased = schema->hasRowid && primaryKeys == 1 && integerKey;
+    return true;
+}
+
+bool TableCopier::copyTable(sqlite3 *db, sqlite3 *target, const TableSchema &schema, int tableIndex, QString *error)
+{
+    const QByteArray table = quoteIdentifier(schema.name).toUtf8();
+    const bool incremental = options.incremental && hasTable(target, schema.name);
+    const QString updated = !options.updatedColumn.isEmpty()
+                                    && schema.columns.contains(options.updatedColumn, Qt::CaseInsensitive)
+                                ? options.updatedColumn
+                                : QString();
+
+    reportProgress(schema.name, tableIndex, 0, true);
+
+    if (!incremental) {
+        if (!execSql(target, "DROP TABLE IF EXISTS " + table, error) || !execSql(target, schema.createSql, error))
+            return false;
+    }
+
+    // Граница инкрементального режима берётся из самой целевой таблицы, отдельного журнала синхронизаций нет
+    RowBatch watermark;
+    if (incremental && (!updated.isEmpty() || schema.hasRowid)) {
+        const QByteArray column = updated.isEmpty() ? QByteArray("rowid") : quoteIdentifier(updated).toUtf8();
+        const QByteArray sql = "SELECT max(" + column + ") FROM " + table;
+        sqlite3_stmt *stmt = nullptr;
+        if (sqlite3_prepare_v2(target, sql.constData(), int(sql.size()), &stmt, nullptr) != SQLITE_OK) {
+            *error = QString::fromUtf8(sqlite3_errmsg(target));
+            return false;
+        }
+        if (sqlite3_step(stmt) == SQLITE_ROW && sqlite3_column_type(stmt, 0) != SQLITE_NULL)
+            appendRow(stmt, 1, &watermark);
+        sqlite3_finalize(stmt);
+    }
+
+    // Диапазоны rowid для параллельного чтения; таблица WITHOUT ROWID читается целиком одним потоком
+    const int readers = options.readers > 0 ? options.readers : qMax(1, QThread::idealThreadCount() - 1);
+    QList<RowidRange> ranges;
+    if (!schema.hasRowid) {
+        ranges << RowidRange { 0, 0 };
+    } else {
+        const QByteArray sql = "SELECT min(rowid), max(rowid) FROM " + table;
+        sqlite3_stmt *stmt = nullptr;
+        if (sqlite3_prepare_v2(db, sql.constData(), int(sql.size()), &stmt, nullptr) == SQLITE_OK
+            && sqlite3_step(stmt) == SQLITE_ROW && sqlite3_column_type(stmt, 0) != SQLITE_NULL) {
+            qint64 low = sqlite3_column_int64(stmt, 0);
+            const qint64 high = sqlite3_column_int64(stmt, 1);
+            if (incremental && updated.isEmpty() && watermark.rows > 0) {
+                const qint64 copiedUpTo = watermark.values.front().integer;
+                low = copiedUpTo < high ? qMax(low, copiedUpTo + 1) : high + 1;
+            }
+            if (low <= high) {
+                // Разреженные rowid дают неравные диапазоны, зато их число ограничено
+                const quint64 span = quint64(high) - quint64(low);
+                const quint64 pieces = readers > 1 ? qMin<quint64>(quint64(readers) * RangesPerReader,
+                                                                   span / MinRangeSpan + 1)
+                                                   : 1;
+                const quint64 step = span / pieces + 1;
+                for (quint64 i = 0; i < pieces; ++i) {
+                    const qint64 from = qint64(quint64(low) + i * step);
+                    ranges << RowidRange { from, i + 1 == pieces ? high : qint64(quint64(from) + step - 1) };
+                }
+            }
+        }
+        sqlite3_finalize(stmt);
+    }
+
+    QStringList quoted;
+    if (schema.hasRowid && !schema.rowidAliased)
+        quoted << QStringLiteral("rowid");
+    for (const QString &column : schema.columns)
+        quoted << quoteIdentifier(column);
+    const QByteArray columnList = quoted.join(QLatin1String(", ")).toUtf8();
+    const int columnCount = int(quoted.size());
+
+    QByteArray selectSql = "SELECT " + columnList + " FROM " + table;
+    QList<QByteArray> conditions;
+    if (schema.hasRowid)
+        conditions << "rowid BETWEEN ?1 AND ?2";
+    if (!updated.isEmpty() && watermark.rows > 0)
+        conditions << quoteIdentifier(updated).toUtf8() + " >= ?3";
+    if (!conditions.isEmpty())
+        selectSql += " WHERE " + conditions.join(" AND ");
+
+    const QByteArray insertSql = QByteArray(incremental ? "INSERT OR REPLACE INTO " : "INSERT INTO ") + table
+                                 + " (" + columnList + ") VALUES ("
+                                 + QByteArray("?, ").repeated(columnCount).chopped(2) + ")";
+    sqlite3_stmt *insert = nullptr;
+    if (sqlite3_prepare_v2(target, insertSql.constData(), int(insertSql.size()), &insert, nullptr) != SQLITE_OK) {
+        *error = QString::fromUtf8(sqlite3_errmsg(target));
+        return false;
+    }
+
+    const int threads = int(qMin<qsizetype>(readers, ranges.size()));
+    BatchQueue queue(threads * 2, threads);
+    std::atomic<int> nextRange { 0 };
+    std::atomic<int> rangesDone { 0 };
+    QMutex readErrorMutex;
+    QString readError;
+
+    auto read = [&] {
+        ScopedConnection readConnection(sourceConnection, QStringLiteral("copy"));
+        sqlite3 *reader = readConnection.open() ? readConnection.handle() : nullptr;
+        sqlite3_stmt *stmt = nullptr;
+        QString readerError;
+        bool began = false;
+        if (!reader)
+            readerError = readConnection.lastError().text();
+        else if ((began = beginReader(reader, snapshot, &readerError))
+                 && sqlite3_prepare_v2(reader, selectSql.constData(), int(selectSql.size()), &stmt, nullptr) != SQLITE_OK)
+            readerError = QString::fromUtf8(sqlite3_errmsg(reader));
+
+        for (int index = nextRange++; readerError.isEmpty() && index < ranges.size(); index = nextRange++) {
+            sqlite3_bind_int64(stmt, 1, ranges.at(index).from);
+            sqlite3_bind_int64(stmt, 2, ranges.at(index).to);
+            if (!updated.isEmpty() && watermark.rows > 0)
+                bindValue(stmt, 3, watermark, 0);
+
+            RowBatch batch;
+            bool pushed = true;
+            int rc = SQLITE_DONE;
+            while (pushed && !isCancelled() && (rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+                appendRow(stmt, columnCount, &batch);
+                if (batch.rows >= BatchRows || batch.storage.size() >= BatchBytes) {
+                    pushed = queue.push(std::move(batch));
+                    batch = RowBatch();
+                }
+            }
+            if (rc != SQLITE_ROW && rc != SQLITE_DONE)
+                readerError = QString::fromUtf8(sqlite3_errmsg(reader));
+            sqlite3_reset(stmt);
+
+            if (!pushed || isCancelled() || !readerError.isEmpty()
+                || (batch.rows > 0 && !queue.push(std::move(batch))))
+                break;
+            ++rangesDone;
+        }
+        sqlite3_finalize(stmt);
+        if (began)
+            execSql(reader, "COMMIT");
+
+        if (!readerError.isEmpty()) {
+            QMutexLocker locker(&readErrorMutex);
+            if (readError.isEmpty())
+                readError = readerError;
+            queue.abort();
+        }
+        queue.producerFinished();
+    };
+
+    QThreadPool readPool;
+    readPool.setMaxThreadCount(qMax(1, threads));
+    for (int i = 0; i < threads; ++i)
+        readPool.start(read);
+
+    // Единственный писатель; порядок пакетов не важен, rowid вставляется явно
+    RowBatch batch;
+    while (error->isEmpty() && queue.pop(&batch)) {
+        for (int row = 0; row < batch.rows; ++row) {
+            const size_t first = size_t(row) * size_t(columnCount);
+            for (int column = 0; column < columnCount; ++column)
+                bindValue(insert, column + 1, batch, first + size_t(column));
+            if (sqlite3_step(insert) != SQLITE_DONE) {
+                *error = QString::fromUtf8(sqlite3_errmsg(target));
+                sqlite3_reset(insert);
+                queue.abort();
+                break;
+            }
+            sqlite3_reset(insert);
+        }
+        copiedRows += batch.rows;
+        reportProgress(schema.name, tableIndex, ranges.isEmpty() ? 1.0 : double(rangesDone) / ranges.size());
+    }
+    readPool.waitForDone();
+    sqlite3_finalize(insert);
+
+    if (error->isEmpty() && !readError.isEmpty())
+        *error = readError;
+    if (!error->isEmpty() || isCancelled())
+        return false;
+
+    // Индексы строятся по уже загруженным данным один раз, а не обновляются на каждой вставке
+    if (!incremental) {
+        for (const QByteArray &sql : schema.deferredSql) {
+            if (!execSql(target, sql, error))
+                return false;
+        }
+    }
+
+    reportProgress(schema.name, tableIndex, 1.0, true);
+    return true;
+}
+
+void TableCopier::reportProgress(const QString &table, int tableIndex, double tableFraction, bool force)
+{
+    const qint64 elapsed = timer.elapsed();
+    if (!force && elapsed - lastProgressMs < ProgressIntervalMs)
+        return;
+    lastProgressMs = elapsed;
+    const int permille = int((tableIndex + tableFraction) * 1000 / qMax(1, tableCount));
+    emit progress(table, copiedRows, permille);
+}
@@ -0,0 +1,91 @@
+#ifndef TABLECOPIER_H
+#define TABLECOPIER_H
+
+#include "backgroundjob.h"
+#include <QElapsedTimer>
+#include <QSqlDatabase>
+#include <QStringList>
+
+struct sqlite3_snapshot;
+
+struct TableCopyOptions
+{
+    // Только строки новее уже скопированных; без этого таблица в целевой базе пересоздаётся
+    bool incremental = false;
+    QString updatedColumn;  // столбец времени изменения; пусто или нет в таблице — сравнение по rowid
+    int readers = 0;        // потоков чтения, 0 — по числу ядер
+};
+
+// Копирование таблиц в другой файл базы вместе со схемой, индексами и триггерами.
+// Писатель один - собственное соединение с целевой базой, всё копирование идёт одной
+// транзакцией. Таблица с rowid делится на диапазоны rowid, которые параллельно читают
+// клоны исходного соединения; индексы и триггеры новой таблицы создаются после загрузки.
+// Всё копирование идёт внутри одной транзакции чтения исходного соединения. В режиме
+// rollback-журнала она не даёт писателям зафиксировать изменения до конца копирования.
+// В режиме WAL читатели открывают тот же снимок (sqlite3_snapshot_open), если SQLite
+// собран с SQLITE_ENABLE_SNAPSHOT; иначе каждый читатель видит базу на момент своего
+// первого запроса, и копия согласована, только если в исходную базу во время копирования не пишут.
+// Инкрементальный режим дописывает строки с rowid больше максимального в целевой
+// таблице, а с updatedColumn - строки, где он не меньше максимального там
+// (INSERT OR REPLACE). Таблицы WITHOUT ROWID без updatedColumn переписываются
+// целиком поверх, удаления не переносятся.
+class TableCopier : public BackgroundJob
+{
+    Q_OBJECT
+
+public:
+    TableCopier(const QString &targetFile, const QStringList &tables,
+                const TableCopyOptions &options = TableCopyOptions(),
+                const QString &sourceConnection = QString::fromLatin1(QSqlDatabase::defaultConnection),
+                QObject *parent = nullptr);
+
+    void run() override;
+
+    // Могут ли параллельные читатели в режиме WAL открыть один снимок базы
+    static bool hasSnapshots();
+
+signals:
+    // permille - доля всей работы в тысячных
+    void progress(const QString &table, qint64 rows, int permille);
+    void warning(const QString &message);
+    void finished(int tables, qint64 rows, qint64 elapsedMs);
+    void cancelled();
+    void failed(const QString &message);
+
+private:
+    struct TableSchema
+    {
+        QString name;
+        QByteArray createSql;
+        QList<QByteArray> deferredSql;  // индексы и триггеры
+        QStringList columns;
+        bool hasRowid = true;
+        bool rowidAliased = false;      // INTEGER PRIMARY KEY: rowid уже среди столбцов
+        bool isVirtual = false;
+    };
+
+    static constexpr int BatchRows = 2048;
+    static constexpr int BatchBytes = 4 * 1024 * 1024;
+    static constexpr int RangesPerReader = 4;
+    static constexpr qint64 MinRangeSpan = 20000;
+    static constexpr int ProgressIntervalMs = 250;
+
+    bool beginRead(sqlite3 *db, QString *error);
+    void endRead(sqlite3 *db);
+    bool readSchema(sqlite3 *db, const QString &table, TableSchema *schema, QString *error);
+    bool copyTable(sqlite3 *db, sqlite3 *target, const TableSchema &schema, int tableIndex, QString *error);
+    void reportProgress(const QString &table, int tableIndex, double tableFraction, bool force = false);
+
+    QString targetFile;
+    QStringList tables;
+    TableCopyOptions options;
+    QString sourceConnection;
+
+    QElapsedTimer timer;
+    qint64 lastProgressMs = 0;
+    qint64 copiedRows = 0;
+    int tableCount = 0;
+    sqlite3_snapshot *snapshot = nullptr;
+};
+
+#endif // TABLECOPIER_H
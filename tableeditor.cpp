@@ -2,28 +2,24 @@
 // SPDX-License-Identifier: LicenseRef-Qt-Commercial OR BSD-3-Clause
 
 #include "tableeditor.h"
+#include "pagedtablemodel.h"
 
 #include <QDialogButtonBox>
 #include <QHBoxLayout>
 #include <QMessageBox>
 #include <QPushButton>
 #include <QSqlError>
-#include <QSqlTableModel>
 #include <QTableView>
 
 //! [0]
 TableEditor::TableEditor(const QString &tableName, QWidget *parent)
     : QWidget(parent)
 {
-    model = new QSqlTableModel(this);
+    // Правки копятся в модели до submit(), как при OnManualSubmit
+    model = new PagedTableModel(this);
     model->setTable(tableName);
-    model->setEditStrategy(QSqlTableModel::OnManualSubmit);
     model->select();
 
-
-    model->setHeaderData(1, Qt::Horizontal, tr("First name"));
-    model->setHeaderData(2, Qt::Horizontal, tr("Last name"));
-
 //! [0] //! [1]
     QTableView *view = new QTableView;
     view->setModel(model);
@@ -44,7 +40,7 @@ TableEditor::TableEditor(const QString &tableName, QWidget *parent)
 
 //! [3]
     connect(submitButton, &QPushButton::clicked, this, &TableEditor::submit);
-    connect(revertButton, &QPushButton::clicked,  model, &QSqlTableModel::revertAll);
+    connect(revertButton, &QPushButton::clicked,  model, &PagedTableModel::revertAll);
     connect(quitButton, &QPushButton::clicked, this, &TableEditor::close);
 //! [3]
 
@@ -61,11 +57,8 @@ TableEditor::TableEditor(const QString &tableName, QWidget *parent)
 //! [5]
 void TableEditor::submit()
 {
-    model->database().transaction();
-    if (model->submitAll()) {
-        model->database().commit();
-    } else {
-        model->database().rollback();
+    // submitAll() сам работает одной транзакцией и откатывает её при ошибке или конфликте
+    if (!model->submitAll()) {
         QMessageBox::warning(this, tr("Cached Table"),
                              tr("The database reported an error: %1")
                              .arg(model->lastError().text()));
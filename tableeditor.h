@@ -8,7 +8,8 @@
 
 QT_FORWARD_DECLARE_CLASS(QDialogButtonBox)
 QT_FORWARD_DECLARE_CLASS(QPushButton)
-QT_FORWARD_DECLARE_CLASS(QSqlTableModel)
+
+class PagedTableModel;
 
 //! [0]
 class TableEditor : public QWidget
@@ -26,7 +27,7 @@ private:
     QPushButton *revertButton;
     QPushButton *quitButton;
     QDialogButtonBox *buttonBox;
-    QSqlTableModel *model;
+    PagedTableModel *model;
 };
 //! [0]
 
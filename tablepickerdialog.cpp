@@ -0,0 +1,129 @@
+#include "tablepickerdialog.h"
+#include <QCoreApplication>
+#include <QDialogButtonBox>
+#include <QItemSelectionModel>
+#include <QKeyEvent>
+#include <QLabel>
+#include <QLineEdit>
+#include <QListView>
+#include <QPushButton>
+#include <QSortFilterProxyModel>
+#include <QStringListModel>
+#include <QVBoxLayout>
+
+TablePickerDialog::TablePickerDialog(const QStringList &tables, QWidget *parent)
+    : QDialog(parent),
+    model(new QStringListModel(tables, this)),
+    proxy(new QSortFilterProxyModel(this)),
+    filterEdit(new QLineEdit(this)),
+    listView(new QListView(this)),
+    label(new QLabel(this))
+{
+    proxy->setSourceModel(model);
+    proxy->setFilterCaseSensitivity(Qt::CaseInsensitive);
+
+    filterEdit->setPlaceholderText(tr("Фильтр по имени (%1 таблиц)").arg(tables.size()));
+    filterEdit->setClearButtonEnabled(true);
+    filterEdit->installEventFilter(this);
+
+    // Одинаковая высота строк: список не меряет каждый элемент
+    listView->setModel(proxy);
+    listView->setUniformItemSizes(true);
+    listView->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    listView->setCurrentIndex(proxy->index(0, 0));
+
+    auto *buttons = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel, Qt::Horizontal, this);
+
+    auto *layout = new QVBoxLayout(this);
+    layout->addWidget(label);
+    layout->addWidget(filterEdit);
+    layout->addWidget(listView);
+    layout->addWidget(buttons);
+    label->hide();
+
+    connect(filterEdit, &QLineEdit::textChanged, this, &TablePickerDialog::updateFilter);
+    connect(listView, &QListView::activated, this, &QDialog::accept);
+    connect(buttons, &QDialogButtonBox::accepted, this, &QDialog::accept);
+    connect(buttons, &QDialogButtonBox::rejected, this, &QDialog::reject);
+
+    resize(400, 500);
+}
+
+void TablePickerDialog::setLabelText(const QString &text)
+{
+    label->setText(text);
+    label->setVisible(!text.isEmpty());
+}
+
+QString TablePickerDialog::selectedTable() const
+{
+    const QModelIndex current = listView->currentIndex();
+    return current.isValid() ? current.data().toString() : QString();
+}
+
+QStringList TablePickerDialog::selectedTables() const
+{
+    QStringList result;
+    const QModelIndexList selected = listView->selectionModel()->selectedIndexes();
+    for (const QModelIndex &index : selected)
+        result << index.data().toString();
+    return result;
+}
+
+void TablePickerDialog::setMultiSelection(bool enabled)
+{
+    listView->setSelectionMode(enabled ? QAbstractItemView::ExtendedSelection
+                                       : QAbstractItemView::SingleSelection);
+    // Enter в многострочном выборе не должен закрывать диалог по одной таблице
+    if (enabled)
+        disconnect(listView, &QListView::activated, this, &QDialog::accept);
+    else
+        connect(listView, &QListView::activated, this, &QDialog::accept, Qt::UniqueConnection);
+}
+
+void TablePickerDialog::updateFilter(const QString &text)
+{
+    proxy->setFilterFixedString(text);
+    if (!listView->currentIndex().isValid())
+        listView->setCurrentIndex(proxy->index(0, 0));
+}
+
+bool TablePickerDialog::eventFilter(QObject *watched, QEvent *event)
+{
+    // Стрелки в поле фильтра листают список, не отнимая фокус у ввода
+    if (watched == filterEdit && event->type() == QEvent::KeyPress) {
+        const int key = static_cast<QKeyEvent *>(event)->key();
+        if (key == Qt::Key_Up || key == Qt::Key_Down || key == Qt::Key_PageUp || key == Qt::Key_PageDown) {
+            QCoreApplication::sendEvent(listView, event);
+            return true;
+        }
+    }
+    return QDialog::eventFilter(watched, event);
+}
+
+QString TablePickerDialog::getTable(QWidget *parent, const QString &title, const QString &label,
+                                    const QStringList &tables, bool *ok)
+{
+    TablePickerDialog dialog(tables, parent);
+    dialog.setWindowTitle(title);
+    dialog.setLabelText(label);
+
+    const bool accepted = dialog.exec() == QDialog::Accepted && !dialog.selectedTable().isEmpty();
+    if (ok)
+        *ok = accepted;
+    return accepted ? dialog.selectedTable() : QString();
+}
+
+QStringList TablePickerDialog::getTables(QWidget *parent, const QString &title, const QString &label,
+                                         const QStringList &tables, bool *ok)
+{
+    TablePickerDialog dialog(tables, parent);
+    dialog.setWindowTitle(title);
+    dialog.setLabelText(label);
+    dialog.setMultiSelection(true);
+
+    const bool accepted = dialog.exec() == QDialog::Accepted && !dialog.selectedTables().isEmpty();
+    if (ok)
+        *ok = accepted;
+    return accepted ? dialog.selectedTables() : QStringList();
+}
@@ -0,0 +1,46 @@
+#ifndef TABLEPICKERDIALOG_H
+#define TABLEPICKERDIALOG_H
+
+#include <QDialog>
+
+class QLabel;
+class QLineEdit;
+class QListView;
+class QSortFilterProxyModel;
+class QStringListModel;
+
+// Выбор таблицы из длинного списка с фильтром по мере ввода.
+// Замена QInputDialog::getItem для баз с тысячами таблиц.
+class TablePickerDialog : public QDialog
+{
+    Q_OBJECT
+
+public:
+    TablePickerDialog(const QStringList &tables, QWidget *parent = nullptr);
+
+    QString selectedTable() const;
+    QStringList selectedTables() const;
+    void setLabelText(const QString &text);
+    // Выбор нескольких таблиц через Ctrl и Shift
+    void setMultiSelection(bool enabled);
+
+    static QString getTable(QWidget *parent, const QString &title, const QString &label,
+                            const QStringList &tables, bool *ok = nullptr);
+    static QStringList getTables(QWidget *parent, const QString &title, const QString &label,
+                                 const QStringList &tables, bool *ok = nullptr);
+
+protected:
+    bool eventFilter(QObject *watched, QEvent *event) override;
+
+private slots:
+    void updateFilter(const QString &text);
+
+private:
+    QStringListModel *model;
+    QSortFilterProxyModel *proxy;
+    QLineEdit *filterEdit;
+    QListView *listView;
+    QLabel *label;
+};
+
+#endif // TABLEPICKERDIALOG_H
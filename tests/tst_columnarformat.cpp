@@ -0,0 +1,287 @@
+#include "../columnarformat.h"
+
+#include <QtTest>
+
+// Колоночный дамп читается из файла, который мог прийти откуда угодно:
+// проверяем, что записанное читается обратно, а испорченное - отвергается без падений
+class TestColumnarFormat : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void headerRoundTrip();
+    void headerRejectsInjectedType();
+    void typeNames_data();
+    void typeNames();
+    void chunkRoundTrip_data();
+    void chunkRoundTrip();
+    void truncatedChunk();
+    void unknownCodec();
+    void oversizedRawSize();
+    void fileRoundTrip();
+};
+
+namespace {
+
+enum Shape { Unique, Repeated, Constant };
+
+// Столбец с целыми, вещественными, строками, BLOB и NULL вперемешку;
+// форма значений определяет, какое кодирование выберет построитель
+ColumnarFormat::ChunkBuilder buildColumn(Shape shape, int rows)
+{
+    ColumnarFormat::ChunkBuilder builder;
+    for (int row = 0; row < rows; ++row) {
+        const int key = shape == Unique ? row : shape == Repeated ? row % 7 : 0;
+        const QByteArray text = "значение " + QByteArray::number(key);
+        switch (shape == Constant ? 2 : row % 5) {
+        case 0:
+            builder.addInteger(qint64(key) * 1000003);
+            break;
+        case 1:
+            builder.addReal(key + 0.25);
+            break;
+        case 2:
+            builder.addBytes(ColumnarFormat::Text, text.constData(), int(text.size()));
+            break;
+        case 3:
+            builder.addBytes(ColumnarFormat::Blob, text.constData(), int(text.size()));
+            break;
+        default:
+            builder.addNull();
+            break;
+        }
+    }
+    return builder;
+}
+
+void checkColumn(const std::vector<ColumnarFormat::Value> &values, Shape shape)
+{
+    for (int row = 0; row < int(values.size()); ++row) {
+        const int key = shape == Unique ? row : shape == Repeated ? row % 7 : 0;
+        const QByteArray text = "значение " + QByteArray::number(key);
+        const ColumnarFormat::Value &value = values[size_t(row)];
+        switch (shape == Constant ? 2 : row % 5) {
+        case 0:
+            QCOMPARE(value.type, quint8(ColumnarFormat::Integer));
+            QCOMPARE(value.integer, qint64(key) * 1000003);
+            break;
+        case 1:
+            QCOMPARE(value.type, quint8(ColumnarFormat::Real));
+            QCOMPARE(value.real, key + 0.25);
+            break;
+        case 2:
+        case 3:
+            QCOMPARE(value.type, quint8(row % 5 == 3 && shape != Constant ? ColumnarFormat::Blob
+                                                                          : ColumnarFormat::Text));
+            QCOMPARE(QByteArray(value.data, value.size), text);
+            break;
+        default:
+            QCOMPARE(value.type, quint8(ColumnarFormat::Null));
+            break;
+        }
+    }
+}
+
+}
+
+void TestColumnarFormat::headerRoundTrip()
+{
+    const QStringList columns = { "id", "имя", "цена" };
+    const QStringList types = { "INTEGER", "VARCHAR(255)", "" };
+    QByteArray file;
+    ColumnarFormat::writeHeader(file, columns, types);
+
+    const char *pos = file.constData();
+    QStringList readColumns;
+    QStringList readTypes;
+    QString error;
+    QVERIFY2(ColumnarFormat::readHeader(pos, file.constData() + file.size(),
+                                        &readColumns, &readTypes, &error), qPrintable(error));
+    QCOMPARE(readColumns, columns);
+    QCOMPARE(readTypes, types);
+    QVERIFY(pos == file.constData() + file.size());
+}
+
+void TestColumnarFormat::headerRejectsInjectedType()
+{
+    QByteArray file;
+    ColumnarFormat::writeHeader(file, { "id" }, { "INT); DROP TABLE users; --" });
+
+    const char *pos = file.constData();
+    QStringList columns;
+    QStringList types;
+    QString error;
+    QVERIFY(!ColumnarFormat::readHeader(pos, file.constData() + file.size(), &columns, &types, &error));
+    QVERIFY(!error.isEmpty());
+}
+
+void TestColumnarFormat::typeNames_data()
+{
+    QTest::addColumn<QString>("type");
+    QTest::addColumn<bool>("valid");
+
+    QTest::newRow("empty") << QString() << true;
+    QTest::newRow("integer") << QStringLiteral("INTEGER") << true;
+    QTest::newRow("varchar") << QStringLiteral("VARCHAR(255)") << true;
+    QTest::newRow("numeric") << QStringLiteral("NUMERIC(10, 2)") << true;
+    QTest::newRow("words") << QStringLiteral("UNSIGNED BIG INT") << true;
+    QTest::newRow("injection") << QStringLiteral("INT); DROP TABLE users; --") << false;
+    QTest::newRow("comment") << QStringLiteral("INT -- x") << false;
+    QTest::newRow("constraint") << QStringLiteral("INT CHECK(id > 0)") << false;
+    QTest::newRow("newline") << QStringLiteral("INT\n") << false;
+    QTest::newRow("quote") << QStringLiteral("\"INT\"") << false;
+}
+
+void TestColumnarFormat::typeNames()
+{
+    QFETCH(QString, type);
+    QFETCH(bool, valid);
+    QCOMPARE(ColumnarFormat::isTypeName(type), valid);
+}
+
+void TestColumnarFormat::chunkRoundTrip_data()
+{
+    QTest::addColumn<int>("shape");
+    QTest::addColumn<bool>("compress");
+
+    QTest::newRow("plain") << int(Unique) << false;
+    QTest::newRow("plain, compressed") << int(Unique) << true;
+    QTest::newRow("dictionary") << int(Repeated) << false;
+    QTest::newRow("dictionary, compressed") << int(Repeated) << true;
+    QTest::newRow("runs") << int(Constant) << false;
+    QTest::newRow("runs, compressed") << int(Constant) << true;
+}
+
+void TestColumnarFormat::chunkRoundTrip()
+{
+    QFETCH(int, shape);
+    QFETCH(bool, compress);
+
+    const int rows = 5000;
+    ColumnarFormat::ChunkBuilder builder = buildColumn(Shape(shape), rows);
+    QByteArray chunk;
+    builder.flush(chunk, compress);
+    QCOMPARE(builder.rowCount(), 0);
+
+    const char *pos = chunk.constData();
+    std::vector<ColumnarFormat::Value> values;
+    QByteArray storage;
+    QString error;
+    QVERIFY2(ColumnarFormat::readChunk(pos, chunk.constData() + chunk.size(), rows,
+                                       values, storage, &error), qPrintable(error));
+    QVERIFY(pos == chunk.constData() + chunk.size());
+    QCOMPARE(int(values.size()), rows);
+    checkColumn(values, Shape(shape));
+}
+
+void TestColumnarFormat::truncatedChunk()
+{
+    for (int shape = Unique; shape <= Constant; ++shape) {
+        ColumnarFormat::ChunkBuilder builder = buildColumn(Shape(shape), 300);
+        QByteArray chunk;
+        builder.flush(chunk, true);
+
+        // Любой обрезанный фрагмент - ошибка, а не чтение за концом буфера
+        for (qsizetype length = 0; length < chunk.size(); ++length) {
+            const QByteArray part = chunk.left(length);
+            const char *pos = part.constData();
+            std::vector<ColumnarFormat::Value> values;
+            QByteArray storage;
+            QString error;
+            QVERIFY(!ColumnarFormat::readChunk(pos, part.constData() + part.size(), 300,
+                                               values, storage, &error));
+            QVERIFY(!error.isEmpty());
+        }
+    }
+}
+
+void TestColumnarFormat::unknownCodec()
+{
+    ColumnarFormat::ChunkBuilder builder = buildColumn(Unique, 100);
+    QByteArray chunk;
+    builder.flush(chunk, false);
+    chunk[1] = char(7);
+
+    const char *pos = chunk.constData();
+    std::vector<ColumnarFormat::Value> values;
+    QByteArray storage;
+    QString error;
+    QVERIFY(!ColumnarFormat::readChunk(pos, chunk.constData() + chunk.size(), 100, values, storage, &error));
+    QVERIFY(!error.isEmpty());
+}
+
+void TestColumnarFormat::oversizedRawSize()
+{
+    if (!ColumnarFormat::hasZstd())
+        QSKIP("Собрано без zstd");
+
+    ColumnarFormat::ChunkBuilder builder = buildColumn(Constant, 5000);
+    QByteArray chunk;
+    builder.flush(chunk, true);
+    // Кодирование сериями даёт слишком короткий фрагмент для сжатия,
+    // поэтому сжимаемый фрагмент берём из повторяющегося столбца
+    if (quint8(chunk[1]) != ColumnarFormat::Zstd) {
+        builder = buildColumn(Repeated, 5000);
+        chunk.clear();
+        builder.flush(chunk, true);
+    }
+    QCOMPARE(quint8(chunk[1]), quint8(ColumnarFormat::Zstd));
+
+    // Заявленный размер распакованных данных - 4 ГБ: читатель не должен его выделять
+    for (int i = 4; i < 8; ++i)
+        chunk[i] = char(0xff);
+
+    const char *pos = chunk.constData();
+    std::vector<ColumnarFormat::Value> values;
+    QByteArray storage;
+    QString error;
+    QVERIFY(!ColumnarFormat::readChunk(pos, chunk.constData() + chunk.size(), 5000, values, storage, &error));
+    QVERIFY(!error.isEmpty());
+    QVERIFY(storage.size() < 1024 * 1024);
+}
+
+void TestColumnarFormat::fileRoundTrip()
+{
+    const int groups = 3;
+    const int rows = 1000;
+    QByteArray file;
+    ColumnarFormat::writeHeader(file, { "a", "b" }, { "INTEGER", "TEXT" });
+    for (int group = 0; group < groups; ++group) {
+        ColumnarFormat::writeGroupStart(file, rows);
+        buildColumn(Unique, rows).flush(file, true);
+        buildColumn(Repeated, rows).flush(file, true);
+    }
+    ColumnarFormat::writeEnd(file, qint64(groups) * rows);
+
+    const char *pos = file.constData();
+    const char *end = file.constData() + file.size();
+    QStringList columns;
+    QStringList types;
+    QString error;
+    QVERIFY2(ColumnarFormat::readHeader(pos, end, &columns, &types, &error), qPrintable(error));
+
+    qint64 total = 0;
+    int rowCount = 0;
+    std::vector<ColumnarFormat::Value> values;
+    QByteArray storage;
+    while (true) {
+        QVERIFY2(ColumnarFormat::readGroupStart(pos, end, &rowCount, &error), qPrintable(error));
+        if (rowCount == 0)
+            break;
+        QCOMPARE(rowCount, rows);
+        QVERIFY2(ColumnarFormat::readChunk(pos, end, rowCount, values, storage, &error), qPrintable(error));
+        checkColumn(values, Unique);
+        QVERIFY2(ColumnarFormat::readChunk(pos, end, rowCount, values, storage, &error), qPrintable(error));
+        checkColumn(values, Repeated);
+        total += rowCount;
+    }
+    QVERIFY2(ColumnarFormat::readEnd(pos, end, total, &error), qPrintable(error));
+    QCOMPARE(total, qint64(groups) * rows);
+
+    // Итог, не совпадающий с прочитанным, - признак потерянной группы
+    const char *endPos = file.constData() + file.size() - 8;
+    QVERIFY(!ColumnarFormat::readEnd(endPos, end, total - 1, &error));
+}
+
+QTEST_GUILESS_MAIN(TestColumnarFormat)
+#include "tst_columnarformat.moc"